@@ -112,12 +112,15 @@ SOURCES += \
     app/util/WorkaroundMessageBox.cpp \
     app/util/qrenderstats.cpp \
     app/util/restartqopenhdmessagebox.cpp \
+    app/util/batchedpropertypublisher.cpp \
+    app/util/settingscache.cpp \
     app/main.cpp \
 
 HEADERS += \
     app/common/util_fs.h \
     app/common/StringHelper.hpp \
     app/common/TimeHelper.hpp \
+    app/common/SeqLock.hpp \
     app/common/Helper.hpp \
     app/logging/hudlogmessagesmodel.h \
     app/logging/loghelper.h \
@@ -126,6 +129,8 @@ HEADERS += \
     app/util/WorkaroundMessageBox.h \
     app/util/qrenderstats.h \
     app/util/restartqopenhdmessagebox.h \
+    app/util/batchedpropertypublisher.h \
+    app/util/settingscache.h \
 
 
 # Geographic lib updated to c-2.0, so much cleaner
@@ -18,7 +18,7 @@
 #include <QNetworkRequest>
 
 #include <QGeoCoordinate>
-#include <QSettings>
+#include "util/settingscache.h"
 
 // This is a base clase for inheriting the links for
 // SDR and Opensky network apis
@@ -62,7 +62,7 @@ protected:
     int timer_interval;
     QTimer *timer;
 
-    QSettings _settings;
+    SettingsCache& _settings=SettingsCache::instance();
 
     QGeoCoordinate _api_center_coord; //private but duplicated across classes
 
@@ -159,5 +159,5 @@ private:
     uint                            _status = 0;
 
     qreal distance = 0;
-    QSettings _settings;
+    SettingsCache& _settings=SettingsCache::instance();
 };
@@ -228,6 +228,8 @@ void Adsb::processReply(QNetworkReply *reply){
         }
 
 
+        // Not the UI thread - use the lock free snapshot of the FC state
+        const auto vehicle_state=FCMavlinkSystem::instance().get_vehicle_state();
         foreach (const QJsonValue & val, array){
 
             callsign=val.toObject().value("flight").toString();
@@ -252,7 +254,7 @@ void Adsb::processReply(QNetworkReply *reply){
 
 
             //calculate distance from center of map so we can sort in marker model
-            distance = calculateKmDistance(FCMavlinkSystem::instance().lat(), FCMavlinkSystem::instance().lon(), lat, lon);
+            distance = calculateKmDistance(vehicle_state.lat, vehicle_state.lon, lat, lon);
             emit addMarker(current_row, last_row, Traffic(callsign,contact,lat,lon,alt,velocity,track,vertical,distance));
             current_row=current_row+1;
 
@@ -311,6 +313,8 @@ void Adsb::processReply(QNetworkReply *reply){
             return;
         }
 
+        // Not the UI thread - use the lock free snapshot of the FC state
+        const auto vehicle_state=FCMavlinkSystem::instance().get_vehicle_state();
         foreach (const QJsonValue & v, array){
             QJsonArray innerarray = v.toArray();
 
@@ -328,7 +332,7 @@ void Adsb::processReply(QNetworkReply *reply){
 
             //calculate distance from center of map so we can sort in marker model
 
-            distance = calculateKmDistance(FCMavlinkSystem::instance().lat(), FCMavlinkSystem::instance().lon(), lat, lon);
+            distance = calculateKmDistance(vehicle_state.lat, vehicle_state.lon, lat, lon);
             emit addMarker(current_row, last_row, Traffic(callsign,contact,lat,lon,alt,velocity,track,vertical,distance));
 
             evaluateTraffic(callsign, contact, lat, lon, alt, velocity, track, vertical, distance);
@@ -371,7 +375,7 @@ void Adsb::evaluateTraffic(QString traffic_callsign,
      *  need to calculate azimuth and bearing of any threats so that it can be shared
      *  and depicted in the adsb widget
      */
-    int drone_alt = FCMavlinkSystem::instance().altitude_msl_m();
+    int drone_alt = FCMavlinkSystem::instance().get_vehicle_state().altitude_msl_m;
 
     if (traffic_alt - drone_alt < 300 && traffic_distance < 2) {
 //        LocalMessage::instance()->showMessage("Aircraft Traffic", 3);
@@ -15,6 +15,7 @@
 #include <QJsonValue>
 
 #include "markermodel.h"
+#include "util/settingscache.h"
 
 
 class Adsb: public QObject {
@@ -56,7 +57,7 @@ private:
     QString lowerr_lon;
     double center_lat;
     double center_lon;
-    QSettings settings;
+    SettingsCache& settings=SettingsCache::instance();
     double radius_earth_km = 6371;
     QString adsb_url;
     int timer_interval = 5000; //get reset later if api or sdr selected
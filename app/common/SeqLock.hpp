@@ -0,0 +1,65 @@
+#ifndef SEQLOCK_HPP
+#define SEQLOCK_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Single writer, multiple reader sequence lock.
+// The writer never blocks, readers never block the writer and retry (rarely) if they raced with a write.
+// Readers get a consistent copy of the whole value (not a mix of two updates) in O(1), without locks.
+// The value is stored as relaxed atomic words, such that concurrent read / write is not a data race in the c++ sense.
+// NOTE: Only one thread may call store() (or the calls need to be serialized externally).
+template<typename T>
+class SeqLock{
+    static_assert(std::is_trivially_copyable<T>::value,"SeqLock needs a trivially copyable type");
+public:
+    SeqLock(){
+        const auto words=to_words(T{});
+        for(size_t i=0;i<N_WORDS;i++){
+            m_words[i].store(words[i],std::memory_order_relaxed);
+        }
+    }
+    void store(const T& value){
+        const auto words=to_words(value);
+        const uint32_t seq=m_seq.load(std::memory_order_relaxed);
+        // odd == write in progress
+        m_seq.store(seq+1,std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for(size_t i=0;i<N_WORDS;i++){
+            m_words[i].store(words[i],std::memory_order_relaxed);
+        }
+        m_seq.store(seq+2,std::memory_order_release);
+    }
+    // version: incremented on each store() (0 == never stored, default value), can be used to check if there is a new value
+    T load(uint32_t* version=nullptr)const{
+        std::array<uint64_t,N_WORDS> words;
+        uint32_t seq_begin;
+        uint32_t seq_end;
+        do{
+            seq_begin=m_seq.load(std::memory_order_acquire);
+            for(size_t i=0;i<N_WORDS;i++){
+                words[i]=m_words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            seq_end=m_seq.load(std::memory_order_relaxed);
+        }while((seq_begin & 1) || seq_begin!=seq_end);
+        T ret;
+        std::memcpy(&ret,words.data(),sizeof(T));
+        if(version)*version=seq_begin/2;
+        return ret;
+    }
+private:
+    static constexpr size_t N_WORDS=(sizeof(T)+sizeof(uint64_t)-1)/sizeof(uint64_t);
+    static std::array<uint64_t,N_WORDS> to_words(const T& value){
+        std::array<uint64_t,N_WORDS> words{};
+        std::memcpy(words.data(),&value,sizeof(T));
+        return words;
+    }
+    std::atomic<uint32_t> m_seq{0};
+    std::array<std::atomic<uint64_t>,N_WORDS> m_words{};
+};
+
+#endif // SEQLOCK_HPP
@@ -5,8 +5,14 @@
 #ifndef LIVEVIDEO10MS_TIMEHELPER_HPP
 #define LIVEVIDEO10MS_TIMEHELPER_HPP
 
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <cstdint>
 #include <deque>
+#include <functional>
+#include <limits>
 #include <algorithm>
 #include <sstream>
 #include <iostream>
@@ -284,6 +290,195 @@ public:
 };
 
 
+// Fixed memory, allocation free latency histogram (log-linear buckets, in the style of HdrHistogram).
+// Values (ns) below SUB_BUCKET_COUNT are recorded exactly, above that each power of two range is split into
+// SUB_BUCKET_COUNT linear sub buckets - the error of a recorded value is less than 1/SUB_BUCKET_COUNT (~3%),
+// independent of its magnitude. In contrast to AvgCalculator this gives us the tail latency (p95 / p99), not just the average.
+// add() is lock free and can be called from any number of producer threads - it is a single relaxed atomic increment
+// (min / max are only written when they change), the n of samples and the sum are derived from the buckets on snapshot.
+// The average is therefore calculated from the bucket centers, which is accurate to well within the bucket precision.
+// snapshot() / snapshot_and_reset() are cheap (~3us, tools/latency_histogram_bench) and meant for the thread that publishes the stats (e.g. to the UI).
+// Same interface as AvgCalculator where it makes sense, such that it can be used as a drop in replacement.
+class LatencyHistogram{
+public:
+    static constexpr int SUB_BUCKET_BITS=5;
+    static constexpr uint64_t SUB_BUCKET_COUNT=1<<SUB_BUCKET_BITS;
+    // Values >= 2^MAX_VALUE_BITS ns (~68s) end up in the last bucket
+    static constexpr int MAX_VALUE_BITS=36;
+    static constexpr size_t N_BUCKETS=(MAX_VALUE_BITS-SUB_BUCKET_BITS+1)*SUB_BUCKET_COUNT;
+    // Plain (non atomic) copy of a histogram, can be merged with other snapshots (e.g. of multiple decoders)
+    struct Snapshot{
+        std::array<uint64_t,N_BUCKETS> counts{};
+        uint64_t n_samples=0;
+        uint64_t sum_ns=0;
+        uint64_t min_ns=std::numeric_limits<uint64_t>::max();
+        uint64_t max_ns=0;
+        void merge(const Snapshot& other){
+            for(size_t i=0;i<N_BUCKETS;i++){
+                counts[i]+=other.counts[i];
+            }
+            n_samples+=other.n_samples;
+            sum_ns+=other.sum_ns;
+            min_ns=std::min(min_ns,other.min_ns);
+            max_ns=std::max(max_ns,other.max_ns);
+        }
+        // percentile in [0,1], e.g. 0.99 for p99. The result is the middle of the bucket (but never more than the max)
+        std::chrono::nanoseconds get_percentile(double percentile)const{
+            if(n_samples==0)return std::chrono::nanoseconds(0);
+            const uint64_t rank=std::max((uint64_t)1,(uint64_t)std::ceil(percentile*(double)n_samples));
+            uint64_t n=0;
+            for(size_t i=0;i<N_BUCKETS;i++){
+                n+=counts[i];
+                if(n>=rank){
+                    return std::chrono::nanoseconds(std::min(bucket_middle(i),max_ns));
+                }
+            }
+            return std::chrono::nanoseconds(max_ns);
+        }
+        std::chrono::nanoseconds getAvg()const{
+            if(n_samples==0)return std::chrono::nanoseconds(0);
+            return std::chrono::nanoseconds(sum_ns/n_samples);
+        }
+        std::chrono::nanoseconds getMin()const{
+            return n_samples==0 ? std::chrono::nanoseconds(0) : std::chrono::nanoseconds(min_ns);
+        }
+        std::chrono::nanoseconds getMax()const{
+            return std::chrono::nanoseconds(max_ns);
+        }
+        long getNSamples()const{
+            return (long)n_samples;
+        }
+        void update_n_samples_and_sum(){
+            n_samples=0;
+            sum_ns=0;
+            for(size_t i=0;i<N_BUCKETS;i++){
+                n_samples+=counts[i];
+                sum_ns+=counts[i]*bucket_middle(i);
+            }
+        }
+        std::string getAvgReadable(const bool averageOnly=false)const{
+            std::stringstream ss;
+            ss<<"avg="<<MyTimeHelper::R(getAvg());
+            if(averageOnly){
+                return ss.str();
+            }
+            ss<<" p95="<<MyTimeHelper::R(get_percentile(0.95))<<" p99="<<MyTimeHelper::R(get_percentile(0.99))<<" max="<<MyTimeHelper::R(getMax());
+            return ss.str();
+        }
+    };
+    LatencyHistogram(std::string name1="") : name(name1) {}
+    void add(const std::chrono::nanoseconds& value){
+        if (value<std::chrono::nanoseconds(0)) {
+            std::cout<<"Cannot add negative value\n";
+            return;
+        }
+        const uint64_t value_ns=value.count();
+        m_counts[bucket_index(value_ns)].fetch_add(1,std::memory_order_relaxed);
+        uint64_t curr=m_max_ns.load(std::memory_order_relaxed);
+        while(value_ns>curr && !m_max_ns.compare_exchange_weak(curr,value_ns,std::memory_order_relaxed)){}
+        curr=m_min_ns.load(std::memory_order_relaxed);
+        while(value_ns<curr && !m_min_ns.compare_exchange_weak(curr,value_ns,std::memory_order_relaxed)){}
+    }
+    void addUs(uint64_t valueUs){
+        add(std::chrono::nanoseconds(valueUs*1000));
+    }
+    // Samples recorded concurrently end up either in this or the next snapshot (their min / max might end up in the other one)
+    Snapshot snapshot()const{
+        Snapshot ret{};
+        for(size_t i=0;i<N_BUCKETS;i++){
+            ret.counts[i]=m_counts[i].load(std::memory_order_relaxed);
+        }
+        ret.min_ns=m_min_ns.load(std::memory_order_relaxed);
+        ret.max_ns=m_max_ns.load(std::memory_order_relaxed);
+        ret.update_n_samples_and_sum();
+        return ret;
+    }
+    Snapshot snapshot_and_reset(){
+        Snapshot ret{};
+        for(size_t i=0;i<N_BUCKETS;i++){
+            ret.counts[i]=m_counts[i].exchange(0,std::memory_order_relaxed);
+        }
+        ret.min_ns=m_min_ns.exchange(std::numeric_limits<uint64_t>::max(),std::memory_order_relaxed);
+        ret.max_ns=m_max_ns.exchange(0,std::memory_order_relaxed);
+        ret.update_n_samples_and_sum();
+        return ret;
+    }
+    void reset(){
+        snapshot_and_reset();
+    }
+    std::chrono::nanoseconds get_percentile(double percentile)const{
+        return snapshot().get_percentile(percentile);
+    }
+    std::chrono::nanoseconds getAvg()const{
+        return snapshot().getAvg();
+    }
+    std::chrono::nanoseconds getMin()const{
+        return snapshot().getMin();
+    }
+    std::chrono::nanoseconds getMax()const{
+        return std::chrono::nanoseconds(m_max_ns.load(std::memory_order_relaxed));
+    }
+    long getNSamples()const{
+        long ret=0;
+        for(const auto& count:m_counts){
+            ret+=(long)count.load(std::memory_order_relaxed);
+        }
+        return ret;
+    }
+    std::string getAvgReadable(const bool averageOnly=false)const{
+        return snapshot().getAvgReadable(averageOnly);
+    }
+    float getAvg_ms(){
+        return (float)(std::chrono::duration_cast<std::chrono::microseconds>(getAvg()).count())/1000.0f;
+    }
+    // The interval helpers below are not thread safe - only one (consumer) thread should call them
+    std::chrono::nanoseconds time_since_last_log(){
+        return std::chrono::steady_clock::now()-last_log;
+    }
+    void set_last_log(){
+        last_log=std::chrono::steady_clock::now();
+    }
+    typedef std::function<void(const Snapshot& snapshot)> CUSTOM_CB;
+    void recalculate_in_fixed_time_intervals(const std::chrono::steady_clock::duration interval_duration_size,CUSTOM_CB cb){
+        if(time_since_last_log()>interval_duration_size){
+            cb(snapshot_and_reset());
+            set_last_log();
+        }
+    }
+    typedef std::function<void(const std::string name,const std::string message)> CUSTOM_PRINT_CB;
+    void custom_print_in_intervals(const std::chrono::steady_clock::duration interval_duration_size,CUSTOM_PRINT_CB cb,bool resetSamples=true){
+        if(time_since_last_log()>interval_duration_size){
+            const auto snapshot=resetSamples ? snapshot_and_reset() : this->snapshot();
+            cb(name,snapshot.getAvgReadable());
+            set_last_log();
+        }
+    }
+    static size_t bucket_index(const uint64_t value_ns){
+        if(value_ns<SUB_BUCKET_COUNT)return (size_t)value_ns;
+        const int msb=63-__builtin_clzll(value_ns);
+        if(msb>=MAX_VALUE_BITS)return N_BUCKETS-1;
+        const int shift=msb-SUB_BUCKET_BITS;
+        return (size_t)(shift+1)*SUB_BUCKET_COUNT+(size_t)(value_ns>>shift)-SUB_BUCKET_COUNT;
+    }
+    // Lowest value that ends up in the given bucket
+    static uint64_t bucket_begin(const size_t index){
+        if(index<SUB_BUCKET_COUNT)return index;
+        const int shift=(int)(index/SUB_BUCKET_COUNT)-1;
+        return (SUB_BUCKET_COUNT+index%SUB_BUCKET_COUNT)<<shift;
+    }
+    static uint64_t bucket_middle(const size_t index){
+        if(index<SUB_BUCKET_COUNT)return index;
+        const int shift=(int)(index/SUB_BUCKET_COUNT)-1;
+        return bucket_begin(index)+((uint64_t)1<<shift)/2;
+    }
+private:
+    std::array<std::atomic<uint64_t>,N_BUCKETS> m_counts{};
+    std::atomic<uint64_t> m_min_ns{std::numeric_limits<uint64_t>::max()};
+    std::atomic<uint64_t> m_max_ns{0};
+    const std::string name;
+    std::chrono::steady_clock::time_point last_log{};
+};
+
 class Chronometer:public AvgCalculator {
 public:
     explicit Chronometer(std::string name="Unknown"): AvgCalculator(name),mName(name){}
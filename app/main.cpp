@@ -23,8 +23,11 @@ const QVector<QString> permissions({"android.permission.INTERNET",
 #include "telemetry/models/wificard.h"
 #include "telemetry/MavlinkTelemetry.h"
 #include "telemetry/models/rcchannelsmodel.h"
+#include "telemetry/models/telemetrylinkstatsmodel.h"
 #include "telemetry/settings/mavlinksettingsmodel.h"
 #include "telemetry/settings/synchronizedsettings.h"
+#include "telemetry/tlog/TLogRecorder.h"
+#include "telemetry/tlog/TLogReplay.h"
 #endif //QOPENHD_HAS_MAVSDK_MAVLINK_TELEMETRY
 
 #include "osd/speedladder.h"
@@ -37,6 +40,7 @@ const QVector<QString> permissions({"android.permission.INTERNET",
 
 // Video - annyoing ifdef crap is needed for all the different platforms / configurations
 #include "decodingstatistcs.h"
+#include "recording/groundrecordingmodel.h"
 #ifdef QOPENHD_ENABLE_VIDEO_VIA_AVCODEC
 #include "QSGVideoTextureItem.h"
 #endif
@@ -49,6 +53,7 @@ const QVector<QString> permissions({"android.permission.INTERNET",
 // Video end
 
 #include "util/qrenderstats.h"
+#include "util/settingscache.h"
 
 #if defined(__ios__)
 #include "platform/appleplatform.h"
@@ -220,6 +225,8 @@ int main(int argc, char *argv[]) {
     //QLoggingCategory::setFilterRules("qt.qpa.egl*=true");
 
     QApplication app(argc, argv);
+    // Create the settings cache on the UI thread, before anything (e.g. the telemetry / video threads) reads settings
+    SettingsCache::instance();
 
     {
         QScreen* screen = app.primaryScreen();
@@ -272,6 +279,7 @@ int main(int argc, char *argv[]) {
     // it is a common practice for QT to prefix models from c++ with an underscore
 
     engine.rootContext()->setContextProperty("_qrenderstats", &QRenderStats::instance());
+    engine.rootContext()->setContextProperty("_settingsCache", &SettingsCache::instance());
 
     write_platform_context_properties(engine);
     engine.rootContext()->setContextProperty("_ohdlogMessagesModel", &LogMessagesModel::instanceOHD());
@@ -287,7 +295,11 @@ int main(int argc, char *argv[]) {
     // exp
     //engine.rootContext()->setContextProperty("_fcSettingsModel", &MavlinkSettingsModel::instanceFC());
     engine.rootContext()->setContextProperty("_synchronizedSettings", &SynchronizedSettings::instance());
+    // before MavlinkTelemetry, the link stats need to be created on the UI thread (timer)
+    engine.rootContext()->setContextProperty("_telemetryLinkStatsModel", &TelemetryLinkStatsModel::instance());
     engine.rootContext()->setContextProperty("_mavlinkTelemetry", &MavlinkTelemetry::instance());
+    engine.rootContext()->setContextProperty("_tlogRecorder", &TLogRecorder::instance());
+    engine.rootContext()->setContextProperty("_tlogReplay", &TLogReplay::instance());
     engine.rootContext()->setContextProperty("_fcMavlinkSystem", &FCMavlinkSystem::instance());
     engine.rootContext()->setContextProperty("_fcMavlinkMissionItemsModel", &FCMavlinkMissionItemsModel::instance());
     engine.rootContext()->setContextProperty("_fcMavlinkkSettingsModel", &FCMavlinkSettingsModel::instance());
@@ -326,6 +338,8 @@ int main(int argc, char *argv[]) {
 // Platform - dependend video end  -----------------------------------------------------------------
 
     engine.rootContext()->setContextProperty("_decodingStatistics", &DecodingStatistcs::instance());
+    engine.rootContext()->setContextProperty("_decodingStatisticsSecondary", &DecodingStatistcs::instanceSecondary());
+    engine.rootContext()->setContextProperty("_groundRecording", &GroundRecordingModel::instance());
     // dirty
     engine.rootContext()->setContextProperty("_messageBoxInstance", &WorkaroundMessageBox::instance());
     engine.rootContext()->setContextProperty("_restartqopenhdmessagebox", &RestartQOpenHDMessageBox::instance());
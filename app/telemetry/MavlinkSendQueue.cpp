@@ -0,0 +1,175 @@
+#include "MavlinkSendQueue.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include "qopenhdmavlinkhelper.hpp"
+
+// Per class, the oldest message is dropped if a queue is full
+static constexpr std::array<size_t,MavlinkSendQueue::N_PRIORITIES> MAX_QUEUE_SIZE{16,64,256,256};
+static constexpr std::array<const char*,MavlinkSendQueue::N_PRIORITIES> PRIORITY_NAMES{"control","cmd","param","bulk"};
+
+MavlinkSendQueue::MavlinkSendQueue(SEND_CB send_cb,STATS_CB stats_cb)
+    : m_send_cb(send_cb),m_stats_cb(stats_cb)
+{
+    m_send_thread=std::make_unique<std::thread>(&MavlinkSendQueue::loop_send,this);
+}
+
+MavlinkSendQueue::~MavlinkSendQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop=true;
+    }
+    m_cv.notify_all();
+    m_send_thread->join();
+}
+
+MavlinkSendQueue::Priority MavlinkSendQueue::get_default_priority(const mavlink_message_t &msg)
+{
+    switch(msg.msgid){
+    case MAVLINK_MSG_ID_RC_CHANNELS_OVERRIDE:
+    case MAVLINK_MSG_ID_MANUAL_CONTROL:
+    case MAVLINK_MSG_ID_SET_POSITION_TARGET_LOCAL_NED:
+    case MAVLINK_MSG_ID_SET_POSITION_TARGET_GLOBAL_INT:
+    case MAVLINK_MSG_ID_SET_ATTITUDE_TARGET:
+    // our ping (see MavlinkTelemetry::ping_all_systems) - paced, the RTT would include the queue delay
+    case MAVLINK_MSG_ID_TIMESYNC:
+        return Priority::CONTROL;
+    case MAVLINK_MSG_ID_COMMAND_LONG:
+    case MAVLINK_MSG_ID_COMMAND_INT:
+    case MAVLINK_MSG_ID_COMMAND_ACK:
+    case MAVLINK_MSG_ID_SET_MODE:
+        return Priority::COMMAND;
+    case MAVLINK_MSG_ID_PARAM_REQUEST_READ:
+    case MAVLINK_MSG_ID_PARAM_REQUEST_LIST:
+    case MAVLINK_MSG_ID_PARAM_SET:
+    case MAVLINK_MSG_ID_PARAM_EXT_REQUEST_READ:
+    case MAVLINK_MSG_ID_PARAM_EXT_REQUEST_LIST:
+    case MAVLINK_MSG_ID_PARAM_EXT_SET:
+        return Priority::PARAM;
+    default:
+        break;
+    }
+    return Priority::BULK;
+}
+
+int64_t MavlinkSendQueue::get_coalesce_key(const mavlink_message_t &msg, Priority priority)
+{
+    // Only control messages are superseded by a newer one - a command or param set has to be sent, even if repeated
+    if(priority!=Priority::CONTROL)return -1;
+    const auto [target_sys_id,target_comp_id]=QOpenHDMavlinkHelper::get_target_sys_comp_id(msg);
+    return ((int64_t)msg.msgid<<16) | (target_sys_id<<8) | target_comp_id;
+}
+
+void MavlinkSendQueue::enqueue(const mavlink_message_t &msg, Priority priority)
+{
+    const int64_t coalesce_key=get_coalesce_key(msg,priority);
+    const auto now=std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& queue=m_queues[(int)priority];
+        if(coalesce_key>=0){
+            auto it=std::find_if(queue.begin(),queue.end(),[coalesce_key](const Entry& entry){
+                return entry.coalesce_key==coalesce_key;
+            });
+            if(it!=queue.end()){
+                // keep the position in the queue, the queue delay is the one of the latest data
+                it->msg=msg;
+                it->enqueue_time=now;
+                m_n_coalesced++;
+                return;
+            }
+        }
+        if(queue.size()>=MAX_QUEUE_SIZE[(int)priority]){
+            queue.pop_front();
+            m_n_dropped++;
+        }
+        queue.push_back(Entry{msg,now,coalesce_key});
+    }
+    m_cv.notify_one();
+}
+
+void MavlinkSendQueue::set_uplink_budget_bps(int64_t budget_bps)
+{
+    m_budget_bps=std::max(budget_bps,(int64_t)0);
+    m_cv.notify_one();
+}
+
+void MavlinkSendQueue::refill_tokens(std::chrono::steady_clock::time_point now,int64_t budget_bps)
+{
+    // 100ms worth of burst, but at least 2 max size packets
+    const double capacity=std::max(budget_bps/8.0/10.0,2.0*MAVLINK_MAX_PACKET_LEN);
+    if(budget_bps<=0){
+        m_tokens=capacity;
+    }else{
+        const double elapsed_s=std::chrono::duration<double>(now-m_last_refill).count();
+        m_tokens=std::min(m_tokens+elapsed_s*budget_bps/8.0,capacity);
+    }
+    m_last_refill=now;
+}
+
+void MavlinkSendQueue::loop_send()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(!m_stop){
+        const auto now=std::chrono::steady_clock::now();
+        if(now-m_last_stats>=std::chrono::seconds(1)){
+            lock.unlock();
+            update_stats();
+            lock.lock();
+            continue;
+        }
+        const auto next_stats=m_last_stats+std::chrono::seconds(1);
+        const int64_t budget_bps=m_budget_bps.load();
+        refill_tokens(now,budget_bps);
+        int priority=0;
+        while(priority<N_PRIORITIES && m_queues[priority].empty()){
+            priority++;
+        }
+        if(priority==N_PRIORITIES){
+            m_cv.wait_until(lock,next_stats);
+            continue;
+        }
+        auto& queue=m_queues[priority];
+        const int wire_size=QOpenHDMavlinkHelper::get_wire_size(queue.front().msg);
+        if(budget_bps>0 && priority!=(int)Priority::CONTROL && m_tokens<wire_size){
+            // Wait until there is budget for it - or something more important is enqueued (or the budget changed)
+            const auto wait=std::chrono::duration<double>((wire_size-m_tokens)*8.0/budget_bps);
+            m_cv.wait_until(lock,std::min(next_stats,now+std::chrono::duration_cast<std::chrono::steady_clock::duration>(wait)));
+            continue;
+        }
+        const Entry entry=queue.front();
+        queue.pop_front();
+        if(budget_bps>0){
+            // the control fast lane can overdraw the budget, the others pay it back
+            m_tokens=std::max(m_tokens-wire_size,-std::max(budget_bps/8.0,2.0*MAVLINK_MAX_PACKET_LEN));
+        }
+        lock.unlock();
+        const bool sent=m_send_cb(entry.msg);
+        m_queue_delay[priority].add(std::chrono::steady_clock::now()-entry.enqueue_time);
+        if(!sent){
+            m_n_unsent++;
+        }
+        lock.lock();
+    }
+}
+
+void MavlinkSendQueue::update_stats()
+{
+    const auto now=std::chrono::steady_clock::now();
+    const double elapsed_s=std::chrono::duration<double>(now-m_last_stats).count();
+    m_last_stats=now;
+    std::stringstream ss;
+    for(int i=0;i<N_PRIORITIES;i++){
+        const auto delay=m_queue_delay[i].snapshot_and_reset();
+        if(delay.getNSamples()==0)continue;
+        ss<<PRIORITY_NAMES[i]<<" "<<std::lround(delay.getNSamples()/elapsed_s)<<"/s delay avg="<<MyTimeHelper::R(delay.getAvg())
+          <<" p99="<<MyTimeHelper::R(delay.get_percentile(0.99))<<" | ";
+    }
+    ss<<"coalesced:"<<m_n_coalesced.load()<<" dropped:"<<m_n_dropped.load()<<" unsent:"<<m_n_unsent;
+    if(m_stats_cb){
+        m_stats_cb(ss.str());
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef MAVLINKSENDQUEUE_H
+#define MAVLINKSENDQUEUE_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "mavsdk_include.h"
+#include "../common/TimeHelper.hpp"
+
+/**
+ * Outbound mavlink queue of MavlinkTelemetry::sendMessage. Callers (e.g. the UI thread for commands and param sets)
+ * only enqueue, a dedicated sender thread hands the messages to mavsdk - a slow send or lock contention doesn't block
+ * the caller, and cannot delay a more important message behind a less important one.
+ * Messages are sent strictly by priority class: control (RC override, manual control, setpoints, timesync ping), commands,
+ * params, bulk.
+ * Control messages are coalesced - a newer one replaces a pending one with the same msg id and target, only the latest
+ * is of any use. Each class has a bounded queue, the oldest message is dropped if it is full.
+ * With an uplink budget (0 == unlimited) all but the control class are paced by a token bucket (wire size) - control is
+ * the fast lane, it is never delayed by the budget, but its bytes count against it.
+ */
+class MavlinkSendQueue
+{
+public:
+    enum class Priority{
+        CONTROL=0,
+        COMMAND,
+        PARAM,
+        BULK
+    };
+    static constexpr int N_PRIORITIES=4;
+    // Sender thread. Returns false if the message could not be sent (no connection yet)
+    typedef std::function<bool(const mavlink_message_t& msg)> SEND_CB;
+    // Sender thread, once per second: queue delay per class, coalesced / dropped / unsent messages
+    typedef std::function<void(const std::string& stats)> STATS_CB;
+    MavlinkSendQueue(SEND_CB send_cb,STATS_CB stats_cb);
+    ~MavlinkSendQueue();
+    // By msg id, see the class description
+    static Priority get_default_priority(const mavlink_message_t& msg);
+    // Any thread, never blocks on the link. msg needs to be finalized (packed)
+    void enqueue(const mavlink_message_t& msg,Priority priority);
+    // Any thread, 0 == unlimited
+    void set_uplink_budget_bps(int64_t budget_bps);
+private:
+    struct Entry{
+        mavlink_message_t msg;
+        std::chrono::steady_clock::time_point enqueue_time;
+        // -1 == never coalesced
+        int64_t coalesce_key;
+    };
+    static int64_t get_coalesce_key(const mavlink_message_t& msg,Priority priority);
+    void loop_send();
+    void refill_tokens(std::chrono::steady_clock::time_point now,int64_t budget_bps);
+    void update_stats();
+    const SEND_CB m_send_cb;
+    const STATS_CB m_stats_cb;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_stop=false;
+    std::array<std::deque<Entry>,N_PRIORITIES> m_queues;
+    std::atomic<int64_t> m_budget_bps{0};
+    // sender thread: token bucket (bytes), can go negative (control fast lane)
+    double m_tokens=0;
+    std::chrono::steady_clock::time_point m_last_refill=std::chrono::steady_clock::now();
+    // stats
+    std::array<LatencyHistogram,N_PRIORITIES> m_queue_delay{};
+    std::atomic<uint64_t> m_n_coalesced{0};
+    std::atomic<uint64_t> m_n_dropped{0};
+    uint64_t m_n_unsent=0;
+    std::chrono::steady_clock::time_point m_last_stats=std::chrono::steady_clock::now();
+    std::unique_ptr<std::thread> m_send_thread;
+};
+
+#endif // MAVLINKSENDQUEUE_H
@@ -6,13 +6,42 @@
 #include "telemetry/openhd_defines.hpp"
 #include "models/aohdsystem.h"
 #include "models/fcmavlinksystem.h"
+#include "models/telemetrylinkstatsmodel.h"
 
 #include "settings/mavlinksettingsmodel.h"
+#include "util/settingscache.h"
+#include "tlog/TLogRecorder.h"
+#include "tlog/TLogReplay.h"
 #include "../logging/logmessagesmodel.h"
 
 MavlinkTelemetry::MavlinkTelemetry(QObject *parent):QObject(parent)
 {
     m_msg_interval_helper=std::make_unique<FCMessageIntervalHelper>();
+    m_send_queue=std::make_unique<MavlinkSendQueue>([this](const mavlink_message_t& msg){
+        std::shared_ptr<mavsdk::MavlinkPassthrough> passtrough;
+        {
+            std::lock_guard<std::mutex> lock(systems_mutex);
+            passtrough=passtroughOhdGround;
+        }
+        if(passtrough==nullptr)return false;
+        passtrough->send_message(msg);
+        return true;
+    },[this](const std::string& stats){
+        set_send_queue_stats(stats.c_str());
+    });
+    // Uplink budget of the outbound queue, can be changed at run time
+    auto& settings_cache=SettingsCache::instance();
+    m_send_queue->set_uplink_budget_bps(settings_cache.value("dev_mavlink_uplink_budget_kbits",0).toInt()*1000LL);
+    settings_cache.subscribe([this](const QString& key){
+        if(key=="dev_mavlink_uplink_budget_kbits"){
+            m_send_queue->set_uplink_budget_bps(SettingsCache::instance().value(key,0).toInt()*1000LL);
+        }
+    });
+    // Record (before any connection is added, such that we don't miss the first messages)
+    TLogRecorder::instance().start();
+    TLogReplay::instance().set_message_cb([this](const mavlink_message_t& msg){
+        on_replay_message(msg);
+    });
     mavsdk::Mavsdk::Configuration config{QOpenHDMavlinkHelper::get_own_sys_id(),QOpenHDMavlinkHelper::get_own_comp_id(),false};
     mavsdk=std::make_shared<mavsdk::Mavsdk>();
     mavsdk->set_configuration(config);
@@ -95,10 +124,11 @@ void MavlinkTelemetry::onNewSystem(std::shared_ptr<mavsdk::System> system){
             onProcessMavlinkMessage(msg);
             return true;
         });
-        //passtroughOhdGround->intercept_outgoing_messages_async([](mavlink_message_t& msg){
-        //    //qDebug()<<"Intercept:send message"<<msg.msgid;
-        //    return true;
-        //});
+        passtroughOhdGround->intercept_outgoing_messages_async([](mavlink_message_t& msg){
+            //qDebug()<<"Intercept:send message"<<msg.msgid;
+            TelemetryLinkStatsModel::instance().on_message_out(msg);
+            return true;
+        });
         MavlinkSettingsModel::instanceGround().set_param_client(system);
         AOHDSystem::instanceGround().set_system(system);
     }else if(system->get_system_id()==OHD_SYS_ID_AIR){
@@ -116,6 +146,10 @@ void MavlinkTelemetry::onNewSystem(std::shared_ptr<mavsdk::System> system){
                 onProcessMavlinkMessage(msg);
                 return true;
             });
+            passtroughOhdGround->intercept_outgoing_messages_async([](mavlink_message_t& msg){
+                TelemetryLinkStatsModel::instance().on_message_out(msg);
+                return true;
+            });
         }
     }
     // mavsdk doesn't report iNAV as being an "autopilot", so for now we just assume that if we have a mavlink system that has not one of the
@@ -144,6 +178,10 @@ void MavlinkTelemetry::onNewSystem(std::shared_ptr<mavsdk::System> system){
                     onProcessMavlinkMessage(msg);
                     return true;
                 });
+                passtroughOhdGround->intercept_outgoing_messages_async([](mavlink_message_t& msg){
+                    TelemetryLinkStatsModel::instance().on_message_out(msg);
+                    return true;
+                });
             }
         }else{
             qDebug()<<"Got weird system:"<<(int)system->get_system_id();
@@ -153,6 +191,10 @@ void MavlinkTelemetry::onNewSystem(std::shared_ptr<mavsdk::System> system){
 }
 
 bool MavlinkTelemetry::sendMessage(mavlink_message_t msg){
+    return sendMessage(msg,MavlinkSendQueue::get_default_priority(msg));
+}
+
+bool MavlinkTelemetry::sendMessage(mavlink_message_t msg,MavlinkSendQueue::Priority priority){
     const auto sys_id=QOpenHDMavlinkHelper::get_own_sys_id();
     const auto comp_id=QOpenHDMavlinkHelper::get_own_comp_id();
     if(msg.sysid!=sys_id){
@@ -164,32 +206,67 @@ bool MavlinkTelemetry::sendMessage(mavlink_message_t msg){
         qDebug()<<"WARN Sending message with comp id:"<<msg.compid<<" instead of"<<comp_id;
     }
     assert(mavsdk!=nullptr);
-    std::lock_guard<std::mutex> lock(systems_mutex);
-    if(passtroughOhdGround!=nullptr){
-        passtroughOhdGround->send_message(msg);
-        return true;
-    }else{
-        // If the passtrough is not created yet, a connection to the OHD ground unit has not yet been established.
-        //qDebug()<<"MAVSDK passtroughOhdGround not created";
-        // only log it once, then not again to keep logcat clean
-        static bool first=true;
-        if(first){
-            qDebug()<<"No OHD Ground unit connected";
-            //first=false;
+    {
+        std::lock_guard<std::mutex> lock(systems_mutex);
+        if(passtroughOhdGround==nullptr){
+            // If the passtrough is not created yet, a connection to the OHD ground unit has not yet been established.
+            //qDebug()<<"MAVSDK passtroughOhdGround not created";
+            // only log it once, then not again to keep logcat clean
+            static bool first=true;
+            if(first){
+                qDebug()<<"No OHD Ground unit connected";
+                //first=false;
+            }
+            return false;
         }
     }
-    return false;
+    // The sender thread hands it to mavsdk, never blocks the caller (e.g. the UI thread)
+    m_send_queue->enqueue(msg,priority);
+    return true;
 }
 
-static int get_message_size(const mavlink_message_t msg){
-    return sizeof(msg);
+void MavlinkTelemetry::onProcessMavlinkMessage(mavlink_message_t msg)
+{
+    TLogRecorder::instance().on_message(msg);
+    TelemetryLinkStatsModel::instance().on_message_in(msg);
+    if(TLogReplay::instance().is_active()){
+        // The OSD is driven by the replay, the live telemetry is only recorded
+        return;
+    }
+    process_mavlink_message_timed(msg);
 }
 
-void MavlinkTelemetry::onProcessMavlinkMessage(mavlink_message_t msg)
+void MavlinkTelemetry::on_replay_message(const mavlink_message_t &msg)
+{
+    // There is no (mavsdk) system discovery for a replay - the first autopilot heartbeat that is not from OpenHD is the FC
+    if(msg.msgid==MAVLINK_MSG_ID_HEARTBEAT && msg.sysid!=OHD_SYS_ID_AIR && msg.sysid!=OHD_SYS_ID_GROUND
+            && !FCMavlinkSystem::instance().get_fc_sys_id().has_value()){
+        mavlink_heartbeat_t heartbeat;
+        mavlink_msg_heartbeat_decode(&msg,&heartbeat);
+        if(heartbeat.autopilot!=MAV_AUTOPILOT_INVALID && heartbeat.type!=MAV_TYPE_GCS){
+            FCMavlinkSystem::instance().set_replay_fc_sys_id(msg.sysid);
+        }
+    }
+    process_mavlink_message_timed(msg);
+}
+
+void MavlinkTelemetry::process_mavlink_message_timed(const mavlink_message_t &msg)
+{
+    const auto begin=std::chrono::steady_clock::now();
+    process_mavlink_message(msg);
+    m_tele_processing_time.add(std::chrono::steady_clock::now()-begin);
+    m_tele_processing_time.recalculate_in_fixed_time_intervals(std::chrono::seconds(3),[this](const LatencyHistogram::Snapshot& self){
+        set_telemetry_processing_time(self.getAvgReadable().c_str());
+        m_tele_processing_time_avg_ns=self.getAvg().count();
+        m_tele_processing_time_p99_ns=self.get_percentile(0.99).count();
+    });
+}
+
+void MavlinkTelemetry::process_mavlink_message(const mavlink_message_t& msg)
 {
-    m_tele_received_packets++;
-    m_tele_received_bytes+=get_message_size(msg);
-    set_telemetry_pps_in(m_tele_pps_in.get_last_or_recalculate(m_tele_received_packets));
+    const int64_t n_received_packets=++m_tele_received_packets;
+    m_tele_received_bytes+=QOpenHDMavlinkHelper::get_wire_size(msg);
+    set_telemetry_pps_in(m_tele_pps_in.get_last_or_recalculate(n_received_packets));
     set_telemetry_bps_in(m_tele_bitrate_in.get_last_or_recalculate(m_tele_received_bytes));
     //qDebug()<<"MavlinkTelemetry::onProcessMavlinkMessage"<<msg.msgid;
     //if(pause_telemetry==true){
@@ -246,7 +323,8 @@ void MavlinkTelemetry::onProcessMavlinkMessage(mavlink_message_t msg)
         if(fc_sys_id.has_value()){
             if(msg.sysid==fc_sys_id.value()){
                 bool processed=FCMavlinkSystem::instance().process_message(msg);
-               if(m_msg_interval_helper){
+               // Don't request message rates from a recording
+               if(m_msg_interval_helper && !TLogReplay::instance().is_active()){
                     m_msg_interval_helper->check_acknowledgement(msg);
                     auto opt_command=m_msg_interval_helper->create_command_if_needed();
                    if(opt_command.has_value()){
@@ -324,6 +402,7 @@ void MavlinkTelemetry::ping_all_systems()
     lastTimeSyncOut=QOpenHDMavlinkHelper::getTimeMicroseconds();
     timesync.ts1=lastTimeSyncOut;
     mavlink_msg_timesync_encode(QOpenHDMavlinkHelper::get_own_sys_id(),QOpenHDMavlinkHelper::get_own_comp_id(),&msg,&timesync);
+    // control class, never paced by the uplink budget - ts1 is stamped here, the RTT must not include a queue delay
     sendMessage(msg);
 }
 
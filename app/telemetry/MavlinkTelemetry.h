@@ -3,11 +3,13 @@
 
 #include <QObject>
 #include <QtQuick>
+#include <atomic>
 #include <chrono>
 #include <mutex>
 #include <thread>
 
 #include "mavsdk_include.h"
+#include "MavlinkSendQueue.h"
 #include "models/fcmessageintervalhelper.hpp"
 #include "../../lib/lqtutils_master/lqtutils_prop.h"
 #include "../common/TimeHelper.hpp"
@@ -38,13 +40,28 @@ public:
      * Send a message to the OHD ground unit. If no connection has been established (yet), this should return immediately.
      * The message can be aimed at either the OHD ground unit, the OHD air unit (forwarded by OpenHD) or the FC connected to the
      * OHD air unit (forwarded by OpenHD).
+     * The message is queued (see MavlinkSendQueue), the priority class is deduced from the msg id.
      * @param msg the message to send.
-     * @return true on success (this does not mean the message was received, but rather the message was sent out via the lossy connection)
+     * @return true if the message was queued - not that it was sent: it can still be dropped if its class queue overflows,
+     * or fail to send in the sender thread (both are counted in the send queue stats).
      */
     bool sendMessage(mavlink_message_t msg);
+    bool sendMessage(mavlink_message_t msg,MavlinkSendQueue::Priority priority);
     // A couple of stats exposed as QT properties
     L_RO_PROP(int,telemetry_pps_in,set_telemetry_pps_in,-1)
     L_RO_PROP(int,telemetry_bps_in,set_telemetry_bps_in,-1)
+    // Time QOpenHD spends processing one incoming message (avg / p95 / p99 / max)
+    L_RO_PROP(QString,telemetry_processing_time,set_telemetry_processing_time,"N/A")
+    // Outbound queue delay per priority class, coalesced / dropped / unsent messages
+    L_RO_PROP(QString,send_queue_stats,set_send_queue_stats,"N/A")
+    // For the telemetry benchmark report (any thread)
+    int64_t get_n_received_packets()const{
+        return m_tele_received_packets.load(std::memory_order_relaxed);
+    }
+    // Of the last (3 second) interval, avg and p99 in nanoseconds
+    std::pair<int64_t,int64_t> get_processing_time_avg_p99_ns()const{
+        return {m_tele_processing_time_avg_ns.load(std::memory_order_relaxed),m_tele_processing_time_p99_ns.load(std::memory_order_relaxed)};
+    }
 private:
     // We follow the same practice as QGrouncontroll: Listen for incoming data on a specific UDP port,
     // -> as soon as we got the first packet, we know the address to send data to for bidirectional communication
@@ -69,12 +86,19 @@ private:
     // Called every time we get a mavlink message (from any system). Intended to be used for message types that don't
     // work with mavsdk / their subscription based pattern.
     void onProcessMavlinkMessage(mavlink_message_t msg);
+    // Called by the TLogReplay (replay thread) for each replayed message, instead of the live ones
+    void on_replay_message(const mavlink_message_t& msg);
+    void process_mavlink_message_timed(const mavlink_message_t& msg);
+    void process_mavlink_message(const mavlink_message_t& msg);
+    LatencyHistogram m_tele_processing_time{"Telemetry processing"};
+    std::atomic<int64_t> m_tele_processing_time_avg_ns{0};
+    std::atomic<int64_t> m_tele_processing_time_p99_ns{0};
     // The mavsdk tcp connect does block, we therefore need to do it in its own thread
     // (not block the UI thread)
     void tcp_only_establish_connection();
     std::unique_ptr<std::thread> m_tcp_connect_thread= nullptr;
     int64_t m_tele_received_bytes=0;
-    int64_t m_tele_received_packets=0;
+    std::atomic<int64_t> m_tele_received_packets{0};
     BitrateCalculator2 m_tele_bitrate_in;
     PacketsPerSecondCalculator m_tele_pps_in;
 public:
@@ -83,7 +107,7 @@ public:
     // request the OpenHD version, both OpenHD air and ground unit will respond to that message.
     Q_INVOKABLE void request_openhd_version();
     // send a command, to all connected systems
-    // doesn't reatransmitt
+    // doesn't reatransmitt. Returns true if queued, see sendMessage
     bool send_command_long_oneshot(const mavlink_command_long_t& command);
 private:
     int pingSequenceNumber=0;
@@ -104,6 +128,9 @@ public:
     Q_INVOKABLE void re_apply_rates();
 public:
     Q_INVOKABLE void add_tcp_connection_handler();
+private:
+    // Declared last - the sender thread is stopped before anything it uses is destroyed
+    std::unique_ptr<MavlinkSendQueue> m_send_queue=nullptr;
 };
 
 #endif // OHDMAVLINKCONNECTION_H
@@ -0,0 +1,155 @@
+#ifndef MAVLINK_DISPATCHER_H
+#define MAVLINK_DISPATCHER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "mavsdk_include.h"
+
+/**
+ * Table driven dispatch of incoming mavlink messages (of one system) to their handler, indexed by msg id -
+ * instead of a giant switch statement, each system registers one handler per message type once.
+ * Also records, per msg id, how often it was received (rate) and how long its handler took, such that one can tell
+ * which message eats the CPU (and set the message rates accordingly, see FCMessageIntervalHelper).
+ * The overhead is one table lookup and 2 clock reads per message.
+ * NOTE: Not thread safe - dispatch() and the stats need to be called from the same (telemetry) thread.
+ */
+class MavlinkDispatcher{
+public:
+    using Handler=std::function<void(const mavlink_message_t& msg)>;
+    explicit MavlinkDispatcher(std::string tag):m_tag(std::move(tag)){}
+    void add_handler(uint32_t msgid,const char* name,Handler handler){
+        Entry& entry=get_or_create_entry(msgid);
+        entry.name=name;
+        entry.handler=std::move(handler);
+        entry.known=true;
+    }
+    // Message type we know about but don't need (consumed, counted, but not logged as unmatched)
+    void add_ignored(uint32_t msgid,const char* name){
+        Entry& entry=get_or_create_entry(msgid);
+        entry.name=name;
+        entry.known=true;
+    }
+    // Returns false if this message type is unknown (not registered)
+    bool dispatch(const mavlink_message_t& msg){
+        Entry& entry=get_or_create_entry(msg.msgid);
+        entry.count++;
+        if(entry.handler){
+            const auto begin=std::chrono::steady_clock::now();
+            entry.handler(msg);
+            const auto elapsed=std::chrono::steady_clock::now()-begin;
+            entry.handler_time+=elapsed;
+            entry.handler_time_max=std::max(entry.handler_time_max,elapsed);
+        }
+        return entry.known;
+    }
+    struct MessageStats{
+        uint32_t msgid;
+        std::string name;
+        bool known;
+        uint64_t count;
+        float rate_hz;
+        float avg_handler_time_us;
+        float max_handler_time_us;
+        // Time spent in the handler per second, which is what matters for CPU usage
+        float handler_time_us_per_second;
+    };
+    // Recalculates the stats (rates / handler times over the last interval) if the interval has elapsed, returns true in this case.
+    bool recalculate_stats_in_fixed_time_intervals(std::chrono::steady_clock::duration interval){
+        const auto now=std::chrono::steady_clock::now();
+        const auto elapsed=now-m_last_stats;
+        if(elapsed<interval)return false;
+        m_last_stats=now;
+        const float elapsed_s=std::chrono::duration<float>(elapsed).count();
+        m_stats.clear();
+        for(auto& entry:m_entries){
+            const uint64_t n_in_interval=entry.count-entry.count_last_stats;
+            if(entry.count==0)continue;
+            MessageStats stats;
+            stats.msgid=entry.msgid;
+            stats.name=entry.name;
+            stats.known=entry.known;
+            stats.count=entry.count;
+            stats.rate_hz=n_in_interval/elapsed_s;
+            const float handler_time_us=std::chrono::duration<float,std::micro>(entry.handler_time).count();
+            stats.avg_handler_time_us=n_in_interval>0 ? handler_time_us/n_in_interval : 0;
+            stats.max_handler_time_us=std::chrono::duration<float,std::micro>(entry.handler_time_max).count();
+            stats.handler_time_us_per_second=handler_time_us/elapsed_s;
+            m_stats.push_back(stats);
+            entry.count_last_stats=entry.count;
+            entry.handler_time=std::chrono::steady_clock::duration{0};
+            entry.handler_time_max=std::chrono::steady_clock::duration{0};
+        }
+        std::sort(m_stats.begin(),m_stats.end(),[](const MessageStats& a,const MessageStats& b){
+            return a.handler_time_us_per_second>b.handler_time_us_per_second;
+        });
+        return true;
+    }
+    // Sorted by handler time per second (most expensive first)
+    const std::vector<MessageStats>& get_last_stats()const{
+        return m_stats;
+    }
+    // One line per message type, the n_max most expensive ones
+    std::string last_stats_as_string(int n_max=10)const{
+        std::stringstream ss;
+        ss<<m_tag<<":";
+        float total_us_per_second=0;
+        for(const auto& stats:m_stats){
+            total_us_per_second+=stats.handler_time_us_per_second;
+        }
+        ss<<std::fixed<<std::setprecision(1)<<" total "<<(total_us_per_second/1000.0f)<<"ms/s";
+        for(size_t i=0;i<m_stats.size() && (int)i<n_max;i++){
+            const auto& stats=m_stats[i];
+            ss<<"\n  "<<get_display_name(stats)<<(stats.known ? "" : " (unmatched)")
+             <<" "<<std::setprecision(1)<<stats.rate_hz<<"Hz avg "<<stats.avg_handler_time_us<<"us max "<<stats.max_handler_time_us<<"us "
+             <<std::setprecision(2)<<(stats.handler_time_us_per_second/1000.0f)<<"ms/s";
+        }
+        return ss.str();
+    }
+private:
+    static std::string get_display_name(const MessageStats& stats){
+        if(!stats.name.empty())return stats.name;
+        if(stats.msgid==MAX_INDEXED_MSGID)return "id>="+std::to_string(MAX_INDEXED_MSGID);
+        return "id "+std::to_string(stats.msgid);
+    }
+    struct Entry{
+        uint32_t msgid;
+        std::string name;
+        Handler handler=nullptr;
+        bool known=false;
+        uint64_t count=0;
+        uint64_t count_last_stats=0;
+        std::chrono::steady_clock::duration handler_time{0};
+        std::chrono::steady_clock::duration handler_time_max{0};
+    };
+    // msg ids of the dialect(s) we use are < 2^16 (mavlink2 allows 2^24, those share one slot for unknown ids)
+    static constexpr uint32_t MAX_INDEXED_MSGID=UINT16_MAX;
+    Entry& get_or_create_entry(uint32_t msgid){
+        const uint32_t index_msgid=std::min(msgid,MAX_INDEXED_MSGID);
+        if(index_msgid>=m_index.size()){
+            m_index.resize(index_msgid+1,-1);
+        }
+        int& index=m_index[index_msgid];
+        if(index<0){
+            Entry entry;
+            entry.msgid=index_msgid;
+            m_entries.push_back(entry);
+            index=(int)m_entries.size()-1;
+        }
+        return m_entries[index];
+    }
+    const std::string m_tag;
+    // msg id -> index into m_entries (-1 == no entry yet)
+    std::vector<int> m_index;
+    std::vector<Entry> m_entries;
+    std::chrono::steady_clock::time_point m_last_stats=std::chrono::steady_clock::now();
+    std::vector<MessageStats> m_stats;
+};
+
+#endif // MAVLINK_DISPATCHER_H
@@ -38,11 +38,12 @@ static int get_required_dbm_for_rate(int channel_width, int mcs_index) {
 }
 
 AOHDSystem::AOHDSystem(const bool is_air,QObject *parent)
-    : QObject{parent},m_is_air(is_air)
+    : QObject{parent},m_is_air(is_air),m_dispatcher(is_air ? "OHD air" : "OHD ground")
 {
     m_alive_timer = new QTimer(this);
     QObject::connect(m_alive_timer, &QTimer::timeout, this, &AOHDSystem::update_alive);
     m_alive_timer->start(1000);
+    register_message_handlers();
 }
 
 AOHDSystem &AOHDSystem::instanceAir()
@@ -70,130 +71,122 @@ bool AOHDSystem::process_message(const mavlink_message_t &msg)
         return false;
     }
     m_last_message_ms=QOpenHDMavlinkHelper::getTimeMilliseconds();
-    switch(msg.msgid){
-        case MAVLINK_MSG_ID_OPENHD_VERSION_MESSAGE:{
-            mavlink_openhd_version_message_t parsedMsg;
-            mavlink_msg_openhd_version_message_decode(&msg,&parsedMsg);
-            QString version(parsedMsg.version);
-            set_openhd_version(version);
-            return true;
-        }break;
-        case MAVLINK_MSG_ID_ONBOARD_COMPUTER_STATUS:{
-            mavlink_onboard_computer_status_t parsedMsg;
-            mavlink_msg_onboard_computer_status_decode(&msg,&parsedMsg);
-            process_onboard_computer_status(parsedMsg);
-            return true;
-        }break;
-        case MAVLINK_MSG_ID_OPENHD_STATS_MONITOR_MODE_WIFI_CARD:{
-            mavlink_openhd_stats_monitor_mode_wifi_card_t parsedMsg;
-            mavlink_msg_openhd_stats_monitor_mode_wifi_card_decode(&msg,&parsedMsg);
-            //qDebug()<<"Got MAVLINK_MSG_ID_OPENHD_WIFI_CARD"<<(int)parsedMsg.card_index<<" "<<(int)parsedMsg.rx_rssi;
-            process_x0(parsedMsg);
-            return true;
-        }break;
-        case MAVLINK_MSG_ID_OPENHD_STATS_MONITOR_MODE_WIFI_LINK:{
-            mavlink_openhd_stats_monitor_mode_wifi_link_t parsedMsg;
-            mavlink_msg_openhd_stats_monitor_mode_wifi_link_decode(&msg,&parsedMsg);
-            process_x1(parsedMsg);
-            return true;
-        }break;
-        case MAVLINK_MSG_ID_OPENHD_STATS_TELEMETRY:{
-            mavlink_openhd_stats_telemetry_t parsedMsg;
-            mavlink_msg_openhd_stats_telemetry_decode(&msg,&parsedMsg);
-            process_x2(parsedMsg);
-            return true;
-        }break;
-        case MAVLINK_MSG_ID_OPENHD_STATS_WB_VIDEO_AIR:{
-            mavlink_openhd_stats_wb_video_air_t parsedMsg;
-            mavlink_msg_openhd_stats_wb_video_air_decode(&msg,&parsedMsg);
-            process_x3(parsedMsg);
-            return true;
-        }break;
-        case MAVLINK_MSG_ID_OPENHD_STATS_WB_VIDEO_AIR_FEC_PERFORMANCE:{
-            mavlink_openhd_stats_wb_video_air_fec_performance_t parsedMsg;
-            mavlink_msg_openhd_stats_wb_video_air_fec_performance_decode(&msg,&parsedMsg);
-            process_x3b(parsedMsg);
-            return true;
-        }break;
-        case MAVLINK_MSG_ID_OPENHD_CAMERA_STATUS:{
-            mavlink_openhd_camera_status_t parsedMsg;
-            mavlink_msg_openhd_camera_status_decode(&msg,&parsedMsg);
-            if(msg.compid==OHD_COMP_ID_AIR_CAMERA_PRIMARY){
-                CameraStreamModel::instance(0).update_mavlink_openhd_camera_stats(parsedMsg);
-            }else if(msg.compid==OHD_COMP_ID_AIR_CAMERA_SECONDARY){
-                CameraStreamModel::instance(1).update_mavlink_openhd_camera_stats(parsedMsg);
-                // Feature - tell user to enable 2 cameras in qopenhd
-                set_n_openhd_cameras(2);
-                const int value_in_qopenhd=QOpenHDVideoHelper::get_qopenhd_n_cameras();
-                if(value_in_qopenhd!=2){
-                    const auto elapsed=std::chrono::steady_clock::now()-m_last_n_cameras_message;
-                    if(elapsed>std::chrono::seconds(10)){
-                        auto message="QOpenHD is not configured for dual cam usage, go to QOpenHD settings / General to configure your GCS to show secondary camera screen";
-                        qDebug()<<message;
-                        WorkaroundMessageBox::makePopupMessage(message,8);
-                        m_last_n_cameras_message=std::chrono::steady_clock::now();
-                    }
-                    HUDLogMessagesModel::instance().add_message_info("QOpenHD only shows 1 camera");
-                }
+    const bool consumed=m_dispatcher.dispatch(msg);
+    if(m_dispatcher.recalculate_stats_in_fixed_time_intervals(std::chrono::seconds(3))){
+        set_mavlink_message_stats(m_dispatcher.last_stats_as_string().c_str());
+    }
+    return consumed;
+}
 
+void AOHDSystem::register_message_handlers()
+{
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_OPENHD_VERSION_MESSAGE,"OPENHD_VERSION_MESSAGE",[this](const mavlink_message_t& msg){
+        mavlink_openhd_version_message_t parsedMsg;
+        mavlink_msg_openhd_version_message_decode(&msg,&parsedMsg);
+        QString version(parsedMsg.version);
+        set_openhd_version(version);
+    });
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_ONBOARD_COMPUTER_STATUS,"ONBOARD_COMPUTER_STATUS",[this](const mavlink_message_t& msg){
+        mavlink_onboard_computer_status_t parsedMsg;
+        mavlink_msg_onboard_computer_status_decode(&msg,&parsedMsg);
+        process_onboard_computer_status(parsedMsg);
+    });
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_OPENHD_STATS_MONITOR_MODE_WIFI_CARD,"OPENHD_STATS_MONITOR_MODE_WIFI_CARD",[this](const mavlink_message_t& msg){
+        mavlink_openhd_stats_monitor_mode_wifi_card_t parsedMsg;
+        mavlink_msg_openhd_stats_monitor_mode_wifi_card_decode(&msg,&parsedMsg);
+        //qDebug()<<"Got MAVLINK_MSG_ID_OPENHD_WIFI_CARD"<<(int)parsedMsg.card_index<<" "<<(int)parsedMsg.rx_rssi;
+        process_x0(parsedMsg);
+    });
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_OPENHD_STATS_MONITOR_MODE_WIFI_LINK,"OPENHD_STATS_MONITOR_MODE_WIFI_LINK",[this](const mavlink_message_t& msg){
+        mavlink_openhd_stats_monitor_mode_wifi_link_t parsedMsg;
+        mavlink_msg_openhd_stats_monitor_mode_wifi_link_decode(&msg,&parsedMsg);
+        process_x1(parsedMsg);
+    });
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_OPENHD_STATS_TELEMETRY,"OPENHD_STATS_TELEMETRY",[this](const mavlink_message_t& msg){
+        mavlink_openhd_stats_telemetry_t parsedMsg;
+        mavlink_msg_openhd_stats_telemetry_decode(&msg,&parsedMsg);
+        process_x2(parsedMsg);
+    });
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_OPENHD_STATS_WB_VIDEO_AIR,"OPENHD_STATS_WB_VIDEO_AIR",[this](const mavlink_message_t& msg){
+        mavlink_openhd_stats_wb_video_air_t parsedMsg;
+        mavlink_msg_openhd_stats_wb_video_air_decode(&msg,&parsedMsg);
+        process_x3(parsedMsg);
+    });
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_OPENHD_STATS_WB_VIDEO_AIR_FEC_PERFORMANCE,"OPENHD_STATS_WB_VIDEO_AIR_FEC_PERFORMANCE",[this](const mavlink_message_t& msg){
+        mavlink_openhd_stats_wb_video_air_fec_performance_t parsedMsg;
+        mavlink_msg_openhd_stats_wb_video_air_fec_performance_decode(&msg,&parsedMsg);
+        process_x3b(parsedMsg);
+    });
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_OPENHD_CAMERA_STATUS,"OPENHD_CAMERA_STATUS",[this](const mavlink_message_t& msg){
+        mavlink_openhd_camera_status_t parsedMsg;
+        mavlink_msg_openhd_camera_status_decode(&msg,&parsedMsg);
+        if(msg.compid==OHD_COMP_ID_AIR_CAMERA_PRIMARY){
+            CameraStreamModel::instance(0).update_mavlink_openhd_camera_stats(parsedMsg);
+        }else if(msg.compid==OHD_COMP_ID_AIR_CAMERA_SECONDARY){
+            CameraStreamModel::instance(1).update_mavlink_openhd_camera_stats(parsedMsg);
+            // Feature - tell user to enable 2 cameras in qopenhd
+            set_n_openhd_cameras(2);
+            const int value_in_qopenhd=QOpenHDVideoHelper::get_qopenhd_n_cameras();
+            if(value_in_qopenhd!=2){
+                const auto elapsed=std::chrono::steady_clock::now()-m_last_n_cameras_message;
+                if(elapsed>std::chrono::seconds(10)){
+                    auto message="QOpenHD is not configured for dual cam usage, go to QOpenHD settings / General to configure your GCS to show secondary camera screen";
+                    qDebug()<<message;
+                    WorkaroundMessageBox::makePopupMessage(message,8);
+                    m_last_n_cameras_message=std::chrono::steady_clock::now();
+                }
+                HUDLogMessagesModel::instance().add_message_info("QOpenHD only shows 1 camera");
             }
-            return true;
-        }break;
-        case MAVLINK_MSG_ID_OPENHD_STATS_WB_VIDEO_GROUND:{
-            mavlink_openhd_stats_wb_video_ground_t parsedMsg;
-            mavlink_msg_openhd_stats_wb_video_ground_decode(&msg,&parsedMsg);
-            process_x4(parsedMsg);
-            return true;
-        }break;
-        case MAVLINK_MSG_ID_OPENHD_STATS_WB_VIDEO_GROUND_FEC_PERFORMANCE:{
-            mavlink_openhd_stats_wb_video_ground_fec_performance_t parsedMsg;
-            mavlink_msg_openhd_stats_wb_video_ground_fec_performance_decode(&msg,&parsedMsg);
-            process_x4b(parsedMsg);
-            return true;
-        }break;
-        case MAVLINK_MSG_ID_OPENHD_ONBOARD_COMPUTER_STATUS_EXTENSION:{
-            mavlink_openhd_onboard_computer_status_extension_t parsedMsg;
-            mavlink_msg_openhd_onboard_computer_status_extension_decode(&msg,&parsedMsg);
-            return true;
-        }break;
-        case MAVLINK_MSG_ID_HEARTBEAT:{
-            mavlink_heartbeat_t parsedMsg;
-            mavlink_msg_heartbeat_decode(&msg,&parsedMsg);
-            m_last_heartbeat_ms=QOpenHDMavlinkHelper::getTimeMilliseconds();
-            if(parsedMsg.autopilot!=MAV_AUTOPILOT_INVALID){
-                qDebug()<<"Warning OpenHD systems should always set autopilot to none";
-            }
-            return true;
-        }break;
-        case MAVLINK_MSG_ID_RC_CHANNELS_OVERRIDE:{
-             mavlink_rc_channels_override_t parsedMsg;
-             mavlink_msg_rc_channels_override_decode(&msg,&parsedMsg);
-             RCChannelsModel::instanceGround().update_all_channels(Telemetryutil::mavlink_msg_rc_channels_override_to_array(parsedMsg));
-             return true;
-        };break;
-        case MAVLINK_MSG_ID_STATUSTEXT:{
-             mavlink_statustext_t parsedMsg;
-             mavlink_msg_statustext_decode(&msg,&parsedMsg);
-             auto tmp=Telemetryutil::statustext_convert(parsedMsg);
-             LogMessagesModel::instanceOHD().addLogMessage(m_is_air ? "OHD[A]":"OHD[G]",tmp.message.c_str(),tmp.level);
-             // Notify user in HUD of external device connect / disconnect events
-             if(tmp.message.find("External device") != std::string::npos){
-                HUDLogMessagesModel::instance().add_message(tmp.level,tmp.message.c_str());
-             }
-             return true;
-        }break;
-        /*case MAVLINK_MSG_ID_OPENHD_LOG_MESSAGE:{
-            mavlink_openhd_log_message_t parsedMsg;
-            mavlink_msg_openhd_log_message_decode(&msg,&parsedMsg);
-            const QString message{parsedMsg.text};
-            const quint64 timestamp=parsedMsg.timestamp;
-            const quint8 severity=parsedMsg.severity;
-            qDebug()<<"Log message:"<<message;
-            LogMessagesModel::instance().addLogMessage({"OHD",message,timestamp,LogMessagesModel::log_severity_to_color(severity)});
-            break;
-        }*/
-    }
-    return false;
+
+        }
+    });
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_OPENHD_STATS_WB_VIDEO_GROUND,"OPENHD_STATS_WB_VIDEO_GROUND",[this](const mavlink_message_t& msg){
+        mavlink_openhd_stats_wb_video_ground_t parsedMsg;
+        mavlink_msg_openhd_stats_wb_video_ground_decode(&msg,&parsedMsg);
+        process_x4(parsedMsg);
+    });
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_OPENHD_STATS_WB_VIDEO_GROUND_FEC_PERFORMANCE,"OPENHD_STATS_WB_VIDEO_GROUND_FEC_PERFORMANCE",[this](const mavlink_message_t& msg){
+        mavlink_openhd_stats_wb_video_ground_fec_performance_t parsedMsg;
+        mavlink_msg_openhd_stats_wb_video_ground_fec_performance_decode(&msg,&parsedMsg);
+        process_x4b(parsedMsg);
+    });
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_OPENHD_ONBOARD_COMPUTER_STATUS_EXTENSION,"OPENHD_ONBOARD_COMPUTER_STATUS_EXTENSION",[this](const mavlink_message_t& msg){
+        mavlink_openhd_onboard_computer_status_extension_t parsedMsg;
+        mavlink_msg_openhd_onboard_computer_status_extension_decode(&msg,&parsedMsg);
+    });
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_HEARTBEAT,"HEARTBEAT",[this](const mavlink_message_t& msg){
+        mavlink_heartbeat_t parsedMsg;
+        mavlink_msg_heartbeat_decode(&msg,&parsedMsg);
+        m_last_heartbeat_ms=QOpenHDMavlinkHelper::getTimeMilliseconds();
+        if(parsedMsg.autopilot!=MAV_AUTOPILOT_INVALID){
+            qDebug()<<"Warning OpenHD systems should always set autopilot to none";
+        }
+    });
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_RC_CHANNELS_OVERRIDE,"RC_CHANNELS_OVERRIDE",[this](const mavlink_message_t& msg){
+        mavlink_rc_channels_override_t parsedMsg;
+        mavlink_msg_rc_channels_override_decode(&msg,&parsedMsg);
+        RCChannelsModel::instanceGround().update_all_channels(Telemetryutil::mavlink_msg_rc_channels_override_to_array(parsedMsg));
+    });
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_STATUSTEXT,"STATUSTEXT",[this](const mavlink_message_t& msg){
+        mavlink_statustext_t parsedMsg;
+        mavlink_msg_statustext_decode(&msg,&parsedMsg);
+        auto tmp=Telemetryutil::statustext_convert(parsedMsg);
+        LogMessagesModel::instanceOHD().addLogMessage(m_is_air ? "OHD[A]":"OHD[G]",tmp.message.c_str(),tmp.level);
+        // Notify user in HUD of external device connect / disconnect events
+        if(tmp.message.find("External device") != std::string::npos){
+           HUDLogMessagesModel::instance().add_message(tmp.level,tmp.message.c_str());
+        }
+    });
+    /*case MAVLINK_MSG_ID_OPENHD_LOG_MESSAGE:{
+        mavlink_openhd_log_message_t parsedMsg;
+        mavlink_msg_openhd_log_message_decode(&msg,&parsedMsg);
+        const QString message{parsedMsg.text};
+        const quint64 timestamp=parsedMsg.timestamp;
+        const quint8 severity=parsedMsg.severity;
+        qDebug()<<"Log message:"<<message;
+        LogMessagesModel::instance().addLogMessage({"OHD",message,timestamp,LogMessagesModel::log_severity_to_color(severity)});
+        break;
+    }*/
 }
 
 void AOHDSystem::process_onboard_computer_status(const mavlink_onboard_computer_status_t &msg)
@@ -295,7 +288,7 @@ void AOHDSystem::process_x1(const mavlink_openhd_stats_monitor_mode_wifi_link_t
                        "If your air unit has 2 or more antennas (ONLY IF!), enable STBC to use them both and increase range significantly."
                        "See the wiki for more info."
                        "You can disable this prompt by going to QOpenHD - DEV and set dev_wb_show_no_stbc_enabled_warning=off.";
-        QSettings settings;
+        auto& settings=SettingsCache::instance();
         const auto dev_wb_show_no_stbc_enabled_warning =settings.value("dev_wb_show_no_stbc_enabled_warning", false).toBool();
         if(!dev_wb_show_no_stbc_enabled_warning){
             WorkaroundMessageBox::makePopupMessage(message,10);
@@ -11,6 +11,7 @@
 #include <atomic>
 
 #include "../../../lib/lqtutils_master/lqtutils_prop.h"
+#include "../mavlink_dispatcher.hpp"
 
 /**
  * Abstract OHD (Mavlink) system.
@@ -40,6 +41,8 @@ public: // public for QT
     // NOTE: I wrote this class before I knew about the lqutils macros, which is why they are used sparingly here
     //
     // WB / Monitor mode link statistics, generic for both air and ground (incoming / outgoing)
+    // Rate and handler time of the most expensive mavlink message types (developer stats)
+    L_RO_PROP(QString,mavlink_message_stats,set_mavlink_message_stats,"N/A")
     L_RO_PROP(int,curr_rx_packet_loss_perc,set_curr_rx_packet_loss_perc,-1)
     L_RO_PROP(quint64,count_tx_inj_error_hint,set_count_tx_inj_error_hint,0)
     L_RO_PROP(quint64,count_tx_dropped_packets,set_count_tx_dropped_packets,0)
@@ -126,6 +129,9 @@ private:
      void process_x3b(const mavlink_openhd_stats_wb_video_air_fec_performance_t& msg);
      void process_x4(const mavlink_openhd_stats_wb_video_ground_t& msg);
      void process_x4b(const mavlink_openhd_stats_wb_video_ground_fec_performance_t& msg);
+     // One handler per message type (telemetry thread)
+     MavlinkDispatcher m_dispatcher;
+     void register_message_handlers();
 private:
      std::atomic<int32_t> m_last_heartbeat_ms = -1;
      std::atomic<int32_t> m_last_message_ms= -1;
@@ -17,6 +17,7 @@
 #include "mavsdk_helper.hpp"
 #include "fcmavlinkmissionitemsmodel.h"
 #include "fcmavlinksettingsmodel.h"
+#include "../telemetry_benchmark_report.hpp"
 
 #include <QDateTime>
 
@@ -27,6 +28,11 @@ FCMavlinkSystem::FCMavlinkSystem(QObject *parent): QObject(parent) {
     m_alive_timer = new QTimer(this);
     QObject::connect(m_alive_timer, &QTimer::timeout, this, &FCMavlinkSystem::update_alive);
     m_alive_timer->start(1000);
+    register_message_handlers();
+    m_batched_publisher.set_stats_cb([this](QString stats){
+        set_telemetry_publish_stats(stats);
+        TelemetryBenchmarkReport::write_if_enabled(m_batched_publisher.get_last_stats());
+    });
 }
 
 FCMavlinkSystem& FCMavlinkSystem::instance() {
@@ -60,7 +66,7 @@ void FCMavlinkSystem::set_system(std::shared_ptr<mavsdk::System> system)
 bool FCMavlinkSystem::process_message(const mavlink_message_t &msg)
 {
     //qDebug()<<"FCMavlinkSystem::process_message";
-    if(!m_system){
+    if(!m_system && m_replay_fc_sys_id<0){
         qDebug()<<"WARNING the system must be set before FC model starts processing data";
         return false;
     }
@@ -79,8 +85,55 @@ bool FCMavlinkSystem::process_message(const mavlink_message_t &msg)
         m_last_update_update_rate_mavlink_message_attitude=std::chrono::steady_clock::now();
     }
     m_last_message_ms=QOpenHDMavlinkHelper::getTimeMilliseconds();
-    switch (msg.msgid) {
-    case MAVLINK_MSG_ID_HEARTBEAT: {
+    if(!m_dispatcher.dispatch(msg)){
+        //printf("MavlinkTelemetry received unmatched message with ID %d, sequence: %d from component %d of system %d\n", msg.msgid, msg.seq, msg.compid, msg.sysid);
+        qDebug()<<"MavlinkTelemetry received unmatched message with ID "<<msg.msgid
+               <<", sequence: "<<msg.seq
+              <<" from component "<<msg.compid
+             <<" of system "<<msg.sysid;
+    }
+    if(m_dispatcher.recalculate_stats_in_fixed_time_intervals(std::chrono::seconds(3))){
+        set_mavlink_message_stats(m_dispatcher.last_stats_as_string().c_str());
+    }
+    return true;
+}
+
+FCMavlinkSystem::VehicleState FCMavlinkSystem::get_vehicle_state(uint32_t* version) const
+{
+    return m_vehicle_state.load(version);
+}
+
+void FCMavlinkSystem::publish_vehicle_state()
+{
+    VehicleState state;
+    state.lat=m_lat;
+    state.lon=m_lon;
+    state.altitude_msl_m=m_altitude_msl_m;
+    state.altitude_rel_m=m_altitude_rel_m;
+    state.roll=m_roll;
+    state.pitch=m_pitch;
+    state.yaw=m_yaw;
+    state.hdg=m_hdg;
+    state.vx=m_vx;
+    state.vy=m_vy;
+    state.vz=m_vz;
+    state.ground_speed_meter_per_second=m_ground_speed_meter_per_second;
+    state.air_speed_meter_per_second=m_air_speed_meter_per_second;
+    state.vertical_speed_indicator_mps=m_vertical_speed_indicator_mps;
+    state.battery_voltage_volt=m_battery_voltage_volt;
+    state.battery_current_ampere=m_battery_current_ampere;
+    state.battery_percent=m_battery_percent;
+    state.battery_consumed_mah=m_battery_consumed_mah;
+    state.home_latitude=m_home_latitude;
+    state.home_longitude=m_home_longitude;
+    state.home_distance=m_home_distance;
+    state.last_update_ms=QOpenHDMavlinkHelper::getTimeMilliseconds();
+    m_vehicle_state.store(state);
+}
+
+void FCMavlinkSystem::register_message_handlers()
+{
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_HEARTBEAT,"HEARTBEAT",[this](const mavlink_message_t& msg){
         mavlink_heartbeat_t heartbeat;
         mavlink_msg_heartbeat_decode(&msg, &heartbeat);
         m_last_heartbeat_ms=QOpenHDMavlinkHelper::getTimeMilliseconds();
@@ -102,7 +155,7 @@ bool FCMavlinkSystem::process_message(const mavlink_message_t &msg)
         m_n_heartbeats++;
         if(m_n_heartbeats>10){
             if(m_n_attitude_messages<=0){
-                QSettings settings;
+                auto& settings=SettingsCache::instance();
                 const bool log_quiet_fc_warning_to_hud = settings.value("log_quiet_fc_warning_to_hud",true).toBool();
                 if(log_quiet_fc_warning_to_hud){
                     HUDLogMessagesModel::instance().add_message_warning("Quiet FC, please check your mavlink message rate(s)");
@@ -111,9 +164,8 @@ bool FCMavlinkSystem::process_message(const mavlink_message_t &msg)
             m_n_attitude_messages=0;
             m_n_heartbeats=0;
         }
-        break;
-    }
-    case MAVLINK_MSG_ID_AUTOPILOT_VERSION: {
+    });
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_AUTOPILOT_VERSION,"AUTOPILOT_VERSION",[this](const mavlink_message_t& msg){
         mavlink_autopilot_version_t autopilot_version;
         mavlink_msg_autopilot_version_decode(&msg, &autopilot_version);
         //ap_version = autopilot_version.flight_sw_version;
@@ -126,9 +178,8 @@ bool FCMavlinkSystem::process_message(const mavlink_message_t &msg)
         qDebug() << "MAVLINK AUTOPILOT os_version=" <<  ap_os_version;
         qDebug() << "MAVLINK AUTOPILOT product_id=" <<  ap_product_id;
         qDebug() << "MAVLINK AUTOPILOT uid=" <<  ap_uid;
-        break;
-    }
-    case MAVLINK_MSG_ID_SYS_STATUS: {
+    });
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_SYS_STATUS,"SYS_STATUS",[this](const mavlink_message_t& msg){
         mavlink_sys_status_t sys_status;
         mavlink_msg_sys_status_decode(&msg, &sys_status);
         const auto battery_voltage_v = (double)sys_status.voltage_battery / 1000.0;
@@ -142,10 +193,9 @@ bool FCMavlinkSystem::process_message(const mavlink_message_t &msg)
             const QString fc_battery_gauge_glyph = Telemetryutil::battery_gauge_glyph_from_percentage(battery_remaining_perc);
             set_battery_percent_gauge(fc_battery_gauge_glyph);
         }
-        break;
-    }
-
-    case MAVLINK_MSG_ID_SYSTEM_TIME:{
+        publish_vehicle_state();
+    });
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_SYSTEM_TIME,"SYSTEM_TIME",[this](const mavlink_message_t& msg){
         mavlink_system_time_t sys_time;
         mavlink_msg_system_time_decode(&msg, &sys_time);
         set_sys_time_unix_usec(sys_time.time_unix_usec);
@@ -166,13 +216,10 @@ bool FCMavlinkSystem::process_message(const mavlink_message_t &msg)
                 setDataStreamRate(MAV_DATA_STREAM_RC_CHANNELS, 2);
             }*/
         //test_set_data_stream_rates();
-        break;
-    }
-    case MAVLINK_MSG_ID_PARAM_VALUE:{
-        // handled by params mavsdk
-        break;
-    }
-    case MAVLINK_MSG_ID_GPS_RAW_INT:{
+    });
+    // handled by params mavsdk
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_PARAM_VALUE,"PARAM_VALUE");
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_GPS_RAW_INT,"GPS_RAW_INT",[this](const mavlink_message_t& msg){
         // https://mavlink.io/en/messages/common.html#GPS_RAW_INT
         // NOTE: Do not use lat/lon values reported here, use the values actually fused by the FC instead.
         // n satelites and such is okay though
@@ -183,28 +230,21 @@ bool FCMavlinkSystem::process_message(const mavlink_message_t &msg)
         set_gps_vdop(gps_status.epv / 100.0);
         set_gps_fix_type((unsigned int)gps_status.fix_type);
         set_gps_status_fix_type_str(Telemetryutil::mavlink_gps_fix_type_to_string(gps_status.fix_type));
-        break;
-    }
-    case MAVLINK_MSG_ID_GPS_STATUS: {
-        break;
-    }
-    case MAVLINK_MSG_ID_SCALED_IMU:{
-        break;
-    }
-    case MAVLINK_MSG_ID_RAW_IMU:{
+    });
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_GPS_STATUS,"GPS_STATUS");
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_SCALED_IMU,"SCALED_IMU");
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_RAW_IMU,"RAW_IMU",[this](const mavlink_message_t& msg){
         mavlink_raw_imu_t raw_imu;
         mavlink_msg_raw_imu_decode(&msg, &raw_imu);
         set_imu_temp_degree((int)raw_imu.temperature/100);
-        break;
-    }
-    case MAVLINK_MSG_ID_SCALED_PRESSURE:{
+    });
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_SCALED_PRESSURE,"SCALED_PRESSURE",[this](const mavlink_message_t& msg){
         mavlink_scaled_pressure_t scaled_pressure;
         mavlink_msg_scaled_pressure_decode(&msg, &scaled_pressure);
         set_preasure_sensor_temperature_degree((int)scaled_pressure.temperature/100);
         //qDebug() << "Temp:" <<  scaled_pressure.temperature;
-        break;
-    }
-    case MAVLINK_MSG_ID_ATTITUDE:{
+    });
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_ATTITUDE,"ATTITUDE",[this](const mavlink_message_t& msg){
         mavlink_attitude_t attitude;
         mavlink_msg_attitude_decode (&msg, &attitude);
         // Not handled by mavsdk telemetry callback(s) anymore
@@ -218,12 +258,10 @@ bool FCMavlinkSystem::process_message(const mavlink_message_t &msg)
         //set_hdg(yaw_deg);
         //qDebug()<<"degree Roll:"<<roll_deg<<" Pitch:"<<pitch_deg<<" Yaw:"<<yaw_deg;
         m_n_attitude_messages++;
-        break;
-    }
-    case MAVLINK_MSG_ID_LOCAL_POSITION_NED:{
-        break;
-    }
-    case MAVLINK_MSG_ID_GLOBAL_POSITION_INT: {
+        publish_vehicle_state();
+    });
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_LOCAL_POSITION_NED,"LOCAL_POSITION_NED");
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_GLOBAL_POSITION_INT,"GLOBAL_POSITION_INT",[this](const mavlink_message_t& msg){
         mavlink_global_position_int_t global_position_int;
         mavlink_msg_global_position_int_decode(&msg, &global_position_int);
         const double lat=static_cast<double>(global_position_int.lat) / 10000000.0;
@@ -256,9 +294,9 @@ bool FCMavlinkSystem::process_message(const mavlink_message_t &msg)
         calculate_home_course();
         updateVehicleAngles();
         updateWind();
-        break;
-    }
-    case MAVLINK_MSG_ID_RC_CHANNELS_RAW:{
+        publish_vehicle_state();
+    });
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_RC_CHANNELS_RAW,"RC_CHANNELS_RAW",[this](const mavlink_message_t& msg){
         // Seems to be outdated
         //qDebug()<<"Got message RC channels raw";
         mavlink_rc_channels_raw_t rc_channels_raw;
@@ -266,21 +304,17 @@ bool FCMavlinkSystem::process_message(const mavlink_message_t &msg)
         //const auto tmp=Telemetryutil::mavlink_msg_rc_channels_raw_to_array(rc_channels_raw);
         //RCChannelsModel::instanceFC().update_all_channels(tmp);
         set_rc_rssi_percentage( Telemetryutil::mavlink_rc_rssi_to_percent(rc_channels_raw.rssi));
-        break;
-    }
-    case MAVLINK_MSG_ID_RC_CHANNELS:{
+    });
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_RC_CHANNELS,"RC_CHANNELS",[this](const mavlink_message_t& msg){
         // Seems to be used by ARDUPILOT
         mavlink_rc_channels_t rc_channels;
         mavlink_msg_rc_channels_decode(&msg, &rc_channels);
         const auto tmp=Telemetryutil::mavlink_msg_rc_channels_to_array(rc_channels);
         RCChannelsModel::instanceFC().update_all_channels(tmp);
         set_rc_rssi_percentage( Telemetryutil::mavlink_rc_rssi_to_percent(rc_channels.rssi));
-        break;
-    }
-    case MAVLINK_MSG_ID_SERVO_OUTPUT_RAW:{
-        break;
-    }
-    case MAVLINK_MSG_ID_MISSION_CURRENT:{
+    });
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_SERVO_OUTPUT_RAW,"SERVO_OUTPUT_RAW");
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_MISSION_CURRENT,"MISSION_CURRENT",[this](const mavlink_message_t& msg){
         // https://mavlink.io/en/messages/common.html#MISSION_CURRENT
         mavlink_mission_current_t mission_current;
         mavlink_msg_mission_current_decode(&msg,&mission_current);
@@ -289,18 +323,16 @@ bool FCMavlinkSystem::process_message(const mavlink_message_t &msg)
         if(mission_current.total!=0){ // 0 == not supported
             set_mission_waypoints_current_total(mission_current.total);
         }
-        break;
-    }
-    case MAVLINK_MSG_ID_MISSION_COUNT:{
+    });
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_MISSION_COUNT,"MISSION_COUNT",[this](const mavlink_message_t& msg){
         //qDebug()<<"Got MAVLINK_MSG_ID_MISSION_COUNT";
         // https://mavlink.io/en/messages/common.html#MISSION_COUNT
         mavlink_mission_count_t mission;
         mavlink_msg_mission_count_decode(&msg,&mission);
         set_mission_waypoints_current_total(mission.count);
         set_mission_current_type(Telemetryutil::mavlink_mission_type_to_string(mission.mission_type));
-        break;
-    }
-    case MAVLINK_MSG_ID_MISSION_ITEM_INT:{
+    });
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_MISSION_ITEM_INT,"MISSION_ITEM_INT",[this](const mavlink_message_t& msg){
         mavlink_mission_item_int_t item;
         mavlink_msg_mission_item_int_decode(&msg, &item);
         //qDebug()<<"Got MAVLINK_MSG_ID_MISSION_ITEM_INT"<<Telemetryutil::mavlink_frame_to_string(item.frame);
@@ -318,12 +350,11 @@ bool FCMavlinkSystem::process_message(const mavlink_message_t &msg)
                }
            }
         }
-        break;
-    }
-    case MAVLINK_MSG_ID_GPS_GLOBAL_ORIGIN:{
+    });
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_GPS_GLOBAL_ORIGIN,"GPS_GLOBAL_ORIGIN",[this](const mavlink_message_t& msg){
         //qDebug()<<"Got MAVLINK_MSG_ID_GPS_GLOBAL_ORIGIN";
         // inav for some reason publishes the home position via this message instead of the home position one (and doesn't want to change it)
-        QSettings settings;
+        auto& settings=SettingsCache::instance();
         const bool dirty_enable_inav_hacks=settings.value("dirty_enable_inav_hacks",false).toBool();
         if(dirty_enable_inav_hacks){
            mavlink_gps_global_origin_t decoded;
@@ -336,12 +367,9 @@ bool FCMavlinkSystem::process_message(const mavlink_message_t &msg)
                set_home_longitude(home_lon);
            }
         }
-        break;
-    }
-    case MAVLINK_MSG_ID_NAV_CONTROLLER_OUTPUT:{
-        break;
-    }
-    case MAVLINK_MSG_ID_VFR_HUD:{
+    });
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_NAV_CONTROLLER_OUTPUT,"NAV_CONTROLLER_OUTPUT");
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_VFR_HUD,"VFR_HUD",[this](const mavlink_message_t& msg){
         mavlink_vfr_hud_t vfr_hud;
         mavlink_msg_vfr_hud_decode (&msg, &vfr_hud);
         set_throttle(vfr_hud.throttle);
@@ -356,26 +384,19 @@ bool FCMavlinkSystem::process_message(const mavlink_message_t &msg)
         // qDebug() << "VSI- " << vsi;
         //qint64 current_timestamp = QDateTime::currentMSecsSinceEpoch();
         //last_vfr_timestamp = current_timestamp;
-        break;
-    }
-    case MAVLINK_MSG_ID_HIGH_LATENCY2:{
+        publish_vehicle_state();
+    });
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_HIGH_LATENCY2,"HIGH_LATENCY2",[this](const mavlink_message_t& msg){
         mavlink_high_latency2_t high_latency2;
         mavlink_msg_high_latency2_decode(&msg, &high_latency2);
         auto airspeed_temp = high_latency2.temperature_air;
         set_airspeed_sensor_temperature_degree(airspeed_temp);
         //qDebug() << "Airspeed Sensor Temp- " << airspeed_temp;
-        break;
-    }
-    case MAVLINK_MSG_ID_TIMESYNC:{
-        break;
-    }
-    case MAVLINK_MSG_ID_POWER_STATUS:{
-        break;
-    }
-    case MAVLINK_MSG_ID_TERRAIN_REPORT:{
-        break;
-    }
-    case MAVLINK_MSG_ID_WIND:{
+    });
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_TIMESYNC,"TIMESYNC");
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_POWER_STATUS,"POWER_STATUS");
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_TERRAIN_REPORT,"TERRAIN_REPORT");
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_WIND,"WIND",[this](const mavlink_message_t& msg){
         //slight change to naming convention due to prexisting "wind" that is calculated by us..
         mavlink_wind_t mav_wind;
         mavlink_msg_wind_decode(&msg, &mav_wind);
@@ -383,13 +404,12 @@ bool FCMavlinkSystem::process_message(const mavlink_message_t &msg)
         set_mav_wind_speed(mav_wind.speed);
         /*qDebug() << "Windmavdir: " << mav_wind.direction;
             qDebug() << "Windmavspd: " << mav_wind.speed;*/
-        break;
-    }
-    case MAVLINK_MSG_ID_BATTERY_STATUS: {
+    });
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_BATTERY_STATUS,"BATTERY_STATUS",[this](const mavlink_message_t& msg){
         mavlink_battery_status_t battery_status;
         mavlink_msg_battery_status_decode(&msg, &battery_status);
         set_battery_consumed_mah(battery_status.current_consumed);
-        QSettings settings;
+        auto& settings=SettingsCache::instance();
         const bool air_battery_use_batt_id_0_only=settings.value("air_battery_use_batt_id_0_only", false).toBool();
         if(!air_battery_use_batt_id_0_only){
            set_battery_percent(battery_status.battery_remaining);
@@ -414,43 +434,24 @@ bool FCMavlinkSystem::process_message(const mavlink_message_t &msg)
            set_battery_id1_remaining_time_s(battery_status.time_remaining);
         }
         //qDebug()<<qopenhd::detailed_battery_voltages_to_string(battery_status.voltages).c_str();
-        break;
-    }
-    case MAVLINK_MSG_ID_SENSOR_OFFSETS: {
-        break;
-    }
-    case MAVLINK_MSG_ID_MEMINFO: {
-        break;
-    }
-    case MAVLINK_MSG_ID_MOUNT_STATUS: {
-        break;
-    }
-    case MAVLINK_MSG_ID_AHRS: {
-        break;
-    }
-    case MAVLINK_MSG_ID_HWSTATUS: {
-        break;
-    }
-    case MAVLINK_MSG_ID_AHRS2: {
-        break;
-    }
-    case MAVLINK_MSG_ID_AHRS3: {
-        break;
-    }
-    case MAVLINK_MSG_ID_MAG_CAL_REPORT: {
-        break;
-    }
-    case MAVLINK_MSG_ID_EKF_STATUS_REPORT: {
-        break;
-    }
-    case MAVLINK_MSG_ID_AOA_SSA: {
+        publish_vehicle_state();
+    });
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_SENSOR_OFFSETS,"SENSOR_OFFSETS");
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_MEMINFO,"MEMINFO");
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_MOUNT_STATUS,"MOUNT_STATUS");
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_AHRS,"AHRS");
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_HWSTATUS,"HWSTATUS");
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_AHRS2,"AHRS2");
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_AHRS3,"AHRS3");
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_MAG_CAL_REPORT,"MAG_CAL_REPORT");
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_EKF_STATUS_REPORT,"EKF_STATUS_REPORT");
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_AOA_SSA,"AOA_SSA",[this](const mavlink_message_t& msg){
         mavlink_aoa_ssa_t aoa;
         mavlink_msg_aoa_ssa_decode(&msg, &aoa);
         set_aoa(aoa.AOA);
         //qDebug() << "AOA- " << aoa.AOA;
-        break;
-    }
-    case MAVLINK_MSG_ID_VIBRATION:{
+    });
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_VIBRATION,"VIBRATION",[this](const mavlink_message_t& msg){
         mavlink_vibration_t vibration;
         mavlink_msg_vibration_decode (&msg, &vibration);
         set_vibration_x(vibration.vibration_x);
@@ -459,38 +460,23 @@ bool FCMavlinkSystem::process_message(const mavlink_message_t &msg)
         set_clipping_x(vibration.clipping_0);
         set_clipping_y(vibration.clipping_1);
         set_clipping_z(vibration.clipping_2);
-        break;
-    }
-    case MAVLINK_MSG_ID_SCALED_IMU2:{
-        break;
-    }
-    case MAVLINK_MSG_ID_SCALED_IMU3:{
-        break;
-    }
-    case MAVLINK_MSG_ID_SIMSTATE:{
-        break;
-    }
-    case MAVLINK_MSG_ID_POSITION_TARGET_GLOBAL_INT:{
-        break;
-    }
-    case MAVLINK_MSG_ID_SCALED_PRESSURE2:{
-        break;
-    }
-    case MAVLINK_MSG_ID_HIL_GPS:{
-        break;
-    }
-    case MAVLINK_MSG_ID_TERRAIN_REQUEST:{
-        break;
-    }
-    case MAVLINK_MSG_ID_HOME_POSITION:{
+    });
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_SCALED_IMU2,"SCALED_IMU2");
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_SCALED_IMU3,"SCALED_IMU3");
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_SIMSTATE,"SIMSTATE");
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_POSITION_TARGET_GLOBAL_INT,"POSITION_TARGET_GLOBAL_INT");
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_SCALED_PRESSURE2,"SCALED_PRESSURE2");
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_HIL_GPS,"HIL_GPS");
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_TERRAIN_REQUEST,"TERRAIN_REQUEST");
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_HOME_POSITION,"HOME_POSITION",[this](const mavlink_message_t& msg){
         mavlink_home_position_t home_position;
         mavlink_msg_home_position_decode(&msg, &home_position);
         set_home_latitude((double)home_position.latitude / 10000000.0);
         set_home_longitude((double)home_position.longitude / 10000000.0);
         //LocalMessage::instance()->showMessage("Home Position set by Telemetry", 7);
-        break;
-    }
-    case MAVLINK_MSG_ID_STATUSTEXT:{
+        publish_vehicle_state();
+    });
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_STATUSTEXT,"STATUSTEXT",[this](const mavlink_message_t& msg){
         mavlink_statustext_t parsedMsg;
         mavlink_msg_statustext_decode(&msg,&parsedMsg);
         auto tmp=Telemetryutil::statustext_convert(parsedMsg);
@@ -500,48 +486,29 @@ bool FCMavlinkSystem::process_message(const mavlink_message_t &msg)
             ss<<"["<<tmp.message<<"]";
             HUDLogMessagesModel::instance().add_message(tmp.level,ss.str().c_str());
         }
-        return true;
-    }break;
-    case MAVLINK_MSG_ID_ESC_TELEMETRY_1_TO_4: {
+    });
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_ESC_TELEMETRY_1_TO_4,"ESC_TELEMETRY_1_TO_4",[this](const mavlink_message_t& msg){
         mavlink_esc_telemetry_1_to_4_t esc_telemetry;
         mavlink_msg_esc_telemetry_1_to_4_decode(&msg, &esc_telemetry);
 
         set_esc_temp((int)esc_telemetry.temperature[0]);
-        break;
-    }
-    case MAVLINK_MSG_ID_ADSB_VEHICLE: {
-        break;
-    }
-    case MAVLINK_MSG_ID_EXTENDED_SYS_STATE:{
-        break;
-    }
-        // Commands and Params are done by mavsdk
-    case MAVLINK_MSG_ID_PARAM_EXT_ACK:
-    case MAVLINK_MSG_ID_PARAM_EXT_VALUE:
-    case MAVLINK_MSG_ID_COMMAND_ACK:
-        //TODO who sends out pings to us ?
-    case MAVLINK_MSG_ID_PING:
-        break;
-    case MAVLINK_MSG_ID_AIRSPEED_AUTOCAL:
-        break;
-    case MAVLINK_MSG_ID_GIMBAL_DEVICE_ATTITUDE_STATUS:
-        break;
-    case MAVLINK_MSG_ID_DISTANCE_SENSOR:{
+    });
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_ADSB_VEHICLE,"ADSB_VEHICLE");
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_EXTENDED_SYS_STATE,"EXTENDED_SYS_STATE");
+    // Commands and Params are done by mavsdk
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_PARAM_EXT_ACK,"PARAM_EXT_ACK");
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_PARAM_EXT_VALUE,"PARAM_EXT_VALUE");
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_COMMAND_ACK,"COMMAND_ACK");
+    //TODO who sends out pings to us ?
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_PING,"PING");
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_AIRSPEED_AUTOCAL,"AIRSPEED_AUTOCAL");
+    m_dispatcher.add_ignored(MAVLINK_MSG_ID_GIMBAL_DEVICE_ATTITUDE_STATUS,"GIMBAL_DEVICE_ATTITUDE_STATUS");
+    m_dispatcher.add_handler(MAVLINK_MSG_ID_DISTANCE_SENSOR,"DISTANCE_SENSOR",[this](const mavlink_message_t& msg){
         mavlink_distance_sensor_t decoded;
         mavlink_msg_distance_sensor_decode(&msg,&decoded);
         set_distance_sensor_distance_cm(decoded.current_distance);
-    };break;
-    default: {
-        //printf("MavlinkTelemetry received unmatched message with ID %d, sequence: %d from component %d of system %d\n", msg.msgid, msg.seq, msg.compid, msg.sysid);
-        qDebug()<<"MavlinkTelemetry received unmatched message with ID "<<msg.msgid
-               <<", sequence: "<<msg.seq
-              <<" from component "<<msg.compid
-             <<" of system "<<msg.sysid;
-        break;
-    }
-    }
+    });
 
-    return true;
 }
 
 std::optional<uint8_t> FCMavlinkSystem::get_fc_sys_id()
@@ -549,9 +516,22 @@ std::optional<uint8_t> FCMavlinkSystem::get_fc_sys_id()
     if(m_system){
         return m_system->get_system_id();
     }
+    if(m_replay_fc_sys_id>=0){
+        return (uint8_t)m_replay_fc_sys_id;
+    }
     return std::nullopt;
 }
 
+void FCMavlinkSystem::set_replay_fc_sys_id(uint8_t sys_id)
+{
+    if(m_replay_fc_sys_id==sys_id)return;
+    qDebug()<<"FCMavlinkSystem::set_replay_fc_sys_id"<<(int)sys_id;
+    m_replay_fc_sys_id=sys_id;
+    if(!m_system){
+        set_for_osd_sys_id(sys_id);
+    }
+}
+
 void FCMavlinkSystem::telemetryStatusMessage(QString message, int level) {
     //QOpenHD::instance().textToSpeech_sayMessage(message);
 }
@@ -741,7 +721,7 @@ void FCMavlinkSystem::updateWind(){
 
     if (m_vertical_speed_indicator_mps < 1 && m_vertical_speed_indicator_mps > -1){
         // we are level, so a 2d vector is possible
-        QSettings settings;
+        auto& settings=SettingsCache::instance();
         auto max_speed = settings.value("wind_max_quad_speed", QVariant(3)).toDouble();
         //qDebug() << "WIND----" << max_speed;
         auto max_tilt=45;
@@ -1130,7 +1110,7 @@ void FCMavlinkSystem::test_set_data_stream_rates()
 
 bool FCMavlinkSystem::get_SHOW_FC_MESSAGES_IN_HUD()
 {
-    QSettings settings;
+    auto& settings=SettingsCache::instance();
     return settings.value("show_fc_messages_in_hud", true).toBool();
 }
 
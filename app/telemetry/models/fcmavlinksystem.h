@@ -10,6 +10,9 @@
 
 // Really nice, this way we don't have to write all the setters / getters / signals ourselves !
 #include "../../../lib/lqtutils_master/lqtutils_prop.h"
+#include "../../util/batchedpropertypublisher.h"
+#include "../../common/SeqLock.hpp"
+#include "../mavlink_dispatcher.hpp"
 
 /**
  * This used to be called OpenHD and was a mix of everything, it has become FCMavlinkSystem -
@@ -33,6 +36,35 @@ public:
     explicit FCMavlinkSystem(QObject *parent = nullptr);
     // singleton for accessing the model from c++
     static FCMavlinkSystem& instance();
+    // Core vehicle state, consistent (all values from the same point in time) and safe to read from any thread.
+    struct VehicleState{
+        double lat=0;
+        double lon=0;
+        double altitude_msl_m=0;
+        double altitude_rel_m=0;
+        double roll=0;
+        double pitch=0;
+        double yaw=0;
+        int hdg=0;
+        double vx=0;
+        double vy=0;
+        double vz=0;
+        double ground_speed_meter_per_second=0;
+        double air_speed_meter_per_second=0;
+        float vertical_speed_indicator_mps=0;
+        double battery_voltage_volt=0;
+        double battery_current_ampere=0;
+        int battery_percent=0;
+        int battery_consumed_mah=0;
+        double home_latitude=0;
+        double home_longitude=0;
+        double home_distance=0;
+        // QOpenHDMavlinkHelper::getTimeMilliseconds() of the last update, -1 if no update yet
+        int64_t last_update_ms=-1;
+    };
+    // Lock free, O(1) - use this instead of the (QML) getters when reading from a thread other than the UI thread.
+    // version (optional): incremented on each update
+    VehicleState get_vehicle_state(uint32_t* version=nullptr)const;
     // Process a new telemetry message coming from the FC mavlink system
     // return true if we know what to do with this message type (aka this message type has been consumed)
     bool process_message(const mavlink_message_t& msg);
@@ -44,6 +76,9 @@ public:
     // manually parsing the message, and we register the callbacks to mavsdk when this is called (since we need the "system"
     // reference for it)
     void set_system(std::shared_ptr<mavsdk::System> system);
+    // Telemetry log replay (TLogReplay) - there is no mavsdk system, but the FC messages of the recording
+    // (with this sys id) shall be processed like live ones. Only used if no system has been discovered.
+    void set_replay_fc_sys_id(uint8_t sys_id);
 public: // Stuff needs to be public for qt
     // These members can be written & read from c++, but are only readable from qml (which is a common recommendation for QT application(s)).
     // Aka we just set them in c++ by calling the setter declared from the macro, which then emits the changed signal if needed
@@ -61,122 +96,133 @@ public: // Stuff needs to be public for qt
     //    emit some-value_changed();
     // }
     //
-    L_RO_PROP(double, battery_current_ampere, set_battery_current_ampere, 0)
-    L_RO_PROP(double, battery_voltage_volt, set_battery_voltage_volt, 0)
+    // The properties here are updated at up to the mavlink message rate (from the mavlink thread) - they are batched,
+    // the changed signals are emitted on the UI thread at display rate (see BatchedPropertyPublisher).
+    // c++ code in here reads m_xxx (latest value), QML / the getter return the last published value.
+private:
+    // Needs to be declared before the properties
+    BatchedPropertyPublisher m_batched_publisher{BatchedPropertyPublisher::get_rate_hz_from_settings()};
+public:
+    // Changes / signals per second of the properties below (UI thread, not batched)
+    L_RO_PROP(QString,telemetry_publish_stats,set_telemetry_publish_stats,"N/A")
+    // Rate and handler time of the most expensive mavlink message types (developer stats)
+    L_RO_PROP(QString,mavlink_message_stats,set_mavlink_message_stats,"N/A")
+    L_RO_PROP_BATCHED(double, battery_current_ampere, set_battery_current_ampere, 0)
+    L_RO_PROP_BATCHED(double, battery_voltage_volt, set_battery_voltage_volt, 0)
     // legacy, not commonly supported by FCs
-    L_RO_PROP(double, battery_voltage_single_cell, set_battery_voltage_single_cell, 0)
-    L_RO_PROP(int, battery_percent, set_battery_percent, 0)
+    L_RO_PROP_BATCHED(double, battery_voltage_single_cell, set_battery_voltage_single_cell, 0)
+    L_RO_PROP_BATCHED(int, battery_percent, set_battery_percent, 0)
     // same as battery_percent, but as an "icon"
-    L_RO_PROP(QString, battery_percent_gauge, set_battery_percent_gauge, "\uf091")
+    L_RO_PROP_BATCHED(QString, battery_percent_gauge, set_battery_percent_gauge, "\uf091")
     // not directly battery, but similar
-    L_RO_PROP(int,battery_consumed_mah,set_battery_consumed_mah,0)
+    L_RO_PROP_BATCHED(int,battery_consumed_mah,set_battery_consumed_mah,0)
     // TODO this value is not calculated yet
-    L_RO_PROP(int,battery_consumed_mah_per_km,set_battery_consumed_mah_per_km,-1)
+    L_RO_PROP_BATCHED(int,battery_consumed_mah_per_km,set_battery_consumed_mah_per_km,-1)
     // Ardupilot might show the same battery as multiple batteries when more than one current sensor is used
     // (Aparently a few peole do that)
-    L_RO_PROP(double, battery_id0_current_ampere, set_battery_id0_current_ampere, 0)
-    L_RO_PROP(double, battery_id0_voltage_volt, set_battery_id0_voltage_volt, 0)
-    L_RO_PROP(int,    battery_id0_consumed_mah,set_battery_id0_consumed_mah,0)
-    L_RO_PROP(QString,battery_id0_type,set_battery_id0_type,"N/A")
-    L_RO_PROP(int,    battery_id0_remaining_time_s,set_battery_id0_remaining_time_s,-1)
-    L_RO_PROP(double, battery_id1_current_ampere, set_battery_id1_current_ampere, 0)
-    L_RO_PROP(double, battery_id1_voltage_volt, set_battery_id1_voltage_volt, 0)
-    L_RO_PROP(int,    battery_id1_consumed_mah,set_battery_id1_consumed_mah,0)
-    L_RO_PROP(QString,battery_id1_type,set_battery_id1_type,"N/A")
-    L_RO_PROP(int,    battery_id1_remaining_time_s,set_battery_id1_remaining_time_s,-1)
+    L_RO_PROP_BATCHED(double, battery_id0_current_ampere, set_battery_id0_current_ampere, 0)
+    L_RO_PROP_BATCHED(double, battery_id0_voltage_volt, set_battery_id0_voltage_volt, 0)
+    L_RO_PROP_BATCHED(int,    battery_id0_consumed_mah,set_battery_id0_consumed_mah,0)
+    L_RO_PROP_BATCHED(QString,battery_id0_type,set_battery_id0_type,"N/A")
+    L_RO_PROP_BATCHED(int,    battery_id0_remaining_time_s,set_battery_id0_remaining_time_s,-1)
+    L_RO_PROP_BATCHED(double, battery_id1_current_ampere, set_battery_id1_current_ampere, 0)
+    L_RO_PROP_BATCHED(double, battery_id1_voltage_volt, set_battery_id1_voltage_volt, 0)
+    L_RO_PROP_BATCHED(int,    battery_id1_consumed_mah,set_battery_id1_consumed_mah,0)
+    L_RO_PROP_BATCHED(QString,battery_id1_type,set_battery_id1_type,"N/A")
+    L_RO_PROP_BATCHED(int,    battery_id1_remaining_time_s,set_battery_id1_remaining_time_s,-1)
 
     // roll, pitch and yaw
-    L_RO_PROP(double, pitch, set_pitch, 0)
-    L_RO_PROP(double, roll, set_roll, 0)
-    L_RO_PROP(double, yaw, set_yaw, 0)
+    L_RO_PROP_BATCHED(double, pitch, set_pitch, 0)
+    L_RO_PROP_BATCHED(double, roll, set_roll, 0)
+    L_RO_PROP_BATCHED(double, yaw, set_yaw, 0)
     // mixed
-    L_RO_PROP(double, throttle, set_throttle, 0)
-    L_RO_PROP(float,vibration_x,set_vibration_x,0)
-    L_RO_PROP(float,vibration_y,set_vibration_y,0)
-    L_RO_PROP(float,vibration_z,set_vibration_z,0)
+    L_RO_PROP_BATCHED(double, throttle, set_throttle, 0)
+    L_RO_PROP_BATCHED(float,vibration_x,set_vibration_x,0)
+    L_RO_PROP_BATCHED(float,vibration_y,set_vibration_y,0)
+    L_RO_PROP_BATCHED(float,vibration_z,set_vibration_z,0)
     // see alive timer
-    L_RO_PROP(bool,is_alive,set_is_alive,false)
+    L_RO_PROP_BATCHED(bool,is_alive,set_is_alive,false)
     //
-    L_RO_PROP(double,lat,set_lat,0.0)
-    L_RO_PROP(double,lon,set_lon,0.0)
-    L_RO_PROP(int,satellites_visible,set_satellites_visible,0)
-    L_RO_PROP(double,gps_hdop,set_gps_hdop,-1)
-    L_RO_PROP(double,gps_vdop,set_gps_vdop,-1)
+    L_RO_PROP_BATCHED(double,lat,set_lat,0.0)
+    L_RO_PROP_BATCHED(double,lon,set_lon,0.0)
+    L_RO_PROP_BATCHED(int,satellites_visible,set_satellites_visible,0)
+    L_RO_PROP_BATCHED(double,gps_hdop,set_gps_hdop,-1)
+    L_RO_PROP_BATCHED(double,gps_vdop,set_gps_vdop,-1)
     // gps lock type, see: mavlink_gps_raw_int_t / gps_status.fix_type
-    L_RO_PROP(int,gps_fix_type,set_gps_fix_type,0)
-    L_RO_PROP(QString,gps_status_fix_type_str,set_gps_status_fix_type_str,"Unknown") // User-understandable string for UI
+    L_RO_PROP_BATCHED(int,gps_fix_type,set_gps_fix_type,0)
+    L_RO_PROP_BATCHED(QString,gps_status_fix_type_str,set_gps_status_fix_type_str,"Unknown") // User-understandable string for UI
     // Home point (lat/lon/...) as reported by the FC via MAVLINK_MSG_ID_HOME_POSITION
-    L_RO_PROP(double,home_latitude,set_home_latitude,0.0);
-    L_RO_PROP(double,home_longitude,set_home_longitude,0.0);
+    L_RO_PROP_BATCHED(double,home_latitude,set_home_latitude,0.0);
+    L_RO_PROP_BATCHED(double,home_longitude,set_home_longitude,0.0);
 
-    L_RO_PROP(double,vx,set_vx,0.0)
-    L_RO_PROP(double,vy,set_vy,0.0)
-    L_RO_PROP(double,vz,set_vz,0.0)
+    L_RO_PROP_BATCHED(double,vx,set_vx,0.0)
+    L_RO_PROP_BATCHED(double,vy,set_vy,0.0)
+    L_RO_PROP_BATCHED(double,vz,set_vz,0.0)
     //
-    L_RO_PROP(double,altitude_rel_m,set_altitude_rel_m,0.0)
-    L_RO_PROP(double,altitude_msl_m,set_altitude_msl_m,0.0)
+    L_RO_PROP_BATCHED(double,altitude_rel_m,set_altitude_rel_m,0.0)
+    L_RO_PROP_BATCHED(double,altitude_msl_m,set_altitude_msl_m,0.0)
     //
-    L_RO_PROP(double,vehicle_vx_angle,set_vehicle_vx_angle,0.0);
-    L_RO_PROP(double,vehicle_vy_angle,set_vehicle_vy_angle,0.0);
-    L_RO_PROP(double,vehicle_vz_angle,set_vehicle_vz_angle,0.0);
+    L_RO_PROP_BATCHED(double,vehicle_vx_angle,set_vehicle_vx_angle,0.0);
+    L_RO_PROP_BATCHED(double,vehicle_vy_angle,set_vehicle_vy_angle,0.0);
+    L_RO_PROP_BATCHED(double,vehicle_vz_angle,set_vehicle_vz_angle,0.0);
     ////
-    L_RO_PROP(double,wind_speed,set_wind_speed,0)
-    L_RO_PROP(double,wind_direction,set_wind_direction,0)
-    L_RO_PROP(float,mav_wind_direction,set_mav_wind_direction,0)
-    L_RO_PROP(float,mav_wind_speed,set_mav_wind_speed,0)
+    L_RO_PROP_BATCHED(double,wind_speed,set_wind_speed,0)
+    L_RO_PROP_BATCHED(double,wind_direction,set_wind_direction,0)
+    L_RO_PROP_BATCHED(float,mav_wind_direction,set_mav_wind_direction,0)
+    L_RO_PROP_BATCHED(float,mav_wind_speed,set_mav_wind_speed,0)
     // Not openhd rc or something, but the RSSI of the (for example) OpenLRS receiver
     // value reported by the FC. Between [0...100], -1 -=> No value reported
-    L_RO_PROP(int,rc_rssi_percentage,set_rc_rssi_percentage,-1);
-    L_RO_PROP(int,imu_temp_degree,set_imu_temp_degree,0);
-    L_RO_PROP(int,preasure_sensor_temperature_degree,set_preasure_sensor_temperature_degree,0)
-    L_RO_PROP(int,airspeed_sensor_temperature_degree,set_airspeed_sensor_temperature_degree,99)
-    L_RO_PROP(int,esc_temp,set_esc_temp,0);
-    L_RO_PROP(QString,flight_time,set_flight_time,"00:00")
-    L_RO_PROP(double,flight_distance_m,set_flight_distance_m,0)
-    L_RO_PROP(double,lateral_speed,set_lateral_speed,0)  
-    L_RO_PROP(double,home_distance,set_home_distance,0)
-    L_RO_PROP(int,boot_time,set_boot_time,0)
-    L_RO_PROP(int,hdg,set_hdg,0)
-    L_RO_PROP(double,ground_speed_meter_per_second,set_ground_speed_meter_per_second,0)
-    L_RO_PROP(double,air_speed_meter_per_second,set_air_speed_meter_per_second,0)
+    L_RO_PROP_BATCHED(int,rc_rssi_percentage,set_rc_rssi_percentage,-1);
+    L_RO_PROP_BATCHED(int,imu_temp_degree,set_imu_temp_degree,0);
+    L_RO_PROP_BATCHED(int,preasure_sensor_temperature_degree,set_preasure_sensor_temperature_degree,0)
+    L_RO_PROP_BATCHED(int,airspeed_sensor_temperature_degree,set_airspeed_sensor_temperature_degree,99)
+    L_RO_PROP_BATCHED(int,esc_temp,set_esc_temp,0);
+    L_RO_PROP_BATCHED(QString,flight_time,set_flight_time,"00:00")
+    L_RO_PROP_BATCHED(double,flight_distance_m,set_flight_distance_m,0)
+    L_RO_PROP_BATCHED(double,lateral_speed,set_lateral_speed,0)  
+    L_RO_PROP_BATCHED(double,home_distance,set_home_distance,0)
+    L_RO_PROP_BATCHED(int,boot_time,set_boot_time,0)
+    L_RO_PROP_BATCHED(int,hdg,set_hdg,0)
+    L_RO_PROP_BATCHED(double,ground_speed_meter_per_second,set_ground_speed_meter_per_second,0)
+    L_RO_PROP_BATCHED(double,air_speed_meter_per_second,set_air_speed_meter_per_second,0)
 
-    L_RO_PROP(float,clipping_x,set_clipping_x,0.0)
-    L_RO_PROP(float,clipping_y,set_clipping_y,0.0)
-    L_RO_PROP(float,clipping_z,set_clipping_z,0.0)
-    L_RO_PROP(float,aoa,set_aoa,0.0)
+    L_RO_PROP_BATCHED(float,clipping_x,set_clipping_x,0.0)
+    L_RO_PROP_BATCHED(float,clipping_y,set_clipping_y,0.0)
+    L_RO_PROP_BATCHED(float,clipping_z,set_clipping_z,0.0)
+    L_RO_PROP_BATCHED(float,aoa,set_aoa,0.0)
     // This is not calculated by qopenhd, it comes from the vfr hud message
-    L_RO_PROP(float,vertical_speed_indicator_mps,set_vertical_speed_indicator_mps,0) //m/s], positive is up
+    L_RO_PROP_BATCHED(float,vertical_speed_indicator_mps,set_vertical_speed_indicator_mps,0) //m/s], positive is up
     //
-    L_RO_PROP(QString,mav_type,set_mav_type,"UNKNOWN");
-    L_RO_PROP(QString,autopilot_type,set_autopilot_type,"UNKNOWN"); //R.n Generic (inav), ardu and pixhawk
+    L_RO_PROP_BATCHED(QString,mav_type,set_mav_type,"UNKNOWN");
+    L_RO_PROP_BATCHED(QString,autopilot_type,set_autopilot_type,"UNKNOWN"); //R.n Generic (inav), ardu and pixhawk
     // Set to true if this FC supports basic commands, like return to home usw
     // R.N we only show those commands in the UI if this flag is set
     // and the flag is set if the FC is PX4 or Ardupilot
     // NOTE: this used to be done by .mav_type == "ARDUPLANE" ... in qml - please avoid that, just add another qt boolean here
     // (for example is_copter, is_plane or similar)
-    L_RO_PROP(bool,supports_basic_commands,set_supports_basic_commands,true)
+    L_RO_PROP_BATCHED(bool,supports_basic_commands,set_supports_basic_commands,true)
     // These are for sending the right flight mode commands
     // Weather it is any type of ardu-"copter,plane or vtol"
-    L_RO_PROP(bool,is_arducopter,set_is_arducopter,false);
-    L_RO_PROP(bool,is_arduplane,set_is_arduplane,false);
-    L_RO_PROP(bool,is_arduvtol,set_is_arduvtol,false);
-    L_RO_PROP(QString, last_ping_result_flight_ctrl,set_last_ping_result_flight_ctrl,"NA")
+    L_RO_PROP_BATCHED(bool,is_arducopter,set_is_arducopter,false);
+    L_RO_PROP_BATCHED(bool,is_arduplane,set_is_arduplane,false);
+    L_RO_PROP_BATCHED(bool,is_arduvtol,set_is_arduvtol,false);
+    L_RO_PROP_BATCHED(QString, last_ping_result_flight_ctrl,set_last_ping_result_flight_ctrl,"NA")
     // update rate: here we keep track of how often we get the "MAVLINK_MSG_ID_ATTITUDE" messages.
     // (since it controlls the art. horizon). This is pretty much the only thing we perhaps need to manually set the update rate on
-    L_RO_PROP(float,curr_update_rate_mavlink_message_attitude,set_curr_update_rate_mavlink_message_attitude,-1)
+    L_RO_PROP_BATCHED(float,curr_update_rate_mavlink_message_attitude,set_curr_update_rate_mavlink_message_attitude,-1)
     // We expose the sys id for the OSD to show - note that this value should not be used by any c++ code
-    L_RO_PROP(int,for_osd_sys_id,set_for_osd_sys_id,-1);
+    L_RO_PROP_BATCHED(int,for_osd_sys_id,set_for_osd_sys_id,-1);
     // TODO: We have 2 variables for the OSD to show - the current total n of waypoints and the current waypoint the FC is at. Depending on how things are broadcasted,
     // The user might have to manually request the current total n of waypoints
     // NOTE: the description "waypoints" is not exactly accurate, left in for now due to legacy reasons though
-    L_RO_PROP(int,mission_waypoints_current_total,set_mission_waypoints_current_total,-1);
-    L_RO_PROP(int,mission_waypoints_current,set_mission_waypoints_current,-1);
+    L_RO_PROP_BATCHED(int,mission_waypoints_current_total,set_mission_waypoints_current_total,-1);
+    L_RO_PROP_BATCHED(int,mission_waypoints_current,set_mission_waypoints_current,-1);
     // Current mission type, verbose as string for the user
-    L_RO_PROP(QString,mission_current_type,set_mission_current_type,"Unknown");
-    L_RO_PROP(int,distance_sensor_distance_cm,set_distance_sensor_distance_cm,-1);
+    L_RO_PROP_BATCHED(QString,mission_current_type,set_mission_current_type,"Unknown");
+    L_RO_PROP_BATCHED(int,distance_sensor_distance_cm,set_distance_sensor_distance_cm,-1);
     // (GPS) reported time
-    L_RO_PROP(quint64,sys_time_unix_usec,set_sys_time_unix_usec,0);
-    L_RO_PROP(QString,sys_time_unix_as_str,set_sys_time_unix_as_str,"N/A");
+    L_RO_PROP_BATCHED(quint64,sys_time_unix_usec,set_sys_time_unix_usec,0);
+    L_RO_PROP_BATCHED(QString,sys_time_unix_as_str,set_sys_time_unix_as_str,"N/A");
 public:
     void telemetryStatusMessage(QString message, int level);
     void calculate_home_distance();
@@ -211,6 +257,8 @@ signals:
 private:
     // NOTE: Null until system discovered
     std::shared_ptr<mavsdk::System> m_system=nullptr;
+    // -1 == not set, see set_replay_fc_sys_id
+    std::atomic<int> m_replay_fc_sys_id{-1};
     std::shared_ptr<mavsdk::Action> m_action=nullptr;
     // We got rid of this submodule for a good reason (see above)
     //std::shared_ptr<mavsdk::Telemetry> _mavsdk_telemetry=nullptr;
@@ -249,6 +297,12 @@ private:
     std::atomic<int32_t> m_last_message_ms= -1;
     void update_alive();
     std::chrono::steady_clock::time_point m_last_update_update_rate_mavlink_message_attitude=std::chrono::steady_clock::now();
+    // One handler per message type (telemetry thread)
+    MavlinkDispatcher m_dispatcher{"FC"};
+    void register_message_handlers();
+    // Written by the telemetry thread only (after each message that changes it)
+    SeqLock<VehicleState> m_vehicle_state;
+    void publish_vehicle_state();
     int m_n_messages_update_rate_mavlink_message_attitude=0;
 public:
     // WARNING: Do not call any non-async send command methods from the same thread that is parsing the mavlink messages !
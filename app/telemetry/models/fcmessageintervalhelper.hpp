@@ -7,6 +7,7 @@
 #include "../mavsdk_include.h"
 #include <optional>
 #include <qsettings.h>
+#include "util/settingscache.h"
 #include "../../logging/hudlogmessagesmodel.h"
 #include "qopenhdmavlinkhelper.hpp"
 
@@ -38,7 +39,7 @@ public:
     std::optional<mavlink_command_long_t> create_command_if_needed(){
         std::lock_guard<std::mutex> lock(m_mutex);
         // Can be disabled by the user
-        QSettings settings;
+        auto& settings=SettingsCache::instance();
         const bool set_mavlink_message_rates = settings.value("set_mavlink_message_rates",true).toBool();
         const bool mavlink_message_rates_high_speed=settings.value("mavlink_message_rates_high_speed",false).toBool();
         const bool mavlink_message_rates_high_speed_rc_channels=settings.value("mavlink_message_rates_high_speed_rc_channels",false).toBool();
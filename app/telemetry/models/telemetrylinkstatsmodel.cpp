@@ -0,0 +1,179 @@
+#include "telemetrylinkstatsmodel.h"
+
+#include <QDebug>
+#include <algorithm>
+#include <sstream>
+
+#include "../openhd_defines.hpp"
+#include "../qopenhdmavlinkhelper.hpp"
+#include "common/StringHelper.hpp"
+
+TelemetryLinkStatsModel::TelemetryLinkStatsModel(QObject *parent)
+    : QAbstractListModel(parent)
+{
+    m_timer=new QTimer(this);
+    QObject::connect(m_timer, &QTimer::timeout, this, &TelemetryLinkStatsModel::recalculate);
+    m_timer->start(1000);
+}
+
+TelemetryLinkStatsModel &TelemetryLinkStatsModel::instance()
+{
+    static TelemetryLinkStatsModel instance{};
+    return instance;
+}
+
+void TelemetryLinkStatsModel::on_message_in(const mavlink_message_t &msg)
+{
+    const int wire_size=QOpenHDMavlinkHelper::get_wire_size(msg);
+    std::lock_guard<std::mutex> lock(m_counters_mutex);
+    auto& counters=m_counters[get_key(msg.sysid,msg.compid)];
+    counters.packets_in++;
+    counters.bytes_in+=wire_size;
+    if(counters.last_seq>=0){
+        // seq wraps at 256, same as QGroundControl we count every gap as lost (a restarted sender too)
+        const uint8_t expected_seq=(uint8_t)(counters.last_seq+1);
+        counters.lost_packets+=(uint8_t)(msg.seq-expected_seq);
+    }
+    counters.last_seq=msg.seq;
+}
+
+void TelemetryLinkStatsModel::on_message_out(const mavlink_message_t &msg)
+{
+    const auto [target_sys_id,target_comp_id]=QOpenHDMavlinkHelper::get_target_sys_comp_id(msg);
+    const int wire_size=QOpenHDMavlinkHelper::get_wire_size(msg);
+    std::lock_guard<std::mutex> lock(m_counters_mutex);
+    auto& counters=m_counters[get_key(target_sys_id,target_comp_id)];
+    counters.packets_out++;
+    counters.bytes_out+=wire_size;
+}
+
+int TelemetryLinkStatsModel::rowCount(const QModelIndex &parent) const
+{
+    return m_data.size();
+}
+
+QVariant TelemetryLinkStatsModel::data(const QModelIndex &index, int role) const
+{
+    if ( !index.isValid() || index.row() >= m_data.size() )
+        return QVariant();
+    const auto& element = m_data.at(index.row());
+    switch(role){
+    case SysIdRole: return element.sys_id;
+    case CompIdRole: return element.comp_id;
+    case NameRole: return element.name;
+    case PpsInRole: return element.pps_in;
+    case BpsInRole: return element.bps_in;
+    case PpsOutRole: return element.pps_out;
+    case BpsOutRole: return element.bps_out;
+    case LostPpsRole: return element.lost_pps;
+    case LostPacketsRole: return (qulonglong)element.last.lost_packets;
+    case LossPercRole: return element.loss_perc;
+    case BytesInRole: return (qulonglong)element.last.bytes_in;
+    case BytesOutRole: return (qulonglong)element.last.bytes_out;
+    case ReadableRole: return get_readable(element);
+    default: break;
+    }
+    return QVariant();
+}
+
+QHash<int, QByteArray> TelemetryLinkStatsModel::roleNames() const
+{
+    static QHash<int, QByteArray> mapping {
+        {SysIdRole, "sys_id"},
+        {CompIdRole, "comp_id"},
+        {NameRole, "name"},
+        {PpsInRole, "pps_in"},
+        {BpsInRole, "bps_in"},
+        {PpsOutRole, "pps_out"},
+        {BpsOutRole, "bps_out"},
+        {LostPpsRole, "lost_pps"},
+        {LostPacketsRole, "lost_packets"},
+        {LossPercRole, "loss_perc"},
+        {BytesInRole, "bytes_in"},
+        {BytesOutRole, "bytes_out"},
+        {ReadableRole, "readable"},
+    };
+    return mapping;
+}
+
+void TelemetryLinkStatsModel::recalculate()
+{
+    const auto now=std::chrono::steady_clock::now();
+    const double elapsed_s=std::chrono::duration<double>(now-m_last_recalculation).count();
+    m_last_recalculation=now;
+    if(elapsed_s<=0)return;
+    std::map<int,Counters> counters;
+    {
+        std::lock_guard<std::mutex> lock(m_counters_mutex);
+        counters=m_counters;
+    }
+    double total_pps_in=0,total_bps_in=0,total_pps_out=0,total_bps_out=0;
+    uint64_t total_lost_packets=0;
+    for(const auto& [key,curr]:counters){
+        // rows are sorted by sys / comp id
+        auto it=std::lower_bound(m_data.begin(),m_data.end(),key,[](const Element& element,int value){
+            return element.key<value;
+        });
+        const int row=it-m_data.begin();
+        if(it==m_data.end() || it->key!=key){
+            Element element{};
+            element.key=key;
+            element.sys_id=key>>8;
+            element.comp_id=key & 0xFF;
+            element.name=get_name(element.sys_id,element.comp_id);
+            beginInsertRows(QModelIndex(),row,row);
+            m_data.insert(row,element);
+            endInsertRows();
+        }
+        Element& element=m_data[row];
+        const Counters& last=element.last;
+        element.pps_in=(curr.packets_in-last.packets_in)/elapsed_s;
+        element.bps_in=(curr.bytes_in-last.bytes_in)*8/elapsed_s;
+        element.pps_out=(curr.packets_out-last.packets_out)/elapsed_s;
+        element.bps_out=(curr.bytes_out-last.bytes_out)*8/elapsed_s;
+        const uint64_t lost=curr.lost_packets-last.lost_packets;
+        const uint64_t received=curr.packets_in-last.packets_in;
+        element.lost_pps=lost/elapsed_s;
+        element.loss_perc=lost+received>0 ? 100.0*lost/(lost+received) : 0;
+        element.last=curr;
+        emit dataChanged(index(row,0),index(row,0));
+        total_pps_in+=element.pps_in;
+        total_bps_in+=element.bps_in;
+        total_pps_out+=element.pps_out;
+        total_bps_out+=element.bps_out;
+        total_lost_packets+=curr.lost_packets;
+    }
+    set_total_in(StringHelper::bitrate_and_pps_to_string(total_bps_in,total_pps_in).c_str());
+    set_total_out(StringHelper::bitrate_and_pps_to_string(total_bps_out,total_pps_out).c_str());
+    set_total_lost_packets((int)total_lost_packets);
+}
+
+QString TelemetryLinkStatsModel::get_name(int sys_id, int comp_id)
+{
+    QString name;
+    if(sys_id==0){
+        name="Broadcast";
+    }else if(sys_id==OHD_SYS_ID_GROUND){
+        name="OHD Ground";
+    }else if(sys_id==OHD_SYS_ID_AIR){
+        name=comp_id==OHD_COMP_ID_AIR_CAMERA_PRIMARY || comp_id==OHD_COMP_ID_AIR_CAMERA_SECONDARY ? "OHD Air camera" : "OHD Air";
+    }else if(sys_id==QOpenHDMavlinkHelper::get_own_sys_id()){
+        name="QOpenHD";
+    }else{
+        // Everything else is most likely the FC (see MavlinkTelemetry::onNewSystem)
+        name=comp_id==MAV_COMP_ID_AUTOPILOT1 ? "FC" : "FC / other";
+    }
+    return name+" ("+QString::number(sys_id)+":"+QString::number(comp_id)+")";
+}
+
+QString TelemetryLinkStatsModel::get_readable(const Element &element)
+{
+    std::stringstream ss;
+    ss<<"in "<<StringHelper::bitrate_and_pps_to_string(element.bps_in,element.pps_in)
+      <<" out "<<StringHelper::bitrate_and_pps_to_string(element.bps_out,element.pps_out)
+      <<" lost "<<element.last.lost_packets;
+    if(element.loss_perc>0){
+        ss<<" ("<<StringHelper::to_string_with_precision(element.loss_perc,1)<<"%)";
+    }
+    return ss.str().c_str();
+}
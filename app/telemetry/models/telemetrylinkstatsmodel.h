@@ -0,0 +1,98 @@
+#ifndef TELEMETRYLINKSTATSMODEL_H
+#define TELEMETRYLINKSTATSMODEL_H
+
+#include <QAbstractListModel>
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+#include <chrono>
+#include <map>
+#include <mutex>
+
+#include "../mavsdk_include.h"
+#include "../../../lib/lqtutils_master/lqtutils_prop.h"
+
+// Telemetry link budget: real (on the wire) bytes and packets per mavlink sys / comp id, per direction, for sizing
+// the (narrow) wifibroadcast telemetry link.
+// In: accounted by the sender (sys / comp id of the message), including the lost packets (gaps in msg.seq, which is
+// per sender component).
+// Out: everything QOpenHD (and mavsdk on behalf of QOpenHD, e.g. heartbeats and params) sends, accounted by the target
+// sys / comp id in the message (0 == broadcast).
+// One row per sys / comp id, the rates are recalculated once per second (UI thread).
+// singleton, corresponding qt name is "_telemetryLinkStatsModel" (see main)
+class TelemetryLinkStatsModel : public QAbstractListModel
+{
+    Q_OBJECT
+    // Sum of all rows, readable
+    L_RO_PROP(QString,total_in,set_total_in,"N/A")
+    L_RO_PROP(QString,total_out,set_total_out,"N/A")
+    L_RO_PROP(int,total_lost_packets,set_total_lost_packets,0)
+public:
+    explicit TelemetryLinkStatsModel(QObject *parent = nullptr);
+    static TelemetryLinkStatsModel& instance();
+    // Telemetry receive thread
+    void on_message_in(const mavlink_message_t& msg);
+    // Any thread, msg needs to be finalized (packed)
+    void on_message_out(const mavlink_message_t& msg);
+public:
+    enum Roles {
+        SysIdRole =Qt::UserRole,
+        CompIdRole,
+        NameRole,
+        PpsInRole,
+        BpsInRole,
+        PpsOutRole,
+        BpsOutRole,
+        // per second, and since QOpenHD has been started
+        LostPpsRole,
+        LostPacketsRole,
+        // lost / (lost + received) of the last second
+        LossPercRole,
+        BytesInRole,
+        BytesOutRole,
+        // e.g. "in 1.2Mbit/s (120pps) out 8kbit/s (5pps) lost 0"
+        ReadableRole
+    };
+    int rowCount(const QModelIndex& parent= QModelIndex()) const override;
+    QVariant data( const QModelIndex& index, int role = Qt::DisplayRole ) const override;
+    QHash<int, QByteArray> roleNames() const override;
+private:
+    static int get_key(uint8_t sys_id,uint8_t comp_id){
+        return (sys_id<<8) | comp_id;
+    }
+    struct Counters{
+        uint64_t packets_in=0;
+        uint64_t bytes_in=0;
+        uint64_t packets_out=0;
+        uint64_t bytes_out=0;
+        uint64_t lost_packets=0;
+        int last_seq=-1;
+    };
+    // Written by the telemetry thread(s), read once per second by the UI thread
+    std::mutex m_counters_mutex;
+    std::map<int,Counters> m_counters;
+private:
+    // UI thread only
+    struct Element{
+        int key=0;
+        int sys_id=0;
+        int comp_id=0;
+        QString name;
+        double pps_in=0;
+        double bps_in=0;
+        double pps_out=0;
+        double bps_out=0;
+        double lost_pps=0;
+        double loss_perc=0;
+        // counters at the last recalculation
+        Counters last{};
+    };
+    void recalculate();
+    static QString get_name(int sys_id,int comp_id);
+    static QString get_readable(const Element& element);
+    QVector<Element> m_data;
+    QTimer* m_timer=nullptr;
+    std::chrono::steady_clock::time_point m_last_recalculation=std::chrono::steady_clock::now();
+};
+
+#endif // TELEMETRYLINKSTATSMODEL_H
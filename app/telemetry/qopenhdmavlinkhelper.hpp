@@ -3,7 +3,9 @@
 
 #include <chrono>
 #include <sstream>
+#include <utility>
 #include <qsettings.h>
+#include "util/settingscache.h"
 #include <QByteArray>
 #include "mavsdk_include.h"
 
@@ -24,7 +26,7 @@ static uint64_t getTimeMilliseconds(){
 // Return: The mavlink sys id of QOpenHD. By default, same as QGroundControl. However, in case one uses multiple ground controlls
 // with OpenHD (or QOpenHD AND QGroundCOntroll at the same time) this value needs to be changed
 static uint8_t get_own_sys_id(){
-    QSettings settings;
+    auto& settings=SettingsCache::instance();
     // NOTE: QGroundControll also uses a sys id of 255 - we need a hard coded 255 sys id for the rc channels override hack in openhd
     // (And in general, for now, you should never have 2 GCS open at the same time connected to OpenHD anyways)
     const int qopenhd_mavlink_sysid = settings.value("qopenhd_mavlink_sysid", 255).toInt();
@@ -37,7 +39,7 @@ static uint8_t get_own_comp_id(){
 }
 
 static int get_vehicle_battery_n_cells(){
-    QSettings settings;
+    auto& settings=SettingsCache::instance();
     const int vehicle_battery_n_cells = settings.value("vehicle_battery_n_cells", 3).toInt();
     return vehicle_battery_n_cells;
 }
@@ -96,6 +98,36 @@ static std::string time_microseconds_readable(int64_t micros){
     return ss.str();
 }
 
+// Size on the wire: header, (trimmed) payload, crc and signature - v1 or v2
+static int get_wire_size(const mavlink_message_t& msg){
+    if(msg.magic==MAVLINK_STX_MAVLINK1){
+        return 1+MAVLINK_CORE_HEADER_MAVLINK1_LEN+msg.len+MAVLINK_NUM_CHECKSUM_BYTES;
+    }
+    int size=1+MAVLINK_CORE_HEADER_LEN+msg.len+MAVLINK_NUM_CHECKSUM_BYTES;
+    if(msg.incompat_flags & MAVLINK_IFLAG_SIGNED){
+        size+=MAVLINK_SIGNATURE_BLOCK_LEN;
+    }
+    return size;
+}
+
+// Target sys / comp id of a (packed) message, 0 (broadcast) if the message has no target field
+static std::pair<uint8_t,uint8_t> get_target_sys_comp_id(const mavlink_message_t& msg){
+    uint8_t target_sys_id=0;
+    uint8_t target_comp_id=0;
+    const mavlink_msg_entry_t* entry=mavlink_get_msg_entry(msg.msgid);
+    if(entry!=nullptr){
+        // the payload is trimmed (trailing zeros) on the wire - a target that is not in there is 0
+        const uint8_t* payload=(const uint8_t*)msg.payload64;
+        if((entry->flags & MAV_MSG_ENTRY_FLAG_HAVE_TARGET_SYSTEM) && entry->target_system_ofs<msg.len){
+            target_sys_id=payload[entry->target_system_ofs];
+        }
+        if((entry->flags & MAV_MSG_ENTRY_FLAG_HAVE_TARGET_COMPONENT) && entry->target_component_ofs<msg.len){
+            target_comp_id=payload[entry->target_component_ofs];
+        }
+    }
+    return {target_sys_id,target_comp_id};
+}
+
 }
 
 #endif // QOPENHDMAVLINKHELPER_H
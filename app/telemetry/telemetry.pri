@@ -73,14 +73,18 @@ SOURCES += \
     app/telemetry/models/aohdsystem.cpp \
     app/telemetry/models/camerastreammodel.cpp \
     app/telemetry/models/rcchannelsmodel.cpp \
+    app/telemetry/models/telemetrylinkstatsmodel.cpp \
     app/telemetry/models/wificard.cpp \
     app/telemetry/settings/improvedintsetting.cpp \
     app/telemetry/settings/improvedstringsetting.cpp \
     app/telemetry/settings/synchronizedsettings.cpp \
     app/telemetry/MavlinkTelemetry.cpp \
+    app/telemetry/MavlinkSendQueue.cpp \
     app/telemetry/settings/mavlinksettingsmodel.cpp \
     app/telemetry/models/fcmavlinksystem.cpp \
     app/telemetry/models/fcmavlinkmissionitemsmodel.cpp \
+    app/telemetry/tlog/TLogRecorder.cpp \
+    app/telemetry/tlog/TLogReplay.cpp \
 
 HEADERS += \
     $$PWD/geodesi_helper.h \
@@ -90,10 +94,13 @@ HEADERS += \
     $$PWD/models/fcmessageintervalhelper.hpp \
     $$PWD/settings/documented_param.h \
     app/telemetry/mavsdk_helper.hpp \
+    app/telemetry/mavlink_dispatcher.hpp \
+    app/telemetry/telemetry_benchmark_report.hpp \
     app/telemetry/mavsdk_include.h \
     app/telemetry/models/aohdsystem.h \
     app/telemetry/models/camerastreammodel.h \
     app/telemetry/models/rcchannelsmodel.h \
+    app/telemetry/models/telemetrylinkstatsmodel.h \
     app/telemetry/models/wificard.h \
     app/telemetry/openhd_defines.hpp \
     app/telemetry/qopenhdmavlinkhelper.hpp \
@@ -102,9 +109,14 @@ HEADERS += \
     app/telemetry/settings/synchronizedsettings.h \
     app/telemetry/telemetryutil.hpp \
     app/telemetry/MavlinkTelemetry.h \
+    app/telemetry/MavlinkSendQueue.h \
     app/telemetry/settings/mavlinksettingsmodel.h \
     app/telemetry/models/fcmavlinksystem.h \
     app/telemetry/models/fcmavlinkmissionitemsmodel.h \
     app/telemetry/models/fcmessageintervalhelper.hpp \
+    app/telemetry/tlog/TLogFormat.hpp \
+    app/telemetry/tlog/TLogRecorder.h \
+    app/telemetry/tlog/TLogReplay.h \
+    app/telemetry/tlog/TLogRing.hpp \
 
 DEFINES += QOPENHD_HAS_MAVSDK_MAVLINK_TELEMETRY
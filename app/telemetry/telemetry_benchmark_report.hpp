@@ -0,0 +1,60 @@
+#ifndef TELEMETRY_BENCHMARK_REPORT_HPP
+#define TELEMETRY_BENCHMARK_REPORT_HPP
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QSaveFile>
+#include <chrono>
+#include <sstream>
+
+#include "MavlinkTelemetry.h"
+#include "util/batchedpropertypublisher.h"
+#include "util/settingscache.h"
+
+/**
+ * Machine readable telemetry stats for headless load testing with tools/mavlink_sim, which runs on the same host and
+ * reads this file while it floods QOpenHD with messages.
+ * Written once per second from the FC property publisher stats (UI thread) if dev_telemetry_benchmark_report is enabled.
+ * One key=value per line, the file is replaced atomically. timestamp_us is steady_clock (CLOCK_MONOTONIC on linux),
+ * the same clock the simulator uses.
+ */
+namespace TelemetryBenchmarkReport{
+
+static QString get_filename(){
+    return QDir::tempPath()+"/qopenhd_telemetry_benchmark.txt";
+}
+
+static void write_if_enabled(const BatchedPropertyPublisher::Stats& stats){
+    if(!SettingsCache::instance().value("dev_telemetry_benchmark_report",false).toBool())return;
+    const auto to_us=[](std::chrono::nanoseconds value){
+        return std::chrono::duration_cast<std::chrono::microseconds>(value).count();
+    };
+    const auto& telemetry=MavlinkTelemetry::instance();
+    const auto processing_time_ns=telemetry.get_processing_time_avg_p99_ns();
+    std::stringstream ss;
+    ss<<"timestamp_us="<<to_us(std::chrono::steady_clock::now().time_since_epoch())<<"\n";
+    ss<<"pid="<<QCoreApplication::applicationPid()<<"\n";
+    ss<<"rx_packets="<<telemetry.get_n_received_packets()<<"\n";
+    ss<<"rx_pps="<<telemetry.telemetry_pps_in()<<"\n";
+    ss<<"processing_avg_us="<<processing_time_ns.first/1000<<"\n";
+    ss<<"processing_p99_us="<<processing_time_ns.second/1000<<"\n";
+    ss<<"publish_latency_avg_us="<<to_us(stats.publish_latency.getAvg())<<"\n";
+    ss<<"publish_latency_p99_us="<<to_us(stats.publish_latency.get_percentile(0.99))<<"\n";
+    ss<<"publish_latency_max_us="<<to_us(stats.publish_latency.getMax())<<"\n";
+    ss<<"changes_per_s="<<(int)stats.changes_per_s<<"\n";
+    ss<<"signals_per_s="<<(int)stats.signals_per_s<<"\n";
+    ss<<"publish_ms_per_s="<<stats.publish_ms_per_s<<"\n";
+    ss<<"ui_cpu_perc="<<stats.ui_thread_cpu_perc<<"\n";
+    QSaveFile file(get_filename());
+    if(!file.open(QIODevice::WriteOnly)){
+        qDebug()<<"TelemetryBenchmarkReport cannot write"<<get_filename();
+        return;
+    }
+    const std::string report=ss.str();
+    file.write(report.data(),report.size());
+    file.commit();
+}
+
+}
+
+#endif // TELEMETRY_BENCHMARK_REPORT_HPP
@@ -0,0 +1,158 @@
+#ifndef TLOGFORMAT_HPP
+#define TLOGFORMAT_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * The (QGroundControl / MissionPlanner / pymavlink) .tlog format: for each mavlink packet, an 8 byte big endian
+ * unix timestamp in microseconds followed by the raw packet (mavlink v1 or v2, as on the wire).
+ * QOpenHD additionally writes a sidecar index (<name>.tlog.idx) with time, offset and msg id of each packet, such that
+ * replay can seek by time (binary search) without scanning the whole file. If the index is missing or doesn't match the
+ * .tlog (e.g. the recording was not closed properly) it is rebuilt by scanning.
+ */
+namespace qopenhd::tlog{
+
+static constexpr size_t TIMESTAMP_SIZE=8;
+static constexpr uint8_t MAVLINK_V1_STX=0xFE;
+static constexpr uint8_t MAVLINK_V2_STX=0xFD;
+// v2, MAVLINK_IFLAG_SIGNED
+static constexpr uint8_t MAVLINK_V2_INCOMPAT_FLAG_SIGNED=0x01;
+static constexpr size_t MAVLINK_V2_SIGNATURE_SIZE=13;
+
+struct IndexEntry{
+    uint64_t timestamp_us;
+    // of the timestamp (the packet follows)
+    uint64_t offset;
+    uint32_t msgid;
+    uint32_t packet_size;
+};
+static_assert(sizeof(IndexEntry)==24,"IndexEntry is written as is");
+
+static constexpr char INDEX_MAGIC[8]={'Q','O','H','D','T','I','X','1'};
+struct IndexHeader{
+    char magic[8];
+    uint32_t entry_size;
+    uint32_t reserved;
+};
+
+static void write_timestamp(uint8_t* dst,uint64_t timestamp_us){
+    for(int i=0;i<8;i++){
+        dst[i]=(uint8_t)(timestamp_us>>(56-8*i));
+    }
+}
+
+static uint64_t read_timestamp(const uint8_t* src){
+    uint64_t ret=0;
+    for(int i=0;i<8;i++){
+        ret=(ret<<8) | src[i];
+    }
+    return ret;
+}
+
+// Size of the mavlink packet starting at data, 0 if data doesn't start with a (plausible) packet or is incomplete
+static size_t get_packet_size(const uint8_t* data,size_t available){
+    if(available<3)return 0;
+    size_t size=0;
+    if(data[0]==MAVLINK_V1_STX){
+        // stx,len,seq,sysid,compid,msgid,payload,crc
+        size=6+data[1]+2;
+    }else if(data[0]==MAVLINK_V2_STX){
+        // stx,len,incompat,compat,seq,sysid,compid,msgid(3),payload,crc,(signature)
+        size=10+data[1]+2;
+        if(data[2] & MAVLINK_V2_INCOMPAT_FLAG_SIGNED){
+            size+=MAVLINK_V2_SIGNATURE_SIZE;
+        }
+    }else{
+        return 0;
+    }
+    return size<=available ? size : 0;
+}
+
+// packet needs to be valid (see get_packet_size)
+static uint32_t get_msgid(const uint8_t* packet){
+    if(packet[0]==MAVLINK_V1_STX){
+        return packet[5];
+    }
+    return packet[7] | (packet[8]<<8) | (packet[9]<<16);
+}
+
+// Scans a whole .tlog, skipping garbage (resync on the next plausible packet)
+static std::vector<IndexEntry> build_index(const uint8_t* data,size_t size){
+    std::vector<IndexEntry> ret;
+    ret.reserve(size/40);
+    size_t offset=0;
+    while(offset+TIMESTAMP_SIZE<size){
+        const uint8_t* packet=data+offset+TIMESTAMP_SIZE;
+        const size_t packet_size=get_packet_size(packet,size-offset-TIMESTAMP_SIZE);
+        if(packet_size==0){
+            offset++;
+            continue;
+        }
+        IndexEntry entry;
+        entry.timestamp_us=read_timestamp(data+offset);
+        entry.offset=offset;
+        entry.msgid=get_msgid(packet);
+        entry.packet_size=(uint32_t)packet_size;
+        ret.push_back(entry);
+        offset+=TIMESTAMP_SIZE+packet_size;
+    }
+    return ret;
+}
+
+static std::string get_index_filename(const std::string& tlog_filename){
+    return tlog_filename+".idx";
+}
+
+// Writes the header of an (empty) index, entries are appended via append_index_entries
+static bool write_index_header(FILE* file){
+    IndexHeader header{};
+    memcpy(header.magic,INDEX_MAGIC,sizeof(INDEX_MAGIC));
+    header.entry_size=sizeof(IndexEntry);
+    return fwrite(&header,sizeof(header),1,file)==1;
+}
+
+static bool append_index_entries(FILE* file,const std::vector<IndexEntry>& entries){
+    if(entries.empty())return true;
+    return fwrite(entries.data(),sizeof(IndexEntry),entries.size(),file)==entries.size();
+}
+
+static bool write_index(const std::string& tlog_filename,const std::vector<IndexEntry>& entries){
+    FILE* file=fopen(get_index_filename(tlog_filename).c_str(),"wb");
+    if(file==nullptr)return false;
+    const bool success=write_index_header(file) && append_index_entries(file,entries);
+    fclose(file);
+    return success;
+}
+
+// Returns nullopt if there is no index or it doesn't match the .tlog of size tlog_size
+static std::optional<std::vector<IndexEntry>> read_index(const std::string& tlog_filename,uint64_t tlog_size){
+    FILE* file=fopen(get_index_filename(tlog_filename).c_str(),"rb");
+    if(file==nullptr)return std::nullopt;
+    std::optional<std::vector<IndexEntry>> ret=std::nullopt;
+    IndexHeader header{};
+    if(fread(&header,sizeof(header),1,file)==1 && memcmp(header.magic,INDEX_MAGIC,sizeof(INDEX_MAGIC))==0
+            && header.entry_size==sizeof(IndexEntry)){
+        std::vector<IndexEntry> entries;
+        IndexEntry entry;
+        while(fread(&entry,sizeof(entry),1,file)==1){
+            entries.push_back(entry);
+        }
+        // The index is written after the data, the last entry has to end exactly at the end of the file
+        const bool matches=entries.empty() ? tlog_size==0 :
+                entries.back().offset+TIMESTAMP_SIZE+entries.back().packet_size==tlog_size;
+        if(matches){
+            ret=std::move(entries);
+        }
+    }
+    fclose(file);
+    return ret;
+}
+
+}
+
+#endif // TLOGFORMAT_HPP
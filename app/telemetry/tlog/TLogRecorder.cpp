@@ -0,0 +1,267 @@
+#include "TLogRecorder.h"
+
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+
+#include <QDir>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <qdebug.h>
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+#include "../openhd_defines.hpp"
+#include "common/StringHelper.hpp"
+#include "util/settingscache.h"
+
+using namespace qopenhd::tlog;
+
+static uint64_t get_unix_time_us(){
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static std::string create_tlog_filename(const std::string& directory,uint64_t timestamp_us,bool recovered){
+    const std::time_t time=timestamp_us/1000000;
+    std::tm tm{};
+#ifdef _WIN32
+    localtime_s(&tm,&time);
+#else
+    localtime_r(&time,&tm);
+#endif
+    std::stringstream base;
+    base<<directory<<"/qopenhd_"<<std::put_time(&tm,"%Y%m%d_%H%M%S")<<(recovered ? "_recovered" : "");
+    std::string filename=base.str()+".tlog";
+    // more than one flight per second (or a clock jump) - don't overwrite
+    for(int i=1;QFileInfo::exists(QString::fromStdString(filename));i++){
+        filename=base.str()+"_"+std::to_string(i)+".tlog";
+    }
+    return filename;
+}
+
+TLogRecorder::TLogRecorder(QObject *parent)
+    : QObject{parent}
+{
+}
+
+TLogRecorder::~TLogRecorder()
+{
+    stop();
+}
+
+TLogRecorder &TLogRecorder::instance()
+{
+    static TLogRecorder recorder{};
+    return recorder;
+}
+
+QString TLogRecorder::get_directory()
+{
+    const QString default_directory=QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation)+"/qopenhd/tlogs";
+    return SettingsCache::instance().value("tlog_directory",default_directory).toString();
+}
+
+void TLogRecorder::start()
+{
+    if(m_writer_thread)return;
+    auto& settings=SettingsCache::instance();
+    if(!settings.value("tlog_recording_enable",false).toBool()){
+        qDebug()<<"TLogRecorder disabled";
+        return;
+    }
+    m_directory=get_directory().toStdString();
+    m_max_total_bytes=(uint64_t)settings.value("tlog_max_total_mb",1024).toInt()*1024*1024;
+    const uint64_t ring_size=(uint64_t)std::max(settings.value("dev_tlog_ring_size_mb",8).toInt(),1)*1024*1024;
+    if(!QDir().mkpath(QString::fromStdString(m_directory))){
+        qDebug()<<"TLogRecorder cannot create"<<m_directory.c_str();
+        return;
+    }
+    if(!m_ring.open(m_directory+"/.qopenhd_tlog_ring",ring_size)){
+        return;
+    }
+    qDebug()<<"TLogRecorder recording to"<<m_directory.c_str()<<"ring:"<<StringHelper::memorySizeReadable(ring_size).c_str();
+    m_running=true;
+    m_writer_thread=std::make_unique<std::thread>(&TLogRecorder::loop_writer,this);
+    m_active=true;
+}
+
+void TLogRecorder::stop()
+{
+    if(!m_writer_thread)return;
+    {
+        // make sure no producer is currently pushing
+        std::lock_guard<std::mutex> lock(m_producer_mutex);
+        m_active=false;
+    }
+    m_running=false;
+    m_writer_thread->join();
+    m_writer_thread=nullptr;
+    m_ring.close();
+}
+
+void TLogRecorder::on_message(const mavlink_message_t &msg)
+{
+    if(!m_active.load(std::memory_order_relaxed))return;
+    const uint64_t timestamp_us=get_unix_time_us();
+    uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+    const uint16_t len=mavlink_msg_to_send_buffer(buffer,&msg);
+    std::lock_guard<std::mutex> lock(m_producer_mutex);
+    if(!m_active)return;
+    m_ring.push(timestamp_us,buffer,len);
+    if(msg.msgid==MAVLINK_MSG_ID_HEARTBEAT && msg.sysid!=OHD_SYS_ID_AIR && msg.sysid!=OHD_SYS_ID_GROUND){
+        mavlink_heartbeat_t heartbeat;
+        mavlink_msg_heartbeat_decode(&msg,&heartbeat);
+        if(heartbeat.autopilot!=MAV_AUTOPILOT_INVALID && heartbeat.type!=MAV_TYPE_GCS){
+            const bool armed=(heartbeat.base_mode & MAV_MODE_FLAG_SAFETY_ARMED)!=0;
+            if(m_fc_armed && !armed && m_fc_sys_id==msg.sysid){
+                // End of flight - the writer rolls after it has written this heartbeat (it is already in the ring)
+                qDebug()<<"TLogRecorder FC disarmed, end of flight";
+                m_roll_requested=true;
+            }
+            m_fc_sys_id=msg.sysid;
+            m_fc_armed=armed;
+        }
+    }
+}
+
+void TLogRecorder::roll()
+{
+    m_roll_requested=true;
+}
+
+void TLogRecorder::loop_writer()
+{
+    // Whatever is still in the ring was received by a previous QOpenHD that didn't exit properly
+    if(m_ring.get_n_buffered_bytes()>0){
+        const int n_recovered=drain(true);
+        qDebug()<<"TLogRecorder recovered"<<n_recovered<<"messages";
+        close_file();
+    }
+    m_last_fsync=std::chrono::steady_clock::now();
+    while(m_running){
+        // Check before draining - everything that was pushed before the request is written into the old file
+        const bool roll=m_roll_requested.exchange(false);
+        drain(false);
+        if(roll){
+            close_file();
+        }
+        publish_status(false);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    drain(false);
+    close_file();
+    publish_status(true);
+}
+
+int TLogRecorder::drain(bool recovered)
+{
+    int n_messages=0;
+    uint64_t timestamp_us;
+    while(m_ring.pop(timestamp_us,m_payload)){
+        const size_t packet_size=get_packet_size(m_payload.data(),m_payload.size());
+        if(packet_size==0)continue;
+        if(m_file==nullptr && !open_file(timestamp_us,recovered))continue;
+        uint8_t timestamp[TIMESTAMP_SIZE];
+        write_timestamp(timestamp,timestamp_us);
+        if(fwrite(timestamp,TIMESTAMP_SIZE,1,m_file)!=1 || fwrite(m_payload.data(),packet_size,1,m_file)!=1){
+            qDebug()<<"TLogRecorder write failed, closing"<<m_filename.c_str();
+            close_file();
+            continue;
+        }
+        m_index_pending.push_back(IndexEntry{timestamp_us,m_file_size,get_msgid(m_payload.data()),(uint32_t)packet_size});
+        m_file_size+=TIMESTAMP_SIZE+packet_size;
+        m_n_messages++;
+        n_messages++;
+    }
+    if(m_file!=nullptr && n_messages>0){
+        // data first, such that the index never points past the end of the data
+        fflush(m_file);
+        append_index_entries(m_index_file,m_index_pending);
+        fflush(m_index_file);
+        m_index_pending.clear();
+        const auto now=std::chrono::steady_clock::now();
+        if(now-m_last_fsync>=std::chrono::seconds(1)){
+            m_last_fsync=now;
+#if defined(__linux__)
+            fdatasync(fileno(m_file));
+#endif
+        }
+    }
+    return n_messages;
+}
+
+bool TLogRecorder::open_file(uint64_t first_timestamp_us,bool recovered)
+{
+    const std::string filename=create_tlog_filename(m_directory,first_timestamp_us,recovered);
+    m_file=fopen(filename.c_str(),"wb");
+    m_index_file=m_file ? fopen(get_index_filename(filename).c_str(),"wb") : nullptr;
+    if(m_file==nullptr || m_index_file==nullptr || !write_index_header(m_index_file)){
+        qDebug()<<"TLogRecorder cannot open"<<filename.c_str();
+        close_file();
+        return false;
+    }
+    setvbuf(m_file,nullptr,_IOFBF,64*1024);
+    qDebug()<<"TLogRecorder recording to"<<filename.c_str();
+    m_filename=filename;
+    m_file_size=0;
+    m_n_messages=0;
+    delete_oldest_recordings();
+    publish_status(true);
+    return true;
+}
+
+void TLogRecorder::close_file()
+{
+    if(m_file!=nullptr){
+        fflush(m_file);
+        append_index_entries(m_index_file,m_index_pending);
+        qDebug()<<"TLogRecorder closing"<<m_filename.c_str()<<m_n_messages<<"messages";
+        fclose(m_file);
+        m_file=nullptr;
+    }
+    if(m_index_file!=nullptr){
+        fclose(m_index_file);
+        m_index_file=nullptr;
+    }
+    m_index_pending.clear();
+    publish_status(true);
+}
+
+void TLogRecorder::delete_oldest_recordings()
+{
+    if(m_max_total_bytes==0)return;
+    QDir dir(QString::fromStdString(m_directory));
+    // oldest first
+    const auto files=dir.entryInfoList(QStringList()<<"*.tlog",QDir::Files,QDir::Time | QDir::Reversed);
+    uint64_t total_bytes=0;
+    for(const auto& file:files){
+        total_bytes+=file.size();
+    }
+    for(const auto& file:files){
+        if(total_bytes<=m_max_total_bytes)break;
+        if(file.absoluteFilePath().toStdString()==m_filename)continue;
+        qDebug()<<"TLogRecorder deleting"<<file.absoluteFilePath();
+        total_bytes-=file.size();
+        QFile::remove(file.absoluteFilePath());
+        QFile::remove(file.absoluteFilePath()+".idx");
+    }
+}
+
+void TLogRecorder::publish_status(bool force)
+{
+    const auto now=std::chrono::steady_clock::now();
+    if(!force && now-m_last_status<std::chrono::seconds(1))return;
+    m_last_status=now;
+    const bool active=m_file!=nullptr;
+    set_recording_active(active);
+    set_recording_file(active ? QString::fromStdString(m_filename) : "");
+    std::stringstream ss;
+    if(active){
+        ss<<m_n_messages<<" msgs "<<StringHelper::memorySizeReadable(m_file_size);
+    }
+    if(m_ring.is_open() && m_ring.get_n_dropped()>0){
+        ss<<" dropped:"<<m_ring.get_n_dropped();
+    }
+    set_recording_status(QString::fromStdString(ss.str()));
+}
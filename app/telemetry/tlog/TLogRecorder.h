@@ -0,0 +1,85 @@
+#ifndef TLOGRECORDER_H
+#define TLOGRECORDER_H
+
+#include <QObject>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lib/lqtutils_master/lqtutils_prop.h"
+#include "../mavsdk_include.h"
+#include "TLogFormat.hpp"
+#include "TLogRing.hpp"
+
+/**
+ * Flight recorder for the mavlink telemetry: every message QOpenHD receives (MavlinkTelemetry::onProcessMavlinkMessage)
+ * is recorded with its receive time.
+ * The receive thread only serializes the message into a preallocated, memory mapped ring file (TLogRing) - it never
+ * blocks on disk. A writer thread drains the ring into a standard .tlog (readable by QGroundControl, MissionPlanner,
+ * pymavlink, ...) plus a sidecar time / msg id index (see TLogFormat.hpp), which is what the TLogReplay uses.
+ * A flight is rolled into its own file when the FC disarms. Data that was still in the ring when QOpenHD crashed is
+ * recovered into a "_recovered" .tlog on the next start. The oldest recordings are deleted once the recordings take
+ * more than tlog_max_total_mb.
+ * singleton, corresponding qt name is "_tlogRecorder" (see main)
+ */
+class TLogRecorder : public QObject
+{
+    Q_OBJECT
+    L_RO_PROP(bool, recording_active, set_recording_active, false)
+    // Current .tlog (file name)
+    L_RO_PROP(QString, recording_file, set_recording_file, "")
+    // n of messages, size and dropped messages (the writer could not keep up), for the stats
+    L_RO_PROP(QString, recording_status, set_recording_status, "")
+public:
+    explicit TLogRecorder(QObject *parent = nullptr);
+    ~TLogRecorder();
+    static TLogRecorder& instance();
+    // Opens the ring and starts the writer thread if recording is enabled (tlog_recording_enable, off by default).
+    void start();
+    // Writes everything that is still in the ring and closes the current .tlog
+    void stop();
+    // Telemetry receive thread. Does nothing (but an atomic load) if not recording.
+    void on_message(const mavlink_message_t& msg);
+    // Close the current .tlog now, messages from now on go into a new one
+    Q_INVOKABLE void roll();
+    // Where the .tlog files are written to (tlog_directory)
+    static QString get_directory();
+private:
+    std::atomic<bool> m_active{false};
+    // receive thread(s) - mavsdk might call us from more than one thread, the ring is single producer
+    std::mutex m_producer_mutex;
+    TLogRing m_ring;
+    int m_fc_sys_id=-1;
+    bool m_fc_armed=false;
+    std::atomic<bool> m_roll_requested{false};
+private:
+    // writer thread only
+    void loop_writer();
+    // Returns the n of drained messages
+    int drain(bool recovered);
+    bool open_file(uint64_t first_timestamp_us,bool recovered);
+    void close_file();
+    void delete_oldest_recordings();
+    void publish_status(bool force);
+    std::unique_ptr<std::thread> m_writer_thread;
+    std::atomic<bool> m_running{false};
+    std::string m_directory;
+    uint64_t m_max_total_bytes=0;
+    FILE* m_file=nullptr;
+    FILE* m_index_file=nullptr;
+    std::string m_filename;
+    uint64_t m_file_size=0;
+    uint64_t m_n_messages=0;
+    // written to the index file together with the data
+    std::vector<qopenhd::tlog::IndexEntry> m_index_pending;
+    std::vector<uint8_t> m_payload;
+    std::chrono::steady_clock::time_point m_last_fsync;
+    std::chrono::steady_clock::time_point m_last_status;
+};
+
+#endif // TLOGRECORDER_H
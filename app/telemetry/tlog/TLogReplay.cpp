@@ -0,0 +1,252 @@
+#include "TLogReplay.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include <QDir>
+#include <QFileInfo>
+#include <qdebug.h>
+
+#include "TLogRecorder.h"
+
+using namespace qopenhd::tlog;
+
+// A gap (no message) longer than this is skipped instead of waited for (e.g. clock jump or recovered data)
+static constexpr int64_t MAX_GAP_US=10*1000*1000;
+
+TLogReplay::TLogReplay(QObject *parent)
+    : QObject{parent}
+{
+}
+
+TLogReplay::~TLogReplay()
+{
+    stop();
+}
+
+TLogReplay &TLogReplay::instance()
+{
+    static TLogReplay replay{};
+    return replay;
+}
+
+void TLogReplay::set_message_cb(MESSAGE_CB cb)
+{
+    m_message_cb=cb;
+}
+
+bool TLogReplay::start(QString filename)
+{
+    stop();
+    auto file=std::make_unique<QFile>(filename);
+    if(!file->open(QIODevice::ReadOnly)){
+        qDebug()<<"TLogReplay cannot open"<<filename;
+        return false;
+    }
+    const qint64 size=file->size();
+    const uint8_t* data=size>0 ? file->map(0,size) : nullptr;
+    if(data==nullptr){
+        qDebug()<<"TLogReplay cannot map"<<filename;
+        return false;
+    }
+    const auto begin=std::chrono::steady_clock::now();
+    auto index=read_index(filename.toStdString(),size);
+    if(index.has_value()){
+        m_index=std::move(index.value());
+    }else{
+        // not recorded by QOpenHD or not closed properly - scan once and store the index for the next time
+        m_index=build_index(data,size);
+        write_index(filename.toStdString(),m_index);
+    }
+    const auto elapsed_ms=std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-begin).count();
+    qDebug()<<"TLogReplay"<<filename<<m_index.size()<<"messages, index"<<(index.has_value() ? "loaded" : "built")<<"in"<<elapsed_ms<<"ms";
+    if(m_index.empty()){
+        return false;
+    }
+    m_file=std::move(file);
+    m_data=data;
+    uint64_t max_timestamp_us=0;
+    for(const auto& entry:m_index){
+        max_timestamp_us=std::max(max_timestamp_us,entry.timestamp_us);
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_control_mutex);
+        m_stop_requested=false;
+        m_paused=false;
+        m_seek_request_us=-1;
+        m_control_version++;
+    }
+    set_replay_file(filename);
+    set_replay_duration_s((max_timestamp_us-m_index.front().timestamp_us)/1000000.0);
+    set_replay_position_s(0);
+    set_replay_n_messages(0);
+    set_replay_paused(false);
+    m_active=true;
+    set_replay_active(true);
+    m_replay_thread=std::make_unique<std::thread>(&TLogReplay::loop_replay,this);
+    return true;
+}
+
+void TLogReplay::stop()
+{
+    if(!m_replay_thread)return;
+    {
+        std::lock_guard<std::mutex> lock(m_control_mutex);
+        m_stop_requested=true;
+    }
+    m_control_cv.notify_all();
+    m_replay_thread->join();
+    m_replay_thread=nullptr;
+    m_active=false;
+    m_data=nullptr;
+    m_file=nullptr;
+    m_index.clear();
+    set_replay_active(false);
+    set_replay_file("");
+    qDebug()<<"TLogReplay stopped";
+}
+
+void TLogReplay::set_paused(bool paused)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_control_mutex);
+        m_paused=paused;
+        m_control_version++;
+    }
+    m_control_cv.notify_all();
+    set_replay_paused(paused);
+}
+
+void TLogReplay::set_playback_speed(double speed)
+{
+    speed=std::clamp(speed,1.0,100.0);
+    {
+        std::lock_guard<std::mutex> lock(m_control_mutex);
+        m_speed=speed;
+        m_control_version++;
+    }
+    m_control_cv.notify_all();
+    set_replay_speed(speed);
+}
+
+void TLogReplay::seek(double position_s)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_control_mutex);
+        m_seek_request_us=std::max((int64_t)(position_s*1000000),(int64_t)0);
+        m_control_version++;
+    }
+    m_control_cv.notify_all();
+}
+
+QStringList TLogReplay::get_recordings()
+{
+    QDir dir(TLogRecorder::get_directory());
+    QStringList ret;
+    // newest first
+    for(const auto& file:dir.entryInfoList(QStringList()<<"*.tlog",QDir::Files,QDir::Time)){
+        ret.push_back(file.absoluteFilePath());
+    }
+    return ret;
+}
+
+size_t TLogReplay::find_index(int64_t position_us) const
+{
+    const uint64_t timestamp_us=m_index.front().timestamp_us+position_us;
+    const auto it=std::lower_bound(m_index.begin(),m_index.end(),timestamp_us,[](const IndexEntry& entry,uint64_t value){
+        return entry.timestamp_us<value;
+    });
+    return it-m_index.begin();
+}
+
+bool TLogReplay::feed(const IndexEntry &entry)
+{
+    const uint8_t* packet=m_data+entry.offset+TIMESTAMP_SIZE;
+    // Each packet is parsed on its own, a broken packet cannot affect the next one
+    memset(&m_parse_status,0,sizeof(m_parse_status));
+    mavlink_message_t msg;
+    mavlink_status_t status;
+    for(uint32_t i=0;i<entry.packet_size;i++){
+        const uint8_t result=mavlink_frame_char_buffer(&m_parse_msg,&m_parse_status,packet[i],&msg,&status);
+        if(result==MAVLINK_FRAMING_OK){
+            if(m_message_cb){
+                m_message_cb(msg);
+            }
+            return true;
+        }
+        if(result!=MAVLINK_FRAMING_INCOMPLETE){
+            // e.g. bad crc (message not in our dialect)
+            return false;
+        }
+    }
+    return false;
+}
+
+void TLogReplay::loop_replay()
+{
+    const uint64_t first_timestamp_us=m_index.front().timestamp_us;
+    const auto get_position_s=[first_timestamp_us](const IndexEntry& entry){
+        return (int64_t)(entry.timestamp_us-first_timestamp_us)/1000000.0;
+    };
+    size_t index=0;
+    int n_messages=0;
+    uint64_t anchor_version=0;
+    bool anchored=false;
+    std::chrono::steady_clock::time_point anchor_time;
+    uint64_t anchor_timestamp_us=0;
+    uint64_t last_timestamp_us=0;
+    double speed=1;
+    auto last_position_update=std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(m_control_mutex);
+    while(!m_stop_requested){
+        if(m_seek_request_us>=0){
+            index=find_index(m_seek_request_us);
+            m_seek_request_us=-1;
+            anchored=false;
+            set_replay_position_s(index<m_index.size() ? get_position_s(m_index[index]) : replay_duration_s());
+        }
+        if(index>=m_index.size()){
+            // End of recording, keep the last state until the user seeks or stops
+            set_replay_position_s(replay_duration_s());
+            m_control_cv.wait(lock,[this]{return m_stop_requested || m_seek_request_us>=0;});
+            continue;
+        }
+        if(m_paused){
+            m_control_cv.wait(lock,[this]{return m_stop_requested || !m_paused || m_seek_request_us>=0;});
+            anchored=false;
+            continue;
+        }
+        const IndexEntry& entry=m_index[index];
+        const bool gap=anchored && entry.timestamp_us>last_timestamp_us+MAX_GAP_US;
+        if(!anchored || anchor_version!=m_control_version || gap){
+            anchored=true;
+            anchor_version=m_control_version;
+            anchor_time=std::chrono::steady_clock::now();
+            anchor_timestamp_us=entry.timestamp_us;
+            last_timestamp_us=entry.timestamp_us;
+            speed=m_speed;
+        }
+        // Timestamps don't have to be monotonic (clock adjustments while recording) - a message from the past is due now
+        const uint64_t delta_us=entry.timestamp_us>anchor_timestamp_us ? entry.timestamp_us-anchor_timestamp_us : 0;
+        const auto due=anchor_time+std::chrono::microseconds((int64_t)(delta_us/speed));
+        if(std::chrono::steady_clock::now()<due){
+            const uint64_t version=m_control_version;
+            m_control_cv.wait_until(lock,due,[this,version]{return m_stop_requested || m_control_version!=version;});
+            continue;
+        }
+        last_timestamp_us=std::max(last_timestamp_us,entry.timestamp_us);
+        lock.unlock();
+        if(feed(entry)){
+            n_messages++;
+        }
+        index++;
+        const auto now=std::chrono::steady_clock::now();
+        if(now-last_position_update>=std::chrono::milliseconds(100)){
+            last_position_update=now;
+            set_replay_position_s(get_position_s(entry));
+            set_replay_n_messages(n_messages);
+        }
+        lock.lock();
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef TLOGREPLAY_H
+#define TLOGREPLAY_H
+
+#include <QFile>
+#include <QObject>
+#include <QStringList>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "lib/lqtutils_master/lqtutils_prop.h"
+#include "../mavsdk_include.h"
+#include "TLogFormat.hpp"
+
+/**
+ * Replays a recorded .tlog (see TLogRecorder) through the same dispatch as the live telemetry
+ * (MavlinkTelemetry), such that the whole OSD can be driven without a vehicle.
+ * The file is memory mapped and the sidecar index is used (or rebuilt) to seek by time in O(log n).
+ * Messages are fed with their original timing, scaled by the playback speed (1x-100x).
+ * While a replay is active, the live telemetry is not processed (but still recorded).
+ * singleton, corresponding qt name is "_tlogReplay" (see main)
+ */
+class TLogReplay : public QObject
+{
+    Q_OBJECT
+    L_RO_PROP(bool, replay_active, set_replay_active, false)
+    L_RO_PROP(bool, replay_paused, set_replay_paused, false)
+    L_RO_PROP(QString, replay_file, set_replay_file, "")
+    L_RO_PROP(double, replay_duration_s, set_replay_duration_s, 0)
+    L_RO_PROP(double, replay_position_s, set_replay_position_s, 0)
+    L_RO_PROP(double, replay_speed, set_replay_speed, 1)
+    L_RO_PROP(int, replay_n_messages, set_replay_n_messages, 0)
+public:
+    explicit TLogReplay(QObject *parent = nullptr);
+    ~TLogReplay();
+    static TLogReplay& instance();
+    typedef std::function<void(const mavlink_message_t& msg)> MESSAGE_CB;
+    // Called on the replay thread for each message, set once by MavlinkTelemetry
+    void set_message_cb(MESSAGE_CB cb);
+    // Cheap, called by the telemetry receive thread for each live message
+    bool is_active()const{
+        return m_active.load(std::memory_order_relaxed);
+    }
+    // Stops a running replay, then replays filename from the beginning. Returns false if the file cannot be opened.
+    Q_INVOKABLE bool start(QString filename);
+    Q_INVOKABLE void stop();
+    Q_INVOKABLE void set_paused(bool paused);
+    // 1 == original timing, clamped to [1,100]
+    Q_INVOKABLE void set_playback_speed(double speed);
+    // seconds since the first message of the recording
+    Q_INVOKABLE void seek(double position_s);
+    // The recordings of the TLogRecorder, newest first
+    Q_INVOKABLE QStringList get_recordings();
+private:
+    void loop_replay();
+    // index of the first message at or after position_us (relative to the first message)
+    size_t find_index(int64_t position_us)const;
+    bool feed(const qopenhd::tlog::IndexEntry& entry);
+    MESSAGE_CB m_message_cb=nullptr;
+    std::atomic<bool> m_active{false};
+    std::unique_ptr<QFile> m_file;
+    const uint8_t* m_data=nullptr;
+    std::vector<qopenhd::tlog::IndexEntry> m_index;
+    std::unique_ptr<std::thread> m_replay_thread;
+    // control (any thread -> replay thread)
+    std::mutex m_control_mutex;
+    std::condition_variable m_control_cv;
+    bool m_stop_requested=false;
+    bool m_paused=false;
+    double m_speed=1;
+    int64_t m_seek_request_us=-1;
+    // incremented on each control change, such that the replay thread re-anchors its timing
+    uint64_t m_control_version=0;
+    // replay thread
+    mavlink_status_t m_parse_status{};
+    mavlink_message_t m_parse_msg{};
+};
+
+#endif // TLOGREPLAY_H
@@ -0,0 +1,186 @@
+#ifndef TLOGRING_HPP
+#define TLOGRING_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <qdebug.h>
+
+#if defined(__linux__) || defined(__APPLE__)
+#define TLOG_RING_USE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Single producer / single consumer byte ring for variable sized records, in a preallocated memory mapped file.
+ * The producer (telemetry receive thread) only copies into (already mapped) memory - it never blocks on disk, if the
+ * consumer cannot keep up records are dropped (and counted) instead.
+ * Since the ring lives in a (shared) file mapping, records that were received but not yet consumed survive a crash of
+ * QOpenHD and are recovered (consumed) on the next start.
+ * Record layout: uint32 payload size, uint64 timestamp (us), payload - wrapping around the end of the ring.
+ * Where mmap is not available, the ring is a plain heap buffer (no crash recovery).
+ */
+class TLogRing{
+public:
+    ~TLogRing(){
+        close();
+    }
+    // (Re-)uses filename if it is a ring of the same capacity, otherwise (re-)creates it. Returns false on error.
+    bool open(const std::string& filename,uint64_t capacity){
+        close();
+        const size_t map_size=sizeof(Header)+capacity;
+#ifdef TLOG_RING_USE_MMAP
+        m_fd=::open(filename.c_str(),O_RDWR | O_CREAT,0644);
+        if(m_fd<0){
+            qDebug()<<"TLogRing cannot open"<<filename.c_str()<<strerror(errno);
+            return false;
+        }
+        struct stat st{};
+        fstat(m_fd,&st);
+        const bool reuse=(size_t)st.st_size==map_size;
+        if(!reuse){
+#ifdef __linux__
+            // really allocate the blocks now, such that writing into the mapping never fails with SIGBUS (disk full)
+            const bool allocated=ftruncate(m_fd,0)==0 && posix_fallocate(m_fd,0,map_size)==0;
+#else
+            const bool allocated=ftruncate(m_fd,0)==0 && ftruncate(m_fd,map_size)==0;
+#endif
+            if(!allocated){
+                qDebug()<<"TLogRing cannot allocate"<<map_size<<"bytes"<<strerror(errno);
+                close();
+                return false;
+            }
+        }
+        void* map=mmap(nullptr,map_size,PROT_READ | PROT_WRITE,MAP_SHARED,m_fd,0);
+        if(map==MAP_FAILED){
+            qDebug()<<"TLogRing cannot mmap"<<strerror(errno);
+            close();
+            return false;
+        }
+        m_map=(uint8_t*)map;
+#else
+        m_heap.resize(map_size);
+        m_map=m_heap.data();
+        const bool reuse=false;
+#endif
+        m_map_size=map_size;
+        m_header=(Header*)m_map;
+        m_data=m_map+sizeof(Header);
+        if(!reuse || memcmp(m_header->magic,MAGIC,sizeof(MAGIC))!=0 || m_header->capacity!=capacity
+                || m_header->write_pos.load()<m_header->read_pos.load() || m_header->write_pos.load()-m_header->read_pos.load()>capacity){
+            new (m_header) Header();
+            memcpy(m_header->magic,MAGIC,sizeof(MAGIC));
+            m_header->capacity=capacity;
+        }
+        // dropped messages are counted per session
+        m_header->n_dropped=0;
+        m_capacity=capacity;
+        return true;
+    }
+    void close(){
+#ifdef TLOG_RING_USE_MMAP
+        if(m_map){
+            munmap(m_map,m_map_size);
+        }
+        if(m_fd>=0){
+            ::close(m_fd);
+            m_fd=-1;
+        }
+#endif
+        m_map=nullptr;
+        m_header=nullptr;
+        m_data=nullptr;
+    }
+    bool is_open()const{
+        return m_header!=nullptr;
+    }
+    // Producer. Returns false (and counts a drop) if there is not enough space.
+    bool push(uint64_t timestamp_us,const uint8_t* payload,uint32_t payload_size){
+        const uint64_t record_size=RECORD_HEADER_SIZE+payload_size;
+        const uint64_t write_pos=m_header->write_pos.load(std::memory_order_relaxed);
+        const uint64_t read_pos=m_header->read_pos.load(std::memory_order_acquire);
+        if(m_capacity-(write_pos-read_pos)<record_size){
+            m_header->n_dropped.fetch_add(1,std::memory_order_relaxed);
+            return false;
+        }
+        uint8_t record_header[RECORD_HEADER_SIZE];
+        memcpy(record_header,&payload_size,sizeof(payload_size));
+        memcpy(record_header+sizeof(payload_size),&timestamp_us,sizeof(timestamp_us));
+        copy_in(write_pos,record_header,RECORD_HEADER_SIZE);
+        copy_in(write_pos+RECORD_HEADER_SIZE,payload,payload_size);
+        m_header->write_pos.store(write_pos+record_size,std::memory_order_release);
+        return true;
+    }
+    // Consumer. Returns false if the ring is empty.
+    bool pop(uint64_t& timestamp_us,std::vector<uint8_t>& payload){
+        const uint64_t read_pos=m_header->read_pos.load(std::memory_order_relaxed);
+        const uint64_t write_pos=m_header->write_pos.load(std::memory_order_acquire);
+        if(write_pos==read_pos)return false;
+        uint8_t record_header[RECORD_HEADER_SIZE];
+        copy_out(read_pos,record_header,RECORD_HEADER_SIZE);
+        uint32_t payload_size;
+        memcpy(&payload_size,record_header,sizeof(payload_size));
+        memcpy(&timestamp_us,record_header+sizeof(payload_size),sizeof(timestamp_us));
+        if(RECORD_HEADER_SIZE+payload_size>write_pos-read_pos){
+            // corrupt (e.g. partially written before a crash) - discard everything
+            qDebug()<<"TLogRing corrupt record, discarding"<<(write_pos-read_pos)<<"bytes";
+            m_header->read_pos.store(write_pos,std::memory_order_release);
+            return false;
+        }
+        payload.resize(payload_size);
+        copy_out(read_pos+RECORD_HEADER_SIZE,payload.data(),payload_size);
+        m_header->read_pos.store(read_pos+RECORD_HEADER_SIZE+payload_size,std::memory_order_release);
+        return true;
+    }
+    uint64_t get_n_buffered_bytes()const{
+        return m_header->write_pos.load(std::memory_order_relaxed)-m_header->read_pos.load(std::memory_order_relaxed);
+    }
+    uint64_t get_n_dropped()const{
+        return m_header->n_dropped.load(std::memory_order_relaxed);
+    }
+private:
+    static constexpr char MAGIC[8]={'Q','O','H','D','T','L','R','1'};
+    static constexpr uint64_t RECORD_HEADER_SIZE=sizeof(uint32_t)+sizeof(uint64_t);
+    // Positions are monotonically increasing byte counters (never wrap in practice), position % capacity is the offset.
+    // NOTE: The atomics live in the file mapping, they need to be lock free (address free) for that.
+    struct Header{
+        char magic[8]{};
+        uint64_t capacity=0;
+        std::atomic<uint64_t> write_pos{0};
+        std::atomic<uint64_t> read_pos{0};
+        std::atomic<uint64_t> n_dropped{0};
+    };
+    void copy_in(uint64_t pos,const uint8_t* src,uint64_t size){
+        const uint64_t offset=pos%m_capacity;
+        const uint64_t first=std::min(size,m_capacity-offset);
+        memcpy(m_data+offset,src,first);
+        memcpy(m_data,src+first,size-first);
+    }
+    void copy_out(uint64_t pos,uint8_t* dst,uint64_t size)const{
+        const uint64_t offset=pos%m_capacity;
+        const uint64_t first=std::min(size,m_capacity-offset);
+        memcpy(dst,m_data+offset,first);
+        memcpy(dst+first,m_data,size-first);
+    }
+#ifdef TLOG_RING_USE_MMAP
+    int m_fd=-1;
+#else
+    std::vector<uint8_t> m_heap;
+#endif
+    uint8_t* m_map=nullptr;
+    size_t m_map_size=0;
+    Header* m_header=nullptr;
+    uint8_t* m_data=nullptr;
+    uint64_t m_capacity=0;
+};
+
+#endif // TLOGRING_HPP
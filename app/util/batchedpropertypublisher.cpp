@@ -0,0 +1,143 @@
+#include "batchedpropertypublisher.h"
+
+#include <QDebug>
+#include <QGuiApplication>
+#include <QScreen>
+#include <QSettings>
+#include <cmath>
+#include <sstream>
+#include <iomanip>
+#if defined(__linux__) || defined(__APPLE__)
+#include <time.h>
+#endif
+
+// CPU time of the calling thread, -1 if not supported on this platform
+static std::chrono::nanoseconds get_thread_cpu_time(){
+#if defined(__linux__) || defined(__APPLE__)
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID,&ts);
+    return std::chrono::seconds(ts.tv_sec)+std::chrono::nanoseconds(ts.tv_nsec);
+#else
+    return std::chrono::nanoseconds(-1);
+#endif
+}
+
+static int get_display_refresh_rate_hz(){
+    const QScreen* screen=QGuiApplication::primaryScreen();
+    if(screen==nullptr || screen->refreshRate()<1)return 60;
+    return std::lround(screen->refreshRate());
+}
+
+BatchedPropertyPublisher::BatchedPropertyPublisher(int rate_hz,QObject *parent)
+    : QObject(parent),m_rate_hz(rate_hz)
+{
+    m_timer=new QTimer(this);
+    QObject::connect(m_timer, &QTimer::timeout, this, &BatchedPropertyPublisher::on_timer);
+    int interval_ms=1000;
+    if(m_rate_hz>=0){
+        const int effective_rate_hz=m_rate_hz==0 ? get_display_refresh_rate_hz() : m_rate_hz;
+        interval_ms=std::max(1000/effective_rate_hz,1);
+        // The default coarse timer can be up to 5% late, which is a lot at display rate
+        m_timer->setTimerType(Qt::PreciseTimer);
+    }
+    qDebug()<<"BatchedPropertyPublisher rate:"<<m_rate_hz<<"Hz interval:"<<interval_ms<<"ms";
+    m_timer->start(interval_ms);
+    m_last_ui_thread_cpu_time=get_thread_cpu_time();
+}
+
+int BatchedPropertyPublisher::get_rate_hz_from_settings()
+{
+    QSettings settings;
+    return settings.value("dev_telemetry_publish_rate_hz", 0).toInt();
+}
+
+int BatchedPropertyPublisher::add_property(std::function<bool ()> publish)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_publish.push_back(publish);
+    m_dirty.push_back(false);
+    m_dirty_since.push_back(std::chrono::steady_clock::time_point{});
+    return (int)m_publish.size()-1;
+}
+
+void BatchedPropertyPublisher::set_stats_cb(std::function<void (QString)> cb)
+{
+    m_stats_cb=cb;
+}
+
+void BatchedPropertyPublisher::on_timer()
+{
+    if(m_rate_hz>=0){
+        publish_dirty();
+    }
+    if(std::chrono::steady_clock::now()-m_last_stats>=std::chrono::seconds(1)){
+        update_stats();
+    }
+}
+
+void BatchedPropertyPublisher::publish_dirty()
+{
+    const auto begin=std::chrono::steady_clock::now();
+    m_dirty_indices.clear();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for(size_t i=0;i<m_dirty.size();i++){
+            if(m_dirty[i]){
+                m_dirty_indices.emplace_back((int)i,m_dirty_since[i]);
+                m_dirty[i]=false;
+            }
+        }
+    }
+    // emit without holding the lock, a setter might be called from a slot connected to the signal
+    int n_signals=0;
+    for(const auto& [index,dirty_since]:m_dirty_indices){
+        if(m_publish[index]()){
+            n_signals++;
+            // the signal is delivered directly (same thread), QML bindings have been updated at this point
+            m_publish_latency.add(std::chrono::steady_clock::now()-dirty_since);
+        }
+    }
+    m_publish_time+=std::chrono::steady_clock::now()-begin;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_n_signals+=n_signals;
+}
+
+void BatchedPropertyPublisher::update_stats()
+{
+    const auto now=std::chrono::steady_clock::now();
+    const double elapsed_s=std::chrono::duration<double>(now-m_last_stats).count();
+    m_last_stats=now;
+    uint64_t n_changes;
+    uint64_t n_signals;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        n_changes=m_n_changes;
+        n_signals=m_n_signals;
+        m_n_changes=0;
+        m_n_signals=0;
+    }
+    const auto cpu_time=get_thread_cpu_time();
+    const auto cpu_time_delta=cpu_time-m_last_ui_thread_cpu_time;
+    m_last_ui_thread_cpu_time=cpu_time;
+    Stats& stats=m_last_stats_values;
+    stats.changes_per_s=n_changes/elapsed_s;
+    stats.signals_per_s=n_signals/elapsed_s;
+    stats.publish_ms_per_s=std::chrono::duration<double,std::milli>(m_publish_time).count()/elapsed_s;
+    stats.ui_thread_cpu_perc=cpu_time.count()>=0 ? 100.0*std::chrono::duration<double>(cpu_time_delta).count()/elapsed_s : -1;
+    stats.publish_latency=m_publish_latency.snapshot_and_reset();
+    std::stringstream ss;
+    ss<<std::fixed<<std::setprecision(0)<<"changes "<<stats.changes_per_s<<"/s signals "<<stats.signals_per_s<<"/s";
+    if(m_rate_hz>=0){
+        ss<<std::setprecision(2)<<" publish "<<stats.publish_ms_per_s<<"ms/s";
+        ss<<" latency "<<MyTimeHelper::R(stats.publish_latency.getAvg())<<" p99 "<<MyTimeHelper::R(stats.publish_latency.get_percentile(0.99));
+    }else{
+        ss<<" (batching off)";
+    }
+    if(stats.ui_thread_cpu_perc>=0){
+        ss<<std::setprecision(1)<<" UI CPU "<<stats.ui_thread_cpu_perc<<"%";
+    }
+    m_publish_time=std::chrono::steady_clock::duration{0};
+    if(m_stats_cb){
+        m_stats_cb(QString(ss.str().c_str()));
+    }
+}
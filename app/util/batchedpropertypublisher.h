@@ -0,0 +1,116 @@
+#ifndef BATCHEDPROPERTYPUBLISHER_H
+#define BATCHEDPROPERTYPUBLISHER_H
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "../common/TimeHelper.hpp"
+
+/**
+ * Coalesces the property updates of a (telemetry) model before they reach QML.
+ * Without it, each setter called from the mavlink thread emits a signal that is queued to the UI thread - at 50Hz attitude + gps + vfr hud
+ * that is thousands of cross thread signal deliveries per second, most of them never displayed.
+ * With it, the setters (any thread) only store the value and mark the property dirty, the publisher runs on the UI thread
+ * at display rate (or a fixed rate) and emits the changed signal of each property that changed since the last run, once.
+ * Use L_RO_PROP_BATCHED instead of L_RO_PROP - the owner needs a BatchedPropertyPublisher member called m_batched_publisher,
+ * declared before the properties. C++ code of the owner keeps using m_xxx (always the latest value), QML sees the published value.
+ * Rate (dev_telemetry_publish_rate_hz): 0 == display refresh rate, -1 == disabled (every change is emitted right away, like L_RO_PROP).
+ */
+class BatchedPropertyPublisher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit BatchedPropertyPublisher(int rate_hz,QObject *parent = nullptr);
+    static int get_rate_hz_from_settings();
+    // Called once per property while the owner is constructed. publish: UI thread, returns true if a signal was emitted
+    int add_property(std::function<bool()> publish);
+    // Any thread. Stores the new value, returns true if the caller has to emit the changed signal right away (batching disabled)
+    template<class T>
+    bool on_set(T& latest,const T& value,int index){
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(latest==value)return false;
+        latest=value;
+        m_n_changes++;
+        if(m_rate_hz<0){
+            m_n_signals++;
+            return true;
+        }
+        if(!m_dirty[index]){
+            m_dirty[index]=true;
+            m_dirty_since[index]=std::chrono::steady_clock::now();
+        }
+        return false;
+    }
+    // UI thread, copy of the latest value
+    template<class T>
+    T take(const T& latest){
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return latest;
+    }
+    // UI thread, once per second: changes / signals per second, UI thread time spent publishing and UI thread CPU usage
+    void set_stats_cb(std::function<void(QString)> cb);
+    struct Stats{
+        double changes_per_s=0;
+        double signals_per_s=0;
+        double publish_ms_per_s=0;
+        // -1 if not supported on this platform
+        double ui_thread_cpu_perc=-1;
+        // Time from the first (unpublished) change of a property until its changed signal has been handled by QML
+        LatencyHistogram::Snapshot publish_latency{};
+    };
+    // UI thread, the stats of the last second (valid in / after the stats cb)
+    const Stats& get_last_stats()const{
+        return m_last_stats_values;
+    }
+private:
+    void on_timer();
+    void publish_dirty();
+    void update_stats();
+    const int m_rate_hz;
+    QTimer* m_timer=nullptr;
+    std::mutex m_mutex;
+    std::vector<std::function<bool()>> m_publish;
+    std::vector<char> m_dirty;
+    std::vector<std::chrono::steady_clock::time_point> m_dirty_since;
+    std::vector<std::pair<int,std::chrono::steady_clock::time_point>> m_dirty_indices;
+    LatencyHistogram m_publish_latency{"Publish latency"};
+    Stats m_last_stats_values{};
+    uint64_t m_n_changes=0;
+    uint64_t m_n_signals=0;
+    std::chrono::steady_clock::duration m_publish_time{0};
+    std::chrono::steady_clock::time_point m_last_stats=std::chrono::steady_clock::now();
+    std::chrono::nanoseconds m_last_ui_thread_cpu_time{0};
+    std::function<void(QString)> m_stats_cb=nullptr;
+};
+
+// Same as L_RO_PROP (read only from QML, setter from c++), but the changed signal is emitted by the BatchedPropertyPublisher
+#define L_RO_PROP_BATCHED(type, name, setter, def)                                              \
+    public:                                                                                     \
+        type name() const { return m_published_##name; }                                        \
+        void setter(type value) {                                                               \
+            if (!m_batched_publisher.on_set(m_##name, value, m_batched_index_##name)) return;   \
+            m_published_##name = m_##name;                                                      \
+            emit name##Changed(m_published_##name);                                             \
+        }                                                                                       \
+    Q_SIGNALS:                                                                                  \
+        void name##Changed(type name);                                                          \
+    private:                                                                                    \
+        Q_PROPERTY(type name READ name NOTIFY name##Changed)                                     \
+        bool publish_batched_##name() {                                                         \
+            const type value = m_batched_publisher.take(m_##name);                              \
+            if (m_published_##name == value) return false;                                      \
+            m_published_##name = value;                                                         \
+            emit name##Changed(m_published_##name);                                             \
+            return true;                                                                        \
+        }                                                                                       \
+        type m_##name = def;                                                                    \
+        type m_published_##name = def;                                                          \
+        const int m_batched_index_##name = m_batched_publisher.add_property([this]() { return publish_batched_##name(); });
+
+#endif // BATCHEDPROPERTYPUBLISHER_H
@@ -57,13 +57,13 @@ void QRenderStats::m_QQuickWindow_afterRendering()
 
 void QRenderStats::m_QQuickWindow_beforeRenderPassRecording()
 {
-    _avg_renderpass_time.start();
+    _renderpass_begin=std::chrono::steady_clock::now();
 
     // Calculate frame time by calculating the delta between calls to render pass recording
     const auto delta=std::chrono::steady_clock::now()-_last_frame;
     _last_frame=std::chrono::steady_clock::now();
     _avg_render_frame_delta.add(delta);
-    _avg_render_frame_delta.recalculate_in_fixed_time_intervals(std::chrono::seconds(1),[this](const AvgCalculator& self){
+    _avg_render_frame_delta.recalculate_in_fixed_time_intervals(std::chrono::seconds(1),[this](const LatencyHistogram::Snapshot& self){
         const auto main_stats=QString(self.getAvgReadable().c_str());
 //        qDebug() << "QRenderStats render frame interval:" << main_stats;
         set_main_render_stats(main_stats);
@@ -72,8 +72,8 @@ void QRenderStats::m_QQuickWindow_beforeRenderPassRecording()
 
 void QRenderStats::m_QQuickWindow_afterRenderPassRecording()
 {
-    _avg_renderpass_time.stop();
-    _avg_renderpass_time.recalculate_in_fixed_time_intervals(std::chrono::seconds(1),[this](const AvgCalculator& self){
+    _avg_renderpass_time.add(std::chrono::steady_clock::now()-_renderpass_begin);
+    _avg_renderpass_time.recalculate_in_fixed_time_intervals(std::chrono::seconds(1),[this](const LatencyHistogram::Snapshot& self){
         const auto stats=QString(self.getAvgReadable().c_str());
         //qDebug() << "QRenderStats render pass time:" << main_stats;
         set_qt_renderpass_time(stats);
@@ -42,10 +42,11 @@ public slots:
 private:
     // for the main render thread (render pass recording)
     std::chrono::steady_clock::time_point _last_frame = std::chrono::steady_clock::now();
-    AvgCalculator _avg_render_frame_delta{};
+    LatencyHistogram _avg_render_frame_delta{};
     // NOTE: For some reason there seems to be no difference between frame time and before / after rendering -
     // looks like there is a glFLush() or somethin in QT.
-    Chronometer _avg_renderpass_time{};
+    LatencyHistogram _avg_renderpass_time{};
+    std::chrono::steady_clock::time_point _renderpass_begin{};
 
 };
 
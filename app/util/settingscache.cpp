@@ -0,0 +1,151 @@
+#include "settingscache.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QJSValue>
+#include <QMetaProperty>
+#include <QSettings>
+
+SettingsCache &SettingsCache::instance()
+{
+    static SettingsCache instance{};
+    return instance;
+}
+
+SettingsCache::SettingsCache(QObject *parent)
+    : QObject{parent}
+{
+    // persisting and the stats are done on the UI thread, regardless of who used the cache first
+    if(QCoreApplication::instance()){
+        moveToThread(QCoreApplication::instance()->thread());
+    }
+    m_stats_timer=new QTimer(this);
+    QObject::connect(m_stats_timer, &QTimer::timeout, this, &SettingsCache::update_stats);
+    m_stats_timer->start(1000);
+}
+
+QVariant SettingsCache::value(const QString &key, const QVariant &default_value)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it=m_values.constFind(key);
+    if(it==m_values.constEnd()){
+        QSettings settings;
+        m_n_backend_reads++;
+        // An invalid QVariant marks a key that doesn't exist (yet) - the default is up to the caller
+        it=m_values.insert(key,settings.contains(key) ? settings.value(key) : QVariant());
+    }
+    return it->isValid() ? *it : default_value;
+}
+
+void SettingsCache::setValue(const QString &key, const QVariant &value)
+{
+    if(!update_cached(key,value))return;
+    bool schedule_persist;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        schedule_persist=m_pending_writes.isEmpty();
+        m_pending_writes.insert(key);
+    }
+    if(schedule_persist){
+        QMetaObject::invokeMethod(this, "persist_pending", Qt::QueuedConnection);
+    }
+    notify_changed(key);
+}
+
+int SettingsCache::subscribe(std::function<void (const QString&)> cb)
+{
+    std::lock_guard<std::recursive_mutex> lock(m_subscribers_mutex);
+    const int id=m_next_subscriber_id++;
+    m_subscribers[id]=cb;
+    return id;
+}
+
+void SettingsCache::unsubscribe(int id)
+{
+    std::lock_guard<std::recursive_mutex> lock(m_subscribers_mutex);
+    m_subscribers.erase(id);
+}
+
+void SettingsCache::watch_qml_settings(QObject *qml_settings)
+{
+    if(qml_settings==nullptr || m_qml_settings!=nullptr)return;
+    m_qml_settings=qml_settings;
+    const QMetaObject* meta_object=qml_settings->metaObject();
+    const int slot_index=metaObject()->indexOfSlot("on_qml_setting_changed()");
+    int n_watched=0;
+    for(int i=0;i<meta_object->propertyCount();i++){
+        const QMetaProperty property=meta_object->property(i);
+        const QString key=property.name();
+        // Properties of the QML Settings type itself, not settings
+        if(key=="objectName" || key=="category" || key=="fileName")continue;
+        if(!property.hasNotifySignal())continue;
+        m_qml_signal_to_key.insert(property.notifySignalIndex(),key);
+        QMetaObject::connect(qml_settings,property.notifySignalIndex(),this,slot_index);
+        QVariant value=property.read(qml_settings);
+        if(value.userType()==qMetaTypeId<QJSValue>()){
+            value=value.value<QJSValue>().toVariant();
+        }
+        if(update_cached(key,value)){
+            notify_changed(key);
+        }
+        n_watched++;
+    }
+    qDebug()<<"SettingsCache watching"<<n_watched<<"QML settings";
+}
+
+bool SettingsCache::update_cached(const QString &key, const QVariant &value)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it=m_values.find(key);
+    if(it!=m_values.end() && *it==value)return false;
+    m_values.insert(key,value);
+    return true;
+}
+
+void SettingsCache::notify_changed(const QString &key)
+{
+    // Called with the lock held, such that no callback runs anymore once unsubscribe() returned
+    std::lock_guard<std::recursive_mutex> lock(m_subscribers_mutex);
+    for(const auto& subscriber:m_subscribers){
+        subscriber.second(key);
+    }
+}
+
+void SettingsCache::persist_pending()
+{
+    QHash<QString,QVariant> to_write;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for(const auto& key:m_pending_writes){
+            to_write.insert(key,m_values.value(key));
+        }
+        m_pending_writes.clear();
+    }
+    if(to_write.isEmpty())return;
+    QSettings settings;
+    for(auto it=to_write.constBegin();it!=to_write.constEnd();++it){
+        settings.setValue(it.key(),it.value());
+        m_n_backend_writes++;
+    }
+}
+
+void SettingsCache::update_stats()
+{
+    set_backend_reads_per_second(m_n_backend_reads.exchange(0));
+    set_backend_writes_per_second(m_n_backend_writes.exchange(0));
+}
+
+void SettingsCache::on_qml_setting_changed()
+{
+    if(sender()!=m_qml_settings)return;
+    const auto it=m_qml_signal_to_key.constFind(senderSignalIndex());
+    if(it==m_qml_signal_to_key.constEnd())return;
+    const QString& key=*it;
+    QVariant value=m_qml_settings->property(key.toUtf8().constData());
+    if(value.userType()==qMetaTypeId<QJSValue>()){
+        value=value.value<QJSValue>().toVariant();
+    }
+    if(update_cached(key,value)){
+        notify_changed(key);
+    }
+}
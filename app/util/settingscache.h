@@ -0,0 +1,70 @@
+#ifndef SETTINGSCACHE_H
+#define SETTINGSCACHE_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QTimer>
+#include <QVariant>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+
+#include "lib/lqtutils_master/lqtutils_prop.h"
+
+// In memory copy of the QOpenHD (QSettings) settings, such that reading a setting is a lookup instead of a
+// QSettings construction + backend access (which can be a file / registry read and is way too expensive for the
+// mavlink / video hot paths).
+// Same value() / setValue() interface as QSettings - values are read from the backend once (on first access),
+// changes made in QML (AppSettings.qml, watched via watch_qml_settings) and via setValue() update the cache immediately,
+// setValue() persists to the backend asynchronously (UI thread).
+// Subscribers can register for change callbacks (e.g. restart the decoder only if a video setting actually changed).
+// NOTE: Values written to the backend by someone else (e.g. QSettings::setValue directly) are not seen - use setValue() here.
+class SettingsCache : public QObject
+{
+    Q_OBJECT
+public:
+    static SettingsCache& instance();
+    // Thread safe. Returns the cached value, reads it from the backend on the first access of this key.
+    QVariant value(const QString& key,const QVariant& default_value=QVariant());
+    // Thread safe. Updates the cache (and notifies subscribers) immediately, persists asynchronously.
+    void setValue(const QString& key,const QVariant& value);
+    // Called with the key that changed, on the thread that changed it (UI thread for changes made in QML).
+    // Returns an id for unsubscribe()
+    int subscribe(std::function<void(const QString& key)> cb);
+    void unsubscribe(int id);
+    // Call once with the QML Settings object (AppSettings.qml) - all its properties are put into the cache and
+    // any change of them is applied to the cache (no backend access)
+    Q_INVOKABLE void watch_qml_settings(QObject* qml_settings);
+    // Number of reads from the settings backend (cache misses) per second
+    L_RO_PROP(int,backend_reads_per_second,set_backend_reads_per_second,0)
+    L_RO_PROP(int,backend_writes_per_second,set_backend_writes_per_second,0)
+private:
+    explicit SettingsCache(QObject *parent = nullptr);
+    // Returns true if the value actually changed
+    bool update_cached(const QString& key,const QVariant& value);
+    void notify_changed(const QString& key);
+    Q_INVOKABLE void persist_pending();
+    void update_stats();
+private slots:
+    void on_qml_setting_changed();
+private:
+    std::mutex m_mutex;
+    QHash<QString,QVariant> m_values;
+    // written via setValue(), not yet persisted
+    QSet<QString> m_pending_writes;
+    // recursive - a callback might change a setting itself
+    std::recursive_mutex m_subscribers_mutex;
+    std::map<int,std::function<void(const QString& key)>> m_subscribers;
+    int m_next_subscriber_id=0;
+    QObject* m_qml_settings=nullptr;
+    // notify signal index -> property name of the watched QML settings object
+    QHash<int,QString> m_qml_signal_to_key;
+    QTimer* m_stats_timer=nullptr;
+    std::atomic<int> m_n_backend_reads{0};
+    std::atomic<int> m_n_backend_writes{0};
+};
+
+#endif // SETTINGSCACHE_H
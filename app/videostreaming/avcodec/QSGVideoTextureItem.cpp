@@ -4,10 +4,12 @@
 #include "QSGVideoTextureItem.h"
 
 #include <QtQuick/qquickwindow.h>
+#include <QtQuick/QSGImageNode>
 #include <QtCore/QRunnable>
 
 #include "util/qrenderstats.h"
 #include "logging/logmessagesmodel.h"
+#include "softwarerenderer.h"
 
 QSGVideoTextureItem::QSGVideoTextureItem():
     _renderer(nullptr)
@@ -36,8 +38,20 @@ QSGVideoTextureItem::QSGVideoTextureItem():
     _sw_decoder = std::make_unique<AVCodecDecoder>(nullptr);
     _sw_decoder->init(true);
 #endif
+    if (QOpenHDVideoHelper::get_qopenhd_n_cameras() >= 2) {
+        LogMessagesModel::instanceOHD().addLogMessage("Video", "Use avcodec software decoder (secondary)");
+        _sw_decoder_secondary = std::make_unique<AVCodecDecoder>(nullptr);
+        _sw_decoder_secondary->init(false);
+    }
 }
 
+QSGVideoTextureItem::~QSGVideoTextureItem()
+{
+    if (_software_backend) {
+        SoftwareRenderer::instance().set_on_new_image(nullptr);
+        SoftwareRenderer::instance().stop();
+    }
+}
 
 void QSGVideoTextureItem::handleWindowChanged(QQuickWindow *win)
 {
@@ -63,12 +77,57 @@ void QSGVideoTextureItem::sync()
 {
     if (_renderer == nullptr) {
         _renderer = &TextureRenderer::instance();
-        connect(window(), &QQuickWindow::beforeRendering, this, &QSGVideoTextureItem::QQuickWindow_beforeRendering, Qt::DirectConnection);
-        connect(window(), &QQuickWindow::beforeRenderPassRecording, this, &QSGVideoTextureItem::QQuickWindow_beforeRenderPassRecording, Qt::DirectConnection);
+        _software_backend = window()->rendererInterface()->graphicsApi() == QSGRendererInterface::Software;
+        if (_software_backend) {
+            // No OpenGL (e.g. -platform linuxfb) - the frames are converted on the CPU and drawn as an image node
+            LogMessagesModel::instanceOHD().addLogMessage("Video", "Software renderer (no OpenGL)");
+            setFlag(ItemHasContents, true);
+            _renderer->enable_software_renderer();
+            SoftwareRenderer::instance().set_on_new_image([this]{
+                QMetaObject::invokeMethod(this, "update", Qt::QueuedConnection);
+            });
+            SoftwareRenderer::instance().start();
+        } else {
+            connect(window(), &QQuickWindow::beforeRendering, this, &QSGVideoTextureItem::QQuickWindow_beforeRendering, Qt::DirectConnection);
+            connect(window(), &QQuickWindow::beforeRenderPassRecording, this, &QSGVideoTextureItem::QQuickWindow_beforeRenderPassRecording, Qt::DirectConnection);
+            connect(window(), &QQuickWindow::frameSwapped, this, &QSGVideoTextureItem::QQuickWindow_frameSwapped, Qt::DirectConnection);
+        }
+    }
+    if (_software_backend) {
+        const QSize size = (QSizeF(width(), height()) * window()->devicePixelRatio()).toSize();
+        SoftwareRenderer::instance().set_target(size, QOpenHDVideoHelper::get_display_rotation(), QOpenHDVideoHelper::get_primary_video_scale_to_fit());
+        return;
     }
     _renderer->setViewportSize(window()->size() * window()->devicePixelRatio());
 }
 
+QSGNode *QSGVideoTextureItem::updatePaintNode(QSGNode *old_node, UpdatePaintNodeData *)
+{
+    if (!_software_backend) {
+        return old_node;
+    }
+    QImage image;
+    QRect rect;
+    if (!SoftwareRenderer::instance().take_new_image(image, rect)) {
+        // keep showing the last image
+        return old_node;
+    }
+    if (image.isNull()) {
+        delete old_node;
+        return nullptr;
+    }
+    auto node = static_cast<QSGImageNode*>(old_node);
+    if (node == nullptr) {
+        node = window()->createImageNode();
+        node->setOwnsTexture(true);
+    }
+    // The software backend just blits this
+    node->setTexture(window()->createTextureFromImage(image));
+    const qreal dpr = window()->devicePixelRatio();
+    node->setRect(QRectF(rect.x() / dpr, rect.y() / dpr, rect.width() / dpr, rect.height() / dpr));
+    return node;
+}
+
 void QSGVideoTextureItem::QQuickWindow_beforeRendering()
 {
     if (_renderer != nullptr) {
@@ -88,5 +147,12 @@ void QSGVideoTextureItem::QQuickWindow_beforeRenderPassRecording()
     //window()->requestUpdate();
 }
 
+void QSGVideoTextureItem::QQuickWindow_frameSwapped()
+{
+    if (_renderer != nullptr) {
+        _renderer->on_frame_swapped();
+    }
+}
+
 
 
@@ -24,6 +24,7 @@ class QSGVideoTextureItem : public QQuickItem
     QML_ELEMENT
 public:
     QSGVideoTextureItem();
+    ~QSGVideoTextureItem();
 
 public slots:
     void sync();
@@ -33,16 +34,22 @@ private slots:
 
 private:
     void releaseResources() override;
+    // Only used with the Qt Software backend (no OpenGL), where the video is a (CPU converted) image node
+    QSGNode *updatePaintNode(QSGNode *old_node, UpdatePaintNodeData *) override;
+    bool _software_backend = false;
 
     TextureRenderer* _renderer = nullptr;
 public slots:
     void QQuickWindow_beforeRendering();
     void QQuickWindow_beforeRenderPassRecording();
+    void QQuickWindow_frameSwapped();
 private:
 #ifdef ENABLE_MPP_DECODER
     std::unique_ptr<MppDecoder> _hw_decoder = nullptr;
 #endif
     std::unique_ptr<AVCodecDecoder> _sw_decoder = nullptr;
+    // Dual camera: the secondary video is always decoded via avcodec, drawn by the same TextureRenderer
+    std::unique_ptr<AVCodecDecoder> _sw_decoder_secondary = nullptr;
     bool _use_sw_decoder = false;
 };
 
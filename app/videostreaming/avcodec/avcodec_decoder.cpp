@@ -3,6 +3,7 @@
 #include <QFileInfo>
 #include <iostream>
 #include <sstream>
+#include <time.h>
 
 #include "common/TimeHelper.hpp"
 #include "common/util_fs.h"
@@ -14,7 +15,15 @@
 #include "avcodec_helper.hpp"
 #include "texturerenderer.h"
 #include "decodingstatistcs.h"
+#include "FrameLatencyTracer.hpp"
 #include "ExternalDecodeService.hpp"
+#include "decode_thread_budget.hpp"
+
+static std::chrono::nanoseconds get_thread_cpu_time(){
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID,&ts);
+    return std::chrono::seconds(ts.tv_sec)+std::chrono::nanoseconds(ts.tv_nsec);
+}
 
 static int hw_decoder_init(AVCodecContext *ctx, const enum AVHWDeviceType type){
     int err = 0;
@@ -28,8 +37,9 @@ static int hw_decoder_init(AVCodecContext *ctx, const enum AVHWDeviceType type){
     return err;
 }
 
-static enum AVPixelFormat wanted_hw_pix_fmt;
-static enum AVPixelFormat get_hw_format(AVCodecContext */*ctx*/,const enum AVPixelFormat *pix_fmts){
+// The wanted format is per decoder (primary and secondary decoder run in parallel), ctx->opaque points to it
+static enum AVPixelFormat get_hw_format(AVCodecContext *ctx,const enum AVPixelFormat *pix_fmts){
+    const enum AVPixelFormat wanted_hw_pix_fmt=*static_cast<const AVPixelFormat*>(ctx->opaque);
     const enum AVPixelFormat *p;
     AVPixelFormat ret=AV_PIX_FMT_NONE;
     std::stringstream supported_formats;
@@ -77,21 +87,25 @@ AVCodecDecoder::~AVCodecDecoder()
     terminate();
 }
 
-void AVCodecDecoder::init(bool /*primaryStream*/)
+void AVCodecDecoder::init(bool primaryStream)
 {
-    qDebug() << "AVCodecDecoder::init()";
+    qDebug() << "AVCodecDecoder::init()"<<(primaryStream ? "primary" : "secondary");
+    m_is_primary=primaryStream;
+    m_stream_index=primaryStream ? TextureRenderer::STREAM_PRIMARY : TextureRenderer::STREAM_SECONDARY;
+    m_stats=&DecodingStatistcs::instance(primaryStream);
     m_last_video_settings=QOpenHDVideoHelper::read_config_from_settings();
     decode_thread = std::make_unique<std::thread>([this]{this->constant_decode();} );
-    timer_check_settings_changed=std::make_unique<QTimer>();
-    QObject::connect(timer_check_settings_changed.get(), &QTimer::timeout, this, &AVCodecDecoder::timer_check_settings_changed_callback);
-    timer_check_settings_changed->start(1000);
+    m_settings_subscription_id=SettingsCache::instance().subscribe([this](const QString&){
+        this->on_setting_changed();
+    });
 }
 
 void AVCodecDecoder::terminate()
 {
-    // Stop the timer, which can be done (almost) immediately (it's runnable doesn't block)
-    timer_check_settings_changed->stop();
-    timer_check_settings_changed=nullptr;
+    if(m_settings_subscription_id>=0){
+        SettingsCache::instance().unsubscribe(m_settings_subscription_id);
+        m_settings_subscription_id=-1;
+    }
     // This will stop the constant_decode as soon as the current running decode_until_error loop returns
     m_should_terminate=true;
     // This will break out of a running "decode until error" loop if there is one currently running
@@ -99,13 +113,25 @@ void AVCodecDecoder::terminate()
     if(decode_thread){
         // Wait for everything to cleanup and stop
         decode_thread->join();
+        decode_thread=nullptr;
+    }
+    if(!m_is_primary){
+        // Otherwise the last frame of the secondary video is shown forever
+        TextureRenderer::instance().clear_video_textures_next_frame(m_stream_index);
     }
 }
 
-void AVCodecDecoder::timer_check_settings_changed_callback()
+const QOpenHDVideoHelper::VideoStreamConfigXX &AVCodecDecoder::get_stream_config(const QOpenHDVideoHelper::VideoStreamConfig &settings) const
+{
+    return m_is_primary ? settings.primary_stream_config : settings.secondary_stream_config;
+}
+
+void AVCodecDecoder::on_setting_changed()
 {
     const auto new_settings=QOpenHDVideoHelper::read_config_from_settings();
-    if(m_last_video_settings!=new_settings){
+    std::lock_guard<std::mutex> lock(m_last_video_settings_mutex);
+    // The settings of the other stream don't matter for this decoder
+    if(m_last_video_settings.generic!=new_settings.generic || get_stream_config(m_last_video_settings)!=get_stream_config(new_settings)){
         // We just request a restart from the video (break out of the current constant_decode() loop,
         // and restart with the new settings.
         request_restart=true;
@@ -115,47 +141,59 @@ void AVCodecDecoder::timer_check_settings_changed_callback()
 
 void AVCodecDecoder::constant_decode()
 {
+    // Re-used for all packets / frames for as long as the decode thread is running
+    m_packet=av_packet_alloc();
+    m_frame=av_frame_alloc();
+    assert(m_packet!=nullptr && m_frame!=nullptr);
     while(!m_should_terminate){
         qDebug()<<"Start decode";
         const auto settings = QOpenHDVideoHelper::read_config_from_settings();
-        // this is always for primary video, unless switching is enabled
-        auto stream_config=settings.primary_stream_config;
+        // primary or secondary video, depending on what this decoder was created for
+        auto stream_config=get_stream_config(settings);
 
         // On a couple of embedded platform(s) we do not do the decoding in qopenhd,
         // but by using a "decode service" that renders / composes the video into a plane behind qopenhd
         // on rpi, this is by far the most performant / low latency option
         // choice - enable regardless of platform, usefull for development
         bool use_external_decode_service = false;
-        if(settings.generic.dev_always_use_generic_external_decode_service){
+        if(m_is_primary && settings.generic.dev_always_use_generic_external_decode_service){
             use_external_decode_service = true;
         }
 
         if (!use_external_decode_service) {
             // Does h264 and h265 custom rtp parse, but uses avcodec for decode
             open_and_decode_until_error_custom_rtp(settings);
+        }else{
+            // Free the udp port
+            m_rtp_receiver=nullptr;
         }
         qDebug()<<"Decode stopped,restarting";
         std::this_thread::sleep_for(std::chrono::seconds(1));
     }
+    av_frame_free(&m_frame);
+    av_packet_free(&m_packet);
 }
 
 
-int AVCodecDecoder::decode_and_wait_for_frame(AVPacket *packet,std::optional<std::chrono::steady_clock::time_point> parse_time)
+int AVCodecDecoder::decode_and_wait_for_frame(AVPacket *packet,std::optional<std::chrono::steady_clock::time_point> parse_time,std::optional<uint32_t> rtp_timestamp)
 {
-    AVFrame *frame = nullptr;
+    AVFrame *frame = m_frame;
     //qDebug()<<"Decode packet:"<<packet->pos<<" size:"<<packet->size<<" B";
     const auto beforeFeedFrame=std::chrono::steady_clock::now();
     if(parse_time!=std::nullopt){
         const auto delay=beforeFeedFrame-parse_time.value();
         avg_parse_time.add(delay);
-        avg_parse_time.custom_print_in_intervals(std::chrono::seconds(3),[](const std::string /*name*/, const std::string message){
+        avg_parse_time.custom_print_in_intervals(std::chrono::seconds(3),[this](const std::string /*name*/, const std::string message){
             //qDebug()<<name.c_str()<<":"<<message.c_str();
-            DecodingStatistcs::instance().set_parse_and_enqueue_time(message.c_str());
+            m_stats->set_parse_and_enqueue_time(message.c_str());
         });
     }
     const auto beforeFeedFrameUs=getTimeUs();
     packet->pts=beforeFeedFrameUs;
     timestamp_add_fed(packet->pts);
+    if(rtp_timestamp!=std::nullopt){
+        if(m_is_primary)FrameLatencyTracer::instance().mark_sent_to_decoder(rtp_timestamp.value(),packet->pts);
+    }
 
     //m_ffmpeg_dequeue_or_queue_mutex.lock();
     const int ret_avcodec_send_packet = avcodec_send_packet(decoder_ctx, packet);
@@ -164,14 +202,6 @@ int AVCodecDecoder::decode_and_wait_for_frame(AVPacket *packet,std::optional<std
         fprintf(stderr, "Error during decoding\n");
         return ret_avcodec_send_packet;
     }
-    // alloc output frame(s)
-    if (!(frame = av_frame_alloc())) {
-        // NOTE: It is a common practice to not care about OOM, and this is the best approach in my opinion.
-        // but ffmpeg uses malloc and returns error codes, so we keep this practice here.
-        qDebug()<<"can not alloc frame";
-        av_frame_free(&frame);
-        return AVERROR(ENOMEM);
-    }
     int ret=0;
     // Poll until we get the frame out
     const auto loopUntilFrameBegin=std::chrono::steady_clock::now();
@@ -191,21 +221,27 @@ int AVCodecDecoder::decode_and_wait_for_frame(AVPacket *packet,std::optional<std
                 const auto x_delay=std::chrono::steady_clock::now()-beforeFeedFrame;
                 //qDebug()<<"(True) decode delay(wait):"<<((float)std::chrono::duration_cast<std::chrono::microseconds>(x_delay).count()/1000.0f)<<" ms";
                 avg_decode_time.add(x_delay);
+                m_threading_avg_decode_time.add(x_delay);
+                frame->pts=beforeFeedFrameUs;
             }else{
+                // (e.g. frame threading) the frame we got out is not necessarily the one we just fed,
+                // but avcodec forwards the pts we gave it
                 const auto now_us=getTimeUs();
                 const auto delay_us=now_us-frame->pts;
                 //qDebug()<<"(True) decode delay(nowait):"<<((float)delay_us/1000.0f)<<" ms";
                 //MLOGD<<"Frame pts:"<<frame->pts<<" Set to:"<<now<<"\n";
                 //frame->pts=now;
                 avg_decode_time.add(std::chrono::microseconds(delay_us));
+                m_threading_avg_decode_time.add(std::chrono::microseconds(delay_us));
             }
             gotFrame=true;
-            frame->pts=beforeFeedFrameUs;
             // display frame
             on_new_frame(frame);
-            avg_decode_time.custom_print_in_intervals(std::chrono::seconds(3),[](const std::string /*name*/,const std::string message){
+            // the renderer holds its own reference, we can re-use the frame
+            av_frame_unref(frame);
+            avg_decode_time.custom_print_in_intervals(std::chrono::seconds(3),[this](const std::string /*name*/,const std::string message){
                 //qDebug()<<name.c_str()<<":"<<message.c_str();
-                DecodingStatistcs::instance().set_decode_time(message.c_str());
+                m_stats->set_decode_time(message.c_str());
             });
         }else if(ret==AVERROR(EAGAIN)){
             // TODO FIXME REMOVE
@@ -230,7 +266,6 @@ int AVCodecDecoder::decode_and_wait_for_frame(AVPacket *packet,std::optional<std
         }
         n_times_we_tried_getting_a_frame_this_time++;
     }
-    av_frame_free(&frame);
     return 0;
 }
 
@@ -241,91 +276,46 @@ int AVCodecDecoder::decode_config_data(AVPacket *packet)
 }
 
 
-bool AVCodecDecoder::feed_rtp_frame_if_available()
+void AVCodecDecoder::on_decode_thread_wakeup()
 {
-    auto frame=m_rtp_receiver->get_next_frame();
-    if(frame){
-        {
-            // parsing delay
-            const auto delay=std::chrono::steady_clock::now()-frame->get_nal().creationTime;
-            avg_parse_time.add(delay);
-            avg_parse_time.custom_print_in_intervals(std::chrono::seconds(3),[](const std::string /*name*/,const std::string message){
-                //qDebug()<<name.c_str()<<":"<<message.c_str();
-                DecodingStatistcs::instance().set_parse_and_enqueue_time(message.c_str());
-            });
-        }
-        AVPacket *pkt=av_packet_alloc();
-        pkt->data=(uint8_t*)frame->get_nal().getData();
-        pkt->size=frame->get_nal().getSize();
-        const auto beforeFeedFrameUs=getTimeUs();
-        pkt->pts=beforeFeedFrameUs;
-        timestamp_add_fed(pkt->pts);
-        avcodec_send_packet(decoder_ctx, pkt);
-        av_packet_free(&pkt);
-        return true;
-    }
-    return false;
-}
-
-void AVCodecDecoder::fetch_frame_or_feed_input_packet(){
-    AVPacket *pkt=av_packet_alloc();
-    bool keep_fetching_frames_or_input_packets=true;
-    while(keep_fetching_frames_or_input_packets){
-        if(request_restart){
-            keep_fetching_frames_or_input_packets=false;
-            request_restart=false;
-            continue;
-        }
-        AVFrame* frame= av_frame_alloc();
-        assert(frame);
-        const int ret = avcodec_receive_frame(decoder_ctx, frame);
-        //m_ffmpeg_dequeue_or_queue_mutex.unlock();
-        if(ret == AVERROR_EOF){
-            qDebug()<<"Got EOF";
-            keep_fetching_frames_or_input_packets=false;
-        }else if(ret==0){
-            timestamp_debug_valid(frame->pts);
-            // we got a new frame
-            const auto now_us=getTimeUs();
-            const auto delay_us=now_us-frame->pts;
-            //qDebug()<<"(True) decode delay(nowait):"<<((float)delay_us/1000.0f)<<" ms";
-            //frame->pts=now;
-            avg_decode_time.add(std::chrono::microseconds(delay_us));
-            // display frame
-            on_new_frame(frame);
-            avg_decode_time.custom_print_in_intervals(std::chrono::seconds(3),[](const std::string /*name*/,const std::string message){
-                 //qDebug()<<name.c_str()<<":"<<message.c_str();
-                 DecodingStatistcs::instance().set_decode_time(message.c_str());
-            });
-            av_frame_free(&frame);
-            frame= av_frame_alloc();
-        }else if(ret==AVERROR(EAGAIN)){
-            //qDebug()<<"Needs more data";
-            // Get more encoded data
-            const bool success=feed_rtp_frame_if_available();
-            if(!success){
-                std::this_thread::sleep_for(std::chrono::milliseconds(1));
-            }
-        }else{
-            qDebug()<<"Weird decoder error:"<<ret;
-            keep_fetching_frames_or_input_packets=false;
-        }
+    m_wakeups_per_second.on_new_frame();
+    const auto elapsed=m_wakeups_per_second.time_since_last_recalculation();
+    if(elapsed>=std::chrono::seconds(1)){
+        const float wakeups_per_second=m_wakeups_per_second.recalculate_fps_and_clear();
+        m_stats->set_decoder_wakeups_per_second((int)wakeups_per_second);
+        // CPU usage of this (the decode) thread
+        const auto cpu_time=get_thread_cpu_time();
+        const auto cpu_time_delta=cpu_time-m_last_thread_cpu_time;
+        m_last_thread_cpu_time=cpu_time;
+        const float cpu_percent=(float)(100.0*cpu_time_delta.count()/std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        TextureRenderer::instance().set_decode_cpu_usage(m_stream_index,cpu_percent);
     }
-    av_packet_free(&pkt);
 }
 
 void AVCodecDecoder::on_new_frame(AVFrame *frame)
 {
+    m_last_frame_time=std::chrono::steady_clock::now();
+    if(m_is_primary)FrameLatencyTracer::instance().mark_by_pts(frame->pts,FrameLatencyTracer::DECODED);
+    if(!m_first_frame_after_start_reported){
+        m_stats->util_set_time_to_first_frame(m_last_frame_time-m_decode_start_time,m_n_primed_frames);
+        m_first_frame_after_start_reported=true;
+    }
+    if(m_switch_pending){
+        const auto gap=m_last_frame_time-m_switch_gap_begin;
+        qDebug()<<"Decoder re-configured, gap:"<<MyTimeHelper::R(gap).c_str();
+        m_stats->util_set_decoder_switch_gap(gap,frame->width,frame->height);
+        m_switch_pending=false;
+    }
     {
         std::stringstream ss;
         ss<<safe_av_get_pix_fmt_name((AVPixelFormat)frame->format)<<" "<<frame->width<<"x"<<frame->height;
-        DecodingStatistcs::instance().set_primary_stream_frame_format(QString(ss.str().c_str()));
+        m_stats->set_primary_stream_frame_format(QString(ss.str().c_str()));
         //qDebug()<<"Got frame:"<<ss.str().c_str();
     }
     // Once we got the first frame, reduce the log level
     av_log_set_level(AV_LOG_WARNING);
     //qDebug()<<debug_frame(frame).c_str();
-    TextureRenderer::instance().queue_new_frame_for_display(frame);
+    TextureRenderer::instance().queue_new_frame_for_display(frame,m_stream_index);
     if(last_frame_width==-1 || last_frame_height==-1){
         last_frame_width=frame->width;
         last_frame_height=frame->height;
@@ -333,8 +323,8 @@ void AVCodecDecoder::on_new_frame(AVFrame *frame)
         if(last_frame_width!=frame->width || last_frame_height!=frame->height){
             // PI and SW decoer will just slently start outputting garbage frames
             // if the width/ height changes during RTP streaming
-            qDebug()<<"Need to restart the decoder, width / heght changed";
-            request_restart=true;
+            qDebug()<<"Need to re-configure the decoder, width / heght changed";
+            m_request_reconfigure=true;
         }
     }
     //drm_prime_out->queue_new_frame_for_display(frame);
@@ -347,16 +337,49 @@ void AVCodecDecoder::reset_before_decode_start()
     last_frame_height=-1;
     avg_decode_time.reset();
     avg_parse_time.reset();
-    DecodingStatistcs::instance().reset_all_to_default();
+    m_stats->reset_all_to_default();
     last_frame_width=-1;
     last_frame_height=-1;
     m_fed_timestamps_queue.clear();
+    m_wakeups_per_second.recalculate_fps_and_clear();
+    m_last_thread_cpu_time=get_thread_cpu_time();
+    m_n_primed_frames=0;
+    m_first_frame_after_start_reported=false;
+    m_request_reconfigure=false;
+    m_switch_pending=false;
+}
+
+void AVCodecDecoder::create_or_reuse_rtp_receiver(const QOpenHDVideoHelper::VideoStreamConfig& settings)
+{
+    const auto& stream_config=get_stream_config(settings);
+    const bool is_h265=stream_config.video_codec==QOpenHDVideoHelper::VideoCodecH265;
+    if(m_rtp_receiver!=nullptr && m_rtp_receiver->is_same_config(stream_config.udp_rtp_input_port,stream_config.udp_rtp_input_ip_address,is_h265,settings.generic)){
+        qDebug()<<"Re-using rtp receiver";
+        return;
+    }
+    // Close the old one first, it is bound to the same port
+    m_rtp_receiver=nullptr;
+    m_rtp_receiver=std::make_unique<RTPReceiver>(stream_config.udp_rtp_input_port,stream_config.udp_rtp_input_ip_address,is_h265,settings.generic,m_is_primary);
+}
+
+void AVCodecDecoder::prime_decoder_from_gop_cache()
+{
+    auto frames=m_rtp_receiver->get_gop_cache_for_decoder_start();
+    if(frames.empty())return;
+    qDebug()<<"Priming decoder with"<<(int)frames.size()<<"cached frames";
+    m_n_primed_frames=(int)frames.size();
+    // As fast as the decoder can go, the renderer only displays the most recent frame anyways
+    for(const auto& frame:frames){
+        m_packet->data=(uint8_t*)frame.get_nal().getData();
+        m_packet->size=frame.get_nal().getSize();
+        decode_and_wait_for_frame(m_packet);
+    }
 }
 
 int AVCodecDecoder::open_and_decode_until_error(const QOpenHDVideoHelper::VideoStreamConfig settings)
 {
-    // this is always for primary video, unless switching is enabled
-    auto stream_config=settings.primary_stream_config;
+    // primary or secondary video, depending on what this decoder was created for
+    auto stream_config=get_stream_config(settings);
     std::string in_filename="";
     in_filename=QOpenHDVideoHelper::get_udp_rtp_sdp_filename(stream_config);
 
@@ -464,31 +487,31 @@ int AVCodecDecoder::open_and_decode_until_error(const QOpenHDVideoHelper::VideoS
             auto tmp = avcodec_find_decoder_by_name("h264_mmal");
             if(tmp!=nullptr){
                 decoder = tmp;
-                wanted_hw_pix_fmt = AV_PIX_FMT_MMAL;
+                m_wanted_hw_pix_fmt = AV_PIX_FMT_MMAL;
             }else{
-                wanted_hw_pix_fmt = AV_PIX_FMT_YUV420P;
+                m_wanted_hw_pix_fmt = AV_PIX_FMT_YUV420P;
             }
         }else{
-            wanted_hw_pix_fmt = AV_PIX_FMT_YUV420P;
-            //wanted_hw_pix_fmt = AV_PIX_FMT_DRM_PRIME;
+            m_wanted_hw_pix_fmt = AV_PIX_FMT_YUV420P;
+            //m_wanted_hw_pix_fmt = AV_PIX_FMT_DRM_PRIME;
         }
     }
     else if(decoder->id==AV_CODEC_ID_H265){
         qDebug()<<"H265 decode";
         qDebug()<<all_hw_configs_for_this_codec(decoder).c_str();
-        wanted_hw_pix_fmt = AV_PIX_FMT_DRM_PRIME;
-        //wanted_hw_pix_fmt = AV_PIX_FMT_CUDA;
-        //wanted_hw_pix_fmt = AV_PIX_FMT_VAAPI;
-        //wanted_hw_pix_fmt = AV_PIX_FMT_YUV420P;
-        //wanted_hw_pix_fmt = AV_PIX_FMT_VAAPI;
-        //wanted_hw_pix_fmt = AV_PIX_FMT_VDPAU;
+        m_wanted_hw_pix_fmt = AV_PIX_FMT_DRM_PRIME;
+        //m_wanted_hw_pix_fmt = AV_PIX_FMT_CUDA;
+        //m_wanted_hw_pix_fmt = AV_PIX_FMT_VAAPI;
+        //m_wanted_hw_pix_fmt = AV_PIX_FMT_YUV420P;
+        //m_wanted_hw_pix_fmt = AV_PIX_FMT_VAAPI;
+        //m_wanted_hw_pix_fmt = AV_PIX_FMT_VDPAU;
     }else if(decoder->id==AV_CODEC_ID_MJPEG){
         qDebug()<<"Codec mjpeg";
         qDebug()<<all_hw_configs_for_this_codec(decoder).c_str();
-        wanted_hw_pix_fmt=AV_PIX_FMT_YUVJ422P;
-        //wanted_hw_pix_fmt=AV_PIX_FMT_YUVJ420P;
-        //wanted_hw_pix_fmt=AV_PIX_FMT_CUDA;
-        //wanted_hw_pix_fmt = AV_PIX_FMT_DRM_PRIME;
+        m_wanted_hw_pix_fmt=AV_PIX_FMT_YUVJ422P;
+        //m_wanted_hw_pix_fmt=AV_PIX_FMT_YUVJ420P;
+        //m_wanted_hw_pix_fmt=AV_PIX_FMT_CUDA;
+        //m_wanted_hw_pix_fmt = AV_PIX_FMT_DRM_PRIME;
         is_mjpeg= true;
     }else{
         assert(true);
@@ -501,6 +524,7 @@ int AVCodecDecoder::open_and_decode_until_error(const QOpenHDVideoHelper::VideoS
         avformat_close_input(&input_ctx);
         return -1;
     }
+    decoder_ctx->opaque=&m_wanted_hw_pix_fmt;
 
     // From moonlight-qt. However, on PI, this doesn't seem to make any difference, at least for H265 decode.
     // (I never measured h264, but don't think there it is different).
@@ -531,9 +555,9 @@ int AVCodecDecoder::open_and_decode_until_error(const QOpenHDVideoHelper::VideoS
           //return -1;
           // H264 and H265 sw decode is always YUV420P, MJPEG seems to be always YUVJ422P;
           if(is_mjpeg){
-            wanted_hw_pix_fmt=AV_PIX_FMT_YUVJ422P;
+            m_wanted_hw_pix_fmt=AV_PIX_FMT_YUVJ422P;
           }
-          wanted_hw_pix_fmt=AV_PIX_FMT_YUV420P;
+          m_wanted_hw_pix_fmt=AV_PIX_FMT_YUV420P;
         }else{
             selected_decoding_type="HW";
         }
@@ -553,7 +577,7 @@ int AVCodecDecoder::open_and_decode_until_error(const QOpenHDVideoHelper::VideoS
     int nFeedFrames=0;
     auto lastFrame=std::chrono::steady_clock::now();
     reset_before_decode_start();
-    DecodingStatistcs::instance().set_decoding_type(selected_decoding_type.c_str());
+    m_stats->set_decoding_type(selected_decoding_type.c_str());
     while (ret >= 0) {
         if(request_restart){
             request_restart=false;
@@ -598,8 +622,8 @@ int AVCodecDecoder::open_and_decode_until_error(const QOpenHDVideoHelper::VideoS
     //packet.data = NULL;
     //packet.size = 0;
     //ret = decode_and_wait_for_frame(&packet);
-    DecodingStatistcs::instance().set_decode_time("-1");
-    DecodingStatistcs::instance().set_primary_stream_frame_format("-1");
+    m_stats->set_decode_time("-1");
+    m_stats->set_primary_stream_frame_format("-1");
     avcodec_free_context(&decoder_ctx);
     qDebug()<<"avcodec_free_context done";    avformat_close_input(&input_ctx);
     qDebug()<<"avformat_close_input_done";
@@ -607,11 +631,159 @@ int AVCodecDecoder::open_and_decode_until_error(const QOpenHDVideoHelper::VideoS
 }
 
 
+bool AVCodecDecoder::open_decoder_context(const std::vector<uint8_t>* extradata)
+{
+    decoder_ctx = avcodec_alloc_context3(decoder);
+    if (!decoder_ctx) {
+        qDebug()<< "AVCodecDecoder::open_decoder_context: Could not allocate video codec context";
+        return false;
+    }
+    decoder_ctx->opaque=&m_wanted_hw_pix_fmt;
+    // ----------------------------------
+    // From moonlight-qt. However, on PI, this doesn't seem to make any difference, at least for H265 decode.
+    // (I never measured h264, but don't think there it is different).
+    // Request low delay decoding (cleared again for frame threading, see apply_threading_policy)
+    decoder_ctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+    // Allow display of corrupt frames and frames missing references
+    decoder_ctx->flags |= AV_CODEC_FLAG_OUTPUT_CORRUPT;
+    decoder_ctx->flags2 |= AV_CODEC_FLAG2_SHOW_ALL;
+    // --------------------------------------
+    if(extradata!=nullptr && !extradata->empty()){
+        // avcodec takes ownership (freed in avcodec_free_context)
+        decoder_ctx->extradata=(uint8_t*)av_mallocz(extradata->size()+AV_INPUT_BUFFER_PADDING_SIZE);
+        if(decoder_ctx->extradata!=nullptr){
+            memcpy(decoder_ctx->extradata,extradata->data(),extradata->size());
+            decoder_ctx->extradata_size=(int)extradata->size();
+        }
+    }
+    // --------------------------------------
+    m_selected_decoding_type="?";
+    if(m_use_pi_hw_decode){
+        decoder_ctx->get_format  = get_hw_format;
+        if (hw_decoder_init(decoder_ctx, AV_HWDEVICE_TYPE_DRM) < 0){
+          qDebug()<<"HW decoder init failed,fallback to SW decode";
+          m_selected_decoding_type="SW(HW failed)";
+          assert(true);
+        }else{
+            m_selected_decoding_type="HW";
+        }
+    }else{
+        m_selected_decoding_type="SW";
+    }
+    apply_threading_policy();
+
+    // ---------------------------------------
+
+    if (avcodec_open2(decoder_ctx, decoder, NULL) < 0) {
+        fprintf(stderr, "Could not open codec\n");
+        avcodec_free_context(&decoder_ctx);
+        return false;
+    }
+    on_decoder_context_opened();
+    return true;
+}
+
+void AVCodecDecoder::apply_threading_policy()
+{
+    const int n_threads=get_n_decode_threads();
+    // What we asked for - avcodec might use less (see avcodec_open2)
+    m_requested_n_threads=n_threads;
+    if(m_active_threading==QOpenHDVideoHelper::DecodeThreadingSlice){
+        decoder_ctx->thread_type = FF_THREAD_SLICE;
+        decoder_ctx->thread_count = n_threads;
+    }else if(m_active_threading==QOpenHDVideoHelper::DecodeThreadingFrame){
+        // avcodec silently disables frame threading with low delay set. Slice threads are the fallback if the codec
+        // cannot do frame threads.
+        decoder_ctx->flags &= ~AV_CODEC_FLAG_LOW_DELAY;
+        decoder_ctx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+        decoder_ctx->thread_count = n_threads;
+    }else{
+        // A thread count of 1 reduces latency for both SW and HW decode
+        decoder_ctx->thread_count = 1;
+    }
+}
+
+void AVCodecDecoder::on_decoder_context_opened()
+{
+    // What avcodec actually uses, which is not necessarily what we requested
+    m_active_n_threads=decoder_ctx->active_thread_type==0 ? 1 : decoder_ctx->thread_count;
+    m_frame_threading_active= (decoder_ctx->active_thread_type & FF_THREAD_FRAME)!=0;
+    // With frame threading, a frame only comes out (n threads -1) frames later
+    use_frame_timestamps_for_latency=m_frame_threading_active;
+    qDebug()<<"Decode threading:"<<QOpenHDVideoHelper::decode_threading_policy_to_string(m_active_threading).c_str()
+           <<" requested threads:"<<m_requested_n_threads<<" active:"<<m_active_n_threads<<(m_frame_threading_active ? " frame" : "")
+           <<((decoder_ctx->active_thread_type & FF_THREAD_SLICE) ? " slice" : "");
+    m_threading_avg_decode_time.reset();
+    m_threading_n_fed_frames=0;
+    m_threading_eval_begin=std::chrono::steady_clock::now();
+}
+
+int AVCodecDecoder::get_n_decode_threads()const
+{
+    if(m_active_threading==QOpenHDVideoHelper::DecodeThreadingSingle)return 1;
+    if(m_decode_n_threads>0)return m_decode_n_threads;
+    // One per core, shared with the decoder of the other stream (if running)
+    return DecodeThreadBudget::instance().get_n_threads_per_decoder();
+}
+
+void AVCodecDecoder::evaluate_threading_policy()
+{
+    m_threading_n_fed_frames++;
+    const auto elapsed=std::chrono::steady_clock::now()-m_threading_eval_begin;
+    if(elapsed<std::chrono::seconds(2))return;
+    if(m_threading_n_fed_frames>=10 && m_threading_avg_decode_time.getNSamples()>0){
+        const auto frame_interval=elapsed/m_threading_n_fed_frames;
+        const auto decode_time=m_threading_avg_decode_time.getAvg();
+        const int n_threads=get_n_decode_threads();
+        std::stringstream ss;
+        ss<<QOpenHDVideoHelper::decode_threading_policy_to_string(m_active_threading)<<" x"<<m_active_n_threads<<" "<<MyTimeHelper::R(decode_time);
+        if(m_frame_threading_active){
+            // Each additional thread holds back one frame
+            ss<<" +"<<MyTimeHelper::R(frame_interval*(m_active_n_threads-1));
+        }
+        m_stats->set_decode_threading(ss.str().c_str());
+        // The other stream's decoder started / stopped, re-open with our new share of the cores
+        if(m_active_threading!=QOpenHDVideoHelper::DecodeThreadingSingle && n_threads!=m_requested_n_threads){
+            qDebug()<<"Decode thread budget changed "<<m_requested_n_threads<<"->"<<n_threads;
+            m_request_reconfigure=true;
+        }
+        // Auto: Switch to frame threads once slice threads cannot keep up with the frame rate anymore (with a bit of headroom).
+        // One way until the next restart, with frame threads we cannot measure the pure decode time anymore
+        if(m_threading_policy==QOpenHDVideoHelper::DecodeThreadingAuto && m_active_threading==QOpenHDVideoHelper::DecodeThreadingSlice &&
+                decode_time > frame_interval*9/10){
+            qDebug()<<"Decode time "<<MyTimeHelper::R(decode_time).c_str()<<" exceeds frame interval "<<MyTimeHelper::R(frame_interval).c_str()<<", using frame threads";
+            m_active_threading=QOpenHDVideoHelper::DecodeThreadingFrame;
+            m_request_reconfigure=true;
+        }
+    }
+    m_threading_avg_decode_time.reset();
+    m_threading_n_fed_frames=0;
+    m_threading_eval_begin=std::chrono::steady_clock::now();
+}
+
+void AVCodecDecoder::begin_reconfigure_in_place()
+{
+    qDebug()<<"Config changed during decode, re-configure decoder";
+    // The gap is measured from the last frame with the old config until the first frame with the new config
+    m_switch_gap_begin= last_frame_width==-1 ? std::chrono::steady_clock::now() : m_last_frame_time;
+    m_switch_pending=true;
+    m_request_reconfigure=false;
+    // Get rid of anything the decoder still holds from the old config, then free the context.
+    // It is re-opened (with the new config data as extradata) as soon as the new config data is available.
+    avcodec_flush_buffers(decoder_ctx);
+    avcodec_free_context(&decoder_ctx);
+    last_frame_width=-1;
+    last_frame_height=-1;
+}
+
 // https://ffmpeg.org/doxygen/3.3/decode_video_8c-example.html
 void AVCodecDecoder::open_and_decode_until_error_custom_rtp(const QOpenHDVideoHelper::VideoStreamConfig settings)
 {
-    // this is always for primary video, unless switching is enabled
-    auto stream_config=settings.primary_stream_config;
+    m_decode_start_time=std::chrono::steady_clock::now();
+    // For as long as we are decoding, we share the cores with the other stream's decoder
+    DecodeThreadBudget::Registration thread_budget_registration{};
+    // primary or secondary video, depending on what this decoder was created for
+    auto stream_config=get_stream_config(settings);
 
     // This thread pulls frame(s) from the rtp decoder and therefore should have high priority
     SchedulingHelper::setThreadParamsMaxRealtime();
@@ -635,71 +807,40 @@ void AVCodecDecoder::open_and_decode_until_error_custom_rtp(const QOpenHDVideoHe
              auto tmp = avcodec_find_decoder_by_name("h264_mmal");
              if(tmp!=nullptr){
                  decoder = tmp;
-                 wanted_hw_pix_fmt = AV_PIX_FMT_MMAL;
+                 m_wanted_hw_pix_fmt = AV_PIX_FMT_MMAL;
                  use_pi_hw_decode=true;
              }else{
-                 wanted_hw_pix_fmt = AV_PIX_FMT_YUV420P;
+                 m_wanted_hw_pix_fmt = AV_PIX_FMT_YUV420P;
              }
          }else{
-             wanted_hw_pix_fmt = AV_PIX_FMT_YUV420P;
+             m_wanted_hw_pix_fmt = AV_PIX_FMT_YUV420P;
          }
      }else if(decoder->id==AV_CODEC_ID_H265){
          qDebug()<<"H265 decode";
          if(!stream_config.enable_software_video_decoder){
              qDebug()<<all_hw_configs_for_this_codec(decoder).c_str();
              // HW format used by rpi h265 HW decoder
-             wanted_hw_pix_fmt = AV_PIX_FMT_DRM_PRIME;
+             m_wanted_hw_pix_fmt = AV_PIX_FMT_DRM_PRIME;
              use_pi_hw_decode=true;
          }else{
 
          }
      }
      // ------------------------------------
-     decoder_ctx = avcodec_alloc_context3(decoder);
-     if (!decoder_ctx) {
-         qDebug()<< "AVCodecDecoder::open_and_decode_until_error_custom_rtp: Could not allocate video codec context";
-         return;
-     }
-     // ----------------------------------
-    // From moonlight-qt. However, on PI, this doesn't seem to make any difference, at least for H265 decode.
-    // (I never measured h264, but don't think there it is different).
-    // Always request low delay decoding
-    decoder_ctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
-    // Allow display of corrupt frames and frames missing references
-    decoder_ctx->flags |= AV_CODEC_FLAG_OUTPUT_CORRUPT;
-    decoder_ctx->flags2 |= AV_CODEC_FLAG2_SHOW_ALL;
-    // --------------------------------------
-    // --------------------------------------
-    std::string selected_decoding_type="?";
-    if(use_pi_hw_decode){
-        decoder_ctx->get_format  = get_hw_format;
-        if (hw_decoder_init(decoder_ctx, AV_HWDEVICE_TYPE_DRM) < 0){
-          qDebug()<<"HW decoder init failed,fallback to SW decode";
-          selected_decoding_type="SW(HW failed)";
-          assert(true);
-        }else{
-            selected_decoding_type="HW";
-        }
-    }else{
-        selected_decoding_type="SW";
-    }
-    // A thread count of 1 reduces latency for both SW and HW decode
-    decoder_ctx->thread_count = 1;
-
-    // ---------------------------------------
-
-     if (avcodec_open2(decoder_ctx, decoder, NULL) < 0) {
-         fprintf(stderr, "Could not open codec\n");
-         avcodec_free_context(&decoder_ctx);
+     m_use_pi_hw_decode=use_pi_hw_decode;
+     // Threading only applies to sw decode
+     m_threading_policy= use_pi_hw_decode ? QOpenHDVideoHelper::DecodeThreadingSingle : stream_config.decode_threading_policy;
+     m_active_threading= m_threading_policy==QOpenHDVideoHelper::DecodeThreadingAuto ? QOpenHDVideoHelper::DecodeThreadingSlice : m_threading_policy;
+     m_decode_n_threads=stream_config.decode_n_threads;
+     if(!open_decoder_context(nullptr)){
          return;
      }
      qDebug()<<"AVCodecDecoder::open_and_decode_until_error_custom_rtp()-begin loop";
-     m_rtp_receiver=std::make_unique<RTPReceiver>(stream_config.udp_rtp_input_port,stream_config.udp_rtp_input_ip_address,stream_config.video_codec==1,settings.generic.dev_feed_incomplete_frames_to_decoder);
+     create_or_reuse_rtp_receiver(settings);
 
      reset_before_decode_start();
-     DecodingStatistcs::instance().set_decoding_type(selected_decoding_type.c_str());
-     AVPacket *pkt=av_packet_alloc();
-     assert(pkt!=nullptr);
+     m_stats->set_decoding_type(m_selected_decoding_type.c_str());
+     AVPacket *pkt=m_packet;
      bool has_keyframe_data=false;
      while(true){
          // We break out of this loop if someone requested a restart
@@ -707,39 +848,56 @@ void AVCodecDecoder::open_and_decode_until_error_custom_rtp(const QOpenHDVideoHe
              request_restart=false;
              goto finish;
          }
-         // or the decode config changed and we need a restart
-         if(m_rtp_receiver->config_has_changed_during_decode){
-             qDebug()<<"Break/Restart,config has changed during decode";
-             goto finish;
+         // or the decode config (e.g. the resolution) changed - we only need to re-open the codec context,
+         // the udp / rtp receiver and the renderer stay as they are
+         if(has_keyframe_data && (m_rtp_receiver->config_has_changed_during_decode || m_request_reconfigure)){
+             begin_reconfigure_in_place();
+             has_keyframe_data=false;
+             continue;
          }
          //std::this_thread::sleep_for(std::chrono::milliseconds(3000));
          if(!has_keyframe_data){
               std::shared_ptr<std::vector<uint8_t>> keyframe_buf=m_rtp_receiver->get_config_data();
+              on_decode_thread_wakeup();
               if(keyframe_buf==nullptr){
-                  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                  // Poll more often when switching, the new config data is usually just a few ms away
+                  std::this_thread::sleep_for(m_switch_pending ? std::chrono::milliseconds(5) : std::chrono::milliseconds(100));
                   continue;
               }
+              if(decoder_ctx==nullptr){
+                  if(decoder->id==AV_CODEC_ID_H264){
+                      // Parsed with the bundled (webrtc) h264 sps parser
+                      const auto width_height=m_rtp_receiver->sps_get_width_height();
+                      qDebug()<<"New config:"<<width_height[0]<<"x"<<width_height[1];
+                  }
+                  // Re-open with the new config data as extradata
+                  if(!open_decoder_context(keyframe_buf.get())){
+                      goto finish;
+                  }
+              }
               qDebug()<<"Decode config data";
               pkt->data=keyframe_buf->data();
               pkt->size=keyframe_buf->size();
               decode_config_data(pkt);
               has_keyframe_data=true;
+              prime_decoder_from_gop_cache();
               continue;
          }else{
              auto buf =m_rtp_receiver->get_next_frame(std::chrono::milliseconds(kDefaultFrameTimeout));
-             if(buf==nullptr){
+             on_decode_thread_wakeup();
+             if(!buf.has_value()){
                  // No buff after X seconds
                  continue;
              }
              pkt->data=(uint8_t*)buf->get_nal().getData();
              pkt->size=buf->get_nal().getSize();
-             decode_and_wait_for_frame(pkt,buf->get_nal().creationTime);
-             //fetch_frame_or_feed_input_packet();
+             decode_and_wait_for_frame(pkt,buf->get_nal().creationTime,buf->get_nal().rtp_timestamp);
+             evaluate_threading_policy();
          }
      }
 finish:
      qDebug()<<"AVCodecDecoder::open_and_decode_until_error_custom_rtp()-end loop";
-     m_rtp_receiver=nullptr;
+     // NOTE: The rtp receiver (and its GOP cache) is kept alive for the next decode start
      avcodec_free_context(&decoder_ctx);
 }
 
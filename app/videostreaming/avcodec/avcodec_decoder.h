@@ -16,8 +16,11 @@
 #include "avcodec_helper.hpp"
 #include "QOpenHDVideoHelper.hpp"
 
+class DecodingStatistcs;
+
 /**
- * Decoding and display of primary video on all platforms except android
+ * Decoding and display of primary or secondary video on all platforms except android.
+ * Both decoders run in parallel (each on its own decode thread), sharing the decode thread budget (cores) and the NALU buffer pool.
  * NOTE: On rpi, we actually don't use avcodec, but the decode service workaround (mmal)
  * since it is the only way to get (ish) low latency h264 video on rpi.
  */
@@ -28,12 +31,26 @@ public:
     ~AVCodecDecoder();
     // called when app is created
     void init(bool primaryStream);
+    bool is_primary()const{return m_is_primary;}
     // called when app terminates
     void terminate();
 private:
     AVCodecContext *decoder_ctx = nullptr;
     const AVCodec *decoder = nullptr;
+    // Allocated once per decode thread and re-used for every packet / frame
+    // (the renderer takes its own reference of each frame, so we can unref and re-use it right away)
+    AVPacket *m_packet = nullptr;
+    AVFrame *m_frame = nullptr;
     std::unique_ptr<std::thread> decode_thread=nullptr;
+    bool m_is_primary=true;
+    // TextureRenderer::STREAM_PRIMARY / STREAM_SECONDARY
+    int m_stream_index=0;
+    // Per stream statistics, set in init()
+    DecodingStatistcs* m_stats=nullptr;
+    // Format get_hw_format() picks, per decoder (decoder_ctx->opaque)
+    enum AVPixelFormat m_wanted_hw_pix_fmt=AV_PIX_FMT_NONE;
+    // Config of the stream this decoder is responsible for
+    const QOpenHDVideoHelper::VideoStreamConfigXX& get_stream_config(const QOpenHDVideoHelper::VideoStreamConfig& settings)const;
 private:
     // The logic of this decode "machine" is simple:
     // Start decoding as soon as enough config data has been received
@@ -51,7 +68,7 @@ private:
     // This will stop performing the lockstep. In this case, either the decoder cannot decode
     // the video without buffering (which is bad, but some IP camera(s) create such a stream)
     // or the underlying decode implementation (e.g. rpi foundation h264 !? investigate) has some quirks.
-    int decode_and_wait_for_frame(AVPacket *packet,std::optional<std::chrono::steady_clock::time_point> parse_time=std::nullopt);
+    int decode_and_wait_for_frame(AVPacket *packet,std::optional<std::chrono::steady_clock::time_point> parse_time=std::nullopt,std::optional<uint32_t> rtp_timestamp=std::nullopt);
     // Just send data to the codec, do not check or wait for a frame
     int decode_config_data(AVPacket *packet);
     // Called every time we get a new frame from the decoder, do what you wish here ;)
@@ -63,16 +80,17 @@ private:
     bool m_should_terminate=false;
     int n_no_output_frame_after_x_seconds=0;
     bool use_frame_timestamps_for_latency=false;
-    AvgCalculator avg_decode_time{"Decode"};
-    AvgCalculator avg_parse_time{"Parse&Enqueue"};
+    LatencyHistogram avg_decode_time{"Decode"};
+    LatencyHistogram avg_parse_time{"Parse&Enqueue"};
     AvgCalculator avg_send_mmal_frame_to_display{"MMAL send frame"};
     static constexpr std::chrono::milliseconds kDefaultFrameTimeout{33*2};
 private:
-    // Completely ineficient, but only way since QT settings callback(s) don't properly work
-    // runs every 1 second, reads the settings and checks if they differ from the previosly
-    // read settings. In case they differ, request a complete restart from the decoder.
-    std::unique_ptr<QTimer> timer_check_settings_changed = nullptr;
-    void timer_check_settings_changed_callback();
+    // Called by the SettingsCache whenever any setting changed, re-reads the video settings (cheap, cached) and
+    // requests a complete restart from the decoder if they differ from the previously read settings.
+    void on_setting_changed();
+    int m_settings_subscription_id=-1;
+    // the settings cache notifies on the thread that changed the setting
+    std::mutex m_last_video_settings_mutex;
     QOpenHDVideoHelper::VideoStreamConfig m_last_video_settings;
 private:
     int last_frame_width=-1;
@@ -89,7 +107,11 @@ private:
     static constexpr auto MAX_FED_TIMESTAMPS_QUEUE_SIZE=100;
     std::deque<int64_t> m_fed_timestamps_queue;
 private:
-    void fetch_frame_or_feed_input_packet();
+    // Counts each time the decode thread returns from a (timed) wait, published as wakeups per second
+    void on_decode_thread_wakeup();
+    FPSCalculator m_wakeups_per_second;
+    // Decode thread CPU time at the last recalculation, for the per stream CPU usage
+    std::chrono::nanoseconds m_last_thread_cpu_time{0};
 private:
     std::unique_ptr<RTPReceiver> m_rtp_receiver=nullptr;
 private:
@@ -97,7 +119,45 @@ private:
     // AND always goes the avcodec decode route (SW decode or avcodec mmal decode).
     // Used for SW decode, for MMAL h264 we go the custom rtp WITHOUT avcodec route by default !
     void open_and_decode_until_error_custom_rtp(const QOpenHDVideoHelper::VideoStreamConfig settings);
-    bool feed_rtp_frame_if_available();
+    // The rtp receiver survives decoder restarts unless the stream config changed
+    void create_or_reuse_rtp_receiver(const QOpenHDVideoHelper::VideoStreamConfig& settings);
+    // Feed everything since the last keyframe (if cached) right after the config data, such that we get an image immediately
+    void prime_decoder_from_gop_cache();
+    // Alloc, configure and open decoder_ctx (decoder and m_use_pi_hw_decode need to be set already).
+    // extradata: config data (SPS,PPS,VPS) if already known, can be nullptr
+    bool open_decoder_context(const std::vector<uint8_t>* extradata);
+    bool m_use_pi_hw_decode=false;
+    std::string m_selected_decoding_type="?";
+    // Threading of the sw decoder (configured policy and what is actually used, auto is either slice or frame)
+    QOpenHDVideoHelper::DecodeThreadingPolicy m_threading_policy=QOpenHDVideoHelper::DecodeThreadingSingle;
+    QOpenHDVideoHelper::DecodeThreadingPolicy m_active_threading=QOpenHDVideoHelper::DecodeThreadingSingle;
+    int m_decode_n_threads=0;
+    // Thread count requested on the last open, compared against the budget (not decoder_ctx->thread_count, which is what avcodec chose)
+    int m_requested_n_threads=1;
+    // Read back after avcodec_open2 - avcodec falls back to fewer threads / slice threads if it cannot do what we requested
+    int m_active_n_threads=1;
+    bool m_frame_threading_active=false;
+    // Sets thread type / count (and flags) before avcodec_open2
+    void apply_threading_policy();
+    // Reads back the threading avcodec chose, (re-)starts the threading stats
+    void on_decoder_context_opened();
+    int get_n_decode_threads()const;
+    // Called for each frame fed to the decoder, publishes decode time / added latency of the active threading
+    // and switches from slice to frame threads (auto) if decoding cannot keep up.
+    void evaluate_threading_policy();
+    LatencyHistogram m_threading_avg_decode_time{"Decode(threading)"};
+    int m_threading_n_fed_frames=0;
+    std::chrono::steady_clock::time_point m_threading_eval_begin;
+    // In place re-configure on a config / resolution change: only the codec context is re-opened
+    // (once the new config data is available), the rtp receiver and the renderer are kept alive.
+    void begin_reconfigure_in_place();
+    bool m_request_reconfigure=false;
+    bool m_switch_pending=false;
+    std::chrono::steady_clock::time_point m_switch_gap_begin;
+    std::chrono::steady_clock::time_point m_last_frame_time;
+    std::chrono::steady_clock::time_point m_decode_start_time;
+    bool m_first_frame_after_start_reported=false;
+    int m_n_primed_frames=0;
 private:
     void reset_before_decode_start();
     // On some platforms, it is easiest to just start and stop a service that does the video decode (QOpenHD is then transparently layered on top)
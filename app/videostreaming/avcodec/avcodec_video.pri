@@ -8,15 +8,23 @@ SOURCES += \
     $$PWD/QSGVideoTextureItem.cpp \
     $$PWD/gl/gl_shaders.cpp \
     $$PWD/gl/gl_videorenderer.cpp \
+    $$PWD/gl/gl_pbo_upload.cpp \
     $$PWD/texturerenderer.cpp \
+    $$PWD/softwarerenderer.cpp \
+    $$PWD/cpu/yuv_to_rgb.cpp \
     $$PWD/avcodec_decoder.cpp \
 
 HEADERS += \
     $$PWD/QSGVideoTextureItem.h \
     $$PWD/gl/gl_shaders.h \
     $$PWD/gl/gl_videorenderer.h \
+    $$PWD/gl/gl_pbo_upload.h \
     $$PWD/texturerenderer.h \
+    $$PWD/softwarerenderer.h \
+    $$PWD/cpu/yuv_to_rgb.h \
+    $$PWD/presentation_scheduler.hpp \
     $$PWD/avcodec_decoder.h \
+    $$PWD/decode_thread_budget.hpp \
 
 
 # dirty way to check if we are on rpi and therefore should use the external decode service
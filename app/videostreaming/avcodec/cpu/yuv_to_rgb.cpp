@@ -0,0 +1,395 @@
+#include "yuv_to_rgb.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#define YUV_TO_RGB_HAS_SSE2
+#include <emmintrin.h>
+#endif
+// AVX2 is compiled per function (target attribute) and only used if the cpu supports it
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define YUV_TO_RGB_HAS_AVX2
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define YUV_TO_RGB_HAS_NEON
+#include <arm_neon.h>
+#endif
+
+namespace yuv_to_rgb{
+
+// BT.601 limited range, same constants as the GL shaders, in 6 bit fixed point.
+// All intermediate values fit into int16 (the SIMD kernels use saturating adds, which only saturate if the result is clamped to 255 anyways).
+static constexpr int kY=75;   // 1.1644
+static constexpr int kRV=102; // 1.596
+static constexpr int kGU=25;  // 0.3918
+static constexpr int kGV=52;  // 0.813
+static constexpr int kBU=129; // 2.0172
+
+static inline uint8_t clamp_u8(int value){
+    return (uint8_t)std::min(std::max(value,0),255);
+}
+
+static inline void yuv_to_bgra_pixel(int y,int u,int v,uint8_t* dst){
+    const int yt=(y-16)*kY+32;
+    const int ut=u-128;
+    const int vt=v-128;
+    dst[0]=clamp_u8((yt+ut*kBU)>>6);
+    dst[1]=clamp_u8((yt-(ut*kGU+vt*kGV))>>6);
+    dst[2]=clamp_u8((yt+vt*kRV)>>6);
+    dst[3]=0xFF;
+}
+
+static void i420_row_scalar(const uint8_t* y,const uint8_t* u,const uint8_t* v,uint8_t* dst,int width){
+    for(int x=0;x<width;x++){
+        yuv_to_bgra_pixel(y[x],u[x/2],v[x/2],dst+x*4);
+    }
+}
+
+static void nv12_row_scalar(const uint8_t* y,const uint8_t* uv,uint8_t* dst,int width){
+    for(int x=0;x<width;x++){
+        yuv_to_bgra_pixel(y[x],uv[(x/2)*2],uv[(x/2)*2+1],dst+x*4);
+    }
+}
+
+#ifdef YUV_TO_RGB_HAS_SSE2
+// 16 pixels, u16 / v16: 8 chroma samples (already -128) as int16
+static inline void sse2_yuv16_to_bgra(__m128i yv,__m128i u16,__m128i v16,uint8_t* dst){
+    const __m128i zero=_mm_setzero_si128();
+    const __m128i c16=_mm_set1_epi16(16);
+    const __m128i c32=_mm_set1_epi16(32);
+    const __m128i cy=_mm_set1_epi16(kY);
+    __m128i ylo=_mm_unpacklo_epi8(yv,zero);
+    __m128i yhi=_mm_unpackhi_epi8(yv,zero);
+    ylo=_mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(ylo,c16),cy),c32);
+    yhi=_mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(yhi,c16),cy),c32);
+    const __m128i bt=_mm_mullo_epi16(u16,_mm_set1_epi16(kBU));
+    const __m128i gt=_mm_add_epi16(_mm_mullo_epi16(u16,_mm_set1_epi16(kGU)),_mm_mullo_epi16(v16,_mm_set1_epi16(kGV)));
+    const __m128i rt=_mm_mullo_epi16(v16,_mm_set1_epi16(kRV));
+    // each chroma sample covers 2 pixels
+    const __m128i b=_mm_packus_epi16(_mm_srai_epi16(_mm_adds_epi16(ylo,_mm_unpacklo_epi16(bt,bt)),6),
+                                     _mm_srai_epi16(_mm_adds_epi16(yhi,_mm_unpackhi_epi16(bt,bt)),6));
+    const __m128i g=_mm_packus_epi16(_mm_srai_epi16(_mm_subs_epi16(ylo,_mm_unpacklo_epi16(gt,gt)),6),
+                                     _mm_srai_epi16(_mm_subs_epi16(yhi,_mm_unpackhi_epi16(gt,gt)),6));
+    const __m128i r=_mm_packus_epi16(_mm_srai_epi16(_mm_adds_epi16(ylo,_mm_unpacklo_epi16(rt,rt)),6),
+                                     _mm_srai_epi16(_mm_adds_epi16(yhi,_mm_unpackhi_epi16(rt,rt)),6));
+    const __m128i a=_mm_set1_epi8((char)0xFF);
+    const __m128i bg_lo=_mm_unpacklo_epi8(b,g);
+    const __m128i bg_hi=_mm_unpackhi_epi8(b,g);
+    const __m128i ra_lo=_mm_unpacklo_epi8(r,a);
+    const __m128i ra_hi=_mm_unpackhi_epi8(r,a);
+    _mm_storeu_si128((__m128i*)(dst),_mm_unpacklo_epi16(bg_lo,ra_lo));
+    _mm_storeu_si128((__m128i*)(dst+16),_mm_unpackhi_epi16(bg_lo,ra_lo));
+    _mm_storeu_si128((__m128i*)(dst+32),_mm_unpacklo_epi16(bg_hi,ra_hi));
+    _mm_storeu_si128((__m128i*)(dst+48),_mm_unpackhi_epi16(bg_hi,ra_hi));
+}
+
+static void i420_row_sse2(const uint8_t* y,const uint8_t* u,const uint8_t* v,uint8_t* dst,int width){
+    const __m128i zero=_mm_setzero_si128();
+    const __m128i c128=_mm_set1_epi16(128);
+    int x=0;
+    for(;x+16<=width;x+=16){
+        const __m128i yv=_mm_loadu_si128((const __m128i*)(y+x));
+        const __m128i u16=_mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(u+x/2)),zero),c128);
+        const __m128i v16=_mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(v+x/2)),zero),c128);
+        sse2_yuv16_to_bgra(yv,u16,v16,dst+x*4);
+    }
+    i420_row_scalar(y+x,u+x/2,v+x/2,dst+x*4,width-x);
+}
+
+static void nv12_row_sse2(const uint8_t* y,const uint8_t* uv,uint8_t* dst,int width){
+    const __m128i c128=_mm_set1_epi16(128);
+    const __m128i mask_lo=_mm_set1_epi16(0x00FF);
+    int x=0;
+    for(;x+16<=width;x+=16){
+        const __m128i yv=_mm_loadu_si128((const __m128i*)(y+x));
+        const __m128i uvv=_mm_loadu_si128((const __m128i*)(uv+x));
+        const __m128i u16=_mm_sub_epi16(_mm_and_si128(uvv,mask_lo),c128);
+        const __m128i v16=_mm_sub_epi16(_mm_srli_epi16(uvv,8),c128);
+        sse2_yuv16_to_bgra(yv,u16,v16,dst+x*4);
+    }
+    nv12_row_scalar(y+x,uv+x,dst+x*4,width-x);
+}
+#endif //YUV_TO_RGB_HAS_SSE2
+
+#ifdef YUV_TO_RGB_HAS_AVX2
+// Each of the 16 chroma terms twice, for pixel 0-15 (lo) and 16-31 (hi).
+// unpack works per 128 bit lane, permute back into pixel order.
+__attribute__((target("avx2")))
+static inline __m256i avx2_dup_lo(__m256i t){
+    return _mm256_permute2x128_si256(_mm256_unpacklo_epi16(t,t),_mm256_unpackhi_epi16(t,t),0x20);
+}
+__attribute__((target("avx2")))
+static inline __m256i avx2_dup_hi(__m256i t){
+    return _mm256_permute2x128_si256(_mm256_unpacklo_epi16(t,t),_mm256_unpackhi_epi16(t,t),0x31);
+}
+
+// 32 pixels, u16 / v16: 16 chroma samples (already -128) as int16
+__attribute__((target("avx2")))
+static inline void avx2_yuv32_to_bgra(__m128i y_0_15,__m128i y_16_31,__m256i u16,__m256i v16,uint8_t* dst){
+    const __m256i c16=_mm256_set1_epi16(16);
+    const __m256i c32=_mm256_set1_epi16(32);
+    const __m256i cy=_mm256_set1_epi16(kY);
+    __m256i y0=_mm256_cvtepu8_epi16(y_0_15);
+    __m256i y1=_mm256_cvtepu8_epi16(y_16_31);
+    y0=_mm256_add_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(y0,c16),cy),c32);
+    y1=_mm256_add_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(y1,c16),cy),c32);
+    const __m256i bt=_mm256_mullo_epi16(u16,_mm256_set1_epi16(kBU));
+    const __m256i gt=_mm256_add_epi16(_mm256_mullo_epi16(u16,_mm256_set1_epi16(kGU)),_mm256_mullo_epi16(v16,_mm256_set1_epi16(kGV)));
+    const __m256i rt=_mm256_mullo_epi16(v16,_mm256_set1_epi16(kRV));
+    // each chroma sample covers 2 pixels
+    // packus is per lane too: lane 0 == pixel 0-7,16-23 lane 1 == pixel 8-15,24-31
+    const __m256i b=_mm256_packus_epi16(_mm256_srai_epi16(_mm256_adds_epi16(y0,avx2_dup_lo(bt)),6),
+                                        _mm256_srai_epi16(_mm256_adds_epi16(y1,avx2_dup_hi(bt)),6));
+    const __m256i g=_mm256_packus_epi16(_mm256_srai_epi16(_mm256_subs_epi16(y0,avx2_dup_lo(gt)),6),
+                                        _mm256_srai_epi16(_mm256_subs_epi16(y1,avx2_dup_hi(gt)),6));
+    const __m256i r=_mm256_packus_epi16(_mm256_srai_epi16(_mm256_adds_epi16(y0,avx2_dup_lo(rt)),6),
+                                        _mm256_srai_epi16(_mm256_adds_epi16(y1,avx2_dup_hi(rt)),6));
+    const __m256i a=_mm256_set1_epi8((char)0xFF);
+    const __m256i bg_lo=_mm256_unpacklo_epi8(b,g);
+    const __m256i bg_hi=_mm256_unpackhi_epi8(b,g);
+    const __m256i ra_lo=_mm256_unpacklo_epi8(r,a);
+    const __m256i ra_hi=_mm256_unpackhi_epi8(r,a);
+    const __m256i o0=_mm256_unpacklo_epi16(bg_lo,ra_lo); // pixel 0-3, 8-11
+    const __m256i o1=_mm256_unpackhi_epi16(bg_lo,ra_lo); // pixel 4-7, 12-15
+    const __m256i o2=_mm256_unpacklo_epi16(bg_hi,ra_hi); // pixel 16-19, 24-27
+    const __m256i o3=_mm256_unpackhi_epi16(bg_hi,ra_hi); // pixel 20-23, 28-31
+    _mm256_storeu_si256((__m256i*)(dst),_mm256_permute2x128_si256(o0,o1,0x20));
+    _mm256_storeu_si256((__m256i*)(dst+32),_mm256_permute2x128_si256(o0,o1,0x31));
+    _mm256_storeu_si256((__m256i*)(dst+64),_mm256_permute2x128_si256(o2,o3,0x20));
+    _mm256_storeu_si256((__m256i*)(dst+96),_mm256_permute2x128_si256(o2,o3,0x31));
+}
+
+__attribute__((target("avx2")))
+static void i420_row_avx2(const uint8_t* y,const uint8_t* u,const uint8_t* v,uint8_t* dst,int width){
+    const __m256i c128=_mm256_set1_epi16(128);
+    int x=0;
+    for(;x+32<=width;x+=32){
+        const __m256i u16=_mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(u+x/2))),c128);
+        const __m256i v16=_mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(v+x/2))),c128);
+        avx2_yuv32_to_bgra(_mm_loadu_si128((const __m128i*)(y+x)),_mm_loadu_si128((const __m128i*)(y+x+16)),u16,v16,dst+x*4);
+    }
+    i420_row_scalar(y+x,u+x/2,v+x/2,dst+x*4,width-x);
+}
+
+__attribute__((target("avx2")))
+static void nv12_row_avx2(const uint8_t* y,const uint8_t* uv,uint8_t* dst,int width){
+    const __m256i c128=_mm256_set1_epi16(128);
+    const __m256i mask_lo=_mm256_set1_epi16(0x00FF);
+    int x=0;
+    for(;x+32<=width;x+=32){
+        const __m256i uvv=_mm256_loadu_si256((const __m256i*)(uv+x));
+        const __m256i u16=_mm256_sub_epi16(_mm256_and_si256(uvv,mask_lo),c128);
+        const __m256i v16=_mm256_sub_epi16(_mm256_srli_epi16(uvv,8),c128);
+        avx2_yuv32_to_bgra(_mm_loadu_si128((const __m128i*)(y+x)),_mm_loadu_si128((const __m128i*)(y+x+16)),u16,v16,dst+x*4);
+    }
+    nv12_row_scalar(y+x,uv+x,dst+x*4,width-x);
+}
+#endif //YUV_TO_RGB_HAS_AVX2
+
+#ifdef YUV_TO_RGB_HAS_NEON
+// 16 pixels, u16 / v16: 8 chroma samples (already -128) as int16
+static inline void neon_yuv16_to_bgra(uint8x16_t yv,int16x8_t u16,int16x8_t v16,uint8_t* dst){
+    const int16x8_t c16=vdupq_n_s16(16);
+    const int16x8_t c32=vdupq_n_s16(32);
+    int16x8_t ylo=vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(yv)));
+    int16x8_t yhi=vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(yv)));
+    ylo=vaddq_s16(vmulq_n_s16(vsubq_s16(ylo,c16),kY),c32);
+    yhi=vaddq_s16(vmulq_n_s16(vsubq_s16(yhi,c16),kY),c32);
+    // each chroma sample covers 2 pixels
+    const int16x8x2_t bt=vzipq_s16(vmulq_n_s16(u16,kBU),vmulq_n_s16(u16,kBU));
+    const int16x8_t gt_=vaddq_s16(vmulq_n_s16(u16,kGU),vmulq_n_s16(v16,kGV));
+    const int16x8x2_t gt=vzipq_s16(gt_,gt_);
+    const int16x8x2_t rt=vzipq_s16(vmulq_n_s16(v16,kRV),vmulq_n_s16(v16,kRV));
+    uint8x16x4_t out;
+    out.val[0]=vcombine_u8(vqmovun_s16(vshrq_n_s16(vqaddq_s16(ylo,bt.val[0]),6)),vqmovun_s16(vshrq_n_s16(vqaddq_s16(yhi,bt.val[1]),6)));
+    out.val[1]=vcombine_u8(vqmovun_s16(vshrq_n_s16(vqsubq_s16(ylo,gt.val[0]),6)),vqmovun_s16(vshrq_n_s16(vqsubq_s16(yhi,gt.val[1]),6)));
+    out.val[2]=vcombine_u8(vqmovun_s16(vshrq_n_s16(vqaddq_s16(ylo,rt.val[0]),6)),vqmovun_s16(vshrq_n_s16(vqaddq_s16(yhi,rt.val[1]),6)));
+    out.val[3]=vdupq_n_u8(0xFF);
+    vst4q_u8(dst,out);
+}
+
+static void i420_row_neon(const uint8_t* y,const uint8_t* u,const uint8_t* v,uint8_t* dst,int width){
+    const int16x8_t c128=vdupq_n_s16(128);
+    int x=0;
+    for(;x+16<=width;x+=16){
+        const int16x8_t u16=vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(u+x/2))),c128);
+        const int16x8_t v16=vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(v+x/2))),c128);
+        neon_yuv16_to_bgra(vld1q_u8(y+x),u16,v16,dst+x*4);
+    }
+    i420_row_scalar(y+x,u+x/2,v+x/2,dst+x*4,width-x);
+}
+
+static void nv12_row_neon(const uint8_t* y,const uint8_t* uv,uint8_t* dst,int width){
+    const int16x8_t c128=vdupq_n_s16(128);
+    int x=0;
+    for(;x+16<=width;x+=16){
+        const uint8x8x2_t uvv=vld2_u8(uv+x);
+        const int16x8_t u16=vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(uvv.val[0])),c128);
+        const int16x8_t v16=vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(uvv.val[1])),c128);
+        neon_yuv16_to_bgra(vld1q_u8(y+x),u16,v16,dst+x*4);
+    }
+    nv12_row_scalar(y+x,uv+x,dst+x*4,width-x);
+}
+#endif //YUV_TO_RGB_HAS_NEON
+
+std::string kernel_to_string(Kernel kernel)
+{
+    switch(kernel){
+    case Kernel::SCALAR:return "scalar";
+    case Kernel::SSE2:return "SSE2";
+    case Kernel::AVX2:return "AVX2";
+    case Kernel::NEON:return "NEON";
+    }
+    return "?";
+}
+
+std::vector<Kernel> get_supported_kernels()
+{
+    std::vector<Kernel> ret{Kernel::SCALAR};
+#ifdef YUV_TO_RGB_HAS_SSE2
+    ret.push_back(Kernel::SSE2);
+#endif
+#ifdef YUV_TO_RGB_HAS_AVX2
+    if(__builtin_cpu_supports("avx2")){
+        ret.push_back(Kernel::AVX2);
+    }
+#endif
+#ifdef YUV_TO_RGB_HAS_NEON
+    ret.push_back(Kernel::NEON);
+#endif
+    return ret;
+}
+
+Kernel get_best_kernel()
+{
+    return get_supported_kernels().back();
+}
+
+static bool is_supported(Kernel kernel){
+    const auto supported=get_supported_kernels();
+    return std::find(supported.begin(),supported.end(),kernel)!=supported.end();
+}
+
+I420_ROW_FN get_i420_row_fn(Kernel kernel)
+{
+    if(!is_supported(kernel))return i420_row_scalar;
+    switch(kernel){
+#ifdef YUV_TO_RGB_HAS_SSE2
+    case Kernel::SSE2:return i420_row_sse2;
+#endif
+#ifdef YUV_TO_RGB_HAS_AVX2
+    case Kernel::AVX2:return i420_row_avx2;
+#endif
+#ifdef YUV_TO_RGB_HAS_NEON
+    case Kernel::NEON:return i420_row_neon;
+#endif
+    default:return i420_row_scalar;
+    }
+}
+
+NV12_ROW_FN get_nv12_row_fn(Kernel kernel)
+{
+    if(!is_supported(kernel))return nv12_row_scalar;
+    switch(kernel){
+#ifdef YUV_TO_RGB_HAS_SSE2
+    case Kernel::SSE2:return nv12_row_sse2;
+#endif
+#ifdef YUV_TO_RGB_HAS_AVX2
+    case Kernel::AVX2:return nv12_row_avx2;
+#endif
+#ifdef YUV_TO_RGB_HAS_NEON
+    case Kernel::NEON:return nv12_row_neon;
+#endif
+    default:return nv12_row_scalar;
+    }
+}
+
+// dst index -> src index (nearest neighbour, sampled at the pixel center)
+static void create_table(std::vector<int>& table,int dst_size,int src_size){
+    table.resize(dst_size);
+    for(int i=0;i<dst_size;i++){
+        table[i]=std::min((int)(((int64_t)2*i+1)*src_size/(2*(int64_t)dst_size)),src_size-1);
+    }
+}
+
+Converter::Converter(Kernel kernel):
+    m_kernel(is_supported(kernel) ? kernel : Kernel::SCALAR),
+    m_i420_row_fn(get_i420_row_fn(kernel)),
+    m_nv12_row_fn(get_nv12_row_fn(kernel))
+{
+}
+
+void Converter::convert_row(const SrcFrame &src, int src_y, uint8_t *dst)
+{
+    const uint8_t* y=src.data[0]+(size_t)src_y*src.linesize[0];
+    if(src.format==SrcFrame::Format::NV12){
+        const uint8_t* uv=src.data[1]+(size_t)(src_y/2)*src.linesize[1];
+        m_nv12_row_fn(y,uv,dst,src.width);
+    }else{
+        const uint8_t* u=src.data[1]+(size_t)(src_y/2)*src.linesize[1];
+        const uint8_t* v=src.data[2]+(size_t)(src_y/2)*src.linesize[2];
+        m_i420_row_fn(y,u,v,dst,src.width);
+    }
+}
+
+void Converter::convert(const SrcFrame &src, const DstImage &dst, bool rotate_90)
+{
+    if(src.width<=0 || src.height<=0 || dst.width<=0 || dst.height<=0)return;
+    if(rotate_90){
+        convert_rotated_90(src,dst);
+        return;
+    }
+    create_table(m_x_table,dst.width,src.width);
+    create_table(m_y_table,dst.height,src.height);
+    m_row.resize(src.width);
+    // No horizontal scaling - convert straight into the destination
+    const bool same_width=dst.width==src.width;
+    int last_src_y=-1;
+    const uint8_t* last_dst_row=nullptr;
+    for(int dst_y=0;dst_y<dst.height;dst_y++){
+        uint8_t* dst_row=dst.data+(size_t)dst_y*dst.stride;
+        const int src_y=m_y_table[dst_y];
+        if(same_width){
+            if(src_y==last_src_y){
+                std::memcpy(dst_row,last_dst_row,(size_t)dst.width*4);
+            }else{
+                convert_row(src,src_y,dst_row);
+            }
+            last_dst_row=dst_row;
+            last_src_y=src_y;
+            continue;
+        }
+        if(src_y!=last_src_y){
+            convert_row(src,src_y,(uint8_t*)m_row.data());
+            last_src_y=src_y;
+        }
+        uint32_t* out=(uint32_t*)dst_row;
+        for(int dst_x=0;dst_x<dst.width;dst_x++){
+            out[dst_x]=m_row[m_x_table[dst_x]];
+        }
+    }
+}
+
+void Converter::convert_rotated_90(const SrcFrame &src, const DstImage &dst)
+{
+    // Clockwise: each dst column is one src row (bottom row first), each dst row one src column
+    create_table(m_x_table,dst.width,src.height);
+    create_table(m_y_table,dst.height,src.width);
+    m_row.resize(src.width);
+    int last_src_y=-1;
+    for(int dst_x=0;dst_x<dst.width;dst_x++){
+        const int src_y=src.height-1-m_x_table[dst_x];
+        if(src_y!=last_src_y){
+            convert_row(src,src_y,(uint8_t*)m_row.data());
+            last_src_y=src_y;
+        }
+        uint8_t* out=dst.data+(size_t)dst_x*4;
+        for(int dst_y=0;dst_y<dst.height;dst_y++){
+            *(uint32_t*)(out+(size_t)dst_y*dst.stride)=m_row[m_y_table[dst_y]];
+        }
+    }
+}
+
+}
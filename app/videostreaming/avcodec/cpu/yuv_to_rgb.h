@@ -0,0 +1,72 @@
+#ifndef YUV_TO_RGB_H
+#define YUV_TO_RGB_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// CPU conversion of decoded (BT.601, limited range - same as the GL shaders) YUV420P / NV12 frames to 32 bit RGB,
+// for when there is no OpenGL (Qt Software scene graph backend, e.g. -platform linuxfb on headless / VM ground stations).
+// The per row kernels are vectorized (SSE2 / AVX2 on x86, NEON on arm) and give the exact same output as the scalar one.
+namespace yuv_to_rgb{
+
+enum class Kernel{
+    SCALAR=0,
+    SSE2=1,
+    AVX2=2,
+    NEON=3,
+};
+std::string kernel_to_string(Kernel kernel);
+// Kernels that can run on this cpu (always includes SCALAR), fastest one last
+std::vector<Kernel> get_supported_kernels();
+Kernel get_best_kernel();
+
+// Convert one row. Output is B,G,R,0xFF per pixel (QImage::Format_RGB32 on little endian).
+// u,v (I420) have (width+1)/2 samples, uv (NV12) has (width+1)/2 interleaved pairs.
+typedef void (*I420_ROW_FN)(const uint8_t* y,const uint8_t* u,const uint8_t* v,uint8_t* dst,int width);
+typedef void (*NV12_ROW_FN)(const uint8_t* y,const uint8_t* uv,uint8_t* dst,int width);
+I420_ROW_FN get_i420_row_fn(Kernel kernel);
+NV12_ROW_FN get_nv12_row_fn(Kernel kernel);
+
+struct SrcFrame{
+    enum class Format{
+        I420,
+        NV12
+    };
+    Format format=Format::I420;
+    int width=0;
+    int height=0;
+    // I420: y,u,v NV12: y,uv
+    const uint8_t* data[3]={nullptr,nullptr,nullptr};
+    int linesize[3]={0,0,0};
+};
+struct DstImage{
+    uint8_t* data=nullptr;
+    int stride=0;
+    int width=0;
+    int height=0;
+};
+
+// Converts and scales (nearest neighbour) a whole frame into dst, optionally rotated by 90° (clockwise, like the GL path).
+// Only the source rows that end up in dst are converted. Not thread safe, keeps its buffers between frames.
+class Converter{
+public:
+    explicit Converter(Kernel kernel=get_best_kernel());
+    void convert(const SrcFrame& src,const DstImage& dst,bool rotate_90);
+    Kernel get_kernel()const{return m_kernel;}
+private:
+    void convert_row(const SrcFrame& src,int src_y,uint8_t* dst);
+    void convert_rotated_90(const SrcFrame& src,const DstImage& dst);
+    const Kernel m_kernel;
+    const I420_ROW_FN m_i420_row_fn;
+    const NV12_ROW_FN m_nv12_row_fn;
+    // dst -> src index
+    std::vector<int> m_x_table;
+    std::vector<int> m_y_table;
+    // one converted source row
+    std::vector<uint32_t> m_row;
+};
+
+}
+
+#endif // YUV_TO_RGB_H
@@ -0,0 +1,44 @@
+#ifndef DECODE_THREAD_BUDGET_HPP
+#define DECODE_THREAD_BUDGET_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+/**
+ * The sw decoders of the primary and secondary stream share the CPU cores. If the n of decode threads is not set explicitly
+ * (0 == one per core), each running decoder gets an equal share of the cores instead of each one spawning a thread per core.
+ * avcodec owns the (slice / frame) worker threads of each codec context, so this is as close as we get to a shared pool.
+ * Thread safe.
+ */
+class DecodeThreadBudget{
+public:
+    static DecodeThreadBudget& instance(){
+        static DecodeThreadBudget instance{};
+        return instance;
+    }
+    // A decoder is counted for as long as it holds one of these
+    class Registration{
+    public:
+        Registration(){
+            DecodeThreadBudget::instance().m_n_decoders++;
+        }
+        ~Registration(){
+            DecodeThreadBudget::instance().m_n_decoders--;
+        }
+        Registration(const Registration&)=delete;
+        Registration& operator=(const Registration&)=delete;
+    };
+    int get_n_threads_per_decoder()const{
+        const int n_cores=std::max((int)std::thread::hardware_concurrency(),1);
+        const int n_decoders=std::max(m_n_decoders.load(),1);
+        return std::max(n_cores/n_decoders,1);
+    }
+    int get_n_decoders()const{
+        return m_n_decoders;
+    }
+private:
+    std::atomic<int> m_n_decoders{0};
+};
+
+#endif // DECODE_THREAD_BUDGET_HPP
@@ -0,0 +1,200 @@
+//
+// Streaming (asynchronous) texture upload for sw decoded frames via a ring of pixel unpack buffers (PBOs).
+//
+
+#include "gl_pbo_upload.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// Not part of the GLES2 headers - PBOs are GLES3 / desktop GL, we resolve what we need at run time.
+#ifndef GL_PIXEL_UNPACK_BUFFER
+#define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#endif
+#ifndef GL_MAP_WRITE_BIT
+#define GL_MAP_WRITE_BIT 0x0002
+#endif
+#ifndef GL_MAP_INVALIDATE_BUFFER_BIT
+#define GL_MAP_INVALIDATE_BUFFER_BIT 0x0008
+#endif
+
+typedef void* (*PFN_MAP_BUFFER_RANGE)(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+typedef GLboolean (*PFN_UNMAP_BUFFER)(GLenum target);
+static PFN_MAP_BUFFER_RANGE map_buffer_range=nullptr;
+static PFN_UNMAP_BUFFER unmap_buffer=nullptr;
+
+// GL_PIXEL_UNPACK_BUFFER needs OpenGL ES 3.0 (or desktop GL 3.x for glMapBufferRange)
+static bool context_supports_pbo(){
+  const auto tmp=glGetString(GL_VERSION);
+  if(tmp== nullptr)return false;
+  const std::string version((const char*)tmp);
+  const std::string es_prefix="OpenGL ES ";
+  if(version.rfind(es_prefix,0)==0){
+    return std::atoi(version.c_str()+es_prefix.size())>=3;
+  }
+  return std::atoi(version.c_str())>=3;
+}
+
+bool GL_PBOFrameLayout::create(const AVFrame *frame, GL_PBOFrameLayout &out) {
+  out=GL_PBOFrameLayout{};
+  out.format=frame->format;
+  out.width=frame->width;
+  out.height=frame->height;
+  out.pts=frame->pts;
+  if(is_AV_PIX_FMT_YUV42XP(frame->format)){
+    const int uv_width=frame->width/2;
+    const int uv_height=is_AV_PIX_FMT_YUV420P(frame->format) ? frame->height/2 : frame->height;
+    out.n_planes=3;
+    out.plane_width={frame->width,uv_width,uv_width};
+    out.plane_height={frame->height,uv_height,uv_height};
+    out.plane_bytes_per_row=out.plane_width;
+  }else if(is_AV_PIX_FMT_NV12(frame->format)){
+    out.n_planes=2;
+    out.plane_width={frame->width,frame->width/2,0};
+    out.plane_height={frame->height,frame->height/2,0};
+    // U,V interleaved
+    out.plane_bytes_per_row={frame->width,(frame->width/2)*2,0};
+  }else{
+    return false;
+  }
+  size_t offset=0;
+  for(int i=0;i<out.n_planes;i++){
+    out.plane_offset[i]=offset;
+    offset+=(size_t)out.plane_bytes_per_row[i]*out.plane_height[i];
+  }
+  out.total_size=offset;
+  return out.width>0 && out.height>0;
+}
+
+bool GL_PBOUploadRing::init_gl() {
+  if(!context_supports_pbo()){
+    std::cout<<"GL_PBOUploadRing: context does not support PBOs, using synchronous upload\n";
+    m_supported=false;
+    return false;
+  }
+  map_buffer_range=(PFN_MAP_BUFFER_RANGE)eglGetProcAddress("glMapBufferRange");
+  unmap_buffer=(PFN_UNMAP_BUFFER)eglGetProcAddress("glUnmapBuffer");
+  m_supported= map_buffer_range!= nullptr && unmap_buffer!= nullptr;
+  std::cout<<"GL_PBOUploadRing: supported:"<<(m_supported ? "Y":"N")<<"\n";
+  return m_supported;
+}
+
+bool GL_PBOUploadRing::map_slot_gl(Slot &slot, size_t size) {
+  if(slot.pbo==0){
+    glGenBuffers(1,&slot.pbo);
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER,slot.pbo);
+  if(slot.capacity!=size){
+    glBufferData(GL_PIXEL_UNPACK_BUFFER,(GLsizeiptr)size, nullptr,GL_STREAM_DRAW);
+    slot.capacity=size;
+  }
+  // Invalidate - the driver can orphan the storage if a previous upload from this buffer is still in flight
+  slot.mapped=(uint8_t*)map_buffer_range(GL_PIXEL_UNPACK_BUFFER,0,(GLsizeiptr)size,GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER,0);
+  GL_shaders::checkGlError("GL_PBOUploadRing::map_slot_gl");
+  return slot.mapped!= nullptr;
+}
+
+void GL_PBOUploadRing::unmap_slot_gl(Slot &slot) {
+  if(slot.mapped== nullptr)return;
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER,slot.pbo);
+  unmap_buffer(GL_PIXEL_UNPACK_BUFFER);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER,0);
+  slot.mapped=nullptr;
+}
+
+void GL_PBOUploadRing::map_free_slots_gl(size_t slot_size) {
+  if(!m_supported || slot_size==0)return;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for(auto& slot:m_slots){
+    if(slot.state==SlotState::MAPPED && slot.capacity!=slot_size){
+      // frame size changed, re-allocate
+      unmap_slot_gl(slot);
+      slot.state=SlotState::FREE;
+    }
+    if(slot.state==SlotState::FREE){
+      if(map_slot_gl(slot,slot_size)){
+        slot.state=SlotState::MAPPED;
+      }
+    }
+  }
+}
+
+bool GL_PBOUploadRing::try_fill(const AVFrame *frame,int& n_dropped) {
+  n_dropped=0;
+  if(!m_supported)return false;
+  GL_PBOFrameLayout layout;
+  if(!GL_PBOFrameLayout::create(frame,layout))return false;
+  Slot* slot=nullptr;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for(auto& candidate:m_slots){
+      if(candidate.state==SlotState::MAPPED && candidate.capacity>=layout.total_size){
+        slot=&candidate;
+        break;
+      }
+    }
+    if(slot== nullptr)return false;
+    slot->state=SlotState::FILLING;
+  }
+  // The expensive part, done without holding the lock
+  for(int i=0;i<layout.n_planes;i++){
+    const uint8_t* src=frame->data[i];
+    uint8_t* dst=slot->mapped+layout.plane_offset[i];
+    const int row_bytes=layout.plane_bytes_per_row[i];
+    if(frame->linesize[i]==row_bytes){
+      std::memcpy(dst,src,(size_t)row_bytes*layout.plane_height[i]);
+    }else{
+      for(int row=0;row<layout.plane_height[i];row++){
+        std::memcpy(dst+(size_t)row*row_bytes,src+(size_t)row*frame->linesize[i],row_bytes);
+      }
+    }
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  // Drop whatever filled frame the GL thread did not pick up yet, it is still mapped and can be re-used directly
+  for(auto& other:m_slots){
+    if(other.state==SlotState::FILLED){
+      other.state=SlotState::MAPPED;
+      n_dropped++;
+    }
+  }
+  slot->layout=layout;
+  slot->state=SlotState::FILLED;
+  return true;
+}
+
+bool GL_PBOUploadRing::acquire_filled_gl(AcquiredSlot &out) {
+  if(!m_supported)return false;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for(int i=0;i<N_SLOTS;i++){
+    auto& slot=m_slots[i];
+    if(slot.state!=SlotState::FILLED)continue;
+    unmap_slot_gl(slot);
+    slot.state=SlotState::UPLOADING;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER,slot.pbo);
+    out.index=i;
+    out.layout=slot.layout;
+    return true;
+  }
+  return false;
+}
+
+void GL_PBOUploadRing::release_gl(const AcquiredSlot &slot) {
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER,0);
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_slots[slot.index].state=SlotState::FREE;
+}
+
+int GL_PBOUploadRing::discard_filled_gl() {
+  if(!m_supported)return 0;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  int n_discarded=0;
+  for(auto& slot:m_slots){
+    if(slot.state==SlotState::FILLED){
+      slot.state=SlotState::MAPPED;
+      n_discarded++;
+    }
+  }
+  return n_discarded;
+}
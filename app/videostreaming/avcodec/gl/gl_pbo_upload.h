@@ -0,0 +1,91 @@
+//
+// Streaming (asynchronous) texture upload for sw decoded frames via a ring of pixel unpack buffers (PBOs).
+//
+
+#ifndef HELLO_DRMPRIME__GL_PBO_UPLOAD_H_
+#define HELLO_DRMPRIME__GL_PBO_UPLOAD_H_
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include "avcodec_helper.hpp"
+#include "gl_shaders.h"
+
+// Layout of a (sw) video frame inside a PBO slot.
+// Each plane is tightly packed (row length == plane width), such that no GL_UNPACK_ROW_LENGTH is needed on upload.
+struct GL_PBOFrameLayout{
+  int format=-1;
+  int width=0;
+  int height=0;
+  int n_planes=0;
+  // width and height of each plane in texels (GL_LUMINANCE for Y,U,V / GL_LUMINANCE_ALPHA for the interleaved NV12 UV plane)
+  std::array<int,3> plane_width{};
+  std::array<int,3> plane_height{};
+  std::array<int,3> plane_bytes_per_row{};
+  // offset of each plane from the beginning of the buffer
+  std::array<size_t,3> plane_offset{};
+  size_t total_size=0;
+  int64_t pts=0;
+  // Returns false if the frame has a format we cannot upload via PBO (e.g. HW frames)
+  static bool create(const AVFrame* frame,GL_PBOFrameLayout& out);
+};
+
+// Ring of PBOs, the CPU copy from the decoded frame into (mapped) PBO memory is done on the decoder thread
+// and the render thread only has to unmap the buffer and issue glTexSubImage2D (which is a GPU side copy).
+// Frames are never queued - if the render thread did not pick up a filled slot yet when a newer frame is filled,
+// the older one is dropped (same behaviour as the "latest frame" in the texture renderer).
+// PBOs / glMapBufferRange are core in OpenGL ES 3.0 / OpenGL 3.0 but not in GLES2 - the map functions are resolved at run time
+// and if they are not available (or the frame does not fit into a slot) the caller has to use the synchronous path.
+class GL_PBOUploadRing{
+ public:
+  static constexpr int N_SLOTS=3;
+  // A filled slot acquired by the render thread, bound to GL_PIXEL_UNPACK_BUFFER until release_gl() is called.
+  struct AcquiredSlot{
+    int index=-1;
+    GL_PBOFrameLayout layout{};
+  };
+  // Needs to be called on the GL thread. Returns false if PBOs are not supported by the current context
+  // (in which case all the other calls are no-ops).
+  bool init_gl();
+  // GL thread. Make sure all slots that are not in use by either thread are mapped and have (at least) the given size,
+  // such that the decoder thread can fill them.
+  void map_free_slots_gl(size_t slot_size);
+  // Any thread (decoder). Copies the frame into a mapped slot. Returns false if the frame cannot go the PBO path
+  // (not supported, no mapped slot available or too big) - the frame should then be uploaded synchronously.
+  // n_dropped: n of filled frames the render thread did not pick up yet and that were dropped in favour of this one.
+  bool try_fill(const AVFrame* frame,int& n_dropped);
+  // GL thread. Returns true if there is a filled slot, unmaps it and binds it as GL_PIXEL_UNPACK_BUFFER.
+  bool acquire_filled_gl(AcquiredSlot& out);
+  // GL thread. Unbinds the slot after glTexSubImage2D has been issued, the slot is re-mapped on the next map_free_slots_gl
+  void release_gl(const AcquiredSlot& slot);
+  // GL thread. Filled slots are stale (e.g. a newer frame came through the synchronous path), give them back to the decoder.
+  int discard_filled_gl();
+  bool is_supported()const{return m_supported;}
+ private:
+  enum class SlotState{
+    // not mapped, owned by the GL thread
+    FREE,
+    // mapped, can be filled by the decoder thread
+    MAPPED,
+    // decoder thread is copying into the mapped memory
+    FILLING,
+    // mapped and filled, waiting for the GL thread
+    FILLED,
+    // unmapped and bound by the GL thread for upload
+    UPLOADING,
+  };
+  struct Slot{
+    GLuint pbo=0;
+    size_t capacity=0;
+    uint8_t* mapped=nullptr;
+    SlotState state=SlotState::FREE;
+    GL_PBOFrameLayout layout{};
+  };
+  bool map_slot_gl(Slot& slot,size_t size);
+  void unmap_slot_gl(Slot& slot);
+  bool m_supported=false;
+  std::mutex m_mutex;
+  std::array<Slot,N_SLOTS> m_slots{};
+};
+
+#endif //HELLO_DRMPRIME__GL_PBO_UPLOAD_H_
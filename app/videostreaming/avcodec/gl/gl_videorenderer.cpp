@@ -47,24 +47,43 @@ void GL_VideoRenderer::init_gl() {
     gl_shaders->initialize();
 }
 
+// Textures are allocated once (and whenever the video size changes), each new frame is then uploaded with glTexSubImage2D
+// which avoids re-specifying the texture storage (and the driver having to allocate / orphan it) on every frame.
+static void upload_plane_gl(GLuint& texture,int& allocated_width,int& allocated_height,const GLenum format,
+                            const int width,const int height,const GLint filter,const void* data){
+    if (texture == 0) {
+        glGenTextures(1, &texture);
+    }
+    glBindTexture(GL_TEXTURE_2D, texture);
+    if (allocated_width != width || allocated_height != height) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        allocated_width = width;
+        allocated_height = height;
+    } else {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, GL_UNSIGNED_BYTE, data);
+    }
+}
+
 // https://stackoverflow.com/questions/9413845/ffmpeg-avframe-to-opengl-texture-without-yuv-to-rgb-soft-conversion
 // https://bugfreeblog.duckdns.org/2022/01/yuv420p-opengl-shader-conversion.html
 // https://stackoverflow.com/questions/30191911/is-it-possible-to-draw-yuv422-and-yuv420-texture-using-opengl
 void GL_VideoRenderer::update_texture_yuv420P_yuv422P(AVFrame* frame) {
     assert(frame != nullptr);
     assert(is_AV_PIX_FMT_YUV42XP(frame->format));
-    const GLuint frame_width = frame->width;
-    const GLuint frame_height = frame->height;
+    const int frame_width = frame->width;
+    const int frame_height = frame->height;
     // Both 420 and 422 have half width
-    const GLuint uv_width = frame_width/2;
+    const int uv_width = frame_width/2;
     // 420 has half height, 422 has full height
-    const GLuint uv_height = is_AV_PIX_FMT_YUV420P(frame->format) ? frame_height/2 : frame_height;
-    GLuint widths[3] = {
+    const int uv_height = is_AV_PIX_FMT_YUV420P(frame->format) ? frame_height/2 : frame_height;
+    const int widths[3] = {
         frame_width,
         uv_width,
         uv_width
     };
-    GLuint heights[3] = {
+    const int heights[3] = {
         frame_height,
         uv_height,
         uv_height
@@ -74,22 +93,16 @@ void GL_VideoRenderer::update_texture_yuv420P_yuv422P(AVFrame* frame) {
     glGetIntegerv(GL_UNPACK_ROW_LENGTH, &gl_unpack_row_length_before);
     int gl_unpack_alignment_before = 0;
     glGetIntegerv(GL_UNPACK_ALIGNMENT, &gl_unpack_alignment_before);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     for (int i = 0; i < 3; i++) {
-        if (yuv_420_p_sw_frame_texture.textures[i] == 0) {
-            glGenTextures(1, &yuv_420_p_sw_frame_texture.textures[i]);
-        }
-
-        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-        glBindTexture(GL_TEXTURE_2D, yuv_420_p_sw_frame_texture.textures[i]);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
         glPixelStorei(GL_UNPACK_ROW_LENGTH, frame->linesize[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, widths[i], heights[i], 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, frame->data[i]);
+        upload_plane_gl(yuv_420_p_sw_frame_texture.textures[i],
+                        yuv_420_p_sw_frame_texture.allocated_width[i], yuv_420_p_sw_frame_texture.allocated_height[i],
+                        GL_LUMINANCE, widths[i], heights[i], GL_NEAREST, frame->data[i]);
     }
     glPixelStorei(GL_UNPACK_ROW_LENGTH, gl_unpack_row_length_before);
     glPixelStorei(GL_UNPACK_ALIGNMENT, gl_unpack_alignment_before);
     glBindTexture(GL_TEXTURE_2D, 0);
-    GL_shaders::checkGlError("upload YUV420P");
     yuv_420_p_sw_frame_texture.has_valid_image = true;
     GL_shaders::checkGlError("upload YUV420P");
 }
@@ -97,15 +110,15 @@ void GL_VideoRenderer::update_texture_yuv420P_yuv422P(AVFrame* frame) {
 void GL_VideoRenderer::update_texture_nv12(AVFrame* frame) {
     assert(frame != nullptr);
     assert(is_AV_PIX_FMT_NV12(frame->format));
-    const GLuint frame_width = frame->width;
-    const GLuint frame_height = frame->height;
-    const GLuint uv_width = frame_width/2;
-    const GLuint uv_height = frame_height/2;
-    GLuint widths[2] = {
+    const int frame_width = frame->width;
+    const int frame_height = frame->height;
+    const int uv_width = frame_width/2;
+    const int uv_height = frame_height/2;
+    const int widths[2] = {
         frame_width,
         uv_width,
     };
-    GLuint heights[2] = {
+    const int heights[2] = {
         frame_height,
         uv_height,
     };
@@ -115,35 +128,61 @@ void GL_VideoRenderer::update_texture_nv12(AVFrame* frame) {
     glGetIntegerv(GL_UNPACK_ROW_LENGTH, &gl_unpack_row_length_before);
     int gl_unpack_alignment_before = 0;
     glGetIntegerv(GL_UNPACK_ALIGNMENT, &gl_unpack_alignment_before);
-
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     for (int i = 0; i < 2; i++) {
-        if (nv12_frametexture.textures[i] == 0) {
-            glGenTextures(1, &nv12_frametexture.textures[i]);
-        }
-
-        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-        glBindTexture(GL_TEXTURE_2D, nv12_frametexture.textures[i]);
         if (i == 1) {
             glPixelStorei(GL_UNPACK_ROW_LENGTH, frame->linesize[i]/2);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE_ALPHA, widths[i], heights[i], 0, GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, frame->data[i]);
+            upload_plane_gl(nv12_frametexture.textures[i],
+                            nv12_frametexture.allocated_width[i], nv12_frametexture.allocated_height[i],
+                            GL_LUMINANCE_ALPHA, widths[i], heights[i], GL_LINEAR, frame->data[i]);
         } else {
             glPixelStorei(GL_UNPACK_ROW_LENGTH, frame->linesize[i]);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, widths[i], heights[i], 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, frame->data[i]);
+            upload_plane_gl(nv12_frametexture.textures[i],
+                            nv12_frametexture.allocated_width[i], nv12_frametexture.allocated_height[i],
+                            GL_LUMINANCE, widths[i], heights[i], GL_NEAREST, frame->data[i]);
         }
     }
     glPixelStorei(GL_UNPACK_ROW_LENGTH, gl_unpack_row_length_before);
     glPixelStorei(GL_UNPACK_ALIGNMENT, gl_unpack_alignment_before);
     glBindTexture(GL_TEXTURE_2D, 0);
-
-    GL_shaders::checkGlError("upload NV12");
     nv12_frametexture.has_valid_image = true;
     GL_shaders::checkGlError("upload NV12");
 }
 
+void GL_VideoRenderer::update_texture_from_pbo_gl(const GL_PBOFrameLayout& layout) {
+    mark_all_video_textures_as_without();
+    _current_video_width = layout.width;
+    _current_video_height = layout.height;
+    int gl_unpack_row_length_before = 0;
+    glGetIntegerv(GL_UNPACK_ROW_LENGTH, &gl_unpack_row_length_before);
+    int gl_unpack_alignment_before = 0;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &gl_unpack_alignment_before);
+    // The planes are tightly packed inside the PBO
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    // With a PBO bound, the data pointer is an offset into the buffer
+    if (is_AV_PIX_FMT_NV12(layout.format)) {
+        for (int i = 0; i < 2; i++) {
+            upload_plane_gl(nv12_frametexture.textures[i],
+                            nv12_frametexture.allocated_width[i], nv12_frametexture.allocated_height[i],
+                            i == 1 ? GL_LUMINANCE_ALPHA : GL_LUMINANCE, layout.plane_width[i], layout.plane_height[i],
+                            i == 1 ? GL_LINEAR : GL_NEAREST, (const void*)layout.plane_offset[i]);
+        }
+        nv12_frametexture.has_valid_image = true;
+    } else {
+        for (int i = 0; i < 3; i++) {
+            upload_plane_gl(yuv_420_p_sw_frame_texture.textures[i],
+                            yuv_420_p_sw_frame_texture.allocated_width[i], yuv_420_p_sw_frame_texture.allocated_height[i],
+                            GL_LUMINANCE, layout.plane_width[i], layout.plane_height[i], GL_NEAREST, (const void*)layout.plane_offset[i]);
+        }
+        yuv_420_p_sw_frame_texture.has_valid_image = true;
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, gl_unpack_row_length_before);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, gl_unpack_alignment_before);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    GL_shaders::checkGlError("upload from PBO");
+}
+
 // Also https://code.videolan.org/videolan/vlc/-/blob/master/modules/video_output/opengl/importer.c#L414-417
 bool GL_VideoRenderer::update_texture_egl_external(AVFrame* frame) {
     assert(frame);
@@ -9,6 +9,7 @@
 #include <vector>
 #include "avcodec_helper.hpp"
 #include "gl_shaders.h"
+#include "gl_pbo_upload.h"
 
 struct EGLFrameTexture{
   // I think we need to keep the av frame reference around as long as we use the generated egl texture in opengl.
@@ -24,6 +25,9 @@ struct NV12FrameTexture {
     // Since we memcpy with cuda, we do not need to keep the av_frame around
     //AVFrame* av_frame=nullptr;
     GLuint textures[2]={0,0};
+    // Storage is only (re) specified when the size changes, otherwise we use glTexSubImage2D
+    int allocated_width[2]={0,0};
+    int allocated_height[2]={0,0};
     bool has_valid_image=false;
 };
 
@@ -31,6 +35,9 @@ struct YUV420PSwFrameTexture {
     // Since we copy the data, we do not need to keep the av frame around
     //AVFrame* av_frame=nullptr;
     GLuint textures[3] = {0,0,0};
+    // Storage is only (re) specified when the size changes, otherwise we use glTexSubImage2D
+    int allocated_width[3]={0,0,0};
+    int allocated_height[3]={0,0,0};
     bool has_valid_image = false;
 };
 
@@ -41,6 +48,8 @@ public:
   // MUST BE ! called from the gl thread, update the appropriate texture type with a new video frame
   // (The old one will be freed if still around).
   void update_texture_gl(AVFrame* frame);
+  // MUST BE ! called from the gl thread, with the PBO holding the frame (see GL_PBOUploadRing) bound as GL_PIXEL_UNPACK_BUFFER.
+  void update_texture_from_pbo_gl(const GL_PBOFrameLayout& layout);
   // draw the latest updated video texture (or the alternating colors if no video texture is set)
   void draw_texture_gl(bool dev_draw_alternating_rgb_dummy_frames,int rotation_degree);
   // clean up any remaining frame(s) stuck in opengl
@@ -14,6 +14,7 @@
 
 #include "texturerenderer.h"
 #include "decodingstatistcs.h"
+#include "FrameLatencyTracer.hpp"
 #include "ExternalDecodeService.hpp"
 
 MppDecoder::MppDecoder(QObject *parent) : QObject(parent) {
@@ -23,24 +24,26 @@ MppDecoder::~MppDecoder() {
     terminate();
 }
 
-void MppDecoder::init(bool /*primaryStream*/)
+void MppDecoder::init(bool primaryStream)
 {
     qDebug() << "MppDecoder::init()";
+    _is_primary = primaryStream;
     _last_video_settings = QOpenHDVideoHelper::read_config_from_settings();
     _decode_thread = std::make_unique<std::thread>([this]{
         this->constant_decode();
     });
 
-    timer_check_settings_changed = std::make_unique<QTimer>();
-    QObject::connect(timer_check_settings_changed.get(), &QTimer::timeout, this, &MppDecoder::timer_check_settings_changed_callback);
-    timer_check_settings_changed->start(1000);
+    _settings_subscription_id = SettingsCache::instance().subscribe([this](const QString&){
+        this->on_setting_changed();
+    });
 }
 
 void MppDecoder::terminate()
 {
-    // Stop the timer, which can be done (almost) immediately (it's runnable doesn't block)
-    timer_check_settings_changed->stop();
-    timer_check_settings_changed = nullptr;
+    if (_settings_subscription_id >= 0) {
+        SettingsCache::instance().unsubscribe(_settings_subscription_id);
+        _settings_subscription_id = -1;
+    }
     // This will stop the constant_decode as soon as the current running decode_until_error loop returns
     _should_terminate = true;
     // This will break out of a running "decode until error" loop if there is one currently running
@@ -51,9 +54,10 @@ void MppDecoder::terminate()
     }
 }
 
-void MppDecoder::timer_check_settings_changed_callback()
+void MppDecoder::on_setting_changed()
 {
     const auto new_settings = QOpenHDVideoHelper::read_config_from_settings();
+    std::lock_guard<std::mutex> lock(_last_video_settings_mutex);
     if (_last_video_settings != new_settings) {
         // We just request a restart from the video (break out of the current constant_decode() loop,
         // and restart with the new settings.
@@ -76,7 +80,7 @@ void MppDecoder::constant_decode()
     }
 }
 
-int MppDecoder::decode_and_wait_for_frame(std::shared_ptr<NALUBuffer> nalu_buffer, std::optional<std::chrono::steady_clock::time_point> parse_time)
+int MppDecoder::decode_and_wait_for_frame(const NALUBuffer& nalu_buffer, std::optional<std::chrono::steady_clock::time_point> parse_time)
 {
     if (parse_time != std::nullopt) {
         const auto delay = std::chrono::steady_clock::now() - parse_time.value();
@@ -89,8 +93,8 @@ int MppDecoder::decode_and_wait_for_frame(std::shared_ptr<NALUBuffer> nalu_buffe
     MppCtx ctx  = _dec_data.ctx;
     MppApi *mpi = _dec_data.mpi;
 
-    uint8_t *data = (uint8_t*)nalu_buffer->get_nal().getData();
-    int32_t size = nalu_buffer->get_nal().getSize();
+    uint8_t *data = (uint8_t*)nalu_buffer.get_nal().getData();
+    int32_t size = nalu_buffer.get_nal().getSize();
 
     //use current time as pts to calc decoder latency
     const auto beforeFeedFrameUs = getTimeUs();
@@ -101,6 +105,7 @@ int MppDecoder::decode_and_wait_for_frame(std::shared_ptr<NALUBuffer> nalu_buffe
     mpp_packet_set_length(mpp_packet, size);
     mpp_packet_set_pts(mpp_packet, beforeFeedFrameUs);
     mpp_packet_set_dts(mpp_packet, beforeFeedFrameUs);
+    if (_is_primary) FrameLatencyTracer::instance().mark_sent_to_decoder(nalu_buffer.get_nal().rtp_timestamp, beforeFeedFrameUs);
 
 //    qDebug() << "put packet pts" << beforeFeedFrameUs;
     MPP_RET ret = mpi->decode_put_packet(ctx, mpp_packet);
@@ -356,6 +361,18 @@ try_again:
 
 void MppDecoder::on_new_frame(AVFrame *frame)
 {
+    _last_frame_time = std::chrono::steady_clock::now();
+    if (_is_primary) FrameLatencyTracer::instance().mark_by_pts(frame->pts, FrameLatencyTracer::DECODED);
+    if (!_first_frame_after_start_reported) {
+        DecodingStatistcs::instance().util_set_time_to_first_frame(_last_frame_time - _decode_start_time, _n_primed_frames);
+        _first_frame_after_start_reported = true;
+    }
+    if (_switch_pending) {
+        const auto gap = _last_frame_time - _switch_gap_begin;
+        qDebug() << "Decoder re-configured, gap:" << MyTimeHelper::R(gap).c_str();
+        DecodingStatistcs::instance().util_set_decoder_switch_gap(gap, frame->width, frame->height);
+        _switch_pending = false;
+    }
     {
         std::stringstream ss;
         ss<<safe_av_get_pix_fmt_name((AVPixelFormat)frame->format)<<" "<<frame->width<<"x"<<frame->height;
@@ -372,8 +389,8 @@ void MppDecoder::on_new_frame(AVFrame *frame)
     } else {
         if (_last_frame_width != frame->width || _last_frame_height != frame->height) {
             // if the width/ height changes during RTP streaming
-            qDebug()<<"Need to restart the decoder, width / heght changed";
-            _request_restart = true;
+            qDebug()<<"Need to re-configure the decoder, width / heght changed";
+            _request_reconfigure = true;
         }
     }
 }
@@ -385,11 +402,29 @@ void MppDecoder::reset_before_decode_start()
     DecodingStatistcs::instance().reset_all_to_default();
     _last_frame_width = -1;
     _last_frame_height = -1;
+    _n_primed_frames = 0;
+    _first_frame_after_start_reported = false;
+    _request_reconfigure = false;
+    _switch_pending = false;
+}
+
+void MppDecoder::begin_reconfigure_in_place()
+{
+    qDebug() << "Config changed during decode, re-configure decoder";
+    // The gap is measured from the last frame with the old config until the first frame with the new config
+    _switch_gap_begin = _last_frame_width == -1 ? std::chrono::steady_clock::now() : _last_frame_time;
+    _switch_pending = true;
+    _request_reconfigure = false;
+    // Drop everything mpp still holds from the old config
+    _dec_data.mpi->reset(_dec_data.ctx);
+    _last_frame_width = -1;
+    _last_frame_height = -1;
 }
 
 // https://ffmpeg.org/doxygen/3.3/decode_video_8c-example.html
 void MppDecoder::open_and_decode_until_error(const QOpenHDVideoHelper::VideoStreamConfig &settings)
 {
+    _decode_start_time = std::chrono::steady_clock::now();
     bool ret = init_mpp_decoder();
     assert(ret);
 
@@ -400,10 +435,7 @@ void MppDecoder::open_and_decode_until_error(const QOpenHDVideoHelper::VideoStre
     SchedulingHelper::setThreadParamsMaxRealtime();
 
     qDebug() << "MppDecoder::open_and_decode_until_error_custom_rtp()-begin loop";
-    _rtp_receiver = std::make_unique<RTPReceiver>(stream_config.udp_rtp_input_port,
-                                                  stream_config.udp_rtp_input_ip_address,
-                                                  stream_config.video_codec == 1,
-                                                  settings.generic.dev_feed_incomplete_frames_to_decoder);
+    create_or_reuse_rtp_receiver(settings);
 
      reset_before_decode_start();
      DecodingStatistcs::instance().set_decoding_type("HW");
@@ -416,32 +448,65 @@ void MppDecoder::open_and_decode_until_error(const QOpenHDVideoHelper::VideoStre
              _request_restart = false;
              goto finish;
          }
-         // or the decode config changed and we need a restart
-         if (_rtp_receiver->config_has_changed_during_decode) {
-             qDebug()<<"Break/Restart,config has changed during decode";
-             goto finish;
-         }         auto buf = _rtp_receiver->get_next_frame(std::chrono::milliseconds(kDefaultFrameTimeout));
-         if (buf == nullptr) {
-             // No buff after X seconds
+         // or the decode config (e.g. the resolution) changed - mpp handles the info change itself,
+         // we just need to reset it and feed the new config data
+         if (has_config_data && (_rtp_receiver->config_has_changed_during_decode || _request_reconfigure)) {
+             begin_reconfigure_in_place();
+             has_config_data = false;
              continue;
          }
          if (!has_config_data) {
               std::shared_ptr<std::vector<uint8_t>> keyframe_buf = _rtp_receiver->get_config_data();
               if(keyframe_buf==nullptr){
-                  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                  // Poll more often when switching, the new config data is usually just a few ms away
+                  std::this_thread::sleep_for(_switch_pending ? std::chrono::milliseconds(5) : std::chrono::milliseconds(100));
                   continue;
               }
               qDebug()<<"Decode config data";
               decode_config_data(keyframe_buf);
               has_config_data=true;
+              prime_decoder_from_gop_cache();
               continue;
-         }else{
-            decode_and_wait_for_frame(buf, buf->get_nal().creationTime);
          }
+         auto buf = _rtp_receiver->get_next_frame(std::chrono::milliseconds(kDefaultFrameTimeout));
+         if (!buf.has_value()) {
+             // No buff after X seconds
+             continue;
+         }
+         decode_and_wait_for_frame(buf.value(), buf->get_nal().creationTime);
      }
 finish:
      qDebug()<<"MppDecoder::open_and_decode_until_error_custom_rtp()-end loop";
-     _rtp_receiver = nullptr;
+     // NOTE: The rtp receiver (and its GOP cache) is kept alive for the next decode start
+}
+
+void MppDecoder::create_or_reuse_rtp_receiver(const QOpenHDVideoHelper::VideoStreamConfig &settings)
+{
+    const auto& stream_config = settings.primary_stream_config;
+    const bool is_h265 = stream_config.video_codec == QOpenHDVideoHelper::VideoCodecH265;
+    if (_rtp_receiver != nullptr && _rtp_receiver->is_same_config(stream_config.udp_rtp_input_port,
+                                                                  stream_config.udp_rtp_input_ip_address,
+                                                                  is_h265, settings.generic)) {
+        qDebug() << "Re-using rtp receiver";
+        return;
+    }
+    // Close the old one first, it is bound to the same port
+    _rtp_receiver = nullptr;
+    _rtp_receiver = std::make_unique<RTPReceiver>(stream_config.udp_rtp_input_port,
+                                                  stream_config.udp_rtp_input_ip_address,
+                                                  is_h265,
+                                                  settings.generic);
+}
+
+void MppDecoder::prime_decoder_from_gop_cache()
+{
+    auto frames = _rtp_receiver->get_gop_cache_for_decoder_start();
+    if (frames.empty()) return;
+    qDebug() << "Priming decoder with" << (int)frames.size() << "cached frames";
+    _n_primed_frames = (int)frames.size();
+    for (const auto& frame : frames) {
+        decode_and_wait_for_frame(frame);
+    }
 }
 
 bool MppDecoder::decode_config_data(std::shared_ptr<std::vector<uint8_t>> config_data) {
@@ -56,6 +56,8 @@ public:
     void terminate();
 private:
     std::unique_ptr<std::thread> _decode_thread = nullptr;
+    // Only the primary stream feeds the FrameLatencyTracer (rtp timestamps of two streams can collide)
+    bool _is_primary = true;
 private:
     // The logic of this decode "machine" is simple:
     // Start decoding as soon as enough config data has been received
@@ -68,7 +70,7 @@ private:
     // This will stop performing the lockstep. In this case, either the decoder cannot decode
     // the video without buffering (which is bad, but some IP camera(s) create such a stream)
     // or the underlying decode implementation (e.g. rpi foundation h264 !? investigate) has some quirks.
-    int decode_and_wait_for_frame(std::shared_ptr<NALUBuffer> nalu_buffer, std::optional<std::chrono::steady_clock::time_point> parse_time=std::nullopt);
+    int decode_and_wait_for_frame(const NALUBuffer& nalu_buffer, std::optional<std::chrono::steady_clock::time_point> parse_time=std::nullopt);
     // Just send data to the codec, do not check or wait for a frame
     bool decode_config_data(std::shared_ptr<std::vector<uint8_t>> config_data);
     // Called every time we get a new frame from the decoder, do what you wish here ;)
@@ -78,21 +80,35 @@ private:
     std::atomic<bool> _request_restart = false;
     // Completely stop (Exit QOpenHD)
     bool _should_terminate=false;
-    AvgCalculator avg_decode_time{"Decode"};
-    AvgCalculator avg_parse_time{"Parse&Enqueue"};
+    LatencyHistogram avg_decode_time{"Decode"};
+    LatencyHistogram avg_parse_time{"Parse&Enqueue"};
     static constexpr std::chrono::milliseconds kDefaultFrameTimeout{33*2};
 private:
-    // Completely ineficient, but only way since QT settings callback(s) don't properly work
-    // runs every 1 second, reads the settings and checks if they differ from the previosly
-    // read settings. In case they differ, request a complete restart from the decoder.
-    std::unique_ptr<QTimer> timer_check_settings_changed = nullptr;
-    void timer_check_settings_changed_callback();
+    // Called by the SettingsCache whenever any setting changed, re-reads the video settings (cheap, cached) and
+    // requests a complete restart from the decoder if they differ from the previously read settings.
+    void on_setting_changed();
+    int _settings_subscription_id = -1;
+    // the settings cache notifies on the thread that changed the setting
+    std::mutex _last_video_settings_mutex;
     QOpenHDVideoHelper::VideoStreamConfig _last_video_settings;
 private:
     int _last_frame_width = -1;
     int _last_frame_height = -1;
 private:
     std::unique_ptr<RTPReceiver> _rtp_receiver = nullptr;
+    // The rtp receiver survives decoder restarts unless the stream config changed
+    void create_or_reuse_rtp_receiver(const QOpenHDVideoHelper::VideoStreamConfig &settings);
+    // Feed everything since the last keyframe (if cached) right after the config data, such that we get an image immediately
+    void prime_decoder_from_gop_cache();
+    // In place re-configure on a config / resolution change, the rtp receiver and the renderer are kept alive.
+    void begin_reconfigure_in_place();
+    bool _request_reconfigure = false;
+    bool _switch_pending = false;
+    std::chrono::steady_clock::time_point _switch_gap_begin;
+    std::chrono::steady_clock::time_point _last_frame_time;
+    std::chrono::steady_clock::time_point _decode_start_time;
+    bool _first_frame_after_start_reported = false;
+    int _n_primed_frames = 0;
 private:
     // Custom rtp parse (and therefore limited to h264 and h265)
     // And always goes the mpp decode route.
@@ -0,0 +1,202 @@
+#ifndef PRESENTATION_SCHEDULER_HPP
+#define PRESENTATION_SCHEDULER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "avcodec_helper.hpp"
+
+/**
+ * Decides which decoded frame to present on each display refresh.
+ * The (Qt) render loop is throttled by the swap, which means it runs at the display refresh rate and its
+ * timestamps give us both the refresh interval and the vsync phase.
+ * Decoded frames are held in a tiny queue, on each refresh we pick the newest frame that is "due" and drop the older ones.
+ * LOWEST_LATENCY: every queued frame is due - the newest one is always shown (same as just keeping the latest frame).
+ * SMOOTH: we track the (circular) mean phase of the frame arrivals relative to vsync and only present a frame once it has
+ * been queued for long enough that arrival jitter cannot move it between two refreshes. Adds less than one refresh
+ * interval of latency, but e.g. 60fps video on a 60Hz panel then shows each frame for exactly one refresh instead of
+ * randomly dropping / repeating frames whenever a frame arrives close to the vsync.
+ * Thread safe (frames are enqueued on the decoder thread and picked up on the GL thread).
+ */
+class PresentationScheduler{
+public:
+    enum class Mode{
+        LOWEST_LATENCY=0,
+        SMOOTH=1,
+    };
+    static constexpr size_t MAX_QUEUE_SIZE=3;
+    struct Result{
+        // nullptr if there is no new frame for this refresh (the previous one is shown again)
+        AVFrame* frame=nullptr;
+        // time the presented frame spent in the queue
+        std::chrono::steady_clock::duration residency{0};
+        // older frames that were skipped in favour of the presented one
+        int n_dropped=0;
+    };
+    ~PresentationScheduler(){
+        clear();
+        for(auto frame:m_free_frames){
+            av_frame_free(&frame);
+        }
+    }
+    void set_mode(Mode mode){
+        m_mode=mode;
+    }
+    Mode get_mode()const{
+        return m_mode;
+    }
+    // Decoder thread. Queues a new reference to the given frame. n_dropped: n of (old) frames that had to be dropped
+    // since the queue was full. Returns 0 on success, an AVERROR otherwise.
+    int enqueue(AVFrame* src_frame,int& n_dropped){
+        n_dropped=0;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        AVFrame* frame=nullptr;
+        if(!m_free_frames.empty()){
+            // re-use the frame (not its data) instead of allocating a new one
+            frame=m_free_frames.back();
+            m_free_frames.pop_back();
+        }else{
+            frame=av_frame_alloc();
+        }
+        if(frame==nullptr)return AVERROR(ENOMEM);
+        if(av_frame_ref(frame,src_frame)!=0){
+            av_frame_free(&frame);
+            return AVERROR(EINVAL);
+        }
+        while(m_queue.size()>=MAX_QUEUE_SIZE){
+            recycle_locked(m_queue.front().frame);
+            m_queue.pop_front();
+            n_dropped++;
+        }
+        const auto now=std::chrono::steady_clock::now();
+        m_queue.push_back(QueuedFrame{frame,now});
+        update_arrival_phase(now);
+        return 0;
+    }
+    // GL thread, once per rendered frame (refresh).
+    Result on_render(const std::chrono::steady_clock::time_point now){
+        std::lock_guard<std::mutex> lock(m_mutex);
+        update_refresh_estimate(now);
+        Result ret{};
+        if(m_queue.empty())return ret;
+        const auto min_age=get_min_age();
+        // newest frame that is due
+        int due=-1;
+        for(int i=(int)m_queue.size()-1;i>=0;i--){
+            if(now-m_queue[i].arrival>=min_age){
+                due=i;
+                break;
+            }
+        }
+        if(due<0)return ret;
+        for(int i=0;i<due;i++){
+            recycle_locked(m_queue.front().frame);
+            m_queue.pop_front();
+            ret.n_dropped++;
+        }
+        ret.frame=m_queue.front().frame;
+        ret.residency=now-m_queue.front().arrival;
+        m_queue.pop_front();
+        return ret;
+    }
+    // Any thread. Give a presented frame back once it is no longer needed.
+    void recycle(AVFrame* frame){
+        std::lock_guard<std::mutex> lock(m_mutex);
+        recycle_locked(frame);
+    }
+    // Any thread. Drop all queued frames, returns n of dropped frames.
+    int clear(){
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const int ret=(int)m_queue.size();
+        for(auto& queued:m_queue){
+            recycle_locked(queued.frame);
+        }
+        m_queue.clear();
+        return ret;
+    }
+    std::chrono::nanoseconds get_refresh_interval(){
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_refresh_interval;
+    }
+    static std::string mode_to_string(Mode mode){
+        return mode==Mode::SMOOTH ? "smooth" : "lowest latency";
+    }
+private:
+    struct QueuedFrame{
+        AVFrame* frame;
+        std::chrono::steady_clock::time_point arrival;
+    };
+    std::atomic<Mode> m_mode{Mode::LOWEST_LATENCY};
+    std::mutex m_mutex;
+    std::deque<QueuedFrame> m_queue;
+    // AVFrame shells (without data) we can re-use
+    std::vector<AVFrame*> m_free_frames;
+    bool m_has_last_render=false;
+    std::chrono::steady_clock::time_point m_last_render;
+    std::chrono::nanoseconds m_refresh_interval=std::chrono::nanoseconds(16666667);
+    int m_n_short_deltas=0;
+    // circular mean of the arrival phase relative to the last refresh
+    double m_arrival_phase_cos=1;
+    double m_arrival_phase_sin=0;
+    void recycle_locked(AVFrame* frame){
+        av_frame_unref(frame);
+        if(m_free_frames.size()<MAX_QUEUE_SIZE+2){
+            m_free_frames.push_back(frame);
+        }else{
+            av_frame_free(&frame);
+        }
+    }
+    void update_refresh_estimate(const std::chrono::steady_clock::time_point now){
+        if(m_has_last_render){
+            const auto delta=now-m_last_render;
+            if(delta>m_refresh_interval/2 && delta<m_refresh_interval*3/2){
+                m_refresh_interval=m_refresh_interval*7/8+std::chrono::duration_cast<std::chrono::nanoseconds>(delta)/8;
+                m_n_short_deltas=0;
+            }else if(delta>=std::chrono::milliseconds(4) && delta<m_refresh_interval/2){
+                // A single short delta is just a late refresh followed by an on-time one, but if it persists the panel
+                // refreshes faster than we assumed (e.g. 120Hz) - re-start the estimate
+                m_n_short_deltas++;
+                if(m_n_short_deltas>=16){
+                    m_refresh_interval=std::chrono::duration_cast<std::chrono::nanoseconds>(delta);
+                    m_n_short_deltas=0;
+                }
+            }
+            // Everything else is either a missed refresh or the render loop being paused, ignore it
+        }
+        m_last_render=now;
+        m_has_last_render=true;
+    }
+    double phase_of(const std::chrono::steady_clock::time_point tp)const{
+        const double interval=m_refresh_interval.count();
+        const double since_render=std::chrono::duration_cast<std::chrono::nanoseconds>(tp-m_last_render).count();
+        return std::fmod(since_render,interval)/interval*2*M_PI;
+    }
+    void update_arrival_phase(const std::chrono::steady_clock::time_point arrival){
+        if(!m_has_last_render)return;
+        const double phase=phase_of(arrival);
+        constexpr double alpha=0.05;
+        m_arrival_phase_cos=(1-alpha)*m_arrival_phase_cos+alpha*std::cos(phase);
+        m_arrival_phase_sin=(1-alpha)*m_arrival_phase_sin+alpha*std::sin(phase);
+    }
+    // How long a frame needs to be queued to be presented on this refresh
+    std::chrono::nanoseconds get_min_age()const{
+        if(m_mode==Mode::LOWEST_LATENCY){
+            return std::chrono::nanoseconds(0);
+        }
+        double mean_phase=std::atan2(m_arrival_phase_sin,m_arrival_phase_cos);
+        if(mean_phase<0)mean_phase+=2*M_PI;
+        const double interval=m_refresh_interval.count();
+        // A frame arriving at the mean phase has this age on the first refresh after it arrived.
+        const double age_on_first_refresh=interval-mean_phase/(2*M_PI)*interval;
+        // Put the deadline half a refresh away from the mean arrival, such that jitter (up to +-interval/2)
+        // does not change the refresh a frame is presented on.
+        const double min_age=std::fmod(age_on_first_refresh+interval/2,interval);
+        return std::chrono::nanoseconds((int64_t)min_age);
+    }
+};
+
+#endif // PRESENTATION_SCHEDULER_HPP
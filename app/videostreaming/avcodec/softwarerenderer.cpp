@@ -0,0 +1,220 @@
+#include "softwarerenderer.h"
+
+#include <qdebug.h>
+#include <sstream>
+
+#include "videostreaming/vscommon/video_ratio_helper.hpp"
+#include "decodingstatistcs.h"
+#include "common/SchedulingHelper.hpp"
+
+SoftwareRenderer &SoftwareRenderer::instance()
+{
+    static SoftwareRenderer instance{};
+    return instance;
+}
+
+SoftwareRenderer::~SoftwareRenderer()
+{
+    stop();
+    if(m_pending_frame){
+        av_frame_free(&m_pending_frame);
+    }
+    if(m_sw_frame){
+        av_frame_free(&m_sw_frame);
+    }
+}
+
+void SoftwareRenderer::start()
+{
+    if(m_running)return;
+    qDebug()<<"SoftwareRenderer::start() kernel:"<<yuv_to_rgb::kernel_to_string(m_converter.get_kernel()).c_str();
+    m_running=true;
+    m_thread=std::make_unique<std::thread>([this]{loop();});
+}
+
+void SoftwareRenderer::stop()
+{
+    if(!m_running)return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running=false;
+    }
+    m_cv.notify_one();
+    if(m_thread){
+        m_thread->join();
+        m_thread=nullptr;
+    }
+}
+
+void SoftwareRenderer::queue_new_frame(AVFrame *frame)
+{
+    if(!m_running)return;
+    AVFrame* new_frame=av_frame_alloc();
+    if(new_frame==nullptr || av_frame_ref(new_frame,frame)!=0){
+        av_frame_free(&new_frame);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_pending_frame){
+            // worker is still busy with the previous frame, only the newest one matters
+            av_frame_free(&m_pending_frame);
+            m_n_frames_dropped++;
+        }
+        m_pending_frame=new_frame;
+    }
+    m_cv.notify_one();
+}
+
+void SoftwareRenderer::set_target(QSize size, int rotation_degree, bool scale_to_fit)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_target_size=size;
+    m_rotation_degree=rotation_degree;
+    m_scale_to_fit=scale_to_fit;
+}
+
+bool SoftwareRenderer::take_new_image(QImage &image, QRect &rect)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(!m_has_new_image)return false;
+    // hand over our reference, such that the worker can write into it again once the UI is done with it
+    image=std::move(m_image);
+    m_image=QImage();
+    rect=m_image_rect;
+    m_has_new_image=false;
+    return true;
+}
+
+void SoftwareRenderer::set_on_new_image(std::function<void()> cb)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_on_new_image=cb;
+}
+
+void SoftwareRenderer::clear()
+{
+    std::function<void()> cb;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_pending_frame){
+            av_frame_free(&m_pending_frame);
+        }
+        m_image=QImage();
+        m_image_rect=QRect();
+        m_has_new_image=true;
+        cb=m_on_new_image;
+    }
+    if(cb)cb();
+}
+
+void SoftwareRenderer::loop()
+{
+    // Like the decoder, this is part of the video latency
+    SchedulingHelper::setThreadParamsMaxRealtime();
+    while(true){
+        AVFrame* frame=nullptr;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock,[this]{return !m_running || m_pending_frame!=nullptr;});
+            if(!m_running)break;
+            frame=m_pending_frame;
+            m_pending_frame=nullptr;
+        }
+        if(convert(frame)){
+            m_n_frames_converted++;
+        }
+        av_frame_free(&frame);
+        if(m_convert_time.time_since_last_log()>std::chrono::seconds(3)){
+            std::stringstream ss;
+            ss<<"SW "<<yuv_to_rgb::kernel_to_string(m_converter.get_kernel())<<" "<<m_convert_time.getAvgReadable();
+            DecodingStatistcs::instance().set_texture_upload_time(ss.str().c_str());
+            DecodingStatistcs::instance().set_n_rendered_frames(m_n_frames_converted);
+            DecodingStatistcs::instance().set_n_renderer_dropped_frames(m_n_frames_dropped);
+            m_convert_time.set_last_log();
+            m_convert_time.reset();
+        }
+    }
+}
+
+bool SoftwareRenderer::convert(AVFrame *frame)
+{
+    AVFrame* src_frame=frame;
+    if(frame->hw_frames_ctx!=nullptr){
+        // e.g. vaapi - download into a sw frame (usually NV12)
+        if(m_sw_frame==nullptr){
+            m_sw_frame=av_frame_alloc();
+        }
+        av_frame_unref(m_sw_frame);
+        if(m_sw_frame==nullptr || av_hwframe_transfer_data(m_sw_frame,frame,0)!=0){
+            if(!m_logged_unsupported_format){
+                qDebug()<<"SoftwareRenderer: cannot download hw frame "<<safe_av_get_pix_fmt_name((AVPixelFormat)frame->format).c_str()<<", use SW decode";
+                m_logged_unsupported_format=true;
+            }
+            return false;
+        }
+        src_frame=m_sw_frame;
+    }
+    yuv_to_rgb::SrcFrame src;
+    switch(src_frame->format){
+    case AV_PIX_FMT_YUV420P:
+    case AV_PIX_FMT_YUVJ420P:
+        src.format=yuv_to_rgb::SrcFrame::Format::I420;
+        break;
+    case AV_PIX_FMT_NV12:
+        src.format=yuv_to_rgb::SrcFrame::Format::NV12;
+        break;
+    default:
+        if(!m_logged_unsupported_format){
+            qDebug()<<"SoftwareRenderer: unsupported format "<<safe_av_get_pix_fmt_name((AVPixelFormat)src_frame->format).c_str();
+            m_logged_unsupported_format=true;
+        }
+        return false;
+    }
+    src.width=src_frame->width;
+    src.height=src_frame->height;
+    for(int i=0;i<3;i++){
+        src.data[i]=src_frame->data[i];
+        src.linesize[i]=src_frame->linesize[i];
+    }
+    QSize target_size;
+    int rotation_degree;
+    bool scale_to_fit;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        target_size=m_target_size;
+        rotation_degree=m_rotation_degree;
+        scale_to_fit=m_scale_to_fit;
+    }
+    if(target_size.isEmpty())return false;
+    // Same as the GL path: 270° is drawn like 90° and 180° like 0°
+    const bool rotate_90=rotation_degree==90 || rotation_degree==270;
+    const int video_width=rotate_90 ? src.height : src.width;
+    const int video_height=rotate_90 ? src.width : src.height;
+    const auto viewport=helper::ratio::calculate_viewport(target_size.width(),target_size.height(),video_width,video_height,scale_to_fit);
+    if(viewport.width<=0 || viewport.height<=0)return false;
+    const auto begin=std::chrono::steady_clock::now();
+    QImage& image=m_images[m_image_index];
+    m_image_index=(m_image_index+1)%2;
+    if(image.width()!=viewport.width || image.height()!=viewport.height){
+        image=QImage(viewport.width,viewport.height,QImage::Format_RGB32);
+    }
+    yuv_to_rgb::DstImage dst;
+    // detaches if the UI still holds this image
+    dst.data=image.bits();
+    dst.stride=image.bytesPerLine();
+    dst.width=image.width();
+    dst.height=image.height();
+    m_converter.convert(src,dst,rotate_90);
+    m_convert_time.add(std::chrono::steady_clock::now()-begin);
+    std::function<void()> cb;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_image=image;
+        m_image_rect=QRect(viewport.x,viewport.y,viewport.width,viewport.height);
+        m_has_new_image=true;
+        cb=m_on_new_image;
+    }
+    if(cb)cb();
+    return true;
+}
@@ -0,0 +1,70 @@
+#ifndef SOFTWARERENDERER_H
+#define SOFTWARERENDERER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <QImage>
+#include <QRect>
+#include <QSize>
+
+#include "avcodec_helper.hpp"
+#include "cpu/yuv_to_rgb.h"
+#include "common/TimeHelper.hpp"
+
+// Video without OpenGL, for the Qt Software scene graph backend (e.g. -platform linuxfb on headless / VM ground stations).
+// Decoded frames are converted (and scaled / rotated) to RGB on a worker thread with the SIMD kernels from cpu/yuv_to_rgb.h,
+// the UI only blits the latest image. Like the GL path, only the newest frame is converted - if the worker is busy
+// when a new frame arrives, the older (not yet converted) one is dropped.
+// Primary video only.
+class SoftwareRenderer
+{
+public:
+    static SoftwareRenderer& instance();
+    ~SoftwareRenderer();
+    void start();
+    void stop();
+    bool is_running()const{return m_running;}
+    // Decoder thread, takes its own reference of the frame. HW frames are downloaded first (if the hw supports it).
+    void queue_new_frame(AVFrame* frame);
+    // UI thread. Size of the video item (in pixels), rotation / scale to fit like the GL path.
+    void set_target(QSize size,int rotation_degree,bool scale_to_fit);
+    // UI thread. Returns true if there is a new image since the last call, rect: where to draw it (in target pixels)
+    bool take_new_image(QImage& image,QRect& rect);
+    // Called on the worker thread once a new image is ready (e.g. to schedule a repaint)
+    void set_on_new_image(std::function<void()> cb);
+    // Drop the last image (e.g. the decoder switched to a path that cannot be shown here)
+    void clear();
+private:
+    SoftwareRenderer()=default;
+    void loop();
+    bool convert(AVFrame* frame);
+    std::unique_ptr<std::thread> m_thread=nullptr;
+    std::atomic<bool> m_running{false};
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    // newest frame not yet converted
+    AVFrame* m_pending_frame=nullptr;
+    QSize m_target_size;
+    int m_rotation_degree=0;
+    bool m_scale_to_fit=false;
+    QImage m_image;
+    QRect m_image_rect;
+    bool m_has_new_image=false;
+    std::function<void()> m_on_new_image=nullptr;
+    // worker thread only
+    yuv_to_rgb::Converter m_converter{};
+    AVFrame* m_sw_frame=nullptr;
+    // Written by the worker while the UI may still hold the other one (QImage detaches if it is still shared)
+    QImage m_images[2];
+    int m_image_index=0;
+    bool m_logged_unsupported_format=false;
+    int m_n_frames_converted=0;
+    std::atomic<int> m_n_frames_dropped{0};
+    LatencyHistogram m_convert_time{"SW convert"};
+};
+
+#endif // SOFTWARERENDERER_H
@@ -2,25 +2,48 @@
 
 #include <cmath>
 #include <algorithm>
-#include <QSettings>
+#include "util/settingscache.h"
 
 #include "videostreaming/vscommon/QOpenHDVideoHelper.hpp"
 #include "videostreaming/vscommon/video_ratio_helper.hpp"
 
 #include "avcodec_helper.hpp"
 #include "decodingstatistcs.h"
+#include "FrameLatencyTracer.hpp"
+#include "softwarerenderer.h"
 
 static bool get_dev_draw_alternating_rgb_dummy_frames() {
-    QSettings settings;
+    auto& settings=SettingsCache::instance();
     return settings.value("dev_draw_alternating_rgb_dummy_frames", false).toBool();
 }
 
+static PresentationScheduler::Mode get_presentation_mode() {
+    auto& settings=SettingsCache::instance();
+    const int mode = settings.value("qopenhd_primary_video_presentation_mode", 0).toInt();
+    return mode == 1 ? PresentationScheduler::Mode::SMOOTH : PresentationScheduler::Mode::LOWEST_LATENCY;
+}
+
+static bool get_dev_pbo_texture_upload() {
+    auto& settings=SettingsCache::instance();
+    return settings.value("dev_pbo_texture_upload", true).toBool();
+}
+
+static QSize get_secondary_video_pip_size() {
+    auto& settings=SettingsCache::instance();
+    return QSize(settings.value("secondary_video_minimized_width", 320).toInt(), settings.value("secondary_video_minimized_height", 240).toInt());
+}
+
 
 TextureRenderer &TextureRenderer::instance() {
     static TextureRenderer renderer{};
     return renderer;
 }
 
+DecodingStatistcs &TextureRenderer::stats(int stream_index)
+{
+    return DecodingStatistcs::instance(stream_index == STREAM_PRIMARY);
+}
+
 void TextureRenderer::initGL(QQuickWindow *window)
 {
     if (!_initialized) {
@@ -28,17 +51,35 @@ void TextureRenderer::initGL(QQuickWindow *window)
         QSGRendererInterface *rif = window->rendererInterface();
         if (rif->graphicsApi() == QSGRendererInterface::Software) {
             //runing Qt with param -platform linuxfb with render as software and cannot display gl render video
-            qDebug() << "graphics render as software";
+            qDebug() << "graphics render as software, video via SoftwareRenderer";
         }
         else if (rif->graphicsApi() == QSGRendererInterface::OpenGL) {
             qDebug() << "graphics render as opengl";
         }
-
-        _gl_video_renderer=std::make_unique<GL_VideoRenderer>();
-        qDebug()<<_gl_video_renderer->debug_info().c_str();
-        _gl_video_renderer->init_gl();
+        qDebug()<<GL_VideoRenderer::debug_info().c_str();
         _dev_draw_alternating_rgb_dummy_frames = get_dev_draw_alternating_rgb_dummy_frames();
+        _use_pbo_upload_if_supported = get_dev_pbo_texture_upload();
+        _secondary_layout = QOpenHDVideoHelper::get_secondary_video_layout();
+        _pip_size = get_secondary_video_pip_size();
+        const auto presentation_mode = get_presentation_mode();
+        for (auto& stream : _streams) {
+            stream.presentation_scheduler.set_mode(presentation_mode);
+        }
+        qDebug()<<"Presentation mode:"<<PresentationScheduler::mode_to_string(presentation_mode).c_str();
+        // The secondary stream is initialized once it has a frame
+        init_stream_gl(STREAM_PRIMARY);
+    }
+}
+
+void TextureRenderer::init_stream_gl(int stream_index)
+{
+    Stream& stream = _streams[stream_index];
+    stream.gl_video_renderer = std::make_unique<GL_VideoRenderer>();
+    stream.gl_video_renderer->init_gl();
+    if (_use_pbo_upload_if_supported) {
+        stream.use_pbo_upload = stream.pbo_upload_ring.init_gl();
     }
+    qDebug()<<"Stream"<<stream_index<<"PBO texture upload:"<<(stream.use_pbo_upload ? "Y":"N");
 }
 
 void TextureRenderer::paint(QQuickWindow *window, int rotation_degree)
@@ -51,14 +92,16 @@ void TextureRenderer::paint(QQuickWindow *window, int rotation_degree)
 //    qDebug()<<" TextureRenderer::paint() frame time:"<<frame_time_ms<<"ms";
     _render_count++;
 
-    if (_clear_all_video_textures_next_frame) {
-        remove_queued_frame_if_avalable();
-        _gl_video_renderer->clean_video_textures_gl();
-        DecodingStatistcs::instance().set_n_renderer_dropped_frames(0);
-        DecodingStatistcs::instance().set_n_rendered_frames(-1);
-        DecodingStatistcs::instance().set_decode_and_render_time("-1");
-        _clear_all_video_textures_next_frame = false;
+    for (int i = 0; i < N_STREAMS; i++) {
+        if (_streams[i].gl_video_renderer == nullptr && _streams[i].received_frames) {
+            init_stream_gl(i);
+        }
+        if (_streams[i].gl_video_renderer == nullptr) continue;
+        if (_clear_all_video_textures_next_frame || _streams[i].clear_next_frame) {
+            clear_stream_gl(i);
+        }
     }
+    _clear_all_video_textures_next_frame = false;
 
     // Play nice with the RHI. Not strictly needed when the scenegraph uses
     // OpenGL directly.
@@ -67,103 +110,259 @@ void TextureRenderer::paint(QQuickWindow *window, int rotation_degree)
         window->beginExternalCommands();
     }
 
-    AVFrame* new_frame = fetch_latest_decoded_frame();
+    std::chrono::steady_clock::duration gl_time[N_STREAMS]{};
+    for (int i = 0; i < N_STREAMS; i++) {
+        if (_streams[i].gl_video_renderer == nullptr) continue;
+        gl_time[i] = update_stream_gl(i);
+    }
+
+    glDisable(GL_DEPTH_TEST);
+    // The secondary video goes full screen in the swapped layout (as long as it has video)
+    const bool swapped = _secondary_layout == QOpenHDVideoHelper::SecondaryVideoLayoutSwapped && has_video(STREAM_SECONDARY);
+    const int main_stream = swapped ? STREAM_SECONDARY : STREAM_PRIMARY;
+    const int pip_stream = swapped ? STREAM_PRIMARY : STREAM_SECONDARY;
+    {
+        const auto draw_begin = std::chrono::steady_clock::now();
+        draw_stream_gl(main_stream, 0, 0, _viewport_size.width(), _viewport_size.height(), rotation_degree, false);
+        gl_time[main_stream] += std::chrono::steady_clock::now() - draw_begin;
+    }
+    if (has_video(pip_stream)) {
+        // bottom right corner (GL viewport origin is bottom left)
+        const int margin = 16;
+        const int pip_width = std::min(_pip_size.width(), _viewport_size.width() / 2);
+        const int pip_height = std::min(_pip_size.height(), _viewport_size.height() / 2);
+        const auto draw_begin = std::chrono::steady_clock::now();
+        draw_stream_gl(pip_stream, _viewport_size.width() - pip_width - margin, margin, pip_width, pip_height, rotation_degree, true);
+        gl_time[pip_stream] += std::chrono::steady_clock::now() - draw_begin;
+    }
+    for (int i = 0; i < N_STREAMS; i++) {
+        if (has_video(i)) {
+            _streams[i].display_stats.gl_time.add(gl_time[i]);
+        }
+    }
+
+    // make sure we leave how we started / such that Qt rendering works normally
+    glEnable(GL_DEPTH_TEST);
+    glViewport(0, 0, _viewport_size.width(), _viewport_size.height());
+
+    if (window != nullptr) {
+        window->endExternalCommands();
+    }
+}
+
+std::chrono::steady_clock::duration TextureRenderer::update_stream_gl(int stream_index)
+{
+    Stream& stream = _streams[stream_index];
+    const auto update_begin = std::chrono::steady_clock::now();
+    const auto presentation = stream.presentation_scheduler.on_render(std::chrono::steady_clock::now());
+    on_frames_dropped(stream_index, presentation.n_dropped);
+    AVFrame* new_frame = presentation.frame;
+    bool presented_new_frame = false;
     if (new_frame != nullptr) {
+        // The decoder only falls back to the synchronous path if it could not fill a PBO, anything still waiting there is older
+        on_frames_dropped(stream_index, stream.pbo_upload_ring.discard_filled_gl());
+        stream.display_stats.queue_residency.add(presentation.residency);
+        update_pbo_ring_gl(stream, new_frame);
         // Note : the update might free the frame, so we gotta store the timestamp before !
         const auto frame_pts = new_frame->pts;
+        // The egl (drm prime) texture keeps the frame referenced until it is replaced by the next one and frees it then
+        const bool frame_consumed_by_texture = new_frame->format == AV_PIX_FMT_DRM_PRIME;
+        const auto upload_begin = std::chrono::steady_clock::now();
         // update the texture with this frame
-        _gl_video_renderer->update_texture_gl(new_frame);
-        av_frame_free(&new_frame);
-        _display_stats.n_frames_rendered++;
-        DecodingStatistcs::instance().set_n_rendered_frames(_display_stats.n_frames_rendered);
-
-        const auto now_us = getTimeUs();
-        const auto delay_us = now_us - frame_pts;
-        _display_stats.decode_and_render.add(std::chrono::microseconds(delay_us));
-        if (_display_stats.decode_and_render.time_since_last_log() > std::chrono::seconds(3)) {
-            DecodingStatistcs::instance().set_decode_and_render_time(_display_stats.decode_and_render.getAvgReadable().c_str());
-            _display_stats.decode_and_render.set_last_log();
-            _display_stats.decode_and_render.reset();
+        stream.gl_video_renderer->update_texture_gl(new_frame);
+        const auto upload_time = std::chrono::steady_clock::now() - upload_begin;
+        if (!frame_consumed_by_texture) {
+            stream.presentation_scheduler.recycle(new_frame);
         }
+        on_frame_uploaded(stream_index, frame_pts, upload_time, false);
+        presented_new_frame = true;
+    } else if (stream.use_pbo_upload) {
+        const auto upload_begin = std::chrono::steady_clock::now();
+        GL_PBOUploadRing::AcquiredSlot slot;
+        if (stream.pbo_upload_ring.acquire_filled_gl(slot)) {
+            stream.gl_video_renderer->update_texture_from_pbo_gl(slot.layout);
+            stream.pbo_upload_ring.release_gl(slot);
+            const auto upload_time = std::chrono::steady_clock::now() - upload_begin;
+            stream.pbo_slot_size = slot.layout.total_size;
+            on_frame_uploaded(stream_index, slot.layout.pts, upload_time, true);
+            presented_new_frame = true;
+        }
+    }
+    if (presented_new_frame) {
+        stream.display_stats.last_frame_presented = std::chrono::steady_clock::now();
+    } else if (std::chrono::steady_clock::now() - stream.display_stats.last_frame_presented < std::chrono::milliseconds(250)) {
+        // video is running, but there was no new frame for this refresh
+        stream.display_stats.n_frames_repeated++;
     }
+    // Give the slot(s) we just uploaded from back to the decoder
+    stream.pbo_upload_ring.map_free_slots_gl(stream.pbo_slot_size);
+    return std::chrono::steady_clock::now() - update_begin;
+}
 
-    auto video_tex_width = _gl_video_renderer->get_current_video_width();
-    auto video_tex_height = _gl_video_renderer->get_current_video_height();
+bool TextureRenderer::draw_stream_gl(int stream_index, int x, int y, int width, int height, int rotation_degree, bool picture_in_picture)
+{
+    Stream& stream = _streams[stream_index];
+    if (stream.gl_video_renderer == nullptr) return false;
+    auto video_tex_width = stream.gl_video_renderer->get_current_video_width();
+    auto video_tex_height = stream.gl_video_renderer->get_current_video_height();
     if (rotation_degree == 90 || rotation_degree == 270) {
         // just swap them around when rotated to get the right viewport
         std::swap(video_tex_width, video_tex_height);
     }
-    if (video_tex_width > 0 && video_tex_height > 0) {
-       const auto viewport = helper::ratio::calculate_viewport(_viewport_size.width(), _viewport_size.height(),video_tex_width,video_tex_height,QOpenHDVideoHelper::get_primary_video_scale_to_fit());
-       glViewport(viewport.x,viewport.y,viewport.width,viewport.height);
+    const bool has_texture = video_tex_width > 0 && video_tex_height > 0;
+    // no dummy frames in the small window
+    const bool draw_dummy_frames = _dev_draw_alternating_rgb_dummy_frames && !picture_in_picture;
+    if (has_texture) {
+       // The picture in picture is always fit into its box, preserving the aspect ratio (aligned to the bottom right)
+       const bool scale_to_fit = !picture_in_picture && QOpenHDVideoHelper::get_primary_video_scale_to_fit();
+       auto viewport = helper::ratio::calculate_viewport(width, height, video_tex_width, video_tex_height, scale_to_fit);
+       if (picture_in_picture) {
+           viewport.x = width - viewport.width;
+           viewport.y = 0;
+       }
+       glViewport(x + viewport.x, y + viewport.y, viewport.width, viewport.height);
+    } else if (draw_dummy_frames) {
+       glViewport(x, y, width, height);
+    } else {
+       return false;
     }
-    glDisable(GL_DEPTH_TEST);
+    stream.gl_video_renderer->draw_texture_gl(draw_dummy_frames, rotation_degree);
+    return has_texture;
+}
 
-    _gl_video_renderer->draw_texture_gl(_dev_draw_alternating_rgb_dummy_frames, rotation_degree);
+void TextureRenderer::clear_stream_gl(int stream_index)
+{
+    Stream& stream = _streams[stream_index];
+    remove_queued_frame_if_avalable(stream_index);
+    stream.pbo_upload_ring.discard_filled_gl();
+    stream.gl_video_renderer->clean_video_textures_gl();
+    stream.clear_next_frame = false;
+    DecodingStatistcs& stream_stats = stats(stream_index);
+    stream_stats.set_n_renderer_dropped_frames(0);
+    stream_stats.set_n_rendered_frames(-1);
+    stream_stats.set_decode_and_render_time("-1");
+    stream_stats.set_texture_upload_time("-1");
+    stream_stats.set_frame_pacing("-1");
+    stream_stats.set_stream_cost("-1");
+    if (stream_index == STREAM_PRIMARY) {
+        stream_stats.set_frame_latency_trace("-1");
+    }
+}
 
-    // make sure we leave how we started / such that Qt rendering works normally
-    glEnable(GL_DEPTH_TEST);
-    glViewport(0, 0, _viewport_size.width(), _viewport_size.height());
+bool TextureRenderer::has_video(int stream_index) const
+{
+    const Stream& stream = _streams[stream_index];
+    return stream.gl_video_renderer != nullptr && stream.gl_video_renderer->get_current_video_width() > 0;
+}
 
-    if (window != nullptr) {
-        window->endExternalCommands();
+void TextureRenderer::update_pbo_ring_gl(Stream& stream, const AVFrame *frame)
+{
+    if (!stream.use_pbo_upload) return;
+    GL_PBOFrameLayout layout;
+    // HW frames don't need a PBO
+    stream.pbo_slot_size = GL_PBOFrameLayout::create(frame, layout) ? layout.total_size : 0;
+}
+
+void TextureRenderer::on_frame_uploaded(int stream_index, int64_t frame_pts, std::chrono::steady_clock::duration upload_time, bool via_pbo)
+{
+    Stream& stream = _streams[stream_index];
+    DisplayStats& display_stats = stream.display_stats;
+    DecodingStatistcs& stream_stats = stats(stream_index);
+    display_stats.n_frames_rendered++;
+    stream_stats.set_n_rendered_frames(display_stats.n_frames_rendered);
+
+    const auto now_us = getTimeUs();
+    const auto delay_us = now_us - frame_pts;
+    display_stats.decode_and_render.add(std::chrono::microseconds(delay_us));
+    display_stats.texture_upload.add(upload_time);
+    display_stats.last_upload_via_pbo = via_pbo;
+    // The latency tracer only follows the primary stream
+    if (stream_index == STREAM_PRIMARY) {
+        FrameLatencyTracer::instance().mark_by_pts(frame_pts, FrameLatencyTracer::UPLOADED);
+        stream.last_uploaded_pts = frame_pts;
+    }
+    if (display_stats.decode_and_render.time_since_last_log() > std::chrono::seconds(3)) {
+        stream_stats.set_decode_and_render_time(display_stats.decode_and_render.getAvgReadable().c_str());
+        const auto texture_upload = display_stats.texture_upload.snapshot_and_reset();
+        stream_stats.util_set_texture_upload_time(texture_upload.getAvg(),
+                                                  texture_upload.get_percentile(0.99),
+                                                  stream.pbo_copy_time.snapshot_and_reset().getAvg(),
+                                                  display_stats.last_upload_via_pbo);
+        stream_stats.util_set_frame_pacing(PresentationScheduler::mode_to_string(stream.presentation_scheduler.get_mode()),
+                                           stream.presentation_scheduler.get_refresh_interval(),
+                                           display_stats.n_frames_repeated,
+                                           display_stats.queue_residency.getAvg());
+        stream_stats.util_set_stream_cost(stream.decode_cpu_percent, display_stats.gl_time.snapshot_and_reset().getAvg());
+        if (stream_index == STREAM_PRIMARY && FrameLatencyTracer::instance().is_enabled()) {
+            stream_stats.set_frame_latency_trace(QString(FrameLatencyTracer::instance().get_percentiles_readable().c_str()));
+        }
+        display_stats.decode_and_render.set_last_log();
+        display_stats.decode_and_render.reset();
+        display_stats.queue_residency.reset();
     }
 }
 
-int TextureRenderer::queue_new_frame_for_display(AVFrame *src_frame)
+void TextureRenderer::on_frame_swapped()
+{
+    Stream& stream = _streams[STREAM_PRIMARY];
+    if (stream.last_uploaded_pts < 0) return;
+    FrameLatencyTracer::instance().mark_by_pts(stream.last_uploaded_pts, FrameLatencyTracer::SWAPPED);
+    stream.last_uploaded_pts = -1;
+}
+
+void TextureRenderer::on_frames_dropped(int stream_index, int n_dropped)
+{
+    if (n_dropped <= 0) return;
+    DisplayStats& display_stats = _streams[stream_index].display_stats;
+    std::lock_guard<std::mutex> lock(display_stats.frames_dropped_mutex);
+    display_stats.n_frames_dropped += n_dropped;
+    stats(stream_index).set_n_renderer_dropped_frames(display_stats.n_frames_dropped);
+}
+
+int TextureRenderer::queue_new_frame_for_display(AVFrame *src_frame, int stream_index)
 {
     assert(src_frame);
+    assert(stream_index >= 0 && stream_index < N_STREAMS);
+    if (_software_renderer_enabled) {
+        // No OpenGL, primary video only
+        if (stream_index == STREAM_PRIMARY) {
+            SoftwareRenderer::instance().queue_new_frame(src_frame);
+        }
+        return 0;
+    }
+    Stream& stream = _streams[stream_index];
+    stream.received_frames = true;
     //std::cout<<"DRMPrimeOut::drmprime_out_display "<<src_frame->width<<"x"<<src_frame->height<<"\n";
     if ((src_frame->flags & AV_FRAME_FLAG_CORRUPT) != 0) {
       //fprintf(stderr, "Discard corrupt frame: fmt=%d, ts=%" PRId64 "\n", src_frame->format, src_frame->pts);
       qDebug()<<"Frame corrupt, but forwarding anyways";
       //return 0;
     }
-
-    std::lock_guard<std::mutex> lock(_latest_frame_mutex);
-    // We drop a frame that has (not yet) been consumed by the render thread to whatever is the newest available.
-    if (_latest_frame != nullptr) {
-      av_frame_free(&_latest_frame);
-      _latest_frame = nullptr;
-      // qDebug()<<"Dropping frame";
-      _display_stats.n_frames_dropped++;
-      DecodingStatistcs::instance().set_n_renderer_dropped_frames(_display_stats.n_frames_dropped);
+    // The PBO ring only holds the latest frame, it can only be used if we always present the newest frame anyways
+    if (stream.use_pbo_upload && stream.presentation_scheduler.get_mode() == PresentationScheduler::Mode::LOWEST_LATENCY) {
+        // Copy the frame into a mapped PBO on this (the decoder) thread, the GL thread then only needs to issue the (GPU side) upload
+        const auto copy_begin = std::chrono::steady_clock::now();
+        int n_dropped = 0;
+        if (stream.pbo_upload_ring.try_fill(src_frame, n_dropped)) {
+            stream.pbo_copy_time.add(std::chrono::steady_clock::now() - copy_begin);
+            // A frame queued via the synchronous path is older than this one
+            n_dropped += stream.presentation_scheduler.clear();
+            on_frames_dropped(stream_index, n_dropped);
+            return 0;
+        }
     }
-    AVFrame *frame = av_frame_alloc();
-    assert(frame);
-    if (av_frame_ref(frame, src_frame) != 0) {
+
+    int n_dropped = 0;
+    const int ret = stream.presentation_scheduler.enqueue(src_frame, n_dropped);
+    if (ret != 0) {
       fprintf(stderr, "av_frame_ref error\n");
-      av_frame_free(&frame);
-      // don't forget to give up the lock
-      return AVERROR(EINVAL);
+      return ret;
     }
-    _latest_frame = frame;
+    on_frames_dropped(stream_index, n_dropped);
     return 0;
 }
 
-void TextureRenderer::remove_queued_frame_if_avalable()
+void TextureRenderer::remove_queued_frame_if_avalable(int stream_index)
 {
-    std::lock_guard<std::mutex> lock(_latest_frame_mutex);
-    if (_latest_frame != nullptr) {
-      av_frame_free(&_latest_frame);
-      _latest_frame = nullptr;
-    }
+    _streams[stream_index].presentation_scheduler.clear();
 }
-
-
-AVFrame *TextureRenderer::fetch_latest_decoded_frame()
-{
-    std::lock_guard<std::mutex> lock(_latest_frame_mutex);
-    if (_latest_frame != nullptr) {
-      // Make a copy and write nullptr to the thread-shared variable such that
-      // it is not freed by the providing thread.
-      AVFrame* new_frame = _latest_frame;
-      _latest_frame = nullptr;
-      return new_frame;
-    }
-    return nullptr;
-}
-
-
-
-
@@ -2,6 +2,7 @@
 #define TEXTURERENDERER_H
 
 #include <memory>
+#include <atomic>
 #include <chrono>
 #include <mutex>
 #include <QObject>
@@ -9,14 +10,23 @@
 #include <QtQuick/QQuickWindow>
 
 #include "gl/gl_videorenderer.h"
+#include "presentation_scheduler.hpp"
 #include "common/TimeHelper.hpp"
+#include "QOpenHDVideoHelper.hpp"
 
+class DecodingStatistcs;
+
+// Draws the primary and (if there is one) secondary video, each stream has its own textures and presentation queue.
+// The secondary video is drawn as a picture in picture on top of the primary video, or the other way around (swapped layout).
 class TextureRenderer : public QObject
 {
     Q_OBJECT
 public:
     // DIRTY, FIXME
     static TextureRenderer& instance();
+    static constexpr int STREAM_PRIMARY = 0;
+    static constexpr int STREAM_SECONDARY = 1;
+    static constexpr int N_STREAMS = 2;
 
     void setViewportSize(const QSize &size) { _viewport_size = size; }
     // create and link the shaders
@@ -25,43 +35,102 @@ public:
     // @param window: just needed to call the begin/end-externalCommands on it
     void paint(QQuickWindow *window,int rotation_degree);
     // adds a new frame to be picked up by the GL thread
-    int queue_new_frame_for_display(AVFrame * src_frame);
+    int queue_new_frame_for_display(AVFrame * src_frame,int stream_index = STREAM_PRIMARY);
     // remoe the currently queued frame if there is one (be carefull to not forget that the
     // GL thread can pick up a queued frame at any time).
-    void remove_queued_frame_if_avalable();
+    void remove_queued_frame_if_avalable(int stream_index = STREAM_PRIMARY);
+    // GL thread, after the frame we painted has been swapped (handed over for presentation)
+    void on_frame_swapped();
     // If we switch from a decode method that requires OpenGL to a decode method
     // that uses the HW composer, we need to become "transparent" again - or rather
     // not draw any video with OpenGL, which will have the same effect
     void clear_all_video_textures_next_frame(){
         _clear_all_video_textures_next_frame = true;
     }
+    // E.g. the secondary decoder stopped - don't keep showing its last frame
+    void clear_video_textures_next_frame(int stream_index){
+        _streams[stream_index].clear_next_frame = true;
+    }
+    // No OpenGL (Qt Software backend): frames of the primary video go to the SoftwareRenderer instead
+    void enable_software_renderer(){
+        _software_renderer_enabled = true;
+    }
+    // Decoder thread, CPU usage (in % of one core) of the decoder of this stream, published together with the GL cost
+    void set_decode_cpu_usage(int stream_index,float cpu_percent){
+        _streams[stream_index].decode_cpu_percent = cpu_percent;
+    }
 private:
     QSize _viewport_size;
     int _index = 0;
     // last frame draw time
     std::chrono::steady_clock::time_point _last_frame = std::chrono::steady_clock::now();
     //
-    std::unique_ptr<GL_VideoRenderer> _gl_video_renderer = nullptr;
-    //
     bool _initialized = false;
     int _render_count = 0;
-private:
-    std::mutex _latest_frame_mutex;
-    AVFrame* _latest_frame = nullptr;
-    AVFrame* fetch_latest_decoded_frame();
+    bool _use_pbo_upload_if_supported = true;
+    QOpenHDVideoHelper::SecondaryVideoLayout _secondary_layout = QOpenHDVideoHelper::SecondaryVideoLayoutPiP;
+    // Size of the picture in picture box (the video is fit into it, preserving the aspect ratio)
+    QSize _pip_size{320,240};
 private:
     struct DisplayStats{
         int n_frames_rendered = 0;
+        // Frames can be dropped by both the decoder and the GL thread (PBO path), only counted in on_frames_dropped()
+        // under frames_dropped_mutex - such that the published count never goes backwards
         int n_frames_dropped = 0;
+        std::mutex frames_dropped_mutex;
         // Delay between frame was given to the egl render <-> we uploaded it to the texture (if not dropped)
         //AvgCalculator delay_until_uploaded{"Delay until uploaded"};
         // Delay between frame was given to the egl renderer <-> swap operation returned (it is handed over to the hw composer)
         //AvgCalculator delay_until_swapped{"Delay until swapped"};
-        AvgCalculator decode_and_render{"Decode and render"}; //Time picked up by GL Thread
+        LatencyHistogram decode_and_render{"Decode and render"}; //Time picked up by GL Thread
+        // Time the GL thread spends updating the video texture(s) with a new frame
+        LatencyHistogram texture_upload{"Texture upload"};
+        bool last_upload_via_pbo = false;
+        // Refreshes where we had no new frame (while video is running) and kept showing the previous one
+        int n_frames_repeated = 0;
+        std::chrono::steady_clock::time_point last_frame_presented{};
+        // Time a presented frame spent in the queue
+        LatencyHistogram queue_residency{"Queue residency"};
+        // GL thread time (texture upload + draw calls) per refresh, CPU side (GLES2 has no timer queries)
+        LatencyHistogram gl_time{"GL time"};
       };
-    DisplayStats _display_stats;
+    struct Stream{
+        std::unique_ptr<GL_VideoRenderer> gl_video_renderer = nullptr;
+        // Decoded frame(s) waiting to be presented, decides which frame to show on each refresh
+        PresentationScheduler presentation_scheduler;
+        // Filled on the decoder thread, uploaded on the GL thread. Only used for sw frames and if the GL context supports PBOs.
+        GL_PBOUploadRing pbo_upload_ring;
+        std::atomic<bool> use_pbo_upload{false};
+        // GL thread only, size of the last sw frame
+        size_t pbo_slot_size = 0;
+        // Recorded on the decoder thread, published by the GL thread
+        LatencyHistogram pbo_copy_time{"PBO copy"};
+        // GL thread, pts of the frame uploaded during the last paint (if any), -1 otherwise
+        int64_t last_uploaded_pts = -1;
+        DisplayStats display_stats;
+        std::atomic<float> decode_cpu_percent{-1};
+        std::atomic<bool> clear_next_frame{false};
+        // Set once the first frame was queued, the GL resources of the secondary stream are only created when needed
+        std::atomic<bool> received_frames{false};
+    };
+    Stream _streams[N_STREAMS];
+    static DecodingStatistcs& stats(int stream_index);
+    // GL thread, textures / shaders and the PBO ring of this stream
+    void init_stream_gl(int stream_index);
+    // GL thread, make sure the PBO ring matches the size of the last uploaded frame
+    void update_pbo_ring_gl(Stream& stream, const AVFrame* frame);
+    // GL thread, upload the frame to present on this refresh (if there is a new one). Returns the time it took.
+    std::chrono::steady_clock::duration update_stream_gl(int stream_index);
+    // GL thread, draw the stream into the given area (GL coordinates). Returns false if the stream has no video.
+    bool draw_stream_gl(int stream_index, int x, int y, int width, int height, int rotation_degree, bool picture_in_picture);
+    void clear_stream_gl(int stream_index);
+    void on_frame_uploaded(int stream_index, int64_t frame_pts, std::chrono::steady_clock::duration upload_time, bool via_pbo);
+    void on_frames_dropped(int stream_index, int n_dropped);
+    bool has_video(int stream_index) const;
+private:
     bool _dev_draw_alternating_rgb_dummy_frames = false;
     bool _clear_all_video_textures_next_frame = false;
+    std::atomic<bool> _software_renderer_enabled{false};
 };
 
 #endif // TEXTURERENDERER_H
@@ -0,0 +1,248 @@
+#ifndef FRAMELATENCYTRACER_HPP
+#define FRAMELATENCYTRACER_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "common/TimeHelper.hpp"
+
+/**
+ * Per frame latency tracer across the whole video pipeline.
+ * Each frame gets a compact record (one timestamp per stage), keyed by its rtp timestamp. Once the frame has been fed
+ * to the decoder it is identified by the (avcodec / mpp) pts we gave it, since that is what comes out of the decoder.
+ * For each stage the latency (time since the previous stage of the same frame) goes into a LatencyHistogram for
+ * percentiles, and the records of the last N_FRAMES frames can be dumped to a (csv) trace file for offline analysis.
+ * All timestamps are steady clock microseconds (same clock as getTimeUs(), which is what we use as pts).
+ * Thread safe - stages are marked from the udp, decoder and render thread. Uses a mutex, but only
+ * a few times per frame (the per packet check for a new frame is lock free).
+ */
+class FrameLatencyTracer{
+public:
+    enum Stage : int{
+        // first udp (rtp) packet of this frame received
+        UDP_RX=0,
+        // (last) NALU of this frame reassembled from rtp
+        NALU_COMPLETE,
+        // frame put into the queue to the decoder
+        ENQUEUED,
+        SENT_TO_DECODER,
+        DECODED,
+        // uploaded to the OpenGL texture
+        UPLOADED,
+        // the frame (with this texture) was handed over for presentation (Qt frameSwapped)
+        SWAPPED,
+        N_STAGES
+    };
+    static constexpr size_t N_FRAMES=256;
+    // The records a lookup checks, starting with the newest one
+    static constexpr size_t N_LOOKBACK=32;
+    static FrameLatencyTracer& instance(){
+        static FrameLatencyTracer instance{};
+        return instance;
+    }
+    void set_enabled(bool enabled){
+        m_enabled=enabled;
+    }
+    bool is_enabled()const{
+        return m_enabled;
+    }
+    // Called for each rtp packet (udp thread). Creates a new record once a packet with a new rtp timestamp comes in.
+    void on_rtp_packet(const uint32_t rtp_timestamp){
+        if(!m_enabled)return;
+        if(m_has_last_rtp_timestamp && rtp_timestamp==m_last_rtp_timestamp)return;
+        m_has_last_rtp_timestamp=true;
+        m_last_rtp_timestamp=rtp_timestamp;
+        const int64_t now=now_us();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(find_by_rtp_timestamp(rtp_timestamp)!=nullptr){
+            // e.g. a late (reordered) packet of a frame we already know
+            return;
+        }
+        m_head=(m_head+1)%N_FRAMES;
+        Record& record=m_records[m_head];
+        record=Record{};
+        record.used=true;
+        record.rtp_timestamp=rtp_timestamp;
+        record.stage_us[UDP_RX]=now;
+        m_n_records++;
+    }
+    void mark(const uint32_t rtp_timestamp,const Stage stage){
+        if(!m_enabled)return;
+        const int64_t now=now_us();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Record* record=find_by_rtp_timestamp(rtp_timestamp);
+        if(record==nullptr)return;
+        mark_locked(*record,stage,now);
+    }
+    // Reverts mark() for a frame that did not make it through the stage after all (e.g. the enqueue failed),
+    // such that the trace shows it as never having reached it
+    void clear_mark(const uint32_t rtp_timestamp,const Stage stage){
+        if(!m_enabled)return;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Record* record=find_by_rtp_timestamp(rtp_timestamp);
+        if(record==nullptr)return;
+        record->stage_us[stage]=-1;
+    }
+    // From now on, the frame can also be looked up by the given pts
+    void mark_sent_to_decoder(const uint32_t rtp_timestamp,const int64_t pts){
+        if(!m_enabled)return;
+        const int64_t now=now_us();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Record* record=find_by_rtp_timestamp(rtp_timestamp);
+        if(record==nullptr)return;
+        record->pts=pts;
+        mark_locked(*record,SENT_TO_DECODER,now);
+    }
+    void mark_by_pts(const int64_t pts,const Stage stage){
+        if(!m_enabled)return;
+        const int64_t now=now_us();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Record* record=find_by_pts(pts);
+        if(record==nullptr)return;
+        mark_locked(*record,stage,now);
+    }
+    struct Percentiles{
+        int64_t p50_us=0;
+        int64_t p95_us=0;
+        int64_t p99_us=0;
+        int64_t max_us=0;
+        size_t n_samples=0;
+    };
+    // Index i is the latency of stage i (time since the previous stage), stage 0 (UDP_RX) is the end to end
+    // latency (first packet received until swapped) instead. Covers all frames since the last call.
+    std::array<Percentiles,N_STAGES> get_percentiles(){
+        std::array<Percentiles,N_STAGES> ret{};
+        for(int i=0;i<N_STAGES;i++){
+            const auto snapshot=m_latencies[i].snapshot_and_reset();
+            if(snapshot.n_samples==0)continue;
+            const auto to_us=[](std::chrono::nanoseconds value){
+                return (int64_t)std::chrono::duration_cast<std::chrono::microseconds>(value).count();
+            };
+            ret[i].p50_us=to_us(snapshot.get_percentile(0.50));
+            ret[i].p95_us=to_us(snapshot.get_percentile(0.95));
+            ret[i].p99_us=to_us(snapshot.get_percentile(0.99));
+            ret[i].max_us=to_us(snapshot.getMax());
+            ret[i].n_samples=snapshot.n_samples;
+        }
+        return ret;
+    }
+    // one line per stage that has samples, "stage p50/p95/p99/max" in ms
+    std::string get_percentiles_readable(){
+        const auto percentiles=get_percentiles();
+        std::stringstream ss;
+        ss<<std::fixed<<std::setprecision(1);
+        bool first=true;
+        for(int i=0;i<N_STAGES;i++){
+            const auto& p=percentiles[i];
+            if(p.n_samples==0)continue;
+            if(!first)ss<<"\n";
+            first=false;
+            ss<<(i==UDP_RX ? "total" : stage_to_string((Stage)i))<<" "<<p.p50_us/1000.0<<"/"<<p.p95_us/1000.0<<"/"
+             <<p.p99_us/1000.0<<"/"<<p.max_us/1000.0;
+        }
+        return ss.str();
+    }
+    // Writes the last (up to) N_FRAMES records, oldest first, one line per frame. Stage times are relative to UDP_RX,
+    // -1 if the frame never reached a stage (e.g. dropped).
+    bool dump(const std::string& filename){
+        std::vector<Record> records;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            const size_t n=std::min(m_n_records,N_FRAMES);
+            for(size_t i=0;i<n;i++){
+                const Record& record=m_records[(m_head+N_FRAMES-(n-1)+i)%N_FRAMES];
+                if(record.used)records.push_back(record);
+            }
+        }
+        std::ofstream file(filename);
+        if(!file.is_open())return false;
+        file<<"rtp_timestamp,udp_rx_us";
+        for(int i=1;i<N_STAGES;i++){
+            file<<","<<stage_to_string((Stage)i)<<"_us";
+        }
+        file<<"\n";
+        for(const auto& record:records){
+            const int64_t begin=record.stage_us[UDP_RX];
+            file<<record.rtp_timestamp<<","<<begin;
+            for(int i=1;i<N_STAGES;i++){
+                file<<","<<(record.stage_us[i]<0 ? -1 : record.stage_us[i]-begin);
+            }
+            file<<"\n";
+        }
+        return file.good();
+    }
+    static const char* stage_to_string(const Stage stage){
+        switch(stage){
+        case UDP_RX:return "udp_rx";
+        case NALU_COMPLETE:return "nalu";
+        case ENQUEUED:return "enqueued";
+        case SENT_TO_DECODER:return "to_decoder";
+        case DECODED:return "decoded";
+        case UPLOADED:return "uploaded";
+        case SWAPPED:return "swapped";
+        default:break;
+        }
+        return "unknown";
+    }
+private:
+    struct Record{
+        bool used=false;
+        uint32_t rtp_timestamp=0;
+        int64_t pts=-1;
+        std::array<int64_t,N_STAGES> stage_us{-1,-1,-1,-1,-1,-1,-1};
+    };
+    static int64_t now_us(){
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    Record* find_by_rtp_timestamp(const uint32_t rtp_timestamp){
+        for(size_t i=0;i<N_LOOKBACK;i++){
+            Record& record=m_records[(m_head+N_FRAMES-i)%N_FRAMES];
+            if(record.used && record.rtp_timestamp==rtp_timestamp)return &record;
+        }
+        return nullptr;
+    }
+    Record* find_by_pts(const int64_t pts){
+        for(size_t i=0;i<N_LOOKBACK;i++){
+            Record& record=m_records[(m_head+N_FRAMES-i)%N_FRAMES];
+            if(record.used && record.pts==pts)return &record;
+        }
+        return nullptr;
+    }
+    // A stage that is marked multiple times (e.g. multiple slices) keeps the latest time
+    void mark_locked(Record& record,const Stage stage,const int64_t now){
+        record.stage_us[stage]=now;
+        for(int prev=stage-1;prev>=0;prev--){
+            if(record.stage_us[prev]>=0){
+                // A previous stage can be marked again later (e.g. the next slice of the same frame without AU assembly)
+                if(now>=record.stage_us[prev]){
+                    m_latencies[stage].addUs(now-record.stage_us[prev]);
+                }
+                break;
+            }
+        }
+        if(stage==SWAPPED && record.stage_us[UDP_RX]>=0){
+            m_latencies[UDP_RX].addUs(now-record.stage_us[UDP_RX]);
+        }
+    }
+    std::atomic<bool> m_enabled{true};
+    // udp thread only
+    bool m_has_last_rtp_timestamp=false;
+    uint32_t m_last_rtp_timestamp=0;
+    std::mutex m_mutex;
+    std::array<Record,N_FRAMES> m_records{};
+    size_t m_head=0;
+    size_t m_n_records=0;
+    // lock free, (only) written with m_mutex held
+    std::array<LatencyHistogram,N_STAGES> m_latencies{};
+};
+
+#endif // FRAMELATENCYTRACER_HPP
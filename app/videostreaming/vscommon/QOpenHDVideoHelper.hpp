@@ -2,6 +2,8 @@
 #define QOPENHDVIDEOHELPER_H
 
 #include <QSettings>
+#include "util/settingscache.h"
+#include <QStandardPaths>
 #include <qqmlapplicationengine.h>
 #include <qquickitem.h>
 #include <qquickwindow.h>
@@ -15,6 +17,7 @@ namespace QOpenHDVideoHelper {
 // Must be in sync with OpenHD
 static constexpr auto kDefault_udp_rtp_input_ip_address="127.0.0.1";
 static constexpr auto kDefault_udp_rtp_input_port_primary=5600;
+static constexpr auto kDefault_udp_rtp_input_port_secondary=5601;
 
 // Supported video codecs
 typedef enum VideoCodec {
@@ -45,6 +48,39 @@ static std::string video_codec_to_string(const VideoCodec& codec) {
     return "h264";
 }
 
+// Threading of the (avcodec) sw decoder.
+// Slice threads don't add latency (but only help if the encoder uses multiple slices),
+// frame threads scale with any stream but add (n threads -1) frames of latency.
+typedef enum DecodeThreadingPolicy {
+    DecodeThreadingSingle=0,
+    DecodeThreadingSlice=1,
+    DecodeThreadingFrame=2,
+    // slice threads as long as decoding keeps up with the frame rate, frame threads otherwise
+    DecodeThreadingAuto=3
+} DecodeThreadingPolicy;
+
+static DecodeThreadingPolicy intToDecodeThreadingPolicy(int policy) {
+    if(policy>=DecodeThreadingSingle && policy<=DecodeThreadingAuto){
+        return (DecodeThreadingPolicy)policy;
+    }
+    qDebug() << "intToDecodeThreadingPolicy::somethingWrong,using single thread as default";
+    return DecodeThreadingSingle;
+}
+
+static std::string decode_threading_policy_to_string(const DecodeThreadingPolicy& policy) {
+    switch(policy) {
+    case DecodeThreadingSingle:
+        return "single";
+    case DecodeThreadingSlice:
+        return "slice";
+    case DecodeThreadingFrame:
+        return "frame";
+    case DecodeThreadingAuto:
+        return "auto";
+    }
+    return "single";
+}
+
 /**
  * Dirty - settings mostly for developing / handling differen platforms
  * Not seperated for primary / secondary stream
@@ -61,6 +97,35 @@ struct GenericVideoSettings {
     // On embedded devices, video is commonly rendered on a special surface, independent of QOpenHD
     // r.n only the rpi mmal impl. supports proper video rotation
     int extra_screen_rotation = 0;
+    // n of udp datagrams fetched per receive syscall (recvmmsg), 1 == one recvfrom per datagram (legacy)
+    int dev_udp_recvmmsg_batch_size = 16;
+    // let the kernel coalesce incoming udp datagrams (UDP_GRO)
+    bool dev_udp_enable_gro = false;
+    // rtp reorder window (0 == disabled), max n of packets held back and max time a packet is held back
+    int dev_rtp_reorder_window_packets = 0;
+    int dev_rtp_reorder_window_us = 5000;
+    // group all slices of one picture into one buffer, such that the decoder gets exactly one packet per frame
+    bool dev_rtp_assemble_access_units = true;
+    // max size of the cached GOP (all frames since the last keyframe) used to prime a restarted decoder, 0 == disabled
+    int dev_rtp_gop_cache_size_kb = 16384;
+    // max. amount of video queued for the decoder, if the decoder cannot keep up whole non-reference frames are dropped first,
+    // then everything until the next keyframe
+    int dev_decoder_queue_max_ms = 200;
+    // trace the latency of each frame through all stages of the pipeline (udp rx until swapped)
+    bool dev_frame_latency_tracer = true;
+    // replay a recorded stream (pcap of rtp/udp or Annex-B h264/h265) instead of receiving via udp, loops forever
+    bool dev_video_replay = false;
+    std::string dev_video_replay_file = "/usr/local/share/qopenhd/video_replay.pcap";
+    // 100 == original timing, 0 == as fast as possible
+    int dev_video_replay_speed_percent = 100;
+    // ground side recording (DVR) of the primary stream, started / stopped via the record widget
+    std::string ground_recording_directory = "";
+    // 0 == mkv, 1 == mp4 (fragmented), 2 == raw Annex-B
+    int ground_recording_container = 0;
+    // a new file is started every N minutes (at the next keyframe), 0 == one file per recording
+    int ground_recording_segment_minutes = 10;
+    // max. memory used for buffering if the disk cannot keep up, frames are dropped above that
+    int ground_recording_max_buffer_mb = 32;
 
     // 2 configs are equal if all members are exactly the same.
     bool operator==(const GenericVideoSettings &o) const {
@@ -68,7 +133,22 @@ struct GenericVideoSettings {
                this->dev_custom_pipeline==o.dev_custom_pipeline &&
                this->dev_feed_incomplete_frames_to_decoder == o.dev_feed_incomplete_frames_to_decoder &&
                this->dev_always_use_generic_external_decode_service==o.dev_always_use_generic_external_decode_service &&
-               this->extra_screen_rotation == o.extra_screen_rotation;
+               this->extra_screen_rotation == o.extra_screen_rotation &&
+               this->dev_udp_recvmmsg_batch_size == o.dev_udp_recvmmsg_batch_size &&
+               this->dev_udp_enable_gro == o.dev_udp_enable_gro &&
+               this->dev_rtp_reorder_window_packets == o.dev_rtp_reorder_window_packets &&
+               this->dev_rtp_reorder_window_us == o.dev_rtp_reorder_window_us &&
+               this->dev_rtp_assemble_access_units == o.dev_rtp_assemble_access_units &&
+               this->dev_rtp_gop_cache_size_kb == o.dev_rtp_gop_cache_size_kb &&
+               this->dev_decoder_queue_max_ms == o.dev_decoder_queue_max_ms &&
+               this->dev_frame_latency_tracer == o.dev_frame_latency_tracer &&
+               this->dev_video_replay == o.dev_video_replay &&
+               this->dev_video_replay_file == o.dev_video_replay_file &&
+               this->dev_video_replay_speed_percent == o.dev_video_replay_speed_percent &&
+               this->ground_recording_directory == o.ground_recording_directory &&
+               this->ground_recording_container == o.ground_recording_container &&
+               this->ground_recording_segment_minutes == o.ground_recording_segment_minutes &&
+               this->ground_recording_max_buffer_mb == o.ground_recording_max_buffer_mb;
      }
     bool operator !=(const GenericVideoSettings &o) const {
         return !(*this==o);
@@ -87,12 +167,17 @@ struct VideoStreamConfigXX {
     VideoCodec video_codec = VideoCodecH264;
     // force sw decoding (only makes a difference if on this platform/compile-time configuration a HW decoder is chosen by default)
     bool enable_software_video_decoder = false;
+    // threading of the sw decoder, and n of threads for slice / frame threading (0 == n of cpu cores)
+    DecodeThreadingPolicy decode_threading_policy = DecodeThreadingSingle;
+    int decode_n_threads = 0;
 
     // 2 configs are equal if all members are exactly the same.
     bool operator == (const VideoStreamConfigXX &o) const {
         return this->udp_rtp_input_port == o.udp_rtp_input_port
                 && this->video_codec == o.video_codec
                 && this->enable_software_video_decoder == o.enable_software_video_decoder
+                && this->decode_threading_policy == o.decode_threading_policy
+                && this->decode_n_threads == o.decode_n_threads
                 && this->udp_rtp_input_ip_address == o.udp_rtp_input_ip_address;
     }
     bool operator != (const VideoStreamConfigXX &o) const {
@@ -103,9 +188,12 @@ struct VideoStreamConfigXX {
 struct VideoStreamConfig {
     GenericVideoSettings generic;
     VideoStreamConfigXX primary_stream_config;
+    // Only decoded if QOpenHD is configured for 2 cameras
+    VideoStreamConfigXX secondary_stream_config;
     bool operator==(const VideoStreamConfig &o) const {
         return this->generic == o.generic
-               && this->primary_stream_config == o.primary_stream_config;
+               && this->primary_stream_config == o.primary_stream_config
+               && this->secondary_stream_config == o.secondary_stream_config;
     }
     bool operator !=(const VideoStreamConfig &o) const {
         return !(*this==o);
@@ -113,23 +201,31 @@ struct VideoStreamConfig {
 };
 
 
-static VideoStreamConfigXX read_from_settingsXX() {
-    QSettings settings;
+// Primary and secondary stream use the same keys, with a different prefix
+static QString stream_settings_key(bool primary,const char* key){
+    return QString(primary ? "qopenhd_primary_video_" : "qopenhd_secondary_video_")+key;
+}
+
+static VideoStreamConfigXX read_from_settingsXX(bool primary=true) {
+    auto& settings=SettingsCache::instance();
     QOpenHDVideoHelper::VideoStreamConfigXX _videoStreamConfig;
 
-    _videoStreamConfig.udp_rtp_input_port = settings.value("qopenhd_primary_video_rtp_input_port", kDefault_udp_rtp_input_port_primary).toInt();
-    _videoStreamConfig.udp_rtp_input_ip_address = settings.value("qopenhd_primary_video_rtp_input_ip", kDefault_udp_rtp_input_ip_address).toString().toStdString();
+    const int default_port = primary ? kDefault_udp_rtp_input_port_primary : kDefault_udp_rtp_input_port_secondary;
+    _videoStreamConfig.udp_rtp_input_port = settings.value(stream_settings_key(primary,"rtp_input_port"), default_port).toInt();
+    _videoStreamConfig.udp_rtp_input_ip_address = settings.value(stream_settings_key(primary,"rtp_input_ip"), kDefault_udp_rtp_input_ip_address).toString().toStdString();
 
-    const int tmp_video_codec = settings.value("qopenhd_primary_video_codec", 0).toInt();
+    const int tmp_video_codec = settings.value(stream_settings_key(primary,"codec"), 0).toInt();
     _videoStreamConfig.video_codec = QOpenHDVideoHelper::intToVideoCodec(tmp_video_codec);
-    _videoStreamConfig.enable_software_video_decoder = settings.value("qopenhd_primary_video_force_sw", 0).toBool();
+    _videoStreamConfig.enable_software_video_decoder = settings.value(stream_settings_key(primary,"force_sw"), 0).toBool();
+    _videoStreamConfig.decode_threading_policy = QOpenHDVideoHelper::intToDecodeThreadingPolicy(settings.value(stream_settings_key(primary,"decode_threading"), 0).toInt());
+    _videoStreamConfig.decode_n_threads = settings.value(stream_settings_key(primary,"decode_n_threads"), 0).toInt();
 
     return _videoStreamConfig;
 }
 
 // Kinda UI, kinda video related
 static int get_display_rotation(){
-    QSettings settings{};
+    auto& settings=SettingsCache::instance();
     return settings.value("general_screen_rotation", 0).toInt();
 }
 
@@ -137,18 +233,34 @@ static int get_display_rotation(){
 // do not preserve aspect ratio of primary video
 // default false (do preserve video aspect ratio)
 static bool get_primary_video_scale_to_fit() {
-    QSettings settings{};
+    auto& settings=SettingsCache::instance();
     return settings.value("primary_video_scale_to_fit", false).toBool();
 }
 
 static GenericVideoSettings read_generic_from_settings() {
-    QSettings settings;
+    auto& settings=SettingsCache::instance();
     GenericVideoSettings _videoStreamConfig;
 
     _videoStreamConfig.dev_enable_custom_pipeline = settings.value("dev_enable_custom_pipeline",false).toBool();
     //
     _videoStreamConfig.dev_always_use_generic_external_decode_service = settings.value("dev_always_use_generic_external_decode_service", false).toBool();
     _videoStreamConfig.extra_screen_rotation=get_display_rotation();
+    _videoStreamConfig.dev_udp_recvmmsg_batch_size = settings.value("dev_udp_recvmmsg_batch_size", 16).toInt();
+    _videoStreamConfig.dev_udp_enable_gro = settings.value("dev_udp_enable_gro", false).toBool();
+    _videoStreamConfig.dev_rtp_reorder_window_packets = settings.value("dev_rtp_reorder_window_packets", 0).toInt();
+    _videoStreamConfig.dev_rtp_reorder_window_us = settings.value("dev_rtp_reorder_window_us", 5000).toInt();
+    _videoStreamConfig.dev_rtp_assemble_access_units = settings.value("dev_rtp_assemble_access_units", true).toBool();
+    _videoStreamConfig.dev_rtp_gop_cache_size_kb = settings.value("dev_rtp_gop_cache_size_kb", 16384).toInt();
+    _videoStreamConfig.dev_decoder_queue_max_ms = settings.value("dev_decoder_queue_max_ms", 200).toInt();
+    _videoStreamConfig.dev_frame_latency_tracer = settings.value("dev_frame_latency_tracer", true).toBool();
+    _videoStreamConfig.dev_video_replay = settings.value("dev_video_replay", false).toBool();
+    _videoStreamConfig.dev_video_replay_file = settings.value("dev_video_replay_file", "/usr/local/share/qopenhd/video_replay.pcap").toString().toStdString();
+    _videoStreamConfig.dev_video_replay_speed_percent = settings.value("dev_video_replay_speed_percent", 100).toInt();
+    const QString default_recording_directory=QStandardPaths::writableLocation(QStandardPaths::MoviesLocation)+"/qopenhd";
+    _videoStreamConfig.ground_recording_directory = settings.value("qopenhd_ground_recording_directory", default_recording_directory).toString().toStdString();
+    _videoStreamConfig.ground_recording_container = settings.value("qopenhd_ground_recording_container", 0).toInt();
+    _videoStreamConfig.ground_recording_segment_minutes = settings.value("qopenhd_ground_recording_segment_minutes", 10).toInt();
+    _videoStreamConfig.ground_recording_max_buffer_mb = settings.value("qopenhd_ground_recording_max_buffer_mb", 32).toInt();
     // QML text input sucks, so we read a file. Not ideal, but for testing only anyways
     {
         _videoStreamConfig.dev_custom_pipeline="";
@@ -170,7 +282,8 @@ static GenericVideoSettings read_generic_from_settings() {
 static VideoStreamConfig read_config_from_settings() {
     VideoStreamConfig ret;
     ret.generic = read_generic_from_settings();
-    ret.primary_stream_config = read_from_settingsXX();
+    ret.primary_stream_config = read_from_settingsXX(true);
+    ret.secondary_stream_config = read_from_settingsXX(false);
     return ret;
 }
 
@@ -212,21 +325,35 @@ static std::string get_udp_rtp_sdp_filename(const VideoStreamConfigXX& video_str
 }
 
 static int get_qopenhd_n_cameras() {
-    QSettings settings;
+    auto& settings=SettingsCache::instance();
     const int num_cameras = settings.value("dev_qopenhd_n_cameras", 1).toInt();
     return num_cameras;
 }
 
+// Secondary video drawn by the TextureRenderer (avcodec), together with the primary video
+typedef enum SecondaryVideoLayout {
+    // secondary video small in the bottom right corner
+    SecondaryVideoLayoutPiP=0,
+    // secondary video full screen, primary video small in the bottom right corner
+    SecondaryVideoLayoutSwapped=1
+} SecondaryVideoLayout;
+
+static SecondaryVideoLayout get_secondary_video_layout() {
+    auto& settings=SettingsCache::instance();
+    const int layout = settings.value("qopenhd_secondary_video_layout", 0).toInt();
+    return layout == 1 ? SecondaryVideoLayoutSwapped : SecondaryVideoLayoutPiP;
+}
+
 // We autmatically (over) write the video codec once we get camera telemetry data
-static int get_qopenhd_camera_video_codec(bool /*secondary*/) {
-    QSettings settings;
-    int codec_in_qopenhd = settings.value("qopenhd_primary_video_codec", 0).toInt();
+static int get_qopenhd_camera_video_codec(bool secondary) {
+    auto& settings=SettingsCache::instance();
+    int codec_in_qopenhd = settings.value(stream_settings_key(!secondary,"codec"), 0).toInt();
     return codec_in_qopenhd;
 }
 
-static void set_qopenhd_camera_video_codec(bool /*secondary*/,int codec){
-    QSettings settings;
-    settings.setValue("qopenhd_primary_video_codec",(int)codec);
+static void set_qopenhd_camera_video_codec(bool secondary,int codec){
+    auto& settings=SettingsCache::instance();
+    settings.setValue(stream_settings_key(!secondary,"codec"),(int)codec);
 }
 
 }
@@ -1,5 +1,8 @@
 #include "decodingstatistcs.h"
 #include <sstream>
+#include <iomanip>
+
+#include "FrameLatencyTracer.hpp"
 
 DecodingStatistcs::DecodingStatistcs(QObject *parent)
     : QObject{parent}
@@ -13,19 +16,53 @@ DecodingStatistcs& DecodingStatistcs::instance()
     return stats;
 }
 
+DecodingStatistcs &DecodingStatistcs::instanceSecondary()
+{
+    static DecodingStatistcs stats{};
+    return stats;
+}
+
 void DecodingStatistcs::reset_all_to_default()
 {
     set_parse_and_enqueue_time("?");
     set_decode_and_render_time("?");
+    set_texture_upload_time("?");
+    set_frame_pacing("?");
+    set_frame_latency_trace("?");
     set_n_renderer_dropped_frames(-1);
     set_udp_rx_bitrate(-1);
+    set_udp_rx_stats("?");
     set_primary_stream_frame_format("?");
     set_decoding_type("?");
     set_n_missing_rtp_video_packets(-1);
+    set_n_rtp_reordered_packets(-1);
+    set_n_rtp_late_packets(-1);
+    set_n_rtp_lost_packets(-1);
     set_rtp_measured_bitrate("-1");
     set_estimate_rtp_fps("-1");
     set_estimate_keyframe_interval(-1);
+    set_access_unit_stats("?");
     set_n_decoder_dropped_frames(-1);
+    set_decoder_overload_drops("?");
+    set_n_nalu_buffer_allocations(-1);
+    set_decoder_wakeups_per_second(-1);
+    set_time_to_first_frame("?");
+    set_decoder_switch_gap("?");
+    set_decode_threading("?");
+    set_stream_cost("?");
+}
+
+void DecodingStatistcs::util_set_stream_cost(float cpu_percent, std::chrono::nanoseconds gl_time_per_frame)
+{
+    std::stringstream ss;
+    ss<<std::fixed<<std::setprecision(1);
+    if(cpu_percent>=0){
+        ss<<"CPU "<<cpu_percent<<"%";
+    }else{
+        ss<<"CPU ?";
+    }
+    ss<<" GL "<<std::chrono::duration_cast<std::chrono::microseconds>(gl_time_per_frame).count()/1000.0<<"ms";
+    set_stream_cost(ss.str().c_str());
 }
 
 void DecodingStatistcs::util_set_primary_stream_frame_format(std::string format, int width_px, int height_px)
@@ -34,3 +71,56 @@ void DecodingStatistcs::util_set_primary_stream_frame_format(std::string format,
     ss<<format<<" "<<width_px<<"x"<<height_px;
     set_primary_stream_frame_format(ss.str().c_str());
 }
+
+void DecodingStatistcs::util_set_time_to_first_frame(std::chrono::steady_clock::duration time_to_first_frame, int n_primed_frames)
+{
+    std::stringstream ss;
+    ss<<std::chrono::duration_cast<std::chrono::milliseconds>(time_to_first_frame).count()<<"ms";
+    if(n_primed_frames>0){
+        ss<<" (primed "<<n_primed_frames<<")";
+    }
+    set_time_to_first_frame(ss.str().c_str());
+}
+
+void DecodingStatistcs::util_set_decoder_switch_gap(std::chrono::steady_clock::duration gap, int width_px, int height_px)
+{
+    std::stringstream ss;
+    ss<<std::chrono::duration_cast<std::chrono::milliseconds>(gap).count()<<"ms (to "<<width_px<<"x"<<height_px<<")";
+    set_decoder_switch_gap(ss.str().c_str());
+}
+
+void DecodingStatistcs::util_set_texture_upload_time(std::chrono::steady_clock::duration upload_time, std::chrono::steady_clock::duration upload_time_p99, std::chrono::steady_clock::duration copy_time, bool via_pbo)
+{
+    const auto to_ms=[](std::chrono::steady_clock::duration dur){
+        return std::chrono::duration_cast<std::chrono::microseconds>(dur).count()/1000.0;
+    };
+    std::stringstream ss;
+    ss<<std::fixed<<std::setprecision(2)<<to_ms(upload_time)<<"ms p99="<<to_ms(upload_time_p99)<<"ms";
+    if(via_pbo){
+        ss<<" (PBO, copy "<<to_ms(copy_time)<<"ms)";
+    }
+    set_texture_upload_time(ss.str().c_str());
+}
+
+void DecodingStatistcs::util_set_frame_pacing(const std::string &mode, std::chrono::nanoseconds refresh_interval, int n_repeated, std::chrono::nanoseconds avg_queue_residency)
+{
+    std::stringstream ss;
+    ss<<mode<<" "<<std::fixed<<std::setprecision(1);
+    if(refresh_interval.count()>0){
+        ss<<(1000.0*1000.0*1000.0/refresh_interval.count())<<"Hz";
+    }
+    ss<<" rep:"<<n_repeated<<" q:"<<std::setprecision(2)<<std::chrono::duration_cast<std::chrono::microseconds>(avg_queue_residency).count()/1000.0<<"ms";
+    set_frame_pacing(ss.str().c_str());
+}
+
+QString DecodingStatistcs::dump_frame_latency_trace()
+{
+    const std::string filename="/tmp/qopenhd_frame_latency_trace.csv";
+    std::stringstream ss;
+    if(FrameLatencyTracer::instance().dump(filename)){
+        ss<<"Written to "<<filename;
+    }else{
+        ss<<"Cannot write "<<filename;
+    }
+    return QString(ss.str().c_str());
+}
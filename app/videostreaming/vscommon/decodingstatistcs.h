@@ -2,6 +2,7 @@
 #define DECODINGSTATISTCS_H
 
 #include <QObject>
+#include <chrono>
 
 // Really nice, this way we don't have to write all the setters / getters / signals ourselves !
 #include "lib/lqtutils_master/lqtutils_prop.h"
@@ -9,6 +10,7 @@
 /**
  * @brief Simple QT model to expose QOpenHD decoding statistics to the UI.
  * singleton, corresponding qt name is "_decodingStatistics" (see main)
+ * The secondary video (dual cam, decoded by avcodec) has its own instance, "_decodingStatisticsSecondary".
  * Data generated by OpenHD itself (e.g. the encoder stats from the air pi) should be handled by a different model
  * Depending on the actually used implementation, some stats might not be available
  * (e.g. when using gstreamer, or the external decode service)
@@ -21,26 +23,71 @@ class DecodingStatistcs : public QObject
     // If we do sw decode & opengl display, we drop already decoded frame(s) if a new
     // (already decoded) frame arrives before we have displayed the previous one
     L_RO_PROP(QString, decode_and_render_time, set_decode_and_render_time, "?")
+    // Avg. (and p99) time the render thread spends uploading a frame to the video texture(s) and, for the PBO path,
+    // the time the decoder thread spends copying the frame into the mapped buffer
+    L_RO_PROP(QString, texture_upload_time, set_texture_upload_time, "?")
+    // Presentation mode, estimated display refresh rate, n of refreshes that repeated the previous frame and
+    // the avg. time a decoded frame was queued before it was presented
+    L_RO_PROP(QString, frame_pacing, set_frame_pacing, "?")
+    // Per pipeline stage latency percentiles (p50/p95/p99/max in ms) from the FrameLatencyTracer, one line per stage
+    L_RO_PROP(QString, frame_latency_trace, set_frame_latency_trace, "?")
     L_RO_PROP(int, n_renderer_dropped_frames, set_n_renderer_dropped_frames, -1)
     L_RO_PROP(int, n_rendered_frames, set_n_rendered_frames, -1)
     L_RO_PROP(int, udp_rx_bitrate, set_udp_rx_bitrate, -1)
+    // packets/s, receive syscalls/s and receive thread CPU time per MBit (see UDPReceiver::RxStats)
+    L_RO_PROP(QString, udp_rx_stats, set_udp_rx_stats, "?")
     L_RO_PROP(QString, primary_stream_frame_format, set_primary_stream_frame_format, "?")
     // SW or HW decode
     L_RO_PROP(QString, decoding_type, set_decoding_type, "?")
     L_RO_PROP(int, n_missing_rtp_video_packets, set_n_missing_rtp_video_packets, -1)
+    // Only if the rtp reorder window is enabled: packets that arrived out of order (but in time),
+    // packets that arrived too late (dropped) and packets that never arrived
+    L_RO_PROP(int, n_rtp_reordered_packets, set_n_rtp_reordered_packets, -1)
+    L_RO_PROP(int, n_rtp_late_packets, set_n_rtp_late_packets, -1)
+    L_RO_PROP(int, n_rtp_lost_packets, set_n_rtp_lost_packets, -1)
     // In QOpenHD (rtp udp receiver) measured bitrate
     L_RO_PROP(QString, rtp_measured_bitrate, set_rtp_measured_bitrate, "-1")
     L_RO_PROP(QString, estimate_rtp_fps, set_estimate_rtp_fps, "-1")
     L_RO_PROP(int, estimate_keyframe_interval, set_estimate_keyframe_interval, -1)
+    // Per frame (access unit) averages: n slices, n bytes and assembly time
+    L_RO_PROP(QString, access_unit_stats, set_access_unit_stats, "?")
     // Not link related - n frame(s) we had to drop since the decoder cannot keep up with
     // the data stream that is provided to it
     L_RO_PROP(int,n_decoder_dropped_frames,set_n_decoder_dropped_frames, -1)
+    // Breakdown of the above: dropped non-reference frames, frames dropped while skipping ahead to the next keyframe
+    // and n of times we had to skip ahead
+    L_RO_PROP(QString,decoder_overload_drops,set_decoder_overload_drops, "?")
+    // Total n of NALU buffer (backing storage) allocations - should stop increasing once the stream is running
+    L_RO_PROP(int,n_nalu_buffer_allocations,set_n_nalu_buffer_allocations, -1)
+    // How often the decode thread wakes up per second - roughly the frame rate when video is flowing, low when idle
+    L_RO_PROP(int,decoder_wakeups_per_second,set_decoder_wakeups_per_second, -1)
+    // Time from (re)starting the decoder until the first frame came out, and n of frames it was primed with (GOP cache)
+    L_RO_PROP(QString,time_to_first_frame,set_time_to_first_frame, "?")
+    // Gap between the last frame before and the first frame after an in-place decoder re-configure (e.g. resolution switch)
+    L_RO_PROP(QString,decoder_switch_gap,set_decoder_switch_gap, "?")
+    // Active sw decode threading, n threads, measured decode time and the latency added by frame threading
+    L_RO_PROP(QString,decode_threading,set_decode_threading, "?")
+    // What this stream costs: CPU usage of the decode thread in % of one core (avcodec slice / frame worker threads are not included)
+    // and GL thread time per frame (texture upload + draw)
+    L_RO_PROP(QString,stream_cost,set_stream_cost, "?")
 public:
     explicit DecodingStatistcs(QObject *parent = nullptr);
     static DecodingStatistcs& instance();
+    static DecodingStatistcs& instanceSecondary();
+    static DecodingStatistcs& instance(bool primary){
+        return primary ? instance() : instanceSecondary();
+    }
     void reset_all_to_default();
 
     void util_set_primary_stream_frame_format(std::string format,int width_px,int height_px);
+    void util_set_time_to_first_frame(std::chrono::steady_clock::duration time_to_first_frame,int n_primed_frames);
+    void util_set_decoder_switch_gap(std::chrono::steady_clock::duration gap,int width_px,int height_px);
+    void util_set_frame_pacing(const std::string& mode,std::chrono::nanoseconds refresh_interval,int n_repeated,std::chrono::nanoseconds avg_queue_residency);
+    void util_set_texture_upload_time(std::chrono::steady_clock::duration upload_time,std::chrono::steady_clock::duration upload_time_p99,std::chrono::steady_clock::duration copy_time,bool via_pbo);
+    // cpu_percent: of one core, -1 if unknown
+    void util_set_stream_cost(float cpu_percent,std::chrono::nanoseconds gl_time_per_frame);
+    // Writes the per stage timestamps of the last frames to a csv file, returns a message for the UI
+    Q_INVOKABLE QString dump_frame_latency_trace();
 };
 
 #endif // DECODINGSTATISTCS_H
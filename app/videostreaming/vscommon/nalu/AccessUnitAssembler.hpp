@@ -0,0 +1,104 @@
+#ifndef ACCESSUNITASSEMBLER_HPP
+#define ACCESSUNITASSEMBLER_HPP
+
+#include <chrono>
+#include <functional>
+#include <cstring>
+
+#include "NALU.hpp"
+#include "NALUBufferPool.hpp"
+
+/**
+ * Groups all the slices (vcl NALUs) of one picture into one contiguous buffer (access unit), such that the decoder
+ * gets exactly one packet per frame. An access unit is complete when either
+ * 1) the rtp marker bit was set on the last packet of a slice (lowest latency, set by pretty much all rtp payloaders)
+ * 2) the next picture starts (AUD, config data, prefix SEI or a slice with first_mb_in_slice==0 / first_slice_segment_in_pic_flag==1)
+ * Single slice pictures are forwarded without a copy, multi slice pictures are copied once into a pooled buffer.
+ * Not thread safe.
+ */
+class AccessUnitAssembler{
+public:
+    struct AccessUnitInfo{
+        int n_slices;
+        size_t n_bytes;
+        // time between the first slice of this picture being handed to the assembler and the access unit being complete
+        std::chrono::nanoseconds assembly_time;
+    };
+    typedef std::function<void(NALUBuffer access_unit,const AccessUnitInfo& info)> ACCESS_UNIT_CALLBACK;
+    AccessUnitAssembler(bool is_h265,ACCESS_UNIT_CALLBACK cb):m_is_h265(is_h265),m_cb(std::move(cb)){}
+    // Feed a vcl NALU (slice). end_of_access_unit: the rtp marker bit was set on the last packet of this slice.
+    void on_slice(NALUBuffer slice,const bool end_of_access_unit){
+        const NALU& nalu=slice.get_nal();
+        if(m_n_slices>0 && nalu.is_first_slice_in_picture()){
+            // The previous picture is complete (marker bit was missing)
+            flush();
+        }
+        if(m_n_slices==0){
+            m_start=std::chrono::steady_clock::now();
+            m_pending_first_slice=std::move(slice);
+            m_n_slices=1;
+        }else{
+            if(m_n_slices==1){
+                // 2nd slice - from now on we need a contiguous buffer
+                const NALU& first=m_pending_first_slice.get_nal();
+                m_au_creation_time=first.creationTime;
+                m_au_rtp_timestamp=first.rtp_timestamp;
+                m_au_size=0;
+                m_au_buffer=NALUBufferPool::instance().acquire(std::max(m_au_size_hint,first.getSize()+nalu.getSize()));
+                append(first.getData(),first.getSize());
+                m_pending_first_slice=NALUBuffer{};
+            }
+            append(nalu.getData(),nalu.getSize());
+            m_n_slices++;
+        }
+        if(end_of_access_unit){
+            flush();
+        }
+    }
+    // Something that can only come before the first slice of a new picture has been received (e.g. an AUD),
+    // forward whatever we have.
+    void flush(){
+        if(m_n_slices==0)return;
+        AccessUnitInfo info{};
+        info.n_slices=m_n_slices;
+        info.assembly_time=std::chrono::steady_clock::now()-m_start;
+        if(m_n_slices==1){
+            info.n_bytes=m_pending_first_slice.get_nal().getSize();
+            m_n_slices=0;
+            m_cb(std::move(m_pending_first_slice),info);
+            m_pending_first_slice=NALUBuffer{};
+            return;
+        }
+        info.n_bytes=m_au_size;
+        m_au_size_hint=std::max(m_au_size,m_au_size_hint-m_au_size_hint/16);
+        m_au_buffer->size=m_au_size;
+        m_n_slices=0;
+        m_au_size=0;
+        m_cb(NALUBuffer(std::move(m_au_buffer),m_is_h265,m_au_creation_time,m_au_rtp_timestamp),info);
+        m_au_buffer=nullptr;
+    }
+private:
+    void append(const uint8_t* data,size_t data_len){
+        if(m_au_size+data_len>m_au_buffer->capacity){
+            auto bigger=NALUBufferPool::instance().acquire(std::max(m_au_size+data_len,m_au_buffer->capacity*2));
+            std::memcpy(bigger->data.get(),m_au_buffer->data.get(),m_au_size);
+            m_au_buffer=std::move(bigger);
+        }
+        std::memcpy(m_au_buffer->data.get()+m_au_size,data,data_len);
+        m_au_size+=data_len;
+    }
+    const bool m_is_h265;
+    const ACCESS_UNIT_CALLBACK m_cb;
+    int m_n_slices=0;
+    std::chrono::steady_clock::time_point m_start;
+    // Only used as long as the picture consists of one slice
+    NALUBuffer m_pending_first_slice{};
+    // Only used for multi slice pictures
+    NALUBufferPool::Buffer m_au_buffer=nullptr;
+    size_t m_au_size=0;
+    size_t m_au_size_hint=64*1024;
+    std::chrono::steady_clock::time_point m_au_creation_time;
+    uint32_t m_au_rtp_timestamp=0;
+};
+
+#endif // ACCESSUNITASSEMBLER_HPP
@@ -0,0 +1,89 @@
+#ifndef DECODERQUEUE_HPP
+#define DECODERQUEUE_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+#include "NALU.hpp"
+
+/**
+ * Bounded fifo of frames (NALUs or access units) from the rtp receiver to the decoder thread.
+ * Unlike a plain (lock free) circular buffer, frames that are already queued can be dropped again:
+ * If the decoder cannot keep up, dropping a queued non-reference frame costs exactly one frame, while dropping an
+ * incoming reference frame corrupts everything until the next keyframe. The lock is only held for a few pointer moves.
+ * Thread safe, one producer and one consumer.
+ */
+class DecoderQueue{
+public:
+    enum class EnqueueResult{
+        QUEUED,
+        // queued, but only after dropping the oldest queued non-reference frame to make up for the overload
+        QUEUED_EVICTED_NON_REFERENCE,
+        // overloaded and nothing left to evict, the given (non-reference) frame was dropped
+        DROPPED_NON_REFERENCE,
+        // overloaded and nothing left to evict, the given reference frame was dropped -
+        // the decoder cannot continue until the next random access point
+        DROPPED_REFERENCE
+    };
+    explicit DecoderQueue(size_t capacity):m_capacity(std::max(capacity,(size_t)1)){}
+    // overloaded: there is already more video queued than the caller wants (e.g. in ms of video).
+    // A full queue is treated the same. The frame is consumed in any case.
+    EnqueueResult enqueue(NALUBuffer&& frame,bool overloaded){
+        EnqueueResult result=EnqueueResult::QUEUED;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if(overloaded || m_queue.size()>=m_capacity){
+                auto it=std::find_if(m_queue.begin(),m_queue.end(),[](const NALUBuffer& queued){
+                    return is_droppable(queued.get_nal());
+                });
+                if(it==m_queue.end()){
+                    return frame.get_nal().is_non_reference() ? EnqueueResult::DROPPED_NON_REFERENCE : EnqueueResult::DROPPED_REFERENCE;
+                }
+                m_queue.erase(it);
+                result=EnqueueResult::QUEUED_EVICTED_NON_REFERENCE;
+            }
+            m_queue.push_back(std::move(frame));
+        }
+        m_cv.notify_one();
+        return result;
+    }
+    bool try_dequeue(NALUBuffer& frame){
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return pop_locked(frame);
+    }
+    bool wait_dequeue_timed(NALUBuffer& frame,std::chrono::microseconds timeout){
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait_for(lock,timeout,[this]{
+            return !m_queue.empty();
+        });
+        return pop_locked(frame);
+    }
+    size_t size()const{
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_queue.size();
+    }
+    void clear(){
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.clear();
+    }
+private:
+    // A picture nothing else refers to. Non vcl NALUs (e.g. end of sequence) are never dropped.
+    static bool is_droppable(const NALU& nalu){
+        return nalu.is_vcl() && nalu.is_non_reference();
+    }
+    bool pop_locked(NALUBuffer& frame){
+        if(m_queue.empty())return false;
+        frame=std::move(m_queue.front());
+        m_queue.pop_front();
+        return true;
+    }
+    const size_t m_capacity;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<NALUBuffer> m_queue;
+};
+
+#endif // DECODERQUEUE_HPP
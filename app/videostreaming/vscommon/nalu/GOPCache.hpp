@@ -0,0 +1,89 @@
+#ifndef GOPCACHE_HPP
+#define GOPCACHE_HPP
+
+#include <vector>
+#include <cstdint>
+
+#include "NALU.hpp"
+
+/**
+ * Keeps all the frames (NALUs or access units) since the most recent random access point (IDR / IRAP),
+ * such that a (re)started decoder can be primed immediately instead of waiting for the next keyframe.
+ * The frames are not copied - the cache holds a reference to the same pooled buffer that goes to the decoder
+ * (see NALUBufferPool::share()), the buffers return to the pool once the cache moves on to the next GOP.
+ * max_size_bytes limits the memory held (pooled buffer capacity, not payload size). If the GOP doesn't fit,
+ * the cache is invalid until the next random access point.
+ * Without access unit assembly a frame is a single NALU - all slices of a multi slice IRAP picture (same rtp timestamp)
+ * are kept, and the cache only starts with the first slice of a picture, such that a (re)started decoder never gets a
+ * partial keyframe.
+ * Not thread safe.
+ */
+class GOPCache{
+public:
+    explicit GOPCache(size_t max_size_bytes):m_max_size_bytes(max_size_bytes){
+        m_frames.reserve(256);
+    }
+    void on_frame(const NALUBuffer& frame){
+        if(m_max_size_bytes==0)return;
+        const NALU& nalu=frame.get_nal();
+        if(nalu.is_random_access_point()){
+            if(nalu.is_first_slice_in_picture()){
+                clear();
+                m_valid=true;
+                m_rap_picture_open=true;
+                m_rap_rtp_timestamp=nalu.rtp_timestamp;
+            }else if(!(m_rap_picture_open && nalu.rtp_timestamp==m_rap_rtp_timestamp)){
+                // We missed the first slice(s) of this picture - a partial keyframe is useless for priming the decoder
+                clear();
+                return;
+            }
+        }else if(nalu.is_vcl()){
+            // the next picture started
+            m_rap_picture_open=false;
+        }
+        if(!m_valid)return;
+        if(m_size_bytes+frame.get_capacity()>m_max_size_bytes){
+            // A partial GOP is useless for priming the decoder
+            clear();
+            return;
+        }
+        m_size_bytes+=frame.get_capacity();
+        m_frames.push_back(frame.share());
+    }
+    // All cached frames (shared, read only), in order, starting with the random access point.
+    // Empty if the cache is not valid.
+    std::vector<NALUBuffer> get_frames()const{
+        std::vector<NALUBuffer> ret;
+        if(!m_valid)return ret;
+        ret.reserve(m_frames.size());
+        for(const auto& frame:m_frames){
+            ret.push_back(frame.share());
+        }
+        return ret;
+    }
+    void clear(){
+        m_frames.clear();
+        m_size_bytes=0;
+        m_valid=false;
+        m_rap_picture_open=false;
+    }
+    bool is_valid()const{
+        return m_valid;
+    }
+    size_t get_n_frames()const{
+        return m_frames.size();
+    }
+    size_t get_size_bytes()const{
+        return m_size_bytes;
+    }
+private:
+    const size_t m_max_size_bytes;
+    std::vector<NALUBuffer> m_frames;
+    size_t m_size_bytes=0;
+    bool m_valid=false;
+    // The random access point the cache starts with, as long as further slices of it can follow
+    bool m_rap_picture_open=false;
+    uint32_t m_rap_rtp_timestamp=0;
+};
+
+#endif // GOPCACHE_HPP
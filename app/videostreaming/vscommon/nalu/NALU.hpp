@@ -19,6 +19,7 @@
 #include <memory>
 
 #include "NALUnitType.hpp"
+#include "NALUBufferPool.hpp"
 
 // dependency could be easily removed again
 #include <h264_common.h>
@@ -33,8 +34,9 @@
  */
 class NALU{
 public:
-    NALU(const uint8_t* data1,size_t data_len1,const bool IS_H265_PACKET1=false,const std::chrono::steady_clock::time_point creationTime=std::chrono::steady_clock::now()):
-            m_data(data1),m_data_len(data_len1),IS_H265_PACKET(IS_H265_PACKET1),creationTime{creationTime}
+    NALU(const uint8_t* data1,size_t data_len1,const bool IS_H265_PACKET1=false,const std::chrono::steady_clock::time_point creationTime=std::chrono::steady_clock::now(),
+         const uint32_t rtp_timestamp1=0):
+            m_data(data1),m_data_len(data_len1),IS_H265_PACKET(IS_H265_PACKET1),creationTime{creationTime},rtp_timestamp(rtp_timestamp1)
     {
         assert(hasValidPrefix());
         assert(getSize()>=getMinimumNaluSize(IS_H265_PACKET1));
@@ -54,6 +56,8 @@ public:
     const bool IS_H265_PACKET;
     // creation time is used to measure latency
     const std::chrono::steady_clock::time_point creationTime;
+    // rtp timestamp of the frame this NALU belongs to (0 if not from rtp), identifies the frame in the FrameLatencyTracer
+    const uint32_t rtp_timestamp;
 public:
     // returns true if starts with 0001, false otherwise
     bool hasValidPrefixLong()const{
@@ -155,6 +159,50 @@ public:
        }
        return false;
    }
+   // A picture the decoder can start decoding from (without any previous pictures)
+   // h264: IDR, h265: any IRAP (BLA, IDR, CRA)
+   bool is_random_access_point()const{
+       if(IS_H265_PACKET){
+           const auto nut=get_nal_unit_type();
+           return nut>=NALUnitType::H265::NAL_UNIT_CODED_SLICE_BLA_W_LP && nut<=NALUnitType::H265::NAL_UNIT_RESERVED_IRAP_VCL23;
+       }
+       return is_keyframe();
+   }
+   // Coded slice (aka picture data), h264: types 1..5, h265: types 0..31
+   bool is_vcl()const{
+       const auto nut=get_nal_unit_type();
+       if(IS_H265_PACKET){
+           return nut<=31;
+       }
+       return nut>=NALUnitType::H264::NAL_UNIT_TYPE_CODED_SLICE_NON_IDR && nut<=NALUnitType::H264::NAL_UNIT_TYPE_CODED_SLICE_IDR;
+   }
+   // Only valid for vcl NALUs. True if this is the first slice of a picture, aka a new access unit starts.
+   // h264: first_mb_in_slice==0 (ue(v) of 0 is a single '1' bit)
+   // h265: first_slice_segment_in_pic_flag==1
+   // In both cases this is the first bit after the NAL unit header.
+   bool is_first_slice_in_picture()const{
+       const int nal_header_size=IS_H265_PACKET ? 2 : 1;
+       if(getDataSizeWithoutPrefix()<=nal_header_size)return false;
+       return (getDataWithoutPrefix()[nal_header_size] & 0x80)!=0;
+   }
+   // Only valid for vcl NALUs. True if no other picture references this one, aka it can be dropped without
+   // breaking the decode of the following pictures.
+   // h264: nal_ref_idc==0, h265: sub-layer non-reference picture (TRAIL_N, TSA_N, STSA_N, RADL_N, RASL_N, even types <=14)
+   bool is_non_reference()const{
+       const auto nut=get_nal_unit_type();
+       if(IS_H265_PACKET){
+           return nut<=14 && (nut%2)==0;
+       }
+       return (getDataWithoutPrefix()[0] & 0x60)==0;
+   }
+   // NALUs that can only come before the first slice of a picture (AUD, config, prefix SEI)
+   bool is_access_unit_start_hint()const{
+       if(is_aud() || is_config())return true;
+       if(IS_H265_PACKET){
+           return get_nal_unit_type()==NALUnitType::H265::NAL_UNIT_PREFIX_SEI;
+       }
+       return is_sei();
+   }
    bool is_frame_but_not_keyframe() const {
        const auto nut = get_nal_unit_type();
        if (IS_H265_PACKET) return false;
@@ -196,26 +244,62 @@ public:
    }
 };
 
-// Copies the nalu data into its own c++-style managed buffer.
+// Owns the nalu data - the memory comes from the NALUBufferPool and is returned there once this buffer is destroyed.
+// Movable (e.g. through a queue), but not copyable. A default constructed buffer is empty.
 class NALUBuffer {
 public:
-    NALUBuffer(const uint8_t* data,int data_len,bool is_h265,std::chrono::steady_clock::time_point creation_time){
-        m_data=std::make_shared<std::vector<uint8_t>>(data,data+data_len);
-        m_nalu=std::make_unique<NALU>(m_data->data(),m_data->size(),is_h265,creation_time);
+    NALUBuffer()=default;
+    // copies the data into a buffer from the pool
+    NALUBuffer(const uint8_t* data,int data_len,bool is_h265,std::chrono::steady_clock::time_point creation_time,uint32_t rtp_timestamp=0){
+        m_buffer=NALUBufferPool::instance().acquire(data_len);
+        std::memcpy(m_buffer->data.get(),data,data_len);
+        m_buffer->size=data_len;
+        m_nalu.emplace(m_buffer->data.get(),m_buffer->size,is_h265,creation_time,rtp_timestamp);
+    }
+    NALUBuffer(const NALU& nalu):NALUBuffer(nalu.getData(),nalu.getSize(),nalu.IS_H265_PACKET,nalu.creationTime,nalu.rtp_timestamp){
     }
-    NALUBuffer(const NALU& nalu){
-        m_data=std::make_shared<std::vector<uint8_t>>(nalu.getData(),nalu.getData()+nalu.getSize());
-        m_nalu=std::make_unique<NALU>(m_data->data(),m_data->size(),nalu.IS_H265_PACKET,nalu.creationTime);
+    // Takes ownership of an already filled (pooled) buffer, no copy
+    NALUBuffer(NALUBufferPool::Buffer buffer,bool is_h265,std::chrono::steady_clock::time_point creation_time,uint32_t rtp_timestamp=0):
+        m_buffer(std::move(buffer)){
+        m_nalu.emplace(m_buffer->data.get(),m_buffer->size,is_h265,creation_time,rtp_timestamp);
     }
     NALUBuffer(const NALUBuffer&)=delete;
-    NALUBuffer(const NALUBuffer&&)=delete;
-
-    const NALU& get_nal(){
-        return *m_nalu;
+    NALUBuffer& operator=(const NALUBuffer&)=delete;
+    // The nalu only points to the (heap) storage, which doesn't move - we can just re-create it
+    NALUBuffer(NALUBuffer&& other) noexcept {
+        *this=std::move(other);
+    }
+    NALUBuffer& operator=(NALUBuffer&& other) noexcept {
+        m_nalu.reset();
+        m_buffer=std::move(other.m_buffer);
+        if(other.m_nalu.has_value()){
+            m_nalu.emplace(other.m_nalu.value());
+            other.m_nalu.reset();
+        }
+        return *this;
+    }
+    bool is_empty()const{
+        return !m_nalu.has_value();
+    }
+    // Another reference to the same (pooled) data, no copy. Neither buffer must be written anymore.
+    NALUBuffer share()const{
+        NALUBuffer ret{};
+        if(is_empty())return ret;
+        ret.m_buffer=NALUBufferPool::share(m_buffer);
+        ret.m_nalu.emplace(m_nalu.value());
+        return ret;
+    }
+    // Memory held by this buffer (the capacity of the pooled storage)
+    size_t get_capacity()const{
+        return m_buffer==nullptr ? 0 : m_buffer->capacity;
+    }
+    const NALU& get_nal()const{
+        assert(!is_empty());
+        return m_nalu.value();
     }
 private:
-    std::shared_ptr<std::vector<uint8_t>> m_data;
-    std::unique_ptr<NALU> m_nalu;
+    NALUBufferPool::Buffer m_buffer=nullptr;
+    std::optional<NALU> m_nalu=std::nullopt;
 };
 
 #endif //LIVE_VIDEO_10MS_ANDROID_NALU_H
@@ -0,0 +1,125 @@
+#ifndef NALUBUFFERPOOL_HPP
+#define NALUBUFFERPOOL_HPP
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+
+/**
+ * Size-classed pool of (re-usable) NALU buffers.
+ * The rtp parser reassembles NALUs directly into a buffer from this pool, which is then moved (not copied)
+ * through the queue to the decoder and returned to the pool once the decoder is done with it.
+ * In steady state, no memory is allocated - the free lists are pre-reserved and the backing storage is recycled.
+ * A buffer can be shared (e.g. with the GOP cache) - it is reference counted and returns to the pool once the last
+ * owner is done with it. A shared buffer must not be written anymore.
+ * Singleton, since buffers might outlive the RTPReceiver that created them.
+ * Thread safe (buffers are acquired on the udp receive thread and returned on the decoder thread).
+ */
+class NALUBufferPool{
+public:
+    struct Storage{
+        std::unique_ptr<uint8_t[]> data;
+        size_t capacity=0;
+        // n of valid bytes in data
+        size_t size=0;
+        // -1 if not pooled (too big for any size class)
+        int size_class=-1;
+        // n of Buffer(s) pointing to this storage, see share()
+        std::atomic<int> n_refs{1};
+    };
+    struct Recycler{
+        void operator()(Storage* storage)const{
+            if(storage->n_refs.fetch_sub(1)==1){
+                NALUBufferPool::instance().recycle(storage);
+            }
+        }
+    };
+    using Buffer=std::unique_ptr<Storage,Recycler>;
+    // Some consumers (e.g. avcodec) read a few bytes past the end of the data, we always add this much
+    // (zeroed) padding to each buffer. Same value as AV_INPUT_BUFFER_PADDING_SIZE.
+    static constexpr size_t PADDING_SIZE=64;
+    static constexpr std::array<size_t,4> SIZE_CLASSES{16*1024,64*1024,256*1024,1024*1024};
+    // Upper limit of free buffers we keep per size class, anything more is freed.
+    // The GOP cache holds on to all the frames of a GOP and releases them at once on the next keyframe - this needs to
+    // be big enough for a whole GOP, otherwise each keyframe would free buffers that then need to be allocated again.
+    static constexpr size_t MAX_FREE_PER_SIZE_CLASS=256;
+public:
+    static NALUBufferPool& instance(){
+        static NALUBufferPool* instance=new NALUBufferPool();
+        return *instance;
+    }
+    // Returns a buffer with at least min_capacity bytes of capacity and a size of 0
+    Buffer acquire(const size_t min_capacity){
+        const int size_class=get_size_class(min_capacity);
+        if(size_class<0){
+            m_n_allocations++;
+            return Buffer(create_storage(min_capacity,-1));
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto& free_list=m_free[size_class];
+            if(!free_list.empty()){
+                Storage* storage=free_list.back();
+                free_list.pop_back();
+                storage->size=0;
+                storage->n_refs=1;
+                return Buffer(storage);
+            }
+        }
+        m_n_allocations++;
+        return Buffer(create_storage(SIZE_CLASSES[size_class],size_class));
+    }
+    // Another owner of the same (read only from now on) storage, no copy.
+    static Buffer share(const Buffer& buffer){
+        if(buffer==nullptr)return nullptr;
+        buffer->n_refs++;
+        return Buffer(buffer.get());
+    }
+    // Total n of times we had to allocate new backing storage.
+    // Should stay constant once the stream is running.
+    int get_n_allocations()const{
+        return m_n_allocations;
+    }
+private:
+    NALUBufferPool(){
+        for(auto& free_list:m_free){
+            // Pre-reserve, such that returning a buffer never allocates
+            free_list.reserve(MAX_FREE_PER_SIZE_CLASS);
+        }
+    }
+    static int get_size_class(const size_t min_capacity){
+        for(size_t i=0;i<SIZE_CLASSES.size();i++){
+            if(min_capacity<=SIZE_CLASSES[i])return (int)i;
+        }
+        return -1;
+    }
+    static Storage* create_storage(const size_t capacity,const int size_class){
+        auto storage=new Storage();
+        storage->data=std::make_unique<uint8_t[]>(capacity+PADDING_SIZE);
+        std::memset(storage->data.get()+capacity,0,PADDING_SIZE);
+        storage->capacity=capacity;
+        storage->size_class=size_class;
+        return storage;
+    }
+    void recycle(Storage* storage){
+        if(storage==nullptr)return;
+        if(storage->size_class>=0){
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto& free_list=m_free[storage->size_class];
+            if(free_list.size()<MAX_FREE_PER_SIZE_CLASS){
+                free_list.push_back(storage);
+                return;
+            }
+        }
+        delete storage;
+    }
+    std::mutex m_mutex;
+    std::array<std::vector<Storage*>,SIZE_CLASSES.size()> m_free;
+    std::atomic<int> m_n_allocations{0};
+};
+
+#endif // NALUBUFFERPOOL_HPP
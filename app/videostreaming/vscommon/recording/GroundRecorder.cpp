@@ -0,0 +1,497 @@
+#include "GroundRecorder.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+
+#include <QDir>
+#include <QFileInfo>
+#include <qdebug.h>
+
+#include "../nalu/NALU.hpp"
+#include "groundrecordingmodel.h"
+#include "common/StringHelper.hpp"
+
+#ifdef QOPENHD_ENABLE_VIDEO_VIA_AVCODEC
+extern "C" {
+#include <libavformat/avformat.h>
+}
+#endif
+
+// A file we write via plain fds, such that we control when the data is fsync'ed
+class FdFile{
+public:
+    ~FdFile(){
+        close();
+    }
+    bool open(const std::string& filename){
+        m_fd=::open(filename.c_str(),O_WRONLY | O_CREAT | O_TRUNC,0644);
+        if(m_fd<0){
+            qDebug()<<"GroundRecorder cannot open "<<filename.c_str()<<" "<<strerror(errno);
+            return false;
+        }
+        return true;
+    }
+    bool write_all(const uint8_t* data,size_t size){
+        while(size>0){
+            const ssize_t ret=::write(m_fd,data,size);
+            if(ret<0){
+                if(errno==EINTR)continue;
+                return false;
+            }
+            data+=ret;
+            size-=ret;
+            m_n_bytes+=ret;
+        }
+        return true;
+    }
+    int64_t seek(int64_t offset,int whence){
+        return lseek(m_fd,offset,whence);
+    }
+    int64_t get_file_size()const{
+        struct stat st{};
+        if(fstat(m_fd,&st)!=0)return -1;
+        return st.st_size;
+    }
+    void sync(){
+        if(m_fd>=0){
+#if defined(__linux__)
+            fdatasync(m_fd);
+#else
+            // no fdatasync on macOS / iOS
+            fsync(m_fd);
+#endif
+        }
+    }
+    void close(){
+        if(m_fd>=0){
+            fsync(m_fd);
+            ::close(m_fd);
+            m_fd=-1;
+        }
+    }
+    uint64_t get_n_written_bytes()const{
+        return m_n_bytes;
+    }
+private:
+    int m_fd=-1;
+    uint64_t m_n_bytes=0;
+};
+
+class SegmentWriter{
+public:
+    virtual ~SegmentWriter()=default;
+    // config_data: SPS,PPS(,VPS) as Annex-B
+    virtual bool open(const std::string& filename,const std::vector<uint8_t>& config_data,int width,int height)=0;
+    // One frame (all the NALUs of one access unit, Annex-B), pts in 90kHz
+    virtual bool write_frame(const uint8_t* data,size_t size,int64_t pts,bool is_keyframe)=0;
+    virtual void close()=0;
+    FdFile& get_file(){
+        return m_file;
+    }
+protected:
+    FdFile m_file;
+};
+
+class RawSegmentWriter : public SegmentWriter{
+public:
+    bool open(const std::string& filename,const std::vector<uint8_t>& config_data,int /*width*/,int /*height*/)override{
+        if(!m_file.open(filename))return false;
+        // the first frame is a keyframe, but it might come without the config data
+        return m_file.write_all(config_data.data(),config_data.size());
+    }
+    bool write_frame(const uint8_t* data,size_t size,int64_t /*pts*/,bool /*is_keyframe*/)override{
+        return m_file.write_all(data,size);
+    }
+    void close()override{
+        m_file.close();
+    }
+};
+
+#ifdef QOPENHD_ENABLE_VIDEO_VIA_AVCODEC
+// The muxers convert the Annex-B extradata / packets to avcC / hvcC and length prefixed NALUs themselves
+class AVFormatSegmentWriter : public SegmentWriter{
+public:
+    AVFormatSegmentWriter(GroundRecorder::Container container,bool is_h265):m_container(container),m_is_h265(is_h265){}
+    ~AVFormatSegmentWriter(){
+        close();
+    }
+    bool open(const std::string& filename,const std::vector<uint8_t>& config_data,int width,int height)override{
+        if(!m_file.open(filename))return false;
+        const char* format=m_container==GroundRecorder::Container::MP4 ? "mp4" : "matroska";
+        if(avformat_alloc_output_context2(&m_ctx,nullptr,format,nullptr)<0 || m_ctx==nullptr){
+            qDebug()<<"GroundRecorder cannot create muxer "<<format;
+            return false;
+        }
+        static constexpr int AVIO_BUFFER_SIZE=64*1024;
+        uint8_t* avio_buffer=(uint8_t*)av_malloc(AVIO_BUFFER_SIZE);
+        m_avio=avio_alloc_context(avio_buffer,AVIO_BUFFER_SIZE,1,this,nullptr,&AVFormatSegmentWriter::avio_write,&AVFormatSegmentWriter::avio_seek);
+        if(m_avio==nullptr){
+            av_free(avio_buffer);
+            return false;
+        }
+        m_ctx->pb=m_avio;
+        m_ctx->flags|=AVFMT_FLAG_CUSTOM_IO;
+        m_stream=avformat_new_stream(m_ctx,nullptr);
+        if(m_stream==nullptr)return false;
+        m_stream->time_base=AVRational{1,90000};
+        AVCodecParameters* par=m_stream->codecpar;
+        par->codec_type=AVMEDIA_TYPE_VIDEO;
+        par->codec_id=m_is_h265 ? AV_CODEC_ID_HEVC : AV_CODEC_ID_H264;
+        par->width=width;
+        par->height=height;
+        par->extradata=(uint8_t*)av_mallocz(config_data.size()+AV_INPUT_BUFFER_PADDING_SIZE);
+        if(par->extradata==nullptr)return false;
+        std::memcpy(par->extradata,config_data.data(),config_data.size());
+        par->extradata_size=(int)config_data.size();
+        AVDictionary* options=nullptr;
+        if(m_container==GroundRecorder::Container::MP4){
+            // no moov at the end, playable even if we never get to write the trailer
+            av_dict_set(&options,"movflags","frag_keyframe+empty_moov+default_base_moof",0);
+        }
+        const int ret=avformat_write_header(m_ctx,&options);
+        av_dict_free(&options);
+        if(ret<0){
+            qDebug()<<"GroundRecorder avformat_write_header failed "<<ret;
+            return false;
+        }
+        m_packet=av_packet_alloc();
+        m_header_written=true;
+        m_last_dts=AV_NOPTS_VALUE;
+        return m_packet!=nullptr;
+    }
+    bool write_frame(const uint8_t* data,size_t size,int64_t pts,bool is_keyframe)override{
+        if(!m_header_written)return false;
+        m_packet->data=(uint8_t*)data;
+        m_packet->size=(int)size;
+        m_packet->stream_index=m_stream->index;
+        m_packet->pts=av_rescale_q(pts,AVRational{1,90000},m_stream->time_base);
+        // e.g. mkv uses ms - two frames must not end up with the same timestamp
+        if(m_last_dts!=AV_NOPTS_VALUE && m_packet->pts<=m_last_dts){
+            m_packet->pts=m_last_dts+1;
+        }
+        m_packet->dts=m_packet->pts;
+        m_packet->flags=is_keyframe ? AV_PKT_FLAG_KEY : 0;
+        m_last_dts=m_packet->dts;
+        const int ret=av_write_frame(m_ctx,m_packet);
+        m_packet->data=nullptr;
+        m_packet->size=0;
+        return ret>=0;
+    }
+    void close()override{
+        if(m_header_written){
+            av_write_trailer(m_ctx);
+            m_header_written=false;
+        }
+        if(m_avio!=nullptr){
+            avio_flush(m_avio);
+            av_freep(&m_avio->buffer);
+            avio_context_free(&m_avio);
+        }
+        if(m_ctx!=nullptr){
+            avformat_free_context(m_ctx);
+            m_ctx=nullptr;
+        }
+        av_packet_free(&m_packet);
+        m_file.close();
+    }
+private:
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+    static int avio_write(void* opaque,const uint8_t* buf,int buf_size){
+#else
+    static int avio_write(void* opaque,uint8_t* buf,int buf_size){
+#endif
+        auto self=(AVFormatSegmentWriter*)opaque;
+        return self->m_file.write_all(buf,buf_size) ? buf_size : AVERROR(EIO);
+    }
+    static int64_t avio_seek(void* opaque,int64_t offset,int whence){
+        auto self=(AVFormatSegmentWriter*)opaque;
+        if(whence==AVSEEK_SIZE){
+            return self->m_file.get_file_size();
+        }
+        return self->m_file.seek(offset,whence & ~AVSEEK_FORCE);
+    }
+    const GroundRecorder::Container m_container;
+    const bool m_is_h265;
+    AVFormatContext* m_ctx=nullptr;
+    AVIOContext* m_avio=nullptr;
+    AVStream* m_stream=nullptr;
+    AVPacket* m_packet=nullptr;
+    bool m_header_written=false;
+    int64_t m_last_dts=0;
+};
+#endif
+
+static std::string create_segment_filename(const std::string& directory,const std::string& extension){
+    const std::time_t now=std::time(nullptr);
+    std::tm tm{};
+#ifdef _WIN32
+    localtime_s(&tm,&now);
+#else
+    localtime_r(&now,&tm);
+#endif
+    std::stringstream base;
+    base<<directory<<"/qopenhd_"<<std::put_time(&tm,"%Y%m%d_%H%M%S");
+    std::string filename=base.str()+extension;
+    // more than one segment per second (e.g. a decoder restart right after the previous segment was closed) - don't overwrite
+    for(int i=1;QFileInfo::exists(QString::fromStdString(filename));i++){
+        filename=base.str()+"_"+std::to_string(i)+extension;
+    }
+    return filename;
+}
+
+GroundRecorder::GroundRecorder(Configuration config,GET_CONFIG_DATA_CB get_config_data,GET_WIDTH_HEIGHT_CB get_width_height)
+    : m_config(std::move(config)),
+      m_get_config_data(std::move(get_config_data)),
+      m_get_width_height(std::move(get_width_height))
+{
+#ifndef QOPENHD_ENABLE_VIDEO_VIA_AVCODEC
+    if(m_config.container!=Container::RAW){
+        qDebug()<<"GroundRecorder built without avformat, recording raw Annex-B";
+    }
+#endif
+    m_writer_thread=std::make_unique<std::thread>([this]{
+        loop_writer();
+    });
+}
+
+GroundRecorder::~GroundRecorder()
+{
+    m_running=false;
+    if(m_writer_thread->joinable()){
+        m_writer_thread->join();
+    }
+}
+
+std::string GroundRecorder::container_to_extension(Container container, bool is_h265)
+{
+#ifdef QOPENHD_ENABLE_VIDEO_VIA_AVCODEC
+    if(container==Container::MKV)return ".mkv";
+    if(container==Container::MP4)return ".mp4";
+#endif
+    return is_h265 ? ".h265" : ".h264";
+}
+
+void GroundRecorder::on_nalu(const uint8_t *data, size_t data_len, bool rtp_marker, uint32_t rtp_timestamp)
+{
+    if(!GroundRecordingModel::instance().is_recording_requested()){
+        m_producer_active=false;
+        return;
+    }
+    if(!m_producer_active){
+        m_producer_active=true;
+        m_waiting_for_start=true;
+        m_drop_until_keyframe=false;
+    }
+    const NALU nalu(data,data_len,m_config.is_h265);
+    const bool is_keyframe=nalu.is_config() || nalu.is_random_access_point();
+    if(m_waiting_for_start){
+        // Make sure we start with a keyframe, the writer thread would discard everything else anyways
+        if(!is_keyframe)return;
+        m_waiting_for_start=false;
+    }
+    if(m_drop_until_keyframe){
+        if(!is_keyframe){
+            on_dropped(rtp_timestamp);
+            return;
+        }
+        m_drop_until_keyframe=false;
+    }
+    const size_t buffered=m_buffered_bytes.load(std::memory_order_relaxed)+data_len;
+    if(buffered>m_config.max_buffered_bytes){
+        // Dropping a reference frame breaks everything until the next keyframe
+        m_drop_until_keyframe=true;
+        on_dropped(rtp_timestamp);
+        return;
+    }
+    if(buffered>m_config.max_buffered_bytes/2 && nalu.is_vcl() && nalu.is_non_reference()){
+        on_dropped(rtp_timestamp);
+        return;
+    }
+    Item item{};
+    item.buffer=NALUBufferPool::instance().acquire(data_len);
+    std::memcpy(item.buffer->data.get(),data,data_len);
+    item.buffer->size=data_len;
+    item.rtp_marker=rtp_marker;
+    item.rtp_timestamp=rtp_timestamp;
+    item.is_keyframe=is_keyframe;
+    item.arrival=std::chrono::steady_clock::now();
+    m_buffered_bytes+=data_len;
+    if(!m_queue.try_enqueue(std::move(item))){
+        m_buffered_bytes-=data_len;
+        m_drop_until_keyframe=true;
+        on_dropped(rtp_timestamp);
+    }
+}
+
+void GroundRecorder::on_dropped(uint32_t rtp_timestamp)
+{
+    // count frames, not NALUs
+    if(!m_has_last_dropped || rtp_timestamp!=m_last_dropped_rtp_timestamp){
+        m_n_dropped_frames++;
+    }
+    m_has_last_dropped=true;
+    m_last_dropped_rtp_timestamp=rtp_timestamp;
+}
+
+void GroundRecorder::loop_writer()
+{
+    while(m_running){
+        Item item{};
+        if(m_queue.wait_dequeue_timed(item,std::chrono::milliseconds(100))){
+            m_buffered_bytes-=item.buffer->size;
+            if(GroundRecordingModel::instance().is_recording_requested()){
+                on_item(std::move(item));
+            }
+        }
+        if(!GroundRecordingModel::instance().is_recording_requested() && m_segment!=nullptr){
+            m_frame.clear();
+            close_segment();
+            m_n_segments=0;
+            m_n_bytes_total=0;
+            publish_status(true);
+        }
+        if(m_segment!=nullptr && std::chrono::steady_clock::now()-m_last_fsync>=m_config.fsync_interval){
+            m_segment->get_file().sync();
+            m_last_fsync=std::chrono::steady_clock::now();
+        }
+        publish_status(false);
+    }
+    if(m_segment!=nullptr){
+        close_segment();
+        publish_status(true);
+    }
+}
+
+void GroundRecorder::on_item(Item item)
+{
+    // A NALU with a new rtp timestamp also completes the previous frame (in case the packet with the marker bit was lost)
+    if(!m_frame.empty() && item.rtp_timestamp!=m_frame_rtp_timestamp){
+        write_frame();
+    }
+    if(m_frame.empty()){
+        m_frame_rtp_timestamp=item.rtp_timestamp;
+        m_frame_arrival=item.arrival;
+        m_frame_is_keyframe=false;
+    }
+    m_frame_is_keyframe|=item.is_keyframe;
+    m_frame.insert(m_frame.end(),item.buffer->data.get(),item.buffer->data.get()+item.buffer->size);
+    if(item.rtp_marker){
+        write_frame();
+    }
+}
+
+void GroundRecorder::write_frame()
+{
+    const auto now=std::chrono::steady_clock::now();
+    if(m_segment!=nullptr && m_frame_is_keyframe && m_config.segment_minutes>0 &&
+            now-m_segment_begin>=std::chrono::minutes(m_config.segment_minutes)){
+        close_segment();
+    }
+    if(m_segment==nullptr){
+        // Each segment starts with a keyframe
+        if(!m_frame_is_keyframe || !open_segment()){
+            m_frame.clear();
+            return;
+        }
+        m_last_pts=0;
+    }else{
+        // Use the rtp timestamps, unless they are obviously broken - then fall back to the arrival time
+        int64_t delta=(int32_t)(m_frame_rtp_timestamp-m_last_rtp_timestamp);
+        if(delta<=0 || delta>10*90000){
+            delta=std::chrono::duration_cast<std::chrono::microseconds>(m_frame_arrival-m_last_arrival).count()*90/1000;
+        }
+        m_last_pts+=std::max<int64_t>(delta,1);
+    }
+    m_last_rtp_timestamp=m_frame_rtp_timestamp;
+    m_last_arrival=m_frame_arrival;
+    if(!m_segment->write_frame(m_frame.data(),m_frame.size(),m_last_pts,m_frame_is_keyframe)){
+        qDebug()<<"GroundRecorder write failed, closing "<<m_segment_filename.c_str();
+        close_segment();
+    }
+    m_frame.clear();
+}
+
+bool GroundRecorder::open_segment()
+{
+    const auto config_data=m_get_config_data();
+    if(config_data==nullptr){
+        return false;
+    }
+    const auto width_height=m_get_width_height();
+    if(!QDir().mkpath(QString::fromStdString(m_config.directory))){
+        qDebug()<<"GroundRecorder cannot create "<<m_config.directory.c_str();
+    }
+    std::unique_ptr<SegmentWriter> segment;
+#ifdef QOPENHD_ENABLE_VIDEO_VIA_AVCODEC
+    if(m_config.container!=Container::RAW){
+        segment=std::make_unique<AVFormatSegmentWriter>(m_config.container,m_config.is_h265);
+    }
+#endif
+    if(segment==nullptr){
+        segment=std::make_unique<RawSegmentWriter>();
+    }
+    const std::string filename=create_segment_filename(m_config.directory,container_to_extension(m_config.container,m_config.is_h265));
+    if(!segment->open(filename,*config_data,width_height[0],width_height[1])){
+        segment->close();
+        return false;
+    }
+    qDebug()<<"GroundRecorder recording to "<<filename.c_str()<<" "<<width_height[0]<<"x"<<width_height[1];
+    const auto now=std::chrono::steady_clock::now();
+    if(m_n_segments==0){
+        m_recording_begin=now;
+        m_n_dropped_frames=0;
+    }
+    m_segment=std::move(segment);
+    m_segment_filename=filename;
+    m_segment_begin=now;
+    m_last_fsync=now;
+    m_n_segments++;
+    publish_status(true);
+    return true;
+}
+
+void GroundRecorder::close_segment()
+{
+    if(m_segment==nullptr)return;
+    m_segment->close();
+    m_n_bytes_total+=m_segment->get_file().get_n_written_bytes();
+    qDebug()<<"GroundRecorder closed "<<m_segment_filename.c_str();
+    m_segment=nullptr;
+}
+
+void GroundRecorder::publish_status(bool force)
+{
+    const auto now=std::chrono::steady_clock::now();
+    if(!force && now-m_last_status<std::chrono::seconds(1))return;
+    m_last_status=now;
+    auto& model=GroundRecordingModel::instance();
+    const bool active=m_segment!=nullptr;
+    model.set_recording_active(active);
+    model.set_n_dropped_frames((int)m_n_dropped_frames);
+    if(!active){
+        model.set_recording_file("");
+        if(model.is_recording_requested()){
+            model.set_recording_status("waiting for keyframe");
+        }
+        return;
+    }
+    const auto n_bytes=m_n_bytes_total+m_segment->get_file().get_n_written_bytes();
+    const auto seconds=std::chrono::duration_cast<std::chrono::seconds>(now-m_recording_begin).count();
+    std::stringstream ss;
+    ss<<std::setfill('0')<<seconds/60<<":"<<std::setw(2)<<seconds%60<<" "<<StringHelper::memorySizeReadable(n_bytes);
+    if(m_n_segments>1){
+        ss<<" seg:"<<m_n_segments;
+    }
+    if(m_n_dropped_frames>0){
+        ss<<" dropped:"<<m_n_dropped_frames;
+    }
+    model.set_recording_file(QString::fromStdString(m_segment_filename));
+    model.set_recording_status(QString::fromStdString(ss.str()));
+}
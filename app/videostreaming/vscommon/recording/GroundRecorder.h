@@ -0,0 +1,109 @@
+#ifndef GROUNDRECORDER_H
+#define GROUNDRECORDER_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "app/common/moodycamel/readerwriterqueue/readerwritercircularbuffer.h"
+#include "../nalu/NALUBufferPool.hpp"
+
+class SegmentWriter;
+
+/**
+ * Ground side recording (DVR) of the received video stream, without re-encoding.
+ * The receive thread only copies each NALU into a (pooled) buffer and hands it to a lock free SPSC ring -
+ * a writer thread groups the NALUs into frames and muxes them into mkv / mp4 (via avformat) or writes the raw
+ * Annex-B stream, with timestamps from the rtp timestamps. Segments always start with a keyframe (using the config data
+ * cached by the KeyFrameFinder) and are rotated every N minutes. The file is fsync'ed in (time) batches, such that
+ * a slow SD card only stalls the writer thread.
+ * If the writer thread cannot keep up (disk stall), memory is bounded: above half of the max. buffered size only
+ * non-reference frames are dropped (the recording stays decodable), above the max. everything is dropped until the next keyframe.
+ * Recording is started / stopped via the GroundRecordingModel, which also shows the state.
+ */
+class GroundRecorder
+{
+public:
+    enum class Container{
+        MKV=0,
+        // fragmented mp4, such that a recording that was not closed properly (e.g. power loss) can still be played
+        MP4=1,
+        // raw Annex-B (.h264 / .h265), can be played back via the ReplaySource
+        RAW=2,
+    };
+    struct Configuration{
+        std::string directory;
+        Container container=Container::MKV;
+        bool is_h265=false;
+        // 0 == no rotation
+        int segment_minutes=10;
+        size_t max_buffered_bytes=32*1024*1024;
+        std::chrono::milliseconds fsync_interval{1000};
+    };
+    // Config data (SPS,PPS(,VPS)) as Annex-B, nullptr if not available yet
+    typedef std::function<std::shared_ptr<std::vector<uint8_t>>()> GET_CONFIG_DATA_CB;
+    // Only called once the config data is available
+    typedef std::function<std::array<int,2>()> GET_WIDTH_HEIGHT_CB;
+    GroundRecorder(Configuration config,GET_CONFIG_DATA_CB get_config_data,GET_WIDTH_HEIGHT_CB get_width_height);
+    ~GroundRecorder();
+    // Receive thread (single producer). NALU with start code, as it comes out of the RTPDecoder.
+    // Does nothing (but an atomic load) if recording is not requested.
+    void on_nalu(const uint8_t* data,size_t data_len,bool rtp_marker,uint32_t rtp_timestamp);
+    static std::string container_to_extension(Container container,bool is_h265);
+private:
+    struct Item{
+        NALUBufferPool::Buffer buffer;
+        bool rtp_marker=false;
+        uint32_t rtp_timestamp=0;
+        // config or random access point - a segment can start with the frame this NALU belongs to
+        bool is_keyframe=false;
+        std::chrono::steady_clock::time_point arrival;
+    };
+    const Configuration m_config;
+    const GET_CONFIG_DATA_CB m_get_config_data;
+    const GET_WIDTH_HEIGHT_CB m_get_width_height;
+    moodycamel::BlockingReaderWriterCircularBuffer<Item> m_queue{2048};
+    std::atomic<size_t> m_buffered_bytes{0};
+    std::atomic<uint64_t> m_n_dropped_frames{0};
+    // receive thread only
+    bool m_producer_active=false;
+    bool m_waiting_for_start=false;
+    bool m_drop_until_keyframe=false;
+    bool m_has_last_dropped=false;
+    uint32_t m_last_dropped_rtp_timestamp=0;
+    void on_dropped(uint32_t rtp_timestamp);
+private:
+    // writer thread only
+    void loop_writer();
+    void on_item(Item item);
+    void write_frame();
+    bool open_segment();
+    void close_segment();
+    void publish_status(bool force);
+    std::unique_ptr<std::thread> m_writer_thread;
+    std::atomic<bool> m_running{true};
+    std::unique_ptr<SegmentWriter> m_segment;
+    // the frame (access unit) currently being assembled
+    std::vector<uint8_t> m_frame;
+    bool m_frame_is_keyframe=false;
+    uint32_t m_frame_rtp_timestamp=0;
+    std::chrono::steady_clock::time_point m_frame_arrival;
+    // pts (90kHz) of the last written frame in the current segment
+    int64_t m_last_pts=0;
+    uint32_t m_last_rtp_timestamp=0;
+    std::chrono::steady_clock::time_point m_last_arrival;
+    std::chrono::steady_clock::time_point m_segment_begin;
+    std::chrono::steady_clock::time_point m_recording_begin;
+    std::chrono::steady_clock::time_point m_last_fsync;
+    std::chrono::steady_clock::time_point m_last_status;
+    uint64_t m_n_bytes_total=0;
+    int m_n_segments=0;
+    std::string m_segment_filename;
+};
+
+#endif // GROUNDRECORDER_H
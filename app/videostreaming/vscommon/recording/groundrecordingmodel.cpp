@@ -0,0 +1,25 @@
+#include "groundrecordingmodel.h"
+
+#include <qdebug.h>
+
+GroundRecordingModel::GroundRecordingModel(QObject *parent)
+    : QObject{parent}
+{
+
+}
+
+GroundRecordingModel &GroundRecordingModel::instance()
+{
+    static GroundRecordingModel model{};
+    return model;
+}
+
+void GroundRecordingModel::set_recording(bool enable)
+{
+    qDebug()<<"GroundRecordingModel::set_recording "<<enable;
+    m_requested=enable;
+    set_recording_requested(enable);
+    if(!enable){
+        set_recording_status("");
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef GROUNDRECORDINGMODEL_H
+#define GROUNDRECORDINGMODEL_H
+
+#include <QObject>
+#include <atomic>
+
+#include "lib/lqtutils_master/lqtutils_prop.h"
+
+/**
+ * Exposes the ground side recording (DVR) of the primary video stream to the UI and lets the user start / stop it.
+ * singleton, corresponding qt name is "_groundRecording" (see main)
+ * The actual recording is done by the GroundRecorder of the RTPReceiver, which reads the requested state and
+ * publishes its state here.
+ */
+class GroundRecordingModel : public QObject
+{
+    Q_OBJECT
+    // The user wants to record (recording starts with the next keyframe)
+    L_RO_PROP(bool, recording_requested, set_recording_requested, false)
+    // A file is open and frames are written to it
+    L_RO_PROP(bool, recording_active, set_recording_active, false)
+    // Current segment (file name)
+    L_RO_PROP(QString, recording_file, set_recording_file, "")
+    // Recorded time, size, n of segments and dropped frames, for the record widget
+    L_RO_PROP(QString, recording_status, set_recording_status, "")
+    // Frames that could not be recorded since the disk could not keep up
+    L_RO_PROP(int, n_dropped_frames, set_n_dropped_frames, 0)
+public:
+    explicit GroundRecordingModel(QObject *parent = nullptr);
+    static GroundRecordingModel& instance();
+    Q_INVOKABLE void set_recording(bool enable);
+    // Cheap, called on the receive thread for each NALU
+    bool is_recording_requested()const{
+        return m_requested;
+    }
+private:
+    std::atomic<bool> m_requested{false};
+};
+
+#endif // GROUNDRECORDINGMODEL_H
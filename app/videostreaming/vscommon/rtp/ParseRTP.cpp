@@ -5,6 +5,7 @@
 #include "ParseRTP.h"
 #include <cstring>
 #include <iostream>
+#include <algorithm>
 #include <qdebug.h>
 
 #define MLOGD qDebug()
@@ -29,7 +30,31 @@ static int diff_between_packets(int last_packet,int curr_packet){
 RTPDecoder::RTPDecoder(RTP_FRAME_DATA_CALLBACK cb,bool feed_incomplete_frames): m_cb(std::move(cb)),m_feed_incomplete_frames(feed_incomplete_frames){
 }
 
+void RTPDecoder::set_reorder_window(int max_n_packets, std::chrono::microseconds max_delay)
+{
+    if(max_n_packets<=0){
+        m_reorder_buffer=nullptr;
+        return;
+    }
+    MLOGD<<"RTP reorder window "<<max_n_packets<<" packets "<<(int)max_delay.count()<<"us";
+    m_reorder_buffer=std::make_unique<RTPReorderBuffer>(max_n_packets,max_delay);
+}
+
+RTPDecoder::ReorderStats RTPDecoder::get_reorder_stats() const
+{
+    ReorderStats ret{};
+    if(m_reorder_buffer){
+        ret.n_reordered=m_reorder_buffer->m_n_reordered;
+        ret.n_late=m_reorder_buffer->m_n_late;
+        ret.n_lost=m_reorder_buffer->m_n_lost;
+    }
+    return ret;
+}
+
 void RTPDecoder::reset(){
+    if(m_reorder_buffer){
+        m_reorder_buffer->reset();
+    }
     m_nalu_data_length=0;
     lastSequenceNumber=-1;
     flagPacketHasGoneMissing=false;
@@ -94,6 +119,9 @@ void RTPDecoder::h264_reconstruct_and_forward_one_nalu(const uint8_t *data,const
         //MLOGD<<"Got full NALU - clearing missing packet flag";
         flagPacketHasGoneMissing= false;
     }
+    // We know the exact size of the NALU here, no need to use the size hint
+    m_nalu_data_length=0;
+    ensure_capacity(4+data_size,false);
     write_h264_h265_nalu_start();
     const uint8_t h264_nal_header = (uint8_t )(nalu_header.type & 0x1f)
                                     | (nalu_header.nri << 5)
@@ -109,6 +137,16 @@ void RTPDecoder::h264_reconstruct_and_forward_one_nalu(const uint8_t *data,const
 }
 
 void RTPDecoder::parseRTPH264toNALU(const uint8_t* rtp_data, const size_t data_length){
+    if(m_reorder_buffer){
+        m_reorder_buffer->on_packet(rtp_data,data_length,[this](const uint8_t* data,const size_t data_len){
+            parse_rtp_h264_in_order(data,data_len);
+        });
+        return;
+    }
+    parse_rtp_h264_in_order(rtp_data,data_length);
+}
+
+void RTPDecoder::parse_rtp_h264_in_order(const uint8_t* rtp_data, const size_t data_length){
     //12 rtp header bytes and 1 nalu_header_t type byte
     if(data_length <= sizeof(rtp_header_t)+sizeof(nalu_header_t)){
         MLOGD<<"Not enough rtp data";
@@ -120,6 +158,8 @@ void RTPDecoder::parseRTPH264toNALU(const uint8_t* rtp_data, const size_t data_l
     if(!validateRTPPacket(rtpPacket.header)){
         return;
     }
+    m_curr_packet_marker=rtpPacket.header.marker;
+    m_curr_packet_rtp_timestamp=rtpPacket.header.getTimestamp();
     const auto& nalu_header=rtpPacket.getNALUHeaderH264();
     if (nalu_header.type == 28) { /* FU-A */
         //MLOGD<<"Got RTP H264 type 28 (fragmented) payload size:"<<rtpPacket.rtpPayloadSize;
@@ -173,6 +213,7 @@ void RTPDecoder::parseRTPH264toNALU(const uint8_t* rtp_data, const size_t data_l
        //MLOGD<<"Got RTP H264 type 24 (aggregated NALUs) payload size:"<<rtpPacket.rtpPayloadSize;
         const uint8_t* rtp_payload=rtpPacket.rtpPayload;
         const auto rtp_payload_size=rtpPacket.rtpPayloadSize;
+        const bool packet_marker=m_curr_packet_marker;
         int offset=0;
         while(true){
             // the size of the (n-th) nalu starts at offset+1 (1 byte STAP-A NAL HDR )
@@ -182,6 +223,8 @@ void RTPDecoder::parseRTPH264toNALU(const uint8_t* rtp_data, const size_t data_l
             const uint8_t* actual_nalu_data_p=&rtp_payload[offset+1+2];
             const auto actual_nalu_size=nalu_size;
             //MLOGD<<"XNALU of size:"<<(int)actual_nalu_size;
+            const bool is_last_nalu=!(rtp_payload_size>offset+2+actual_nalu_size+3);
+            m_curr_packet_marker=packet_marker && is_last_nalu;
             h264_reconstruct_and_forward_one_nalu(actual_nalu_data_p,actual_nalu_size);
             offset+=2+actual_nalu_size;
             if(!(rtp_payload_size>offset+3)){
@@ -206,6 +249,8 @@ void RTPDecoder::h265_forward_one_nalu(const uint8_t *data, int data_size,bool w
         //MLOGD<<"Got full NALU - clearing missing packet flag";
         flagPacketHasGoneMissing= false;
     }
+    m_nalu_data_length=0;
+    ensure_capacity(4+data_size,false);
     write_h264_h265_nalu_start(write_4_bytes_for_start_code);
     // I do not know what about the 'DONL' field but it seems to be never present
     // copy the NALU header and NALU data, other than h264 here nothing has to be 'reconstructed'
@@ -215,6 +260,16 @@ void RTPDecoder::h265_forward_one_nalu(const uint8_t *data, int data_size,bool w
 }
 
 void RTPDecoder::parseRTPH265toNALU(const uint8_t* rtp_data, const size_t data_length){
+    if(m_reorder_buffer){
+        m_reorder_buffer->on_packet(rtp_data,data_length,[this](const uint8_t* data,const size_t data_len){
+            parse_rtp_h265_in_order(data,data_len);
+        });
+        return;
+    }
+    parse_rtp_h265_in_order(rtp_data,data_length);
+}
+
+void RTPDecoder::parse_rtp_h265_in_order(const uint8_t* rtp_data, const size_t data_length){
     // 12 rtp header bytes and 1 nalu_header_t type byte
     if(data_length <= sizeof(rtp_header_t)+sizeof(nal_unit_header_h265_t)){
         MLOGD<<"Not enough rtp data";
@@ -226,6 +281,8 @@ void RTPDecoder::parseRTPH265toNALU(const uint8_t* rtp_data, const size_t data_l
     if(!validateRTPPacket(rtpPacket.header)){
         return;
     }
+    m_curr_packet_marker=rtpPacket.header.marker;
+    m_curr_packet_rtp_timestamp=rtpPacket.header.getTimestamp();
     const auto& nal_unit_header_h265=rtpPacket.getNALUHeaderH265();
     if (nal_unit_header_h265.type > 50){
         MLOGD<<"Unsupported (HEVC) NAL type "<<(int)nal_unit_header_h265.type;
@@ -235,6 +292,7 @@ void RTPDecoder::parseRTPH265toNALU(const uint8_t* rtp_data, const size_t data_l
         //MLOGD<<"Got RTP H265 type 48 (aggregated) payload size:"<<rtpPacket.rtpPayloadSize;
         const uint8_t* rtp_payload=rtpPacket.rtpPayload;
         const auto rtp_payload_size=rtpPacket.rtpPayloadSize;
+        const bool packet_marker=m_curr_packet_marker;
         int offset=0;
         while(true){
             // the size of the (n-th) nalu starts at offset+1 (1 byte STAP-A NAL HDR )
@@ -246,6 +304,8 @@ void RTPDecoder::parseRTPH265toNALU(const uint8_t* rtp_data, const size_t data_l
             const uint8_t* actual_nalu_data_p=&rtp_payload[offset+don_offset+1+2];
             const auto actual_nalu_size=nalu_size;
             //MLOGD<<"XNALU of size:"<<(int)actual_nalu_size;
+            const bool is_last_nalu=!(rtp_payload_size>offset+2+actual_nalu_size+3);
+            m_curr_packet_marker=packet_marker && is_last_nalu;
             h265_forward_one_nalu(actual_nalu_data_p,actual_nalu_size);
             offset+=2+actual_nalu_size;
             if(!(rtp_payload_size>offset+3)){
@@ -309,24 +369,46 @@ void RTPDecoder::parse_rtp_mjpeg(const uint8_t *rtp_data, const size_t data_leng
 }
 
 void RTPDecoder::forwardNALU(const bool isH265) {
-    if(m_cb!= nullptr){
+    if(m_cb!= nullptr && m_curr_nalu!=nullptr){
         // if either the rtp encoder is buggy or the premise of increasing sequence numbers is not given, this
         // callback might be called with grabage data. Try and catch that as early as possible.
         if(!check_curr_nalu_has_valid_prefix(true)){
+            m_nalu_data_length=0;
             return;
         }
-        uint8_t* p=&m_curr_nalu.at(0);
-        m_cb(timePointStartOfReceivingNALU,p,m_nalu_data_length);
+        m_nalu_size_hint=std::max(m_nalu_data_length,m_nalu_size_hint-m_nalu_size_hint/16);
+        m_curr_nalu->size=m_nalu_data_length;
+        m_cb(timePointStartOfReceivingNALU,std::move(m_curr_nalu),m_curr_packet_marker,m_curr_packet_rtp_timestamp);
+        m_curr_nalu=nullptr;
     }
     m_nalu_data_length=0;
 }
 
-void RTPDecoder::append_nalu_data(const uint8_t *data, size_t data_len) {
-    if(m_nalu_data_length+data_len>m_curr_nalu.size()){
+bool RTPDecoder::ensure_capacity(size_t data_len,bool use_size_hint)
+{
+    const size_t required=m_nalu_data_length+data_len;
+    if(required>NALU_MAXLEN){
         MLOGD<<"Weird - not enugh space to write NALU. curr_size:"<<m_nalu_data_length<<" append:"<<data_len;
+        return false;
+    }
+    if(m_curr_nalu==nullptr){
+        m_curr_nalu=NALUBufferPool::instance().acquire(use_size_hint ? std::max(required,m_nalu_size_hint) : required);
+        return true;
+    }
+    if(required>m_curr_nalu->capacity){
+        // Rare, switch to a buffer of a bigger size class
+        auto bigger=NALUBufferPool::instance().acquire(std::max(required,m_curr_nalu->capacity*2));
+        std::memcpy(bigger->data.get(),m_curr_nalu->data.get(),m_nalu_data_length);
+        m_curr_nalu=std::move(bigger);
+    }
+    return true;
+}
+
+void RTPDecoder::append_nalu_data(const uint8_t *data, size_t data_len) {
+    if(!ensure_capacity(data_len)){
         return;
     }
-    uint8_t* p=&m_curr_nalu.at(m_nalu_data_length);
+    uint8_t* p=m_curr_nalu->data.get()+m_nalu_data_length;
     memcpy(p,data,data_len);
     m_nalu_data_length+=data_len;
 }
@@ -338,11 +420,10 @@ void RTPDecoder::append_nalu_data_byte(uint8_t byte)
 
 void RTPDecoder::append_empty(size_t data_len)
 {
-    if(m_nalu_data_length+data_len>m_curr_nalu.size()){
-        MLOGD<<"Weird - not enugh space to write NALU. curr_size:"<<m_nalu_data_length<<" append:"<<data_len;
+    if(!ensure_capacity(data_len)){
         return;
     }
-    uint8_t* p=&m_curr_nalu.at(m_nalu_data_length);
+    uint8_t* p=m_curr_nalu->data.get()+m_nalu_data_length;
     std::memset(p,0,data_len);
     m_nalu_data_length+=data_len;
 }
@@ -393,7 +474,8 @@ bool RTPDecoder::check_has_valid_prefix(const uint8_t *nalu_data, int nalu_data_
 
 bool RTPDecoder::check_curr_nalu_has_valid_prefix(bool use_4_bytes_start_code)
 {
-    uint8_t* p=&m_curr_nalu.at(0);
+    if(m_curr_nalu==nullptr)return false;
+    const uint8_t* p=m_curr_nalu->data.get();
     return check_has_valid_prefix(p,m_nalu_data_length,use_4_bytes_start_code);
 }
 
@@ -10,6 +10,9 @@
 #include <functional>
 #include <array>
 #include "RTP.hpp"
+#include "../nalu/NALUBufferPool.hpp"
+#include "RTPReorderBuffer.hpp"
+#include <memory>
 
 /*********************************************
  ** Parses a stream of rtp h264 / h265 data into NALUs.
@@ -19,12 +22,17 @@
  ** No special dependencies other than std library.
  ** R.n Supports single, aggregated and fragmented rtp packets for both h264 and h265.
  ** Data is forwarded directly via a callback for no thread scheduling overhead
+** NALUs are reassembled directly into a buffer from the NALUBufferPool, which is then handed over via the callback
+** (aka no extra copy / allocation per NALU)
 **********************************************/
 
 // Enough for pretty much any resolution/framerate we handle in OpenHD
 static constexpr const auto NALU_MAXLEN=1024*1024;
 
-typedef std::function<void(const std::chrono::steady_clock::time_point creation_time,const uint8_t* nalu_data,const int nalu_data_size)> RTP_FRAME_DATA_CALLBACK;
+// The buffer holds exactly one NALU (buffer->size bytes), ownership is passed to the callback
+// rtp_marker: the rtp marker bit was set on the packet that completed this NALU, aka this is the last NALU of an access unit.
+// rtp_timestamp: rtp timestamp of the packet(s) this NALU was reassembled from (same for all NALUs of one frame)
+typedef std::function<void(const std::chrono::steady_clock::time_point creation_time,NALUBufferPool::Buffer nalu_buffer,bool rtp_marker,uint32_t rtp_timestamp)> RTP_FRAME_DATA_CALLBACK;
 
 class RTPDecoder{
 public:
@@ -40,10 +48,25 @@ public:
     void parseRTPH264toNALU(const uint8_t* rtp_data, const size_t data_length);
     // parse rtp h265 packet to NALU
     void parseRTPH265toNALU(const uint8_t* rtp_data, const size_t data_length);
+    // Hold back out of order packets for up to max_n_packets / max_delay, such that they can be parsed in order.
+    // Needs to be called before any data is parsed. max_n_packets<=0 disables the reorder window (default)
+    void set_reorder_window(int max_n_packets,std::chrono::microseconds max_delay);
+    struct ReorderStats{
+        int n_reordered=0;
+        int n_late=0;
+        int n_lost=0;
+    };
+    // all 0 if the reorder window is disabled
+    ReorderStats get_reorder_stats()const;
     // exp
     void parse_rtp_mjpeg(const uint8_t* rtp_data, const size_t data_length);
     // reset to defaults
     void reset();
+private:
+    // Same as the public parse functions, but without the reorder stage
+    void parse_rtp_h264_in_order(const uint8_t* rtp_data, const size_t data_length);
+    void parse_rtp_h265_in_order(const uint8_t* rtp_data, const size_t data_length);
+    std::unique_ptr<RTPReorderBuffer> m_reorder_buffer=nullptr;
 private:
     // Write 0,0,0,1 (or 0,0,1) into the start of the NALU buffer and set the length to 4 / 3
     void write_h264_h265_nalu_start(bool use_4_bytes=true);
@@ -53,13 +76,24 @@ private:
     // like append_nalu_data, but for one byte
     void append_nalu_data_byte(uint8_t byte);
     void append_empty(size_t data_len);
+    // Make sure the current NALU buffer can hold data_len more bytes - acquires a (bigger) buffer from the pool if needed.
+    // Returns false if the NALU would exceed NALU_MAXLEN
+    // use_size_hint: set to false if the final size of the NALU is already known (e.g. single / aggregated packets)
+    bool ensure_capacity(size_t data_len,bool use_size_hint=true);
     // Properly calls the cb function (if not null)
     // Resets the m_nalu_data_length to 0
     void forwardNALU(const bool isH265=false);
     const RTP_FRAME_DATA_CALLBACK m_cb;
-    //std::shared_ptr<std::array<uint8_t,NALU_MAXLEN>> m_curr_nalu{};
-    std::array<uint8_t,NALU_MAXLEN> m_curr_nalu;
+    // Buffer the current NALU is reassembled into, nullptr after it has been forwarded
+    NALUBufferPool::Buffer m_curr_nalu=nullptr;
     size_t m_nalu_data_length=0;
+    // Initial capacity requested from the pool for a new NALU - tracks the (slowly decaying) max NALU size,
+    // such that we rarely need to switch to a bigger buffer during reassembly.
+    size_t m_nalu_size_hint=64*1024;
+    // Marker bit of the rtp packet that is currently parsed (for aggregated packets, only set while forwarding the last NALU)
+    bool m_curr_packet_marker=false;
+    // Timestamp of the rtp packet that is currently parsed
+    uint32_t m_curr_packet_rtp_timestamp=0;
     bool m_feed_incomplete_frames;
     int m_total_n_fragments_for_current_fu=0;
 private:
@@ -0,0 +1,181 @@
+#ifndef RTPREORDERBUFFER_HPP
+#define RTPREORDERBUFFER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "RTP.hpp"
+
+/**
+ * Small rtp reorder (jitter) window keyed on the 16 bit rtp sequence number.
+ * In order packets are forwarded immediately (no added latency). Once a gap is detected, following packets are held back until either
+ * 1) the gap is filled (the packets are then released in order)
+ * 2) more than max_n_packets would have to be held back or
+ * 3) the oldest held back packet has been waiting for more than max_delay
+ * In case 2) and 3) the missing packet(s) are considered lost and skipped.
+ * Note that the deadline is only checked when a new packet arrives - this is fine for a continuous video stream.
+ * Not thread safe, use from the udp receive thread only.
+ */
+class RTPReorderBuffer{
+public:
+    RTPReorderBuffer(int max_n_packets,std::chrono::microseconds max_delay):
+        m_window_size(std::max(max_n_packets,1)),
+        m_max_delay(max_delay),
+        m_slots(next_power_of_2(m_window_size))
+    {
+    }
+    // Packets that arrived after a packet with a higher sequence number, but in time to be released in order
+    int m_n_reordered=0;
+    // Packets that arrived after we already gave up on them (dropped)
+    int m_n_late=0;
+    // Packets that never arrived (skipped after the window / deadline expired)
+    int m_n_lost=0;
+    int m_n_duplicates=0;
+    // cb is called for each packet, in order. Data is only valid for the duration of the cb.
+    template<class OUTPUT_CB>
+    void on_packet(const uint8_t* rtp_data,const size_t data_length,OUTPUT_CB&& cb){
+        if(data_length<sizeof(rtp_header_t)){
+            return;
+        }
+        const auto now=std::chrono::steady_clock::now();
+        const uint16_t seq=((const rtp_header_t*)rtp_data)->getSequence();
+        if(m_next_seq<0){
+            m_next_seq=seq;
+            m_highest_seq=seq;
+        }
+        const int diff=seq_diff(seq,(uint16_t)m_next_seq);
+        if(diff<0){
+            // We already released / skipped this sequence number
+            m_n_late++;
+            m_n_consecutive_late++;
+            if(m_n_consecutive_late>m_window_size){
+                // Most likely the sender restarted (and therefore the sequence numbers jumped back), re-sync
+                flush_and_resync(seq,cb);
+            }else{
+                release_expired(now,cb);
+                return;
+            }
+        }
+        m_n_consecutive_late=0;
+        if(seq_diff(seq,(uint16_t)m_next_seq)>=MAX_FORWARD_JUMP){
+            // Huge jump forward (sender restart or a really long link outage), re-sync instead of skipping packet by packet
+            flush_and_resync(seq,cb);
+        }
+        if(seq_diff(seq,(uint16_t)m_highest_seq)<0){
+            m_n_reordered++;
+        }else{
+            m_highest_seq=seq;
+        }
+        if(seq==m_next_seq && m_n_buffered==0){
+            // fast path, in order and nothing held back
+            cb(rtp_data,data_length);
+            advance();
+            return;
+        }
+        // Make space - everything that doesn't fit into the window is either released or lost
+        while(seq_diff(seq,(uint16_t)m_next_seq)>=m_window_size){
+            release_or_skip_next(cb);
+        }
+        Slot& slot=m_slots[seq % m_slots.size()];
+        if(slot.used && slot.seq==seq){
+            m_n_duplicates++;
+        }else{
+            slot.used=true;
+            slot.seq=seq;
+            slot.arrival=now;
+            // re-uses the allocated memory of the slot
+            slot.data.assign(rtp_data,rtp_data+data_length);
+            m_n_buffered++;
+        }
+        release_in_order(cb);
+        release_expired(now,cb);
+    }
+    // Forget all state (e.g. on restart)
+    void reset(){
+        for(auto& slot:m_slots){
+            slot.used=false;
+        }
+        m_n_buffered=0;
+        m_next_seq=-1;
+        m_highest_seq=-1;
+        m_n_consecutive_late=0;
+    }
+private:
+    struct Slot{
+        bool used=false;
+        uint16_t seq=0;
+        std::chrono::steady_clock::time_point arrival;
+        std::vector<uint8_t> data;
+    };
+    // Max n of sequence numbers we hold back at once
+    const int m_window_size;
+    const std::chrono::microseconds m_max_delay;
+    // power of 2 (and >= the window size), such that seq % size stays consistent when the sequence number wraps around
+    std::vector<Slot> m_slots;
+    int m_n_buffered=0;
+    int m_n_consecutive_late=0;
+    static constexpr int MAX_FORWARD_JUMP=1000;
+    static size_t next_power_of_2(int value){
+        size_t ret=1;
+        while(ret<(size_t)value)ret*=2;
+        return ret;
+    }
+    // next sequence number to release, -1 if no packet received yet
+    int m_next_seq=-1;
+    int m_highest_seq=-1;
+    // signed difference between 2 rtp sequence numbers, taking the uint16_t overflow into account
+    static int seq_diff(uint16_t a,uint16_t b){
+        return (int16_t)(uint16_t)(a-b);
+    }
+    void advance(){
+        m_next_seq=(m_next_seq+1) % (UINT16_MAX+1);
+    }
+    // Release everything we have in order (and count the holes as lost), then continue at seq
+    template<class OUTPUT_CB>
+    void flush_and_resync(const uint16_t seq,OUTPUT_CB& cb){
+        while(m_n_buffered>0){
+            release_or_skip_next(cb);
+        }
+        m_next_seq=seq;
+        m_highest_seq=seq;
+        m_n_consecutive_late=0;
+    }
+    template<class OUTPUT_CB>
+    void release_or_skip_next(OUTPUT_CB& cb){
+        Slot& slot=m_slots[m_next_seq % m_slots.size()];
+        if(slot.used && slot.seq==m_next_seq){
+            cb(slot.data.data(),slot.data.size());
+            slot.used=false;
+            m_n_buffered--;
+        }else{
+            m_n_lost++;
+        }
+        advance();
+    }
+    template<class OUTPUT_CB>
+    void release_in_order(OUTPUT_CB& cb){
+        while(m_n_buffered>0){
+            Slot& slot=m_slots[m_next_seq % m_slots.size()];
+            if(!(slot.used && slot.seq==m_next_seq))break;
+            release_or_skip_next(cb);
+        }
+    }
+    // Skip over missing packet(s) as long as the oldest held back packet has exceeded the deadline
+    template<class OUTPUT_CB>
+    void release_expired(const std::chrono::steady_clock::time_point now,OUTPUT_CB& cb){
+        while(m_n_buffered>0){
+            auto oldest=now;
+            for(const auto& slot:m_slots){
+                if(slot.used && slot.arrival<oldest)oldest=slot.arrival;
+            }
+            if(now-oldest<m_max_delay)break;
+            // skip until the next held back packet, then release whatever is in order
+            release_or_skip_next(cb);
+            release_in_order(cb);
+        }
+    }
+};
+
+#endif // RTPREORDERBUFFER_HPP
@@ -1,6 +1,7 @@
 #include "rtpreceiver.h"
 
 #include <qdebug.h>
+#include <algorithm>
 
 #include "common/StringHelper.hpp"
 #include "common/openhd-util.hpp"
@@ -9,32 +10,70 @@
 
 #include "QOpenHDVideoHelper.hpp"
 #include "decodingstatistcs.h"
+#include "FrameLatencyTracer.hpp"
 
-RTPReceiver::RTPReceiver(const int port,const std::string ip,bool is_h265,bool feed_incomplete_frames):
-    is_h265(is_h265)
+RTPReceiver::RTPReceiver(const int port,const std::string ip,bool is_h265,const QOpenHDVideoHelper::GenericVideoSettings& generic_settings,bool is_primary):
+    m_port(port),
+    m_ip(ip),
+    is_h265(is_h265),
+    m_generic_settings(generic_settings),
+    m_is_primary(is_primary),
+    m_stats(DecodingStatistcs::instance(is_primary))
 {
     if(ip!=std::string(QOpenHDVideoHelper::kDefault_udp_rtp_input_ip_address)){
         qWarning()<<"Using non-default dev_stream0_udp_rtp_input_ip_address";
     }
-    if(port!=QOpenHDVideoHelper::kDefault_udp_rtp_input_port_primary){
+    const int default_port=is_primary ? QOpenHDVideoHelper::kDefault_udp_rtp_input_port_primary : QOpenHDVideoHelper::kDefault_udp_rtp_input_port_secondary;
+    if(port!=default_port){
         qWarning()<<"Using non-default udp_rtp_input_port";
     }
-    if(false){
-        // Debug write raw data to file
-        std::stringstream ss;
-        ss<<"/tmp/received_rtp.";
-        if(is_h265){
-            ss<<"h265";
-        }else{
-            ss<<"h264";
-        }
-        m_out_file=std::make_unique<std::ofstream>(ss.str());
-    }
     m_keyframe_finder=std::make_unique<KeyFrameFinder>();
+    // Ground recording, latency tracing and replay are only for the primary stream
+    if(is_primary){
+        GroundRecorder::Configuration recorder_config{};
+        recorder_config.directory=generic_settings.ground_recording_directory;
+        recorder_config.container=(GroundRecorder::Container)std::clamp(generic_settings.ground_recording_container,0,2);
+        recorder_config.is_h265=is_h265;
+        recorder_config.segment_minutes=generic_settings.ground_recording_segment_minutes;
+        recorder_config.max_buffered_bytes=(size_t)std::max(generic_settings.ground_recording_max_buffer_mb,1)*1024*1024;
+        m_ground_recorder=std::make_unique<GroundRecorder>(recorder_config,[this](){
+            return this->get_config_data();
+        },[this](){
+            return this->sps_get_width_height();
+        });
+    }
+    if(generic_settings.dev_rtp_gop_cache_size_kb>0){
+        m_gop_cache=std::make_unique<GOPCache>(generic_settings.dev_rtp_gop_cache_size_kb*1024);
+    }
 
-    m_rtp_decoder=std::make_unique<RTPDecoder>([this](const std::chrono::steady_clock::time_point creation_time,const uint8_t *nalu_data, const int nalu_data_size){
-        this->nalu_data_callback(creation_time,nalu_data,nalu_data_size);
-    },feed_incomplete_frames);
+    if(generic_settings.dev_rtp_assemble_access_units){
+        m_au_assembler=std::make_unique<AccessUnitAssembler>(is_h265,[this](NALUBuffer access_unit,const AccessUnitAssembler::AccessUnitInfo& info){
+            this->on_new_access_unit(std::move(access_unit),info);
+        });
+    }
+    if(is_primary){
+        FrameLatencyTracer::instance().set_enabled(generic_settings.dev_frame_latency_tracer);
+    }
+    m_rtp_decoder=std::make_unique<RTPDecoder>([this](const std::chrono::steady_clock::time_point creation_time,NALUBufferPool::Buffer nalu_buffer,bool rtp_marker,uint32_t rtp_timestamp){
+        this->nalu_data_callback(creation_time,std::move(nalu_buffer),rtp_marker,rtp_timestamp);
+    },generic_settings.dev_feed_incomplete_frames_to_decoder);
+    m_rtp_decoder->set_reorder_window(generic_settings.dev_rtp_reorder_window_packets,std::chrono::microseconds(generic_settings.dev_rtp_reorder_window_us));
+    if(is_primary && generic_settings.dev_video_replay){
+        ReplaySource::Configuration replay_config{};
+        replay_config.filename=generic_settings.dev_video_replay_file;
+        replay_config.speed=generic_settings.dev_video_replay_speed_percent/100.0;
+        replay_config.loop=true;
+        replay_config.annexb_is_h265=is_h265;
+        m_replay_source=std::make_unique<ReplaySource>("V_REPLAY",replay_config,[this](const UDPReceiver::Datagram* datagrams,size_t n_datagrams){
+            this->udp_raw_data_batch_callback(datagrams,n_datagrams);
+        });
+        if(m_replay_source->load()){
+            m_replay_source->start();
+            return;
+        }
+        HUDLogMessagesModel::instance().add_message_warning("Cannot replay video, using udp");
+        m_replay_source=nullptr;
+    }
     // Increase the OS max UDP buffer size (only works as root) such that the UDP receiver
     // doesn't fail when requesting a bigger UDP buffer size
     OHDUtil::run_command("sysctl ",{"-w","net.core.rmem_max=26214400"});
@@ -42,9 +81,13 @@ RTPReceiver::RTPReceiver(const int port,const std::string ip,bool is_h265,bool f
     udp_config.opt_os_receive_buff_size=UDPReceiver::BIG_UDP_RECEIVE_BUFFER_SIZE;
     udp_config.set_sched_param_max_realtime=true;
     udp_config.enable_nonblocking=false;
-    m_udp_receiver=std::make_unique<UDPReceiver>("V_REC",udp_config,[this](const uint8_t *payload, const std::size_t payloadSize){
-        this->udp_raw_data_callback(payload,payloadSize);
-        DecodingStatistcs::instance().set_n_missing_rtp_video_packets(m_rtp_decoder->m_n_gaps);
+    udp_config.recvmmsg_batch_size=generic_settings.dev_udp_recvmmsg_batch_size;
+    udp_config.enable_udp_gro=generic_settings.dev_udp_enable_gro;
+    m_udp_receiver=std::make_unique<UDPReceiver>(is_primary ? "V_REC" : "V_REC2",udp_config,[this](const UDPReceiver::Datagram* datagrams,size_t n_datagrams){
+        this->udp_raw_data_batch_callback(datagrams,n_datagrams);
+    });
+    m_udp_receiver->set_rx_stats_callback([this](const UDPReceiver::RxStats& stats){
+        m_stats.set_udp_rx_stats(stats.to_string().c_str());
     });
     m_udp_receiver->startReceiving();
 }
@@ -54,18 +97,27 @@ RTPReceiver::~RTPReceiver()
    if(m_udp_receiver){
        m_udp_receiver->stopReceiving();
    }
+   if(m_replay_source){
+       m_replay_source->stop();
+   }
+   // the writer thread uses the keyframe finder
+   m_ground_recorder=nullptr;
 }
 
 
-std::shared_ptr<NALUBuffer> RTPReceiver::get_next_frame(std::optional<std::chrono::microseconds> timeout)
+std::optional<NALUBuffer> RTPReceiver::get_next_frame(std::optional<std::chrono::microseconds> timeout)
 {
-    std::shared_ptr<NALUBuffer> ret=nullptr;
-    //qDebug()<<"get_data size_estimate:"<<m_data_queue.size_approx();
+    NALUBuffer ret{};
+    //qDebug()<<"get_data size_estimate:"<<m_data_queue.size();
+    bool success;
     if(timeout!=std::nullopt){
-        m_data_queue.wait_dequeue_timed(ret,timeout.value());
+        success=m_data_queue.wait_dequeue_timed(ret,timeout.value());
     }else{
-        m_data_queue.try_dequeue(ret);
+        success=m_data_queue.try_dequeue(ret);
     }
+    if(!success)return std::nullopt;
+    m_last_dequeued_rtp_timestamp=ret.get_nal().rtp_timestamp;
+    m_has_dequeued=true;
     return ret;
  }
 
@@ -88,14 +140,39 @@ std::array<int, 2> RTPReceiver::sps_get_width_height(){
     return m_keyframe_finder->sps_get_width_height();
 }
 
-void RTPReceiver::queue_data(const uint8_t* nalu_data,const std::size_t nalu_data_len)
+bool RTPReceiver::is_same_config(int port,const std::string& ip,bool is_h265,const QOpenHDVideoHelper::GenericVideoSettings& generic_settings)const
+{
+    return m_port==port && m_ip==ip && this->is_h265==is_h265 && m_generic_settings==generic_settings;
+}
+
+std::vector<NALUBuffer> RTPReceiver::get_gop_cache_for_decoder_start()
+{
+    std::lock_guard<std::mutex> lock(m_data_mutex);
+    const bool config_changed=config_has_changed_during_decode;
+    config_has_changed_during_decode=false;
+    if(m_gop_cache==nullptr || !m_gop_cache->is_valid()){
+        if(config_changed){
+            // Whatever is still queued needs the old config
+            m_data_queue.clear();
+        }
+        return {};
+    }
+    // Everything in the queue is also in the cache (or needs the old config) - the decoder continues with whatever is queued after this call
+    m_data_queue.clear();
+    // The cache has all frames since the last keyframe (including the ones dropped due to overload)
+    m_skip_to_keyframe=false;
+    qDebug()<<"GOP cache:"<<(int)m_gop_cache->get_n_frames()<<" frames "<<StringHelper::memorySizeReadable(m_gop_cache->get_size_bytes()).c_str();
+    return m_gop_cache->get_frames();
+}
+
+void RTPReceiver::queue_data(NALUBuffer nalu_buffer,const bool rtp_marker)
 {
     std::lock_guard<std::mutex> lock(m_data_mutex);
     // we discard any data in this state
     // TODO fixme
     //if(config_has_changed_during_decode)return;
     //qDebug()<<"Got frame2";
-    NALU nalu(nalu_data,nalu_data_len,is_h265);
+    const NALU& nalu=nalu_buffer.get_nal();
     // qDebug()<<"Got frame:"<<nalu.get_nal_unit_type_as_string().c_str();
     // hacky way to estimate keyframe interval
     if (nalu.is_frame_but_not_keyframe()) {
@@ -105,47 +182,45 @@ void RTPReceiver::queue_data(const uint8_t* nalu_data,const std::size_t nalu_dat
         n_frames_idr++;
     }
     if (n_frames_idr >= 3) {
-        DecodingStatistcs::instance().set_estimate_keyframe_interval((n_frames_non_idr+n_frames_idr)/n_frames_idr);
+        m_stats.set_estimate_keyframe_interval((n_frames_non_idr+n_frames_idr)/n_frames_idr);
         n_frames_idr=0;
         n_frames_non_idr=0;
     }
     if (m_keyframe_finder->allKeyFramesAvailable(is_h265)) {
         if(!m_keyframe_finder->check_is_still_same_config_data(nalu)){
-            // We neither queue on new data nor call the callback - upper level needs to reconfigure the decoder
+            // Upper level needs to re-configure the decoder. Start collecting the new config data right away,
+            // until the decoder has been re-configured new frames only go into the GOP cache.
             qDebug()<<"config_has_changed_during_decode";
+            if(m_au_assembler)m_au_assembler->flush();
+            m_keyframe_finder->reset();
+            if(m_gop_cache)m_gop_cache->clear();
             config_has_changed_during_decode=true;
+            m_keyframe_finder->saveIfKeyFrame(nalu);
             return;
         }
+        if(m_au_assembler && nalu.is_access_unit_start_hint()){
+            // A new picture starts, forward the previous one in case the marker bit was missing
+            m_au_assembler->flush();
+        }
         // If we have all config data, start storing video frames
         // We can drop things we don't need for decoding frames though
         if (nalu.is_config()) return;
         if (nalu.is_aud()) return;
         if (nalu.is_sei()) return;
         if (nalu.is_dps()) return;
-        // recalculate rough fps in X seconds intervalls:
-        m_estimate_fps_calculator.on_new_frame();
-        if(m_estimate_fps_calculator.time_since_last_recalculation()>std::chrono::seconds(2)){
-            const auto fps=m_estimate_fps_calculator.recalculate_fps_and_clear();
-            const auto fps_as_string=StringHelper::to_string_with_precision(fps,2)+"fps";
-            DecodingStatistcs::instance().set_estimate_rtp_fps({fps_as_string.c_str()});
-        }
-        //qDebug()<<"Queue size:"<<m_data_queue.size_approx();
+        //qDebug()<<"Queue size:"<<m_data_queue.size();
         if (m_new_nalu_cb) {
             // Use the cb approach
+            on_new_frame_for_fps_estimate();
             m_new_nalu_cb(nalu);
+        } else if(m_au_assembler && nalu.is_vcl()){
+            // Goes into the queue once the access unit is complete
+            m_au_assembler->on_slice(std::move(nalu_buffer),rtp_marker);
         } else {
-            // Use the queue approach
-            if (!m_data_queue.try_enqueue(std::make_shared<NALUBuffer>(nalu))) {
-                // If we cannot push a frame onto this queue, it means the decoder cannot keep up what we want to provide to it
-                n_dropped_frames++;
-                qDebug() << "Dropping incoming frame, total:" << n_dropped_frames;
-                DecodingStatistcs::instance().set_n_decoder_dropped_frames(n_dropped_frames);
-                const auto elapsed = std::chrono::steady_clock::now() - m_last_log_hud_dropped_frame;
-                if (elapsed > std::chrono::seconds(3)) {
-                    HUDLogMessagesModel::instance().add_message_warning("Decoder unhealthy-reduce load");
-                    m_last_log_hud_dropped_frame = std::chrono::steady_clock::now();
-                }
-            }
+            // Keep the stream order - a non vcl NALU (e.g. end of sequence, filler data) must not overtake the slices
+            // of the picture it follows, which might still be pending in the assembler.
+            if(m_au_assembler)m_au_assembler->flush();
+            enqueue_for_decoder(std::move(nalu_buffer));
         }
     } else {
         // We don't have all config data yet, drop anything that is not config data.
@@ -153,11 +228,137 @@ void RTPReceiver::queue_data(const uint8_t* nalu_data,const std::size_t nalu_dat
     }
 }
 
+void RTPReceiver::enqueue_for_decoder(NALUBuffer buffer)
+{
+    on_new_frame_for_fps_estimate();
+    if(m_gop_cache){
+        m_gop_cache->on_frame(buffer);
+    }
+    if(config_has_changed_during_decode){
+        // The decoder is not ready for frames with the new config yet, it gets them from the GOP cache
+        return;
+    }
+    const NALU& nalu=buffer.get_nal();
+    if(m_skip_to_keyframe){
+        if(!nalu.is_random_access_point()){
+            on_decoder_overload_drop(false);
+            return;
+        }
+        // The decoder can continue from here
+        m_skip_to_keyframe=false;
+    }
+    // If we cannot push a frame onto this queue (or there is already more than X ms of video queued up),
+    // it means the decoder cannot keep up what we want to provide to it.
+    // A keyframe is always queued if there is space, since it ends the corruption of whatever was dropped before.
+    const auto queue_max=std::chrono::milliseconds(std::max(m_generic_settings.dev_decoder_queue_max_ms,1));
+    const bool overloaded=!nalu.is_random_access_point() && get_queued_video_duration(nalu.rtp_timestamp)>=queue_max;
+    const uint32_t rtp_timestamp=nalu.rtp_timestamp;
+    // Marked before the enqueue, otherwise the decoder thread might already pick it up before it is marked
+    if(m_is_primary){
+        FrameLatencyTracer::instance().mark(rtp_timestamp,FrameLatencyTracer::ENQUEUED);
+    }
+    // No copy, the (pooled) buffer is moved into the queue
+    // On overload, the queue first drops the oldest queued non-reference frame (if any) to make room
+    const auto result=m_data_queue.enqueue(std::move(buffer),overloaded);
+    if(result==DecoderQueue::EnqueueResult::QUEUED)return;
+    if(result==DecoderQueue::EnqueueResult::QUEUED_EVICTED_NON_REFERENCE){
+        on_decoder_overload_drop(false);
+        return;
+    }
+    if(m_is_primary){
+        // Never made it into the queue
+        FrameLatencyTracer::instance().clear_mark(rtp_timestamp,FrameLatencyTracer::ENQUEUED);
+    }
+    // Dropping a non-reference frame costs us one frame, dropping a reference frame corrupts all frames until the next keyframe -
+    // in this case we rather don't give the decoder anything until then.
+    on_decoder_overload_drop(result==DecoderQueue::EnqueueResult::DROPPED_REFERENCE);
+}
+
+std::chrono::milliseconds RTPReceiver::get_queued_video_duration(uint32_t rtp_timestamp)
+{
+    const size_t queue_size=m_data_queue.size();
+    if(queue_size==0)return std::chrono::milliseconds(0);
+    // 90kHz rtp clock, the difference is wrap around safe
+    const int32_t delta=(int32_t)(rtp_timestamp-m_last_dequeued_rtp_timestamp.load());
+    if(m_has_dequeued && delta>0 && delta<10*90000){
+        return std::chrono::milliseconds(delta/90);
+    }
+    // Nothing dequeued yet or the timestamps are not usable (e.g. the air unit restarted) - estimate using the fps
+    const float fps=m_last_fps_estimate>1 ? m_last_fps_estimate : 60;
+    return std::chrono::milliseconds((int)(queue_size*1000/fps));
+}
+
+void RTPReceiver::on_decoder_overload_drop(bool skip_to_keyframe)
+{
+    n_dropped_frames++;
+    std::string hud_message;
+    if(skip_to_keyframe){
+        m_skip_to_keyframe=true;
+        m_n_skipped_to_keyframe++;
+        m_n_dropped_skip++;
+        qDebug()<<"Decoder overloaded, skipping to next keyframe, total dropped:"<<n_dropped_frames;
+        hud_message="Decoder unhealthy-skipped to keyframe";
+    }else if(m_skip_to_keyframe){
+        m_n_dropped_skip++;
+    }else{
+        m_n_dropped_non_reference++;
+        qDebug()<<"Dropping non-reference frame, total dropped:"<<n_dropped_frames;
+        hud_message="Decoder unhealthy-reduce load";
+    }
+    m_stats.set_n_decoder_dropped_frames(n_dropped_frames);
+    std::stringstream ss;
+    ss<<"nonref:"<<m_n_dropped_non_reference<<" skip:"<<m_n_dropped_skip<<" ("<<m_n_skipped_to_keyframe<<"x)";
+    m_stats.set_decoder_overload_drops(ss.str().c_str());
+    if(hud_message.empty())return;
+    const auto elapsed = std::chrono::steady_clock::now() - m_last_log_hud_dropped_frame;
+    if (elapsed > std::chrono::seconds(3)) {
+        HUDLogMessagesModel::instance().add_message_warning(hud_message.c_str());
+        m_last_log_hud_dropped_frame = std::chrono::steady_clock::now();
+    }
+}
+
+void RTPReceiver::on_new_frame_for_fps_estimate()
+{
+    // recalculate rough fps in X seconds intervalls:
+    m_estimate_fps_calculator.on_new_frame();
+    if(m_estimate_fps_calculator.time_since_last_recalculation()>std::chrono::seconds(2)){
+        const auto fps=m_estimate_fps_calculator.recalculate_fps_and_clear();
+        m_last_fps_estimate=fps;
+        const auto fps_as_string=StringHelper::to_string_with_precision(fps,2)+"fps";
+        m_stats.set_estimate_rtp_fps({fps_as_string.c_str()});
+    }
+}
+
+void RTPReceiver::on_new_access_unit(NALUBuffer access_unit, const AccessUnitAssembler::AccessUnitInfo &info)
+{
+    m_au_stats_n_frames++;
+    m_au_stats_n_slices+=info.n_slices;
+    m_au_stats_n_bytes+=info.n_bytes;
+    m_avg_au_assembly_time.add(info.assembly_time);
+    if(std::chrono::steady_clock::now()-m_au_stats_last_log>std::chrono::seconds(2)){
+        const double slices_per_frame=m_au_stats_n_slices/(double)m_au_stats_n_frames;
+        std::stringstream ss;
+        ss<<StringHelper::to_string_with_precision(slices_per_frame,1)<<"sl "
+         <<StringHelper::memorySizeReadable(m_au_stats_n_bytes/m_au_stats_n_frames)<<" "
+         <<MyTimeHelper::R(m_avg_au_assembly_time.getAvg());
+        m_stats.set_access_unit_stats(ss.str().c_str());
+        m_au_stats_n_frames=0;
+        m_au_stats_n_slices=0;
+        m_au_stats_n_bytes=0;
+        m_avg_au_assembly_time.reset();
+        m_au_stats_last_log=std::chrono::steady_clock::now();
+    }
+    enqueue_for_decoder(std::move(access_unit));
+}
+
 void RTPReceiver::udp_raw_data_callback(const uint8_t *payload, const std::size_t payloadSize)
 {
     //qDebug()<<"Got UDP data "<<payloadSize;
-    m_rtp_bitrate.addBytes(payloadSize,[](std::string bitrate){
-        DecodingStatistcs::instance().set_rtp_measured_bitrate(bitrate.c_str());
+    if(m_is_primary && payloadSize>=sizeof(rtp_header_t)){
+        FrameLatencyTracer::instance().on_rtp_packet(((const rtp_header_t*)payload)->getTimestamp());
+    }
+    m_rtp_bitrate.addBytes(payloadSize,[this](std::string bitrate){
+        m_stats.set_rtp_measured_bitrate(bitrate.c_str());
     });
     if(is_h265){
         m_rtp_decoder->parseRTPH265toNALU(payload,payloadSize);
@@ -167,17 +368,40 @@ void RTPReceiver::udp_raw_data_callback(const uint8_t *payload, const std::size_
     }
 }
 
-void RTPReceiver::nalu_data_callback(const std::chrono::steady_clock::time_point /*creation_time*/,const uint8_t *nalu_data, const int nalu_data_size)
+void RTPReceiver::udp_raw_data_batch_callback(const UDPReceiver::Datagram *datagrams, size_t n_datagrams)
 {
+    for(size_t i=0;i<n_datagrams;i++){
+        udp_raw_data_callback(datagrams[i].data,datagrams[i].data_len);
+    }
+    // Once per batch instead of once per packet
+    update_rtp_loss_stats();
+}
+
+void RTPReceiver::update_rtp_loss_stats()
+{
+    m_stats.set_n_missing_rtp_video_packets(m_rtp_decoder->m_n_gaps);
+    const auto reorder_stats=m_rtp_decoder->get_reorder_stats();
+    m_stats.set_n_rtp_reordered_packets(reorder_stats.n_reordered);
+    m_stats.set_n_rtp_late_packets(reorder_stats.n_late);
+    m_stats.set_n_rtp_lost_packets(reorder_stats.n_lost);
+}
+
+void RTPReceiver::nalu_data_callback(const std::chrono::steady_clock::time_point /*creation_time*/,NALUBufferPool::Buffer nalu_buffer,bool rtp_marker,uint32_t rtp_timestamp)
+{
+    if(m_is_primary){
+        FrameLatencyTracer::instance().mark(rtp_timestamp,FrameLatencyTracer::NALU_COMPLETE);
+    }
+    const uint8_t* nalu_data=nalu_buffer->data.get();
+    const int nalu_data_size=nalu_buffer->size;
     //qDebug()<<"Got NALU "<<nalu_data_size;
     {
         //std::vector<uint8_t> tmp(nalu_data,nalu_data+nalu_data_size);
         //qDebug()<<StringHelper::vectorAsString(tmp).c_str()<<"\n";
     }
-    if(m_out_file!=nullptr){
-        m_out_file->write((const char*)nalu_data,nalu_data_size);
-        m_out_file->flush();
+    if(m_ground_recorder){
+        m_ground_recorder->on_nalu(nalu_data,nalu_data_size,rtp_marker,rtp_timestamp);
     }
-    queue_data(nalu_data,nalu_data_size);
+    queue_data(NALUBuffer(std::move(nalu_buffer),is_h265,std::chrono::steady_clock::now(),rtp_timestamp),rtp_marker);
+    m_stats.set_n_nalu_buffer_allocations(NALUBufferPool::instance().get_n_allocations());
 }
 
@@ -1,8 +1,8 @@
 #ifndef RTPRECEIVER_H
 #define RTPRECEIVER_H
 
-#include <fstream>
 #include <mutex>
+#include <atomic>
 #include <functional>
 #include <memory>
 #ifdef OPENHD_USE_LIB_UVGRTP
@@ -10,23 +10,34 @@
 #endif
 
 #include "app/common/TimeHelper.hpp"
-#include "app/common/moodycamel/readerwriterqueue/readerwritercircularbuffer.h"
 #include "app/videostreaming/vscommon/udp/UDPReceiver.h"
+#include "app/videostreaming/vscommon/udp/ReplaySource.h"
 #include "app/videostreaming/vscommon/nalu/NALU.hpp"
 #include "app/videostreaming/vscommon/nalu/KeyFrameFinder.hpp"
+#include "app/videostreaming/vscommon/nalu/AccessUnitAssembler.hpp"
+#include "app/videostreaming/vscommon/nalu/GOPCache.hpp"
+#include "app/videostreaming/vscommon/nalu/DecoderQueue.hpp"
+#include "app/videostreaming/vscommon/recording/GroundRecorder.h"
 
 #include "ParseRTP.h"
+#include "QOpenHDVideoHelper.hpp"
+
+class DecodingStatistcs;
 
 class RTPReceiver
 {
 public:
-    RTPReceiver(int port,std::string ip,bool is_h265,bool feed_incomplete_frames);
+    // The generic (dev) settings control the udp receive mode, rtp reorder window and similar.
+    // is_primary: primary / secondary video stream, the statistics go to the corresponding DecodingStatistcs instance.
+    RTPReceiver(int port,std::string ip,bool is_h265,const QOpenHDVideoHelper::GenericVideoSettings& generic_settings,bool is_primary=true);
     ~RTPReceiver();
 
     // Returns the oldest frame if available.
-    // (nullptr on failure)
+    // If access unit assembly is enabled (default), one frame == all the slices of one picture, otherwise one frame == one NALU
+    // (std::nullopt on failure)
     // The timeout is optional
-    std::shared_ptr<NALUBuffer> get_next_frame(std::optional<std::chrono::microseconds> timeout=std::nullopt);
+    // The buffer is moved out of the queue - it returns to the NALUBufferPool once the caller is done with it.
+    std::optional<NALUBuffer> get_next_frame(std::optional<std::chrono::microseconds> timeout=std::nullopt);
     // Instead of using a queue and another thread for fetching data between what's basically the udp receiver
     // and the decoder, you can register a callback here that is called directly when there is a new NALU
     // available. Note that care needs to be taken to not perform any blocking operation(s) in this callback -
@@ -35,27 +46,60 @@ public:
     void register_new_nalu_callback(NEW_NALU_CALLBACK cb);
     // return nullptr if not enough config data is available yet, otherwise, return valid config data
     std::shared_ptr<std::vector<uint8_t>> get_config_data();
-    bool config_has_changed_during_decode=false;
+    // Set by the receiver once it sees config data that differs from the current config data.
+    // The decoder then needs to be re-configured (wait for get_config_data(), then get_gop_cache_for_decoder_start()).
+    // In this state, new frames are not queued (they only go into the GOP cache), since they need the new config.
+    std::atomic<bool> config_has_changed_during_decode=false;
     // get width height using the config data (SPS)
     // do not call that if there is no config data
     std::array<int,2> sps_get_width_height();
+    // The receiver (and its GOP cache) is meant to survive decoder restarts as long as the stream config doesn't change.
+    bool is_same_config(int port,const std::string& ip,bool is_h265,const QOpenHDVideoHelper::GenericVideoSettings& generic_settings)const;
+    // Call right after feeding the config data to a (re)started / re-configured decoder.
+    // Returns all the frames since the most recent keyframe (empty if there are none cached),
+    // in which case everything that was queued up (and is therefore part of the returned frames) is discarded.
+    // Feeding them to the decoder gives an image immediately instead of waiting for the next keyframe.
+    // Also ends the config_has_changed_during_decode state.
+    std::vector<NALUBuffer> get_gop_cache_for_decoder_start();
 private:
     std::unique_ptr<UDPReceiver> m_udp_receiver=nullptr;
+    // replaces the udp receiver if dev_video_replay is enabled
+    std::unique_ptr<ReplaySource> m_replay_source=nullptr;
     std::unique_ptr<RTPDecoder> m_rtp_decoder=nullptr;
 
     void udp_raw_data_callback(const uint8_t *payload, const std::size_t payloadSize);
+    void udp_raw_data_batch_callback(const UDPReceiver::Datagram* datagrams,size_t n_datagrams);
+    void update_rtp_loss_stats();
 
-    void nalu_data_callback(const std::chrono::steady_clock::time_point creation_time,const uint8_t* nalu_data,const int nalu_data_size);
-    //
-    std::unique_ptr<std::ofstream> m_out_file=nullptr;
+    void nalu_data_callback(const std::chrono::steady_clock::time_point creation_time,NALUBufferPool::Buffer nalu_buffer,bool rtp_marker,uint32_t rtp_timestamp);
+    // ground side recording (DVR), does nothing unless recording is requested. Primary stream only (nullptr otherwise)
+    std::unique_ptr<GroundRecorder> m_ground_recorder=nullptr;
 private:
+    const int m_port;
+    const std::string m_ip;
     const bool is_h265;
+    const QOpenHDVideoHelper::GenericVideoSettings m_generic_settings;
+    const bool m_is_primary;
+    DecodingStatistcs& m_stats;
 private:
     std::mutex m_data_mutex;
-    // space for up to X NALUs to account for "weird" cases, fifo anyways
-    // In case the decoder cannot keep up with the data we provide to it, the only fix would be to reduce the fps/resolution anyways.
-    moodycamel::BlockingReaderWriterCircularBuffer<std::shared_ptr<NALUBuffer>> m_data_queue{20};
-    void queue_data(const uint8_t* nalu_data,const std::size_t nalu_data_len);
+    // fifo, the depth is limited in ms of video (dev_decoder_queue_max_ms), this is just the upper limit of queued
+    // frames / NALUs. In case the decoder cannot keep up with the data we provide to it, the only fix would be to reduce the fps/resolution anyways.
+    DecoderQueue m_data_queue{64};
+    void queue_data(NALUBuffer nalu_buffer,bool rtp_marker);
+    void enqueue_for_decoder(NALUBuffer buffer);
+    // Amount of video between the frame the decoder took last and the given frame, 0 if the queue is empty
+    std::chrono::milliseconds get_queued_video_duration(uint32_t rtp_timestamp);
+    // Overload: a (whole) frame was dropped, skip_to_keyframe if it was a reference frame
+    void on_decoder_overload_drop(bool skip_to_keyframe);
+    // rtp timestamp of the frame the decoder took last (written by the decoder thread)
+    std::atomic<uint32_t> m_last_dequeued_rtp_timestamp{0};
+    std::atomic<bool> m_has_dequeued{false};
+    // A reference frame was dropped, everything until the next keyframe would be corrupted anyways
+    bool m_skip_to_keyframe=false;
+    int m_n_dropped_non_reference=0;
+    int m_n_dropped_skip=0;
+    int m_n_skipped_to_keyframe=0;
     std::mutex m_new_nalu_data_cb_mutex;
     NEW_NALU_CALLBACK m_new_nalu_cb=nullptr;
     bool forward_via_cb_if_registered();
@@ -66,6 +110,20 @@ private:
 private:
     // Calculate fps, but note that this might not give the exact/correct value in some case(s)
     FPSCalculator m_estimate_fps_calculator{};
+    float m_last_fps_estimate=0;
+    void on_new_frame_for_fps_estimate();
+private:
+    // nullptr if access unit assembly is disabled
+    std::unique_ptr<AccessUnitAssembler> m_au_assembler=nullptr;
+    void on_new_access_unit(NALUBuffer access_unit,const AccessUnitAssembler::AccessUnitInfo& info);
+    // nullptr if disabled
+    std::unique_ptr<GOPCache> m_gop_cache=nullptr;
+private:
+    int m_au_stats_n_frames=0;
+    int m_au_stats_n_slices=0;
+    uint64_t m_au_stats_n_bytes=0;
+    LatencyHistogram m_avg_au_assembly_time{"AU assembly"};
+    std::chrono::steady_clock::time_point m_au_stats_last_log=std::chrono::steady_clock::now();
 private:
     int n_frames_non_idr=0;
     int n_frames_idr=0;
@@ -0,0 +1,458 @@
+#include "ReplaySource.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+#include <qdebug.h>
+
+namespace {
+
+uint16_t read_u16_be(const uint8_t* p){
+    return (uint16_t)((p[0]<<8) | p[1]);
+}
+
+uint32_t read_u32(const uint8_t* p,const bool swapped){
+    uint32_t ret;
+    std::memcpy(&ret,p,4);
+    return swapped ? __builtin_bswap32(ret) : ret;
+}
+
+void write_u16_be(uint8_t* p,const uint16_t value){
+    p[0]=(uint8_t)(value>>8);
+    p[1]=(uint8_t)value;
+}
+
+void write_u32_be(uint8_t* p,const uint32_t value){
+    p[0]=(uint8_t)(value>>24);
+    p[1]=(uint8_t)(value>>16);
+    p[2]=(uint8_t)(value>>8);
+    p[3]=(uint8_t)value;
+}
+
+// pcap link layer types we can get ipv4 out of
+static constexpr uint32_t LINKTYPE_NULL=0;
+static constexpr uint32_t LINKTYPE_ETHERNET=1;
+static constexpr uint32_t LINKTYPE_RAW_BSD=12;
+static constexpr uint32_t LINKTYPE_RAW_BSD2=14;
+static constexpr uint32_t LINKTYPE_RAW=101;
+static constexpr uint32_t LINKTYPE_LINUX_SLL=113;
+static constexpr uint32_t LINKTYPE_IPV4=228;
+static constexpr uint32_t LINKTYPE_LINUX_SLL2=276;
+
+// Returns the offset of the ipv4 header in the given (captured) frame, -1 if this is not an ipv4 packet
+int get_ipv4_offset(const uint32_t link_type,const uint8_t* frame,const size_t size){
+    int offset=-1;
+    uint16_t ether_type=0x0800;
+    switch(link_type){
+    case LINKTYPE_NULL:
+        // 4 byte address family (host byte order of the capturing machine), check the ip version below
+        offset=4;
+        break;
+    case LINKTYPE_ETHERNET:
+        if(size<14)return -1;
+        offset=14;
+        ether_type=read_u16_be(&frame[12]);
+        // 802.1Q vlan tag
+        if(ether_type==0x8100 && size>=18){
+            ether_type=read_u16_be(&frame[16]);
+            offset=18;
+        }
+        break;
+    case LINKTYPE_RAW_BSD:
+    case LINKTYPE_RAW_BSD2:
+    case LINKTYPE_RAW:
+    case LINKTYPE_IPV4:
+        offset=0;
+        break;
+    case LINKTYPE_LINUX_SLL:
+        if(size<16)return -1;
+        ether_type=read_u16_be(&frame[14]);
+        offset=16;
+        break;
+    case LINKTYPE_LINUX_SLL2:
+        if(size<20)return -1;
+        ether_type=read_u16_be(&frame[0]);
+        offset=20;
+        break;
+    default:
+        return -1;
+    }
+    if(ether_type!=0x0800 || (size_t)offset>=size)return -1;
+    if((frame[offset]>>4)!=4)return -1;
+    return offset;
+}
+
+// A NALU in an Annex-B file (without the start code)
+struct AnnexBNALU{
+    const uint8_t* data;
+    size_t size;
+};
+
+std::vector<AnnexBNALU> split_annexb(const uint8_t* data,const size_t size){
+    std::vector<AnnexBNALU> ret;
+    size_t nalu_begin=0;
+    bool has_nalu=false;
+    auto end_nalu=[&](size_t end){
+        if(!has_nalu)return;
+        // trailing zero bytes (e.g. the first byte of a 4 byte start code) are not part of the NALU
+        while(end>nalu_begin && data[end-1]==0)end--;
+        if(end>nalu_begin){
+            ret.push_back(AnnexBNALU{&data[nalu_begin],end-nalu_begin});
+        }
+    };
+    size_t i=0;
+    while(i+2<size){
+        if(data[i]==0 && data[i+1]==0 && data[i+2]==1){
+            end_nalu(i);
+            nalu_begin=i+3;
+            has_nalu=true;
+            i+=3;
+        }else{
+            i++;
+        }
+    }
+    end_nalu(size);
+    return ret;
+}
+
+bool is_vcl(const uint8_t* nalu,const bool is_h265){
+    if(is_h265){
+        return ((nalu[0]>>1) & 0x3F)<32;
+    }
+    const int type=nalu[0] & 0x1F;
+    return type>=1 && type<=5;
+}
+
+// AUD, parameter sets and (prefix) SEI - if there already was a slice, they belong to the next frame
+bool is_access_unit_prefix(const uint8_t* nalu,const bool is_h265){
+    if(is_h265){
+        const int type=(nalu[0]>>1) & 0x3F;
+        return (type>=32 && type<=35) || type==39;
+    }
+    const int type=nalu[0] & 0x1F;
+    return type>=6 && type<=9;
+}
+
+// first_mb_in_slice==0 (h264, ue(v) 0 is a single 1 bit) / first_slice_segment_in_pic_flag (h265)
+bool is_first_slice(const AnnexBNALU& nalu,const bool is_h265){
+    const size_t header_size=is_h265 ? 2 : 1;
+    if(nalu.size<=header_size)return false;
+    return (nalu.data[header_size] & 0x80)!=0;
+}
+
+static constexpr uint8_t RTP_PAYLOAD_TYPE=96;
+static constexpr uint32_t RTP_SSRC=0x5245504C;
+static constexpr size_t RTP_HEADER_SIZE=12;
+
+}
+
+ReplaySource::ReplaySource(std::string tag,Configuration config,UDPReceiver::DATA_BATCH_CALLBACK cb)
+    :
+    m_tag(std::move(tag)),
+    m_config(std::move(config)),
+    m_cb(std::move(cb)),
+    m_rng(m_config.seed)
+{
+    qDebug()<<"ReplaySource "<<m_tag.c_str()<<"with "<<m_config.to_string().c_str();
+}
+
+ReplaySource::~ReplaySource()
+{
+    if(m_thread){
+        stop();
+    }
+}
+
+bool ReplaySource::load()
+{
+    m_data.clear();
+    m_packets.clear();
+    std::ifstream file(m_config.filename,std::ios::binary);
+    if(!file.is_open()){
+        qDebug()<<"ReplaySource "<<m_tag.c_str()<<"cannot open "<<m_config.filename.c_str();
+        return false;
+    }
+    const std::vector<uint8_t> content((std::istreambuf_iterator<char>(file)),std::istreambuf_iterator<char>());
+    bool is_pcap=false;
+    if(content.size()>=4){
+        const uint32_t magic=read_u32(content.data(),false);
+        is_pcap= magic==0xa1b2c3d4 || magic==0xd4c3b2a1 || magic==0xa1b23c4d || magic==0x4d3cb2a1;
+    }
+    const bool success=is_pcap ? load_pcap(content) : load_annexb(content);
+    qDebug()<<"ReplaySource "<<m_tag.c_str()<<(is_pcap ? "pcap":"Annex-B")<<" packets:"<<(int)m_packets.size()
+           <<" duration:"<<std::chrono::duration_cast<std::chrono::milliseconds>(get_duration()).count()<<"ms";
+    return success && !m_packets.empty();
+}
+
+bool ReplaySource::load_pcap(const std::vector<uint8_t>& file)
+{
+    static constexpr size_t GLOBAL_HEADER_SIZE=24;
+    static constexpr size_t RECORD_HEADER_SIZE=16;
+    if(file.size()<GLOBAL_HEADER_SIZE)return false;
+    const uint32_t magic=read_u32(file.data(),false);
+    const bool swapped= magic==0xd4c3b2a1 || magic==0x4d3cb2a1;
+    const bool nanosecond_resolution= magic==0xa1b23c4d || magic==0x4d3cb2a1;
+    const uint32_t link_type=read_u32(&file[20],swapped) & 0xFFFF;
+    size_t offset=GLOBAL_HEADER_SIZE;
+    bool has_first_timestamp=false;
+    std::chrono::nanoseconds first_timestamp{0};
+    int n_skipped=0;
+    while(offset+RECORD_HEADER_SIZE<=file.size()){
+        const uint32_t ts_sec=read_u32(&file[offset],swapped);
+        const uint32_t ts_frac=read_u32(&file[offset+4],swapped);
+        const uint32_t captured_len=read_u32(&file[offset+8],swapped);
+        offset+=RECORD_HEADER_SIZE;
+        if(offset+captured_len>file.size()){
+            qDebug()<<"ReplaySource "<<m_tag.c_str()<<"truncated pcap";
+            break;
+        }
+        const uint8_t* frame=&file[offset];
+        offset+=captured_len;
+        const int ip_offset=get_ipv4_offset(link_type,frame,captured_len);
+        if(ip_offset<0){
+            n_skipped++;
+            continue;
+        }
+        const uint8_t* ip=&frame[ip_offset];
+        const size_t ip_size=captured_len-ip_offset;
+        const size_t ip_header_size=(ip[0] & 0x0F)*4;
+        if(ip_size<20 || ip_header_size<20 || ip_size<ip_header_size+8 || ip[9]!=17){
+            n_skipped++;
+            continue;
+        }
+        // fragmented datagrams are not re-assembled
+        if((read_u16_be(&ip[6]) & 0x3FFF)!=0){
+            n_skipped++;
+            continue;
+        }
+        const uint8_t* udp=&ip[ip_header_size];
+        const int dst_port=read_u16_be(&udp[2]);
+        const size_t udp_len=read_u16_be(&udp[4]);
+        if(udp_len<8 || (m_config.pcap_udp_port>=0 && dst_port!=m_config.pcap_udp_port)){
+            n_skipped++;
+            continue;
+        }
+        // the capture might have been cut short (snaplen)
+        const size_t payload_size=std::min(udp_len-8,ip_size-ip_header_size-8);
+        const std::chrono::nanoseconds timestamp=std::chrono::seconds(ts_sec)+
+                (nanosecond_resolution ? std::chrono::nanoseconds(ts_frac) : std::chrono::microseconds(ts_frac));
+        if(!has_first_timestamp){
+            first_timestamp=timestamp;
+            has_first_timestamp=true;
+        }
+        // captures are not strictly ordered in time, never go back
+        std::chrono::nanoseconds relative=timestamp-first_timestamp;
+        if(!m_packets.empty() && relative<m_packets.back().timestamp){
+            relative=m_packets.back().timestamp;
+        }
+        add_packet(&udp[8],payload_size,relative);
+    }
+    if(n_skipped>0){
+        qDebug()<<"ReplaySource "<<m_tag.c_str()<<"skipped "<<n_skipped<<" non udp packets";
+    }
+    return true;
+}
+
+bool ReplaySource::load_annexb(const std::vector<uint8_t>& file)
+{
+    const bool is_h265=m_config.annexb_is_h265;
+    const auto nalus=split_annexb(file.data(),file.size());
+    if(nalus.empty() || m_config.annexb_fps<=0)return false;
+    // Group the NALUs into frames (access units), since all the packets of a frame share the rtp timestamp
+    // and the last one has the marker bit set.
+    std::vector<int> frame_index(nalus.size());
+    int curr_frame=0;
+    bool frame_has_vcl=false;
+    for(size_t i=0;i<nalus.size();i++){
+        const auto& nalu=nalus[i];
+        const bool vcl=is_vcl(nalu.data,is_h265);
+        if(frame_has_vcl && (is_access_unit_prefix(nalu.data,is_h265) || (vcl && is_first_slice(nalu,is_h265)))){
+            curr_frame++;
+            frame_has_vcl=false;
+        }
+        frame_has_vcl|=vcl;
+        frame_index[i]=curr_frame;
+    }
+    for(size_t i=0;i<nalus.size();i++){
+        const bool last_of_frame= i+1==nalus.size() || frame_index[i+1]!=frame_index[i];
+        const int64_t frame=frame_index[i];
+        const uint32_t rtp_timestamp=(uint32_t)(frame*90000/m_config.annexb_fps);
+        const auto timestamp=std::chrono::nanoseconds(frame*1000*1000*1000/m_config.annexb_fps);
+        packetize_nalu(nalus[i].data,nalus[i].size,last_of_frame,rtp_timestamp,timestamp);
+    }
+    return true;
+}
+
+void ReplaySource::add_packet(const uint8_t* data,size_t size,std::chrono::nanoseconds timestamp)
+{
+    m_packets.push_back(Packet{m_data.size(),size,timestamp});
+    m_data.insert(m_data.end(),data,data+size);
+}
+
+void ReplaySource::add_rtp_packet(const uint8_t* payload_header,size_t payload_header_size,const uint8_t* data,size_t data_size,
+                                  bool marker,uint32_t rtp_timestamp,std::chrono::nanoseconds timestamp)
+{
+    m_packets.push_back(Packet{m_data.size(),RTP_HEADER_SIZE+payload_header_size+data_size,timestamp});
+    uint8_t header[RTP_HEADER_SIZE];
+    header[0]=0x80;
+    header[1]=(uint8_t)((marker ? 0x80 : 0) | RTP_PAYLOAD_TYPE);
+    write_u16_be(&header[2],m_rtp_seq_nr++);
+    write_u32_be(&header[4],rtp_timestamp);
+    write_u32_be(&header[8],RTP_SSRC);
+    m_data.insert(m_data.end(),header,header+RTP_HEADER_SIZE);
+    m_data.insert(m_data.end(),payload_header,payload_header+payload_header_size);
+    m_data.insert(m_data.end(),data,data+data_size);
+}
+
+// RFC 6184 (h264) / RFC 7798 (h265), single NAL unit packets and fragmentation units only (what the air unit sends)
+void ReplaySource::packetize_nalu(const uint8_t* nalu,size_t size,bool last_of_frame,uint32_t rtp_timestamp,std::chrono::nanoseconds timestamp)
+{
+    const bool is_h265=m_config.annexb_is_h265;
+    const size_t max_payload=m_config.annexb_rtp_max_payload_size;
+    const size_t nalu_header_size=is_h265 ? 2 : 1;
+    if(size<=max_payload || size<=nalu_header_size){
+        add_rtp_packet(nullptr,0,nalu,size,last_of_frame,rtp_timestamp,timestamp);
+        return;
+    }
+    uint8_t fu_header[3];
+    size_t fu_header_size;
+    if(is_h265){
+        fu_header[0]=(uint8_t)((nalu[0] & 0x81) | (49<<1));
+        fu_header[1]=nalu[1];
+        fu_header[2]=(uint8_t)((nalu[0]>>1) & 0x3F);
+        fu_header_size=3;
+    }else{
+        fu_header[0]=(uint8_t)((nalu[0] & 0xE0) | 28);
+        fu_header[1]=(uint8_t)(nalu[0] & 0x1F);
+        fu_header_size=2;
+    }
+    const uint8_t fu_type=fu_header[fu_header_size-1];
+    const size_t max_fragment_size=max_payload>fu_header_size ? max_payload-fu_header_size : 1;
+    size_t offset=nalu_header_size;
+    while(offset<size){
+        const size_t fragment_size=std::min(max_fragment_size,size-offset);
+        const bool start= offset==nalu_header_size;
+        const bool end= offset+fragment_size==size;
+        fu_header[fu_header_size-1]=(uint8_t)(fu_type | (start ? 0x80 : 0) | (end ? 0x40 : 0));
+        add_rtp_packet(fu_header,fu_header_size,&nalu[offset],fragment_size,end && last_of_frame,rtp_timestamp,timestamp);
+        offset+=fragment_size;
+    }
+}
+
+void ReplaySource::start()
+{
+    m_running=true;
+    m_thread=std::make_unique<std::thread>([this]{
+        while(m_running){
+            replay_once();
+            if(!m_config.loop)break;
+            m_n_loops++;
+        }
+        m_running=false;
+    });
+}
+
+void ReplaySource::stop()
+{
+    m_running=false;
+    if(m_thread && m_thread->joinable()){
+        m_thread->join();
+    }
+    m_thread=nullptr;
+    qDebug()<<"ReplaySource "<<m_tag.c_str()<<"stopped "<<get_stats().to_string().c_str();
+}
+
+void ReplaySource::run_blocking()
+{
+    m_running=true;
+    replay_once();
+    m_running=false;
+}
+
+ReplaySource::Stats ReplaySource::get_stats() const
+{
+    Stats ret{};
+    ret.n_packets=m_n_packets;
+    ret.n_bytes=m_n_bytes;
+    ret.n_dropped=m_n_dropped;
+    ret.n_reordered=m_n_reordered;
+    ret.n_loops=m_n_loops;
+    return ret;
+}
+
+std::chrono::nanoseconds ReplaySource::get_duration() const
+{
+    if(m_packets.empty())return std::chrono::nanoseconds(0);
+    return m_packets.back().timestamp;
+}
+
+void ReplaySource::forward(std::vector<UDPReceiver::Datagram>& batch)
+{
+    if(batch.empty())return;
+    uint64_t n_bytes=0;
+    for(const auto& datagram:batch){
+        n_bytes+=datagram.data_len;
+    }
+    m_cb(batch.data(),batch.size());
+    m_n_packets+=batch.size();
+    m_n_bytes+=n_bytes;
+    batch.clear();
+}
+
+void ReplaySource::replay_once()
+{
+    const bool real_time=m_config.speed>0;
+    const size_t max_batch_size=std::max(1,m_config.max_batch_size);
+    std::uniform_real_distribution<float> percent(0,100);
+    // packets held back for reordering, forwarded once the given n of packets has been forwarded after them
+    struct HeldBack{
+        const Packet* packet;
+        int remaining;
+    };
+    std::deque<HeldBack> held_back;
+    std::vector<UDPReceiver::Datagram> batch;
+    batch.reserve(max_batch_size);
+    auto add_to_batch=[&](const Packet& packet){
+        batch.push_back(UDPReceiver::Datagram{&m_data[packet.offset],packet.size});
+        if(batch.size()>=max_batch_size){
+            forward(batch);
+        }
+    };
+    const auto begin=std::chrono::steady_clock::now();
+    for(size_t i=0;i<m_packets.size() && m_running;i++){
+        const Packet& packet=m_packets[i];
+        if(real_time){
+            const auto due=begin+std::chrono::duration_cast<std::chrono::nanoseconds>(packet.timestamp/m_config.speed);
+            if(due>std::chrono::steady_clock::now()){
+                // nothing else is due right now
+                forward(batch);
+                std::this_thread::sleep_until(due);
+            }
+        }
+        if(m_config.loss_percent>0 && percent(m_rng)<m_config.loss_percent){
+            m_n_dropped++;
+            continue;
+        }
+        if(m_config.reorder_percent>0 && percent(m_rng)<m_config.reorder_percent){
+            held_back.push_back(HeldBack{&packet,std::max(1,m_config.reorder_distance)});
+            m_n_reordered++;
+            continue;
+        }
+        add_to_batch(packet);
+        for(auto& held:held_back){
+            held.remaining--;
+        }
+        while(!held_back.empty() && held_back.front().remaining<=0){
+            add_to_batch(*held_back.front().packet);
+            held_back.pop_front();
+        }
+    }
+    for(const auto& held:held_back){
+        add_to_batch(*held.packet);
+    }
+    forward(batch);
+}
@@ -0,0 +1,122 @@
+#ifndef REPLAYSOURCE_H
+#define REPLAYSOURCE_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "UDPReceiver.h"
+
+// Replays a recorded video stream as if it was received via UDP - for reproducing decoder / latency issues
+// and benchmarking the receive pipeline without an air unit (deterministic and network free).
+// Input is either
+// 1) a pcap (e.g. tcpdump -i lo udp port 5600 -w replay.pcap) - the (ipv4) udp payload of each packet is forwarded,
+//    with the capture timestamps as timing
+// 2) an Annex-B h264 / h265 file (e.g. a raw ground recording) - split into NALUs and packetized into
+//    rtp on the fly (single NAL unit / fragmentation units), all packets of one frame are sent at once with a fixed fps.
+// The datagrams are forwarded via the same (batch) callback as the UDPReceiver, with the original timing (scaled by speed)
+// or as fast as the consumer takes them. Optionally, packet loss / reordering is injected (seeded, therefore reproducible).
+class ReplaySource {
+public:
+    struct Configuration{
+        std::string filename;
+        // 1.0 == original timing, 2.0 == twice as fast, <=0 == as fast as possible
+        double speed=1.0;
+        // start again once the end of the file is reached (start() only)
+        bool loop=false;
+        // pcap only: only forward udp packets with this destination port, -1 == all udp packets
+        int pcap_udp_port=-1;
+        // Annex-B only
+        bool annexb_is_h265=false;
+        int annexb_fps=60;
+        size_t annexb_rtp_max_payload_size=1024;
+        // Injected loss / reordering in percent of the forwarded packets
+        float loss_percent=0;
+        float reorder_percent=0;
+        // A reordered packet is held back until this many packets have been forwarded after it
+        int reorder_distance=2;
+        uint32_t seed=0;
+        // Max n of datagrams forwarded per callback (packets that are due at the same time are batched, like recvmmsg)
+        int max_batch_size=16;
+        std::string to_string()const{
+            std::stringstream ss;
+            ss<<filename<<" speed:";
+            if(speed>0){
+                ss<<speed;
+            }else{
+                ss<<"max";
+            }
+            if(loop){
+                ss<<" loop";
+            }
+            if(loss_percent>0 || reorder_percent>0){
+                ss<<" loss:"<<loss_percent<<"% reorder:"<<reorder_percent<<"%/"<<reorder_distance<<" seed:"<<seed;
+            }
+            return ss.str();
+        }
+    };
+    struct Stats{
+        uint64_t n_packets=0;
+        uint64_t n_bytes=0;
+        uint64_t n_dropped=0;
+        uint64_t n_reordered=0;
+        int n_loops=0;
+        std::string to_string()const{
+            std::stringstream ss;
+            ss<<"packets:"<<n_packets<<" bytes:"<<n_bytes<<" dropped:"<<n_dropped<<" reordered:"<<n_reordered<<" loops:"<<n_loops;
+            return ss.str();
+        }
+    };
+    ReplaySource(std::string tag,Configuration config,UDPReceiver::DATA_BATCH_CALLBACK cb);
+    ~ReplaySource();
+    // Reads (and parses / packetizes) the whole file into memory, such that file io does not affect the timing.
+    // Returns false if the file cannot be read or contains no packets.
+    bool load();
+    // Replay on a new thread (like UDPReceiver::startReceiving), load() needs to be called first
+    void start();
+    void stop();
+    // Replay once on the calling thread, returns when all packets have been forwarded or stop() has been called
+    void run_blocking();
+    bool is_running()const{return m_running;}
+    Stats get_stats()const;
+    size_t get_n_packets()const{return m_packets.size();}
+    // Duration of the recording (first until last packet)
+    std::chrono::nanoseconds get_duration()const;
+private:
+    struct Packet{
+        size_t offset;
+        size_t size;
+        // relative to the first packet
+        std::chrono::nanoseconds timestamp;
+    };
+    bool load_pcap(const std::vector<uint8_t>& file);
+    bool load_annexb(const std::vector<uint8_t>& file);
+    void add_packet(const uint8_t* data,size_t size,std::chrono::nanoseconds timestamp);
+    void add_rtp_packet(const uint8_t* payload_header,size_t payload_header_size,const uint8_t* data,size_t data_size,
+                        bool marker,uint32_t rtp_timestamp,std::chrono::nanoseconds timestamp);
+    void packetize_nalu(const uint8_t* nalu,size_t size,bool last_of_frame,uint32_t rtp_timestamp,std::chrono::nanoseconds timestamp);
+    void replay_once();
+    void forward(std::vector<UDPReceiver::Datagram>& batch);
+    const std::string m_tag;
+    const Configuration m_config;
+    const UDPReceiver::DATA_BATCH_CALLBACK m_cb;
+    // all packets, back to back
+    std::vector<uint8_t> m_data;
+    std::vector<Packet> m_packets;
+    uint16_t m_rtp_seq_nr=0;
+    std::mt19937 m_rng;
+    std::unique_ptr<std::thread> m_thread=nullptr;
+    std::atomic<bool> m_running{false};
+    std::atomic<uint64_t> m_n_packets{0};
+    std::atomic<uint64_t> m_n_bytes{0};
+    std::atomic<uint64_t> m_n_dropped{0};
+    std::atomic<uint64_t> m_n_reordered{0};
+    std::atomic<int> m_n_loops{0};
+};
+
+#endif // REPLAYSOURCE_H
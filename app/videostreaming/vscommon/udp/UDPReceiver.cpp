@@ -8,11 +8,21 @@
 #include <sstream>
 #include <array>
 #include <cstring>
+#include <cassert>
 
 #include <sys/time.h>
 #include <sys/resource.h>
+#include <time.h>
 #include <iostream>
 
+#if defined(__linux__)
+#include <netinet/udp.h>
+// Not exposed by older libc headers (value from linux/udp.h)
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+#endif
+
 #include <qdebug.h>
 
 UDPReceiver::UDPReceiver(std::string tag,Configuration config,DATA_CALLBACK onDataReceivedCallbackX)
@@ -24,12 +34,33 @@ UDPReceiver::UDPReceiver(std::string tag,Configuration config,DATA_CALLBACK onDa
     qDebug()<<"UDPReceiver "<<m_tag.c_str()<<"with "<<m_config.to_string().c_str();
 }
 
+UDPReceiver::UDPReceiver(std::string tag, Configuration config, DATA_BATCH_CALLBACK onDataBatchReceivedCallbackX)
+    :
+    m_tag(tag),
+    m_config(config),
+    m_on_data_batch_received_cb(std::move(onDataBatchReceivedCallbackX))
+{
+    qDebug()<<"UDPReceiver "<<m_tag.c_str()<<"with "<<m_config.to_string().c_str();
+}
+
 long UDPReceiver::getNReceivedBytes()const {
     return m_n_received_bytes;
 }
 
 std::string UDPReceiver::getSourceIPAddress()const {
-    return m_sender_ip;
+    in_addr addr{};
+    addr.s_addr=m_sender_addr;
+    char buff[INET_ADDRSTRLEN]={};
+    if(inet_ntop(AF_INET,&addr,buff,sizeof(buff))==nullptr){
+        return "0.0.0.0";
+    }
+    return std::string(buff);
+}
+
+void UDPReceiver::set_rx_stats_callback(RX_STATS_CALLBACK cb)
+{
+    assert(m_receive_thread==nullptr);
+    m_rx_stats_cb=std::move(cb);
 }
 
 void UDPReceiver::startReceiving() {
@@ -78,6 +109,12 @@ static void increase_socket_recv_buff_size(int sockfd, const int wanted_rcvbuff_
   }
 }
 
+static std::chrono::nanoseconds get_thread_cpu_time(){
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID,&ts);
+    return std::chrono::seconds(ts.tv_sec)+std::chrono::nanoseconds(ts.tv_nsec);
+}
+
 void UDPReceiver::receiveFromUDPLoop() {
     m_socket=socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
     if (m_socket == -1) {
@@ -94,6 +131,16 @@ void UDPReceiver::receiveFromUDPLoop() {
     if(m_config.opt_os_receive_buff_size){
         increase_socket_recv_buff_size(m_socket,m_config.opt_os_receive_buff_size.value());
     }
+#if defined(__linux__)
+    bool use_gro=false;
+    if(m_config.enable_udp_gro){
+        if(setsockopt(m_socket,SOL_UDP,UDP_GRO,&enable,sizeof(int))<0){
+            std::cerr<<"Cannot enable UDP_GRO (kernel too old ?), using plain recvmmsg\n";
+        }else{
+            use_gro=true;
+        }
+    }
+#endif
     struct sockaddr_in myaddr;
     memset((uint8_t *) &myaddr, 0, sizeof(myaddr));
     myaddr.sin_family = AF_INET;
@@ -107,48 +154,179 @@ void UDPReceiver::receiveFromUDPLoop() {
         std::cerr<<"Error binding to "<<m_config.to_string()<<"\n";
         return;
     }
+    m_rx_stats_last_recalculation=std::chrono::steady_clock::now();
+    m_rx_stats_last_thread_cpu_time=get_thread_cpu_time();
+#if defined(__linux__)
+    // GRO only makes sense with recvmmsg, since a coalesced buffer needs the UDP_GRO cmsg to be split up again
+    if(m_config.recvmmsg_batch_size>1 || use_gro){
+        loop_recvmmsg();
+    }else{
+        loop_recvfrom();
+    }
+#else
+    if(m_config.recvmmsg_batch_size>1 || m_config.enable_udp_gro){
+        std::cerr<<"recvmmsg / UDP_GRO are linux only, using recvfrom\n";
+    }
+    loop_recvfrom();
+#endif
+    close(m_socket);
+}
+
+void UDPReceiver::loop_recvfrom()
+{
     //wrap into unique pointer to avoid running out of stack
     const auto buff=std::make_unique<std::array<uint8_t,UDP_PACKET_MAX_SIZE>>();
 
     sockaddr_in source;
     socklen_t sourceLen= sizeof(sockaddr_in);
-    
+
     while (m_receiving) {
         //TODO investigate: does a big buffer size create latency with MSG_WAITALL ?
         //I do not think so. recvfrom should return as soon as new data arrived,not when the buffer is full
         //But with a bigger buffer we do not loose packets when the receiver thread cannot keep up for a short amount of time
         // MSG_WAITALL does not wait until we have __n data, but a new UDP packet (that can be smaller than __n)
         //NOTE: NONBLOCKING hogs a whole CPU core ! do not use whenever possible !
-		ssize_t tmp;
+        ssize_t tmp;
         if(m_config.enable_nonblocking){
-			tmp = recvfrom(m_socket,buff->data(),UDP_PACKET_MAX_SIZE, MSG_DONTWAIT,(sockaddr*)&source,&sourceLen);
-		}else{
-			tmp = recvfrom(m_socket,buff->data(),UDP_PACKET_MAX_SIZE, MSG_WAITALL,(sockaddr*)&source,&sourceLen);
-		}
-		const ssize_t message_length=tmp;
+            tmp = recvfrom(m_socket,buff->data(),UDP_PACKET_MAX_SIZE, MSG_DONTWAIT,(sockaddr*)&source,&sourceLen);
+        }else{
+            tmp = recvfrom(m_socket,buff->data(),UDP_PACKET_MAX_SIZE, MSG_WAITALL,(sockaddr*)&source,&sourceLen);
+        }
+        m_rx_stats_n_syscalls++;
+        const ssize_t message_length=tmp;
         if (message_length > 0) { //else -1 was returned;timeout/No data received
-			if(m_last_received_packet_ts!=std::chrono::steady_clock::time_point{}){
-				//const auto delta=std::chrono::steady_clock::now()-lastReceivedPacket;
-				//avgDeltaBetweenPackets.add(delta);
-			}
-			m_last_received_packet_ts=std::chrono::steady_clock::now();
+            m_last_received_packet_ts=std::chrono::steady_clock::now();
             //LOGD("Data size %d",(int)message_length);
-            m_on_data_received_cb(buff->data(), (size_t)message_length);
-
-            m_n_received_bytes+=message_length;
-            //The source ip stuff
-            const char* p=inet_ntoa(source.sin_addr);
-            std::string s1=std::string(p);
-            if(m_sender_ip!=s1){
-                m_sender_ip=s1;
-            }
+            const Datagram datagram{buff->data(),(size_t)message_length};
+            forward_datagrams(&datagram,1);
+            on_sender_address(source);
         }else{
             if(errno != EWOULDBLOCK) {
                 //MLOGE<<"Error on recvfrom. errno="<<errno<<" "<<strerror(errno);
             }
         }
+        update_rx_stats(0,0);
     }
-    close(m_socket);
+}
+
+#if defined(__linux__)
+void UDPReceiver::loop_recvmmsg()
+{
+    const size_t batch_size=std::max(1,m_config.recvmmsg_batch_size);
+    // With GRO, the kernel might give us up to 64k of coalesced datagrams in one buffer
+    static constexpr size_t BUFF_SIZE=65535;
+    static constexpr size_t CMSG_BUFF_SIZE=CMSG_SPACE(sizeof(int));
+    // Allocated once, re-used for every receive call. Not zero-initialized on purpose - without GRO the kernel only ever
+    // writes the first (MTU sized) part of each buffer, so only those pages become resident (~16 x 4k instead of 1MB
+    // for the default batch size of 16).
+    std::unique_ptr<uint8_t[]> buffers(new uint8_t[batch_size*BUFF_SIZE]);
+    std::vector<uint8_t> cmsg_buffers(batch_size*CMSG_BUFF_SIZE);
+    std::vector<sockaddr_in> sources(batch_size);
+    std::vector<iovec> iovecs(batch_size);
+    std::vector<mmsghdr> msgs(batch_size);
+    std::vector<Datagram> datagrams;
+    datagrams.reserve(batch_size*8);
+    for(size_t i=0;i<batch_size;i++){
+        iovecs[i].iov_base=&buffers[i*BUFF_SIZE];
+        iovecs[i].iov_len=BUFF_SIZE;
+    }
+    // MSG_WAITFORONE: block until at least one datagram is available, then return whatever else is queued up
+    // (without blocking) - we never wait for the batch to become full.
+    const int flags=m_config.enable_nonblocking ? MSG_DONTWAIT : MSG_WAITFORONE;
+    while (m_receiving) {
+        // The kernel (over)writes these on each call
+        for(size_t i=0;i<batch_size;i++){
+            msghdr& hdr=msgs[i].msg_hdr;
+            memset(&hdr,0,sizeof(msghdr));
+            hdr.msg_name=&sources[i];
+            hdr.msg_namelen=sizeof(sockaddr_in);
+            hdr.msg_iov=&iovecs[i];
+            hdr.msg_iovlen=1;
+            hdr.msg_control=&cmsg_buffers[i*CMSG_BUFF_SIZE];
+            hdr.msg_controllen=CMSG_BUFF_SIZE;
+            msgs[i].msg_len=0;
+        }
+        const int n_msgs=recvmmsg(m_socket,msgs.data(),batch_size,flags,nullptr);
+        m_rx_stats_n_syscalls++;
+        if(n_msgs<=0){
+            if(n_msgs<0 && errno != EWOULDBLOCK && errno!=EINTR && m_receiving) {
+                //MLOGE<<"Error on recvmmsg. errno="<<errno<<" "<<strerror(errno);
+            }
+            update_rx_stats(0,0);
+            continue;
+        }
+        m_last_received_packet_ts=std::chrono::steady_clock::now();
+        datagrams.clear();
+        for(int i=0;i<n_msgs;i++){
+            const uint8_t* data=(const uint8_t*)iovecs[i].iov_base;
+            const size_t data_len=msgs[i].msg_len;
+            if(data_len==0)continue;
+            // If the kernel coalesced multiple datagrams, the UDP_GRO cmsg holds the segment size
+            size_t segment_size=data_len;
+            for(cmsghdr* cmsg=CMSG_FIRSTHDR(&msgs[i].msg_hdr);cmsg!=nullptr;cmsg=CMSG_NXTHDR(&msgs[i].msg_hdr,cmsg)){
+                if(cmsg->cmsg_level==SOL_UDP && cmsg->cmsg_type==UDP_GRO){
+                    int gso_size=0;
+                    memcpy(&gso_size,CMSG_DATA(cmsg),sizeof(int));
+                    if(gso_size>0)segment_size=gso_size;
+                }
+            }
+            for(size_t offset=0;offset<data_len;offset+=segment_size){
+                datagrams.push_back(Datagram{data+offset,std::min(segment_size,data_len-offset)});
+            }
+        }
+        forward_datagrams(datagrams.data(),datagrams.size());
+        on_sender_address(sources[n_msgs-1]);
+    }
+}
+#endif
+
+void UDPReceiver::forward_datagrams(const Datagram *datagrams, size_t n_datagrams)
+{
+    uint64_t n_bytes=0;
+    for(size_t i=0;i<n_datagrams;i++){
+        n_bytes+=datagrams[i].data_len;
+    }
+    if(m_on_data_batch_received_cb){
+        m_on_data_batch_received_cb(datagrams,n_datagrams);
+    }else{
+        for(size_t i=0;i<n_datagrams;i++){
+            m_on_data_received_cb(datagrams[i].data,datagrams[i].data_len);
+        }
+    }
+    m_n_received_bytes+=n_bytes;
+    update_rx_stats(n_datagrams,n_bytes);
+}
+
+void UDPReceiver::on_sender_address(const sockaddr_in &source)
+{
+    // Plain integer compare & store, no string conversion per packet
+    if(m_sender_addr!=source.sin_addr.s_addr){
+        m_sender_addr=source.sin_addr.s_addr;
+    }
+}
+
+void UDPReceiver::update_rx_stats(int n_packets,uint64_t n_bytes)
+{
+    m_rx_stats_n_packets+=n_packets;
+    m_rx_stats_n_bytes+=n_bytes;
+    if(!m_rx_stats_cb)return;
+    const auto now=std::chrono::steady_clock::now();
+    const auto elapsed=now-m_rx_stats_last_recalculation;
+    if(elapsed<std::chrono::seconds(1))return;
+    const double elapsed_s=std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()/1000.0/1000.0;
+    const auto cpu_time=get_thread_cpu_time();
+    const auto cpu_time_delta_us=std::chrono::duration_cast<std::chrono::microseconds>(cpu_time-m_rx_stats_last_thread_cpu_time).count();
+    const double mbits=m_rx_stats_n_bytes*8/1000.0/1000.0;
+    RxStats stats{};
+    stats.packets_per_second=static_cast<int>(m_rx_stats_n_packets/elapsed_s);
+    stats.syscalls_per_second=static_cast<int>(m_rx_stats_n_syscalls/elapsed_s);
+    stats.cpu_us_per_mbit= mbits>0 ? static_cast<int>(cpu_time_delta_us/mbits) : 0;
+    m_rx_stats_cb(stats);
+    m_rx_stats_n_packets=0;
+    m_rx_stats_n_syscalls=0;
+    m_rx_stats_n_bytes=0;
+    m_rx_stats_last_recalculation=now;
+    m_rx_stats_last_thread_cpu_time=cpu_time;
 }
 
 int UDPReceiver::getPort() const {
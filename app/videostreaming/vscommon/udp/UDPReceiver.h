@@ -19,6 +19,14 @@
 class UDPReceiver {
 public:
     typedef std::function<void(const uint8_t[],size_t)> DATA_CALLBACK;
+    // A single received datagram, only valid for the duration of the callback
+    struct Datagram{
+        const uint8_t* data;
+        size_t data_len;
+    };
+    // Called with all the datagrams received by one (batched) receive syscall.
+    // (Span of n_datagrams elements, only valid for the duration of the callback)
+    typedef std::function<void(const Datagram* datagrams,size_t n_datagrams)> DATA_BATCH_CALLBACK;
     // Custom struct to keep the constructor simple / documented
     struct Configuration{
         // If no IP addr is given, uses INADRR_ANY
@@ -34,6 +42,13 @@ public:
         bool set_sched_param_max_realtime=false;
         // busy instead of blocking receive - hogs one cpu core, experimental
         bool enable_nonblocking=false;
+        // Max n of datagrams fetched per recvmmsg() syscall - 1 means legacy recvfrom() per datagram.
+        // At high bitrates this saves a lot of syscalls (and therefore CPU) on the receiving side. Linux only (like GRO),
+        // other platforms always use recvfrom().
+        int recvmmsg_batch_size=1;
+        // Let the kernel coalesce consecutive datagrams of the same flow (UDP_GRO, linux >= 5.0)
+        // we split them up again before forwarding, so this is transparent to the consumer.
+        bool enable_udp_gro=false;
         std::string to_string()const{
             std::stringstream ss;
             ss<<udp_ip_address.value_or("INADDR_ANY")<<":"<<udp_port;
@@ -46,6 +61,12 @@ public:
             if(enable_nonblocking){
                 ss<<" enable_nonblocking";
             }
+            if(recvmmsg_batch_size>1){
+                ss<<" recvmmsg_batch_size:"<<recvmmsg_batch_size;
+            }
+            if(enable_udp_gro){
+                ss<<" enable_udp_gro";
+            }
             return ss.str();
         }
     };
@@ -55,6 +76,8 @@ public:
      * @param onDataReceivedCallback: called every time new data is received
      */
     UDPReceiver(std::string tag,Configuration config,DATA_CALLBACK onDataReceivedCallbackX);
+    // Same as above, but all datagrams of one receive call are forwarded at once
+    UDPReceiver(std::string tag,Configuration config,DATA_BATCH_CALLBACK onDataBatchReceivedCallbackX);
     /**
      * Start receiver thread,which opens UDP port
      */
@@ -67,16 +90,44 @@ public:
     long getNReceivedBytes()const;
     std::string getSourceIPAddress()const;
     int getPort()const;
+    // Receive performance, recalculated in 1 second intervals by the receive thread.
+    // Use this to compare the different receive modes (recvfrom / recvmmsg / recvmmsg+GRO) -
+    // cpu_us_per_mbit is the CPU time spent by the receive thread (including the callback) per MBit of received data.
+    struct RxStats{
+        int packets_per_second=0;
+        int syscalls_per_second=0;
+        int cpu_us_per_mbit=0;
+        std::string to_string()const{
+            std::stringstream ss;
+            ss<<packets_per_second<<"pps "<<syscalls_per_second<<"sys/s "<<cpu_us_per_mbit<<"us/MBit";
+            return ss.str();
+        }
+    };
+    typedef std::function<void(const RxStats& stats)> RX_STATS_CALLBACK;
+    // Optional, called from the receive thread whenever the rx stats have been recalculated.
+    // Must be set before startReceiving()
+    void set_rx_stats_callback(RX_STATS_CALLBACK cb);
     static constexpr auto BIG_UDP_RECEIVE_BUFFER_SIZE=1024*1024*50;
     static constexpr auto MEDIUM_UDP_RECEIVE_BUFFER_SIZE=1024*1024*25;
 private:
     void receiveFromUDPLoop();
+    // Legacy, one recvfrom() per datagram
+    void loop_recvfrom();
+#if defined(__linux__)
+    // Up to m_config.recvmmsg_batch_size datagrams (or GRO segments) per syscall
+    void loop_recvmmsg();
+#endif
+    void forward_datagrams(const Datagram* datagrams,size_t n_datagrams);
+    void on_sender_address(const sockaddr_in& source);
+    void update_rx_stats(int n_packets,uint64_t n_bytes);
     const std::string m_tag;
     const Configuration m_config;
     const DATA_CALLBACK m_on_data_received_cb=nullptr;
+    const DATA_BATCH_CALLBACK m_on_data_batch_received_cb=nullptr;
     ///We need this reference to stop the receiving thread
     int m_socket=0;
-    std::string m_sender_ip="0.0.0.0";
+    // Raw ipv4 address (network byte order) - only converted to a string when somebody actually asks for it.
+    std::atomic<uint32_t> m_sender_addr{0};
     std::unique_ptr<std::thread> m_receive_thread;
     std::atomic<bool> m_receiving={false};
     std::atomic<long> m_n_received_bytes={0};
@@ -84,6 +135,13 @@ private:
     //65,507 bytes (65,535 − 8 byte UDP header − 20 byte IP header).
     static constexpr const size_t UDP_PACKET_MAX_SIZE=65507;
     std::chrono::steady_clock::time_point m_last_received_packet_ts{};
+private:
+    RX_STATS_CALLBACK m_rx_stats_cb=nullptr;
+    int m_rx_stats_n_packets=0;
+    int m_rx_stats_n_syscalls=0;
+    uint64_t m_rx_stats_n_bytes=0;
+    std::chrono::steady_clock::time_point m_rx_stats_last_recalculation=std::chrono::steady_clock::now();
+    std::chrono::nanoseconds m_rx_stats_last_thread_cpu_time{0};
 };
 
 #endif // FPV_VR_UDPRECEIVER_H
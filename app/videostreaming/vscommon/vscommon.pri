@@ -17,19 +17,33 @@ windows {
         $$PWD/rtp/ParseRTP.cpp \
         $$PWD/rtp/rtpreceiver.cpp \
         $$PWD/udp/UDPReceiver.cpp \
+        $$PWD/udp/ReplaySource.cpp \
+        $$PWD/recording/GroundRecorder.cpp \
         $$PWD/decodingstatistcs.cpp \
 
     HEADERS += \
         $$PWD/nalu/KeyFrameFinder.hpp \
         $$PWD/nalu/NALUnitType.hpp \
+        $$PWD/nalu/NALUBufferPool.hpp \
+        $$PWD/nalu/AccessUnitAssembler.hpp \
+        $$PWD/nalu/GOPCache.hpp \
+        $$PWD/nalu/DecoderQueue.hpp \
         $$PWD/rtp/ParseRTP.h \
         $$PWD/rtp/RTP.hpp \
+        $$PWD/rtp/RTPReorderBuffer.hpp \
         $$PWD/rtp/rtpreceiver.h \
         $$PWD/udp/UDPReceiver.h \
+        $$PWD/udp/ReplaySource.h \
+        $$PWD/recording/GroundRecorder.h \
         $$PWD/decodingstatistcs.h \
         $$PWD/QOpenHDVideoHelper.hpp \
+        $$PWD/FrameLatencyTracer.hpp \
 }
 
+SOURCES += \
+    $$PWD/recording/groundrecordingmodel.cpp \
+
 HEADERS += \
-    $$PWD/ExternalDecodeService.hpp
+    $$PWD/ExternalDecodeService.hpp \
+    $$PWD/recording/groundrecordingmodel.h \
 
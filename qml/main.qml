@@ -62,7 +62,8 @@ ApplicationWindow {
         AppSettings {
             id: settings
             Component.onCompleted: {
-                //
+                // changes made here are applied to the c++ settings cache (no QSettings access in c++ hot paths)
+                _settingsCache.watch_qml_settings(settings)
             }
         }
 
@@ -228,6 +228,146 @@ ScrollView {
                     onCheckedChanged: settings.dev_wb_show_no_stbc_enabled_warning = checked
                 }
             }
+            SettingBaseElement{
+                m_short_description: "dev_telemetry_benchmark_report"
+                m_long_description: "Write the telemetry stats (rate, processing time, property update latency, UI CPU) for tools/mavlink_sim once per second"
+                Switch {
+                    width: 32
+                    height: elementHeight
+                    anchors.rightMargin: Qt.inputMethod.visible ? 96 : 36
+                    anchors.right: parent.right
+                    anchors.verticalCenter: parent.verticalCenter
+                    checked: settings.dev_telemetry_benchmark_report
+                    onCheckedChanged: settings.dev_telemetry_benchmark_report = checked
+                }
+            }
+            SettingBaseElement{
+                m_short_description: "dev_mavlink_uplink_budget_kbits"
+                m_long_description: "Uplink budget (kbit/s) for the messages QOpenHD sends, control messages (RC override) are never delayed. 0 == unlimited"
+                SpinBox {
+                    height: elementHeight
+                    width: 210
+                    font.pixelSize: 14
+                    anchors.right: parent.right
+                    anchors.verticalCenter: parent.verticalCenter
+                    from: 0
+                    to: 1000
+                    stepSize: 1
+                    editable: true
+                    anchors.rightMargin: Qt.inputMethod.visible ? 78 : 18
+                    value: settings.dev_mavlink_uplink_budget_kbits
+                    onValueModified: settings.dev_mavlink_uplink_budget_kbits = value
+                }
+            }
+            SettingBaseElement{
+                m_short_description: "tlog_recording_enable"
+                m_long_description: "Requires full restart. Record all received telemetry into a .tlog per flight (readable by QGroundControl / MissionPlanner), can be replayed below"
+                Switch {
+                    width: 32
+                    height: elementHeight
+                    anchors.rightMargin: Qt.inputMethod.visible ? 96 : 36
+                    anchors.right: parent.right
+                    anchors.verticalCenter: parent.verticalCenter
+                    checked: settings.tlog_recording_enable
+                    onCheckedChanged: settings.tlog_recording_enable = checked
+                }
+            }
+            SettingBaseElement{
+                m_short_description: "Replay telemetry log"
+                m_long_description: "Drive the OSD from a recorded .tlog instead of the live telemetry (newest recording first)"
+                ComboBox {
+                    id: tlog_replay_file
+                    height: elementHeight
+                    width: 320
+                    anchors.right: tlog_replay_button.left
+                    anchors.rightMargin: 6
+                    anchors.verticalCenter: parent.verticalCenter
+                    enabled: !_tlogReplay.replay_active
+                    displayText: currentText.substring(currentText.lastIndexOf("/")+1)
+                    onPressedChanged: {
+                        if(pressed){
+                            model = _tlogReplay.get_recordings()
+                        }
+                    }
+                    Component.onCompleted: model = _tlogReplay.get_recordings()
+                }
+                Button {
+                    id: tlog_replay_button
+                    height: elementHeight
+                    anchors.rightMargin: Qt.inputMethod.visible ? 96 : 36
+                    anchors.right: parent.right
+                    anchors.verticalCenter: parent.verticalCenter
+                    text: _tlogReplay.replay_active ? qsTr("Stop") : qsTr("Start")
+                    onClicked: {
+                        if(_tlogReplay.replay_active){
+                            _tlogReplay.stop()
+                        }else if(!_tlogReplay.start(tlog_replay_file.currentText)){
+                            _messageBoxInstance.set_text_and_show("Cannot replay "+tlog_replay_file.currentText)
+                        }
+                    }
+                }
+            }
+            SettingBaseElement{
+                m_short_description: "Replay speed"
+                m_long_description: "1x (original timing) to 100x"
+                visible: _tlogReplay.replay_active
+                SpinBox {
+                    height: elementHeight
+                    width: 210
+                    font.pixelSize: 14
+                    anchors.right: parent.right
+                    anchors.verticalCenter: parent.verticalCenter
+                    from: 1
+                    to: 100
+                    stepSize: 1
+                    editable: true
+                    anchors.rightMargin: Qt.inputMethod.visible ? 78 : 18
+                    value: _tlogReplay.replay_speed
+                    onValueModified: _tlogReplay.set_playback_speed(value)
+                }
+            }
+            SettingBaseElement{
+                m_short_description: "Replay position"
+                m_long_description: _tlogReplay.replay_file
+                visible: _tlogReplay.replay_active
+                Text {
+                    anchors.right: tlog_replay_slider.left
+                    anchors.rightMargin: 6
+                    anchors.verticalCenter: parent.verticalCenter
+                    font.pixelSize: 14
+                    text: _tlogReplay.replay_position_s.toFixed(0)+"/"+_tlogReplay.replay_duration_s.toFixed(0)+"s"
+                }
+                Slider {
+                    id: tlog_replay_slider
+                    height: elementHeight
+                    width: 240
+                    anchors.right: tlog_replay_pause.left
+                    anchors.verticalCenter: parent.verticalCenter
+                    from: 0
+                    to: _tlogReplay.replay_duration_s
+                    onPressedChanged: {
+                        if(!pressed){
+                            _tlogReplay.seek(value)
+                        }
+                    }
+                }
+                // follow the replay, unless the user is dragging
+                Binding {
+                    target: tlog_replay_slider
+                    property: "value"
+                    value: _tlogReplay.replay_position_s
+                    when: !tlog_replay_slider.pressed
+                }
+                Button {
+                    id: tlog_replay_pause
+                    height: elementHeight
+                    anchors.rightMargin: Qt.inputMethod.visible ? 96 : 36
+                    anchors.right: parent.right
+                    anchors.verticalCenter: parent.verticalCenter
+                    text: _tlogReplay.replay_paused ? qsTr("Play") : qsTr("Pause")
+                    onClicked: _tlogReplay.set_paused(!_tlogReplay.replay_paused)
+                }
+            }
         }
         Card {
             id: simplePopupHack
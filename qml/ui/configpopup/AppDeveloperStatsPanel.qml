@@ -76,6 +76,48 @@ Rectangle {
             id: tele_in
             text: qsTr("Tele in"+_mavlinkTelemetry.telemetry_pps_in+" pps")
         }
+        Text {
+            id: tele_processing_time
+            text: qsTr("Tele processing: "+_mavlinkTelemetry.telemetry_processing_time)
+        }
+        // link budget, real (on the wire) size per mavlink sys:comp id
+        Text {
+            id: tele_link_budget
+            text: qsTr("Tele link in: "+_telemetryLinkStatsModel.total_in+" out: "+_telemetryLinkStatsModel.total_out+" lost: "+_telemetryLinkStatsModel.total_lost_packets)
+        }
+        Repeater {
+            model: _telemetryLinkStatsModel
+            Text {
+                text: "  "+name+": "+readable
+            }
+        }
+        // outgoing, delay per priority class (control / cmd / param / bulk)
+        Text {
+            id: tele_send_queue
+            text: qsTr("Tele send queue: "+_mavlinkTelemetry.send_queue_stats)
+        }
+        // per message type rate / handler time, most expensive first - use it to set the message rates
+        Text {
+            id: tele_msg_stats_fc
+            text: _fcMavlinkSystem.mavlink_message_stats
+        }
+        Text {
+            id: tele_msg_stats_air
+            text: _ohdSystemAir.mavlink_message_stats
+        }
+        Text {
+            id: tele_msg_stats_ground
+            text: _ohdSystemGround.mavlink_message_stats
+        }
+        Text {
+            id: tlog_recorder_status
+            text: qsTr("TLog: "+(_tlogRecorder.recording_active ? _tlogRecorder.recording_file+" "+_tlogRecorder.recording_status : "not recording"))
+        }
+        // should be ~0 in steady state, all settings reads are served from the in-memory cache
+        Text {
+            id: settings_backend_access
+            text: qsTr("Settings backend reads: "+_settingsCache.backend_reads_per_second+"/s writes: "+_settingsCache.backend_writes_per_second+"/s")
+        }
         // air
         Text {
             id: test2
@@ -74,6 +74,133 @@ ScrollView {
                     onCheckedChanged: settings.qopenhd_primary_video_force_sw = checked
                 }
             }
+
+            ListModel {
+                id: itemsDecodeThreading
+                ListElement { text: "Single (lowest latency)"; }
+                ListElement { text: "Slice threads"; }
+                ListElement { text: "Frame threads"; }
+                ListElement { text: "Auto"; }
+            }
+
+            SettingBaseElement{
+                m_short_description: "SW decode threading"
+                m_long_description: "Threading of the software decoder. Slice threads don't add latency, but only help if the stream has multiple slices. Frame threads always help, but add one frame of latency per extra thread. Auto uses slice threads and switches to frame threads if decoding cannot keep up with the frame rate."
+                ComboBox {
+                    width: 320
+                    height: elementHeight
+                    anchors.right: parent.right
+                    anchors.rightMargin: Qt.inputMethod.visible ? 96 : 36
+                    anchors.verticalCenter: parent.verticalCenter
+                    anchors.horizontalCenter: parent.horizonatalCenter
+                    model: itemsDecodeThreading
+                    Component.onCompleted: {
+                        // out of bounds checking
+                        if(settings.qopenhd_primary_video_decode_threading>3 || settings.qopenhd_primary_video_decode_threading<0){
+                            settings.qopenhd_primary_video_decode_threading=0;
+                        }
+                        currentIndex = settings.qopenhd_primary_video_decode_threading;
+                    }
+                    onCurrentIndexChanged:{
+                        settings.qopenhd_primary_video_decode_threading=currentIndex;
+                    }
+                }
+            }
+            SettingBaseElement{
+                m_short_description: "SW decode threads"
+                m_long_description: "N of threads for slice / frame threading, 0 means one per CPU core."
+                SpinBox {
+                    height: elementHeight
+                    width: 210
+                    font.pixelSize: 14
+                    anchors.right: parent.right
+                    anchors.verticalCenter: parent.verticalCenter
+                    from: 0
+                    to: 16
+                    stepSize: 1
+                    editable: true
+                    anchors.rightMargin: Qt.inputMethod.visible ? 78 : 18
+                    value: settings.qopenhd_primary_video_decode_n_threads
+                    onValueChanged: settings.qopenhd_primary_video_decode_n_threads = value
+                }
+            }
+            ListModel {
+                id: itemsPresentationMode
+                ListElement { text: "Lowest latency"; }
+                ListElement { text: "Smooth"; }
+            }
+
+            SettingBaseElement{
+                m_short_description: "Frame presentation"
+                m_long_description: "Lowest latency always shows the newest decoded frame. Smooth aligns frames to the display refresh such that each frame is shown for the same time, at the cost of up to one refresh of latency. Takes effect after a restart."
+                ComboBox {
+                    width: 320
+                    height: elementHeight
+                    anchors.right: parent.right
+                    anchors.rightMargin: Qt.inputMethod.visible ? 96 : 36
+                    anchors.verticalCenter: parent.verticalCenter
+                    anchors.horizontalCenter: parent.horizonatalCenter
+                    model: itemsPresentationMode
+                    Component.onCompleted: {
+                        // out of bounds checking
+                        if(settings.qopenhd_primary_video_presentation_mode>1 || settings.qopenhd_primary_video_presentation_mode<0){
+                            settings.qopenhd_primary_video_presentation_mode=0;
+                        }
+                        currentIndex = settings.qopenhd_primary_video_presentation_mode;
+                    }
+                    onCurrentIndexChanged:{
+                        settings.qopenhd_primary_video_presentation_mode=currentIndex;
+                    }
+                }
+            }
+            ListModel {
+                id: itemsGroundRecordingContainer
+                ListElement { text: "MKV"; }
+                ListElement { text: "MP4"; }
+                ListElement { text: "Raw h264/h265"; }
+            }
+
+            SettingBaseElement{
+                m_short_description: "Ground recording format"
+                m_long_description: "File format for recording the received video on the ground station (record widget), the video is not re-encoded. Takes effect after a restart."
+                ComboBox {
+                    width: 320
+                    height: elementHeight
+                    anchors.right: parent.right
+                    anchors.rightMargin: Qt.inputMethod.visible ? 96 : 36
+                    anchors.verticalCenter: parent.verticalCenter
+                    anchors.horizontalCenter: parent.horizonatalCenter
+                    model: itemsGroundRecordingContainer
+                    Component.onCompleted: {
+                        // out of bounds checking
+                        if(settings.qopenhd_ground_recording_container>2 || settings.qopenhd_ground_recording_container<0){
+                            settings.qopenhd_ground_recording_container=0;
+                        }
+                        currentIndex = settings.qopenhd_ground_recording_container;
+                    }
+                    onCurrentIndexChanged:{
+                        settings.qopenhd_ground_recording_container=currentIndex;
+                    }
+                }
+            }
+            SettingBaseElement{
+                m_short_description: "Ground recording segment"
+                m_long_description: "Start a new file every N minutes (at the next keyframe), 0 means one file per recording. Takes effect after a restart."
+                SpinBox {
+                    height: elementHeight
+                    width: 210
+                    font.pixelSize: 14
+                    anchors.right: parent.right
+                    anchors.verticalCenter: parent.verticalCenter
+                    from: 0
+                    to: 120
+                    stepSize: 1
+                    editable: true
+                    anchors.rightMargin: Qt.inputMethod.visible ? 78 : 18
+                    value: settings.qopenhd_ground_recording_segment_minutes
+                    onValueChanged: settings.qopenhd_ground_recording_segment_minutes = value
+                }
+            }
             SettingBaseElement{
                 m_short_description: "Video port"
                 m_long_description: "Video port for video stream data"
@@ -93,6 +220,87 @@ ScrollView {
                 }
             }
 
+            ListModel {
+                id: itemsSecondaryVideoLayout
+                ListElement { text: "Picture in picture"; }
+                ListElement { text: "Swapped";  }
+            }
+            SettingBaseElement{
+                m_short_description: "Secondary video (dualcam)"
+                m_long_description: "Decode and show the video of the secondary camera (picture in picture). Requires a restart."
+                Switch {
+                    width: 32
+                    height: elementHeight
+                    anchors.rightMargin: Qt.inputMethod.visible ? 96 : 36
+
+                    anchors.right: parent.right
+                    anchors.verticalCenter: parent.verticalCenter
+                    checked: settings.dev_qopenhd_n_cameras==2
+                    onCheckedChanged: settings.dev_qopenhd_n_cameras = checked ? 2 : 1
+                }
+            }
+            SettingBaseElement{
+                m_short_description: "Secondary video port"
+                m_long_description: "Video port for the secondary video stream data"
+                visible: settings.dev_qopenhd_n_cameras==2
+                SpinBox {
+                    height: elementHeight
+                    width: 210
+                    font.pixelSize: 14
+                    anchors.right: parent.right
+                    anchors.verticalCenter: parent.verticalCenter
+                    from: 1
+                    to: 6900
+                    stepSize: 1
+                    editable: true
+                    anchors.rightMargin: Qt.inputMethod.visible ? 78 : 18
+                    value: settings.qopenhd_secondary_video_rtp_input_port
+                    onValueChanged: settings.qopenhd_secondary_video_rtp_input_port = value
+                }
+            }
+            SettingBaseElement{
+                m_short_description: "Secondary video codec"
+                m_long_description: "Video codec of the secondary stream."
+                visible: settings.dev_qopenhd_n_cameras==2
+                ComboBox {
+                    width: 320
+                    height: elementHeight
+                    anchors.right: parent.right
+                    anchors.rightMargin: Qt.inputMethod.visible ? 96 : 36
+                    anchors.verticalCenter: parent.verticalCenter
+                    model: itemsVideoCodec
+                    Component.onCompleted: {
+                        // out of bounds checking
+                        if(settings.qopenhd_secondary_video_codec>1 || settings.qopenhd_secondary_video_codec<0){
+                            settings.qopenhd_secondary_video_codec=0;
+                        }
+                        currentIndex = settings.qopenhd_secondary_video_codec;
+                    }
+                    onCurrentIndexChanged:{
+                        settings.qopenhd_secondary_video_codec=currentIndex;
+                    }
+                }
+            }
+            SettingBaseElement{
+                m_short_description: "Secondary video layout"
+                m_long_description: "Picture in picture: secondary video in the bottom right corner. Swapped: secondary video full screen, primary video in the bottom right corner."
+                visible: settings.dev_qopenhd_n_cameras==2
+                ComboBox {
+                    width: 320
+                    height: elementHeight
+                    anchors.right: parent.right
+                    anchors.rightMargin: Qt.inputMethod.visible ? 96 : 36
+                    anchors.verticalCenter: parent.verticalCenter
+                    model: itemsSecondaryVideoLayout
+                    Component.onCompleted: {
+                        currentIndex = settings.qopenhd_secondary_video_layout;
+                    }
+                    onCurrentIndexChanged:{
+                        settings.qopenhd_secondary_video_layout=currentIndex;
+                    }
+                }
+            }
+
             SettingBaseElement{
                 m_short_description: "Scale video to fit"
                 m_long_description: "Fit the video to the exact screen size (discards actual video aspect ratio,aka video is a bit distorted). Not supported on all platforms / implementations. Might require a restart."
@@ -136,6 +344,48 @@ ScrollView {
                 }
             }
 
+            SettingBaseElement{
+                m_short_description: "dev_pbo_texture_upload"
+                m_long_description: "Upload sw decoded frames via pixel unpack buffers (needs OpenGL ES 3), takes effect after a restart"
+                Switch {
+                    width: 32
+                    height: elementHeight
+                    anchors.rightMargin: Qt.inputMethod.visible ? 96 : 36
+                    anchors.right: parent.right
+                    anchors.verticalCenter: parent.verticalCenter
+                    checked: settings.dev_pbo_texture_upload
+                    onCheckedChanged: settings.dev_pbo_texture_upload = checked
+                }
+            }
+
+            SettingBaseElement{
+                m_short_description: "dev_frame_latency_tracer"
+                m_long_description: "Trace the latency of each frame through the video pipeline (udp rx until displayed), shown in the video stats"
+                Switch {
+                    width: 32
+                    height: elementHeight
+                    anchors.rightMargin: Qt.inputMethod.visible ? 96 : 36
+                    anchors.right: parent.right
+                    anchors.verticalCenter: parent.verticalCenter
+                    checked: settings.dev_frame_latency_tracer
+                    onCheckedChanged: settings.dev_frame_latency_tracer = checked
+                }
+            }
+
+            SettingBaseElement{
+                m_short_description: "dev_video_replay"
+                m_long_description: "Replay the recorded stream in dev_video_replay_file (pcap of rtp/udp or Annex-B h264/h265) instead of receiving video via udp, for testing without an air unit"
+                Switch {
+                    width: 32
+                    height: elementHeight
+                    anchors.rightMargin: Qt.inputMethod.visible ? 96 : 36
+                    anchors.right: parent.right
+                    anchors.verticalCenter: parent.verticalCenter
+                    checked: settings.dev_video_replay
+                    onCheckedChanged: settings.dev_video_replay = checked
+                }
+            }
+
             SettingBaseElement{
                 m_short_description: "dev_always_use_generic_external_decode_service"
                 //m_long_description: "Video decode is not done via QOpenHD, but rather in an extra service (started and stopped by QOpenHD). For platforms other than rpi"
@@ -30,15 +30,57 @@ Settings {
     // Video codec of the primary video stream (main window).
     property int qopenhd_primary_video_codec: 0 //0==h264,1==h265, other (error) default to h264
     property bool qopenhd_primary_video_force_sw: false
+    // SW decode threading: 0==single,1==slice,2==frame,3==auto and n of threads (0==n of cpu cores)
+    property int qopenhd_primary_video_decode_threading: 0
+    property int qopenhd_primary_video_decode_n_threads: 0
+    // Frame presentation (OpenGL video): 0==lowest latency (always show the newest frame), 1==smooth (vsync phase aware)
+    property int qopenhd_primary_video_presentation_mode: 0
+    // Secondary video (dualcam, dev_qopenhd_n_cameras==2), decoded in parallel to the primary video (avcodec)
+    property int qopenhd_secondary_video_rtp_input_port: 5601
+    property string qopenhd_secondary_video_rtp_input_ip: "127.0.0.1"
+    property int qopenhd_secondary_video_codec: 0 //0==h264,1==h265
+    property bool qopenhd_secondary_video_force_sw: false
+    property int qopenhd_secondary_video_decode_threading: 0
+    property int qopenhd_secondary_video_decode_n_threads: 0
+    // 0==secondary video as picture in picture, 1==swapped (secondary video full screen, primary video as picture in picture)
+    property int qopenhd_secondary_video_layout: 0
+    // ground side recording (DVR) of the primary video: 0 == mkv, 1 == mp4, 2 == raw h264/h265
+    property int qopenhd_ground_recording_container: 0
+    // a new file every N minutes, 0 == one file per recording
+    property int qopenhd_ground_recording_segment_minutes: 10
 
     // When this one is set to true, we read a file (where you can then write your custom rx gstreamer pipeline
     // that ends with qmlglsink )
     property bool dev_enable_custom_pipeline: false
 
     property bool dev_draw_alternating_rgb_dummy_frames: false;
+    // sw decoded frames are copied into pixel unpack buffers on the decoder thread (if supported by the GL context)
+    property bool dev_pbo_texture_upload: true
 
     property bool dev_feed_incomplete_frames_to_decoder:false;
 
+    // n of udp datagrams fetched per receive syscall (1 == legacy recvfrom) and kernel udp coalescing
+    property int dev_udp_recvmmsg_batch_size: 16
+    property bool dev_udp_enable_gro: false
+    // rtp reorder window (0 packets == disabled) - trades a bit of latency for less discarded frames with out of order packets
+    property int dev_rtp_reorder_window_packets: 0
+    property int dev_rtp_reorder_window_us: 5000
+    // feed one packet per frame (all slices) instead of one packet per NALU to the decoder
+    property bool dev_rtp_assemble_access_units: true
+    // cache all frames since the last keyframe to restart the decoder without waiting for a keyframe (0 == disabled)
+    property int dev_rtp_gop_cache_size_kb: 16384
+    // max. amount of video (ms) queued for the decoder, above that frames are dropped (non-reference frames first)
+    property int dev_decoder_queue_max_ms: 200
+    // per frame latency (percentiles per pipeline stage) in the video stats, small overhead
+    property bool dev_frame_latency_tracer: true
+    // replay a recorded stream (pcap / Annex-B file) instead of receiving video via udp
+    property bool dev_video_replay: false
+    property string dev_video_replay_file: "/usr/local/share/qopenhd/video_replay.pcap"
+    // 100 == original timing, 0 == as fast as possible
+    property int dev_video_replay_speed_percent: 100
+    // rate (Hz) at which changed FC telemetry values are pushed to the UI, 0 == display refresh rate, -1 == every change right away (legacy)
+    property int dev_telemetry_publish_rate_hz: 0
+
     // dirty, perhaps temporary
     property bool dev_always_use_generic_external_decode_service: false
 
@@ -358,6 +400,16 @@ Settings {
     property bool dev_mavlink_via_tcp: false
     property string dev_mavlink_tcp_ip: "0.0.0.0"
 
+    // telemetry flight recorder (.tlog), requires restart
+    property bool tlog_recording_enable: false
+    // the oldest recordings are deleted above this size
+    property int tlog_max_total_mb: 1024
+    property int dev_tlog_ring_size_mb: 8
+    // stats for the telemetry load test (tools/mavlink_sim), written to the temp directory once per second
+    property bool dev_telemetry_benchmark_report: false
+    // pacing of the (non control) outgoing mavlink messages, 0 == unlimited
+    property int dev_mavlink_uplink_budget_kbits: 0
+
     // message can be removed if needed.
     property bool dev_wb_show_no_stbc_enabled_warning: false
 
@@ -17,7 +17,7 @@ BaseWidget {
         if(settings.show_minimal_record_widget){
             return 35;
         }
-        return 150;
+        return 190;
     }
     function get_height(){
         if(settings.show_minimal_record_widget){
@@ -42,13 +42,15 @@ BaseWidget {
     hasWidgetDetail: true
     hasWidgetAction: true
     widgetActionWidth: 250
-    widgetActionHeight: 130
+    widgetActionHeight: 230
     widgetDetailWidth:275
     widgetDetailHeight:175
 
     // Set to true if the camera is currently doing recordng (the UI element(s) turn red in this case)
     property bool m_camera1_is_currently_recording: _cameraStreamModelPrimary.air_recording_active
     property bool m_camera2_is_currently_recording: _cameraStreamModelSecondary.air_recording_active
+    // Ground side recording (DVR) of the received primary video
+    property bool m_ground_is_currently_recording: _groundRecording.recording_active
 
     // THIS IS A MAVLINK PARAM, SYNCHRONIZATION THEREFORE IS HARD AND HERE NOT WORTH IT
     property int m_camera1_recording_mode: -1
@@ -221,6 +223,55 @@ BaseWidget {
                     }
                 }
             }
+            Text {
+                text: qsTr("(Ground) Record Video");
+                color: settings.color_text
+                elide: Text.ElideNone
+                wrapMode: Text.NoWrap
+                horizontalAlignment: Text.AlignLeft
+                font.pixelSize: settings.recordTextSize
+                font.family: settings.font_text
+                style: Text.Outline
+                styleColor: settings.color_glow
+                visible: true
+            }
+            Item{
+                width: parent.width
+                height: 50
+                GridLayout{
+                    width: parent.width
+                    height: parent.height
+                    rows: 1
+                    columns: 2
+                    Button{
+                        text: "OFF"
+                        onClicked: {
+                            _groundRecording.set_recording(false)
+                            _hudLogMessagesModel.signalAddLogMessage(6,"ground recording disabled")
+                        }
+                        highlighted: !_groundRecording.recording_requested
+                    }
+                    Button{
+                        text: "ON"
+                        onClicked: {
+                            _groundRecording.set_recording(true)
+                            _hudLogMessagesModel.signalAddLogMessage(6,"ground recording enabled")
+                        }
+                        highlighted: _groundRecording.recording_requested
+                    }
+                }
+            }
+            Text {
+                text: _groundRecording.recording_status
+                color: m_ground_is_currently_recording ? "green" : settings.color_text
+                elide: Text.ElideRight
+                wrapMode: Text.NoWrap
+                font.pixelSize: settings.recordTextSize
+                font.family: settings.font_text
+                style: Text.Outline
+                styleColor: settings.color_glow
+                visible: _groundRecording.recording_requested
+            }
         }
     }
 
@@ -260,6 +311,22 @@ BaseWidget {
             styleColor: settings.color_glow
             visible: true
         }
+        Text {
+            id:record_status_ground
+            text: "GND"
+            color: m_ground_is_currently_recording ? "green" : "red"
+            anchors.fill: parent
+            anchors.leftMargin: 140*settings.recordTextSize/14
+            anchors.topMargin: 5*settings.recordTextSize/12
+            verticalAlignment: Text.AlignVCenter
+            elide: Text.ElideNone
+            wrapMode: Text.NoWrap
+            font.pixelSize: settings.recordTextSize
+            font.family: settings.font_text
+            style: Text.Outline
+            styleColor: settings.color_glow
+            visible: true
+        }
         Text {
             text: qsTr("Free Space");
             color: settings.color_text
@@ -303,7 +370,7 @@ BaseWidget {
             id:record_status_cam1_min
             text: "\uf03d"
             font.family: "Font Awesome 5 Free"
-            color: (m_camera1_is_currently_recording == true) ? "red" : "white"
+            color: (m_camera1_is_currently_recording == true || m_ground_is_currently_recording == true) ? "red" : "white"
             anchors.fill: parent
             anchors.leftMargin: 5*settings.recordTextSize/14
             anchors.topMargin: 5*settings.recordTextSize/12
@@ -0,0 +1,21 @@
+# Check of the decoder queue overload policy (DecoderQueue): queued non-reference frames are dropped first,
+# a reference frame only once there is nothing left to drop.
+# qmake tools/decoder_queue_test/decoder_queue_test.pro && make
+# ./decoder_queue_test
+TEMPLATE = app
+TARGET = decoder_queue_test
+CONFIG += c++17 console
+CONFIG -= app_bundle
+QT = core
+
+INCLUDEPATH += $$PWD/../../app/videostreaming/vscommon
+
+include(../../lib/h264/h264.pri)
+
+SOURCES += \
+    $$PWD/main.cpp \
+
+HEADERS += \
+    $$PWD/../../app/videostreaming/vscommon/nalu/DecoderQueue.hpp \
+
+LIBS += -lpthread
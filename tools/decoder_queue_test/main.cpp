@@ -0,0 +1,172 @@
+// Checks the overload policy of the queue between the rtp receiver and the decoder (DecoderQueue):
+// On overload (or a full queue) the oldest queued non-reference frame is dropped first, an incoming frame is only
+// dropped once no queued non-reference frame is left. Non vcl NALUs are never dropped.
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "nalu/DecoderQueue.hpp"
+
+// One letter per frame: I == IDR, P == reference, n == non-reference, E == end of sequence (non vcl)
+static NALUBuffer create_frame(char type,uint32_t id,bool is_h265=false){
+    std::vector<uint8_t> data{0,0,0,1};
+    if(is_h265){
+        // TRAIL_N / TRAIL_R / IDR_W_RADL / EOS
+        const uint8_t nut= type=='n' ? 0 : type=='P' ? 1 : type=='I' ? 19 : 36;
+        data.insert(data.end(),{(uint8_t)(nut<<1),0x01});
+    }else{
+        // nal_ref_idc in bits 5,6
+        const uint8_t header= type=='n' ? 0x01 : type=='P' ? 0x41 : type=='I' ? 0x65 : 0x0A;
+        data.push_back(header);
+    }
+    data.insert(data.end(),{0x88,0x84,0x00,0x10});
+    return NALUBuffer(data.data(),(int)data.size(),is_h265,std::chrono::steady_clock::now(),id);
+}
+
+// Frames are identified by their rtp timestamp
+static void enqueue_all(DecoderQueue& queue,const std::string& types,uint32_t& next_id,bool is_h265=false){
+    for(const char type:types){
+        queue.enqueue(create_frame(type,next_id++,is_h265),false);
+    }
+}
+
+static std::vector<uint32_t> dequeue_all(DecoderQueue& queue){
+    std::vector<uint32_t> ret;
+    NALUBuffer frame{};
+    while(queue.try_dequeue(frame)){
+        ret.push_back(frame.get_nal().rtp_timestamp);
+    }
+    return ret;
+}
+
+static std::string to_string(const std::vector<uint32_t>& ids){
+    std::string ret;
+    for(const auto id:ids){
+        ret+=std::to_string(id)+" ";
+    }
+    return ret;
+}
+
+static std::string to_string(DecoderQueue::EnqueueResult result){
+    switch(result){
+    case DecoderQueue::EnqueueResult::QUEUED:return "queued";
+    case DecoderQueue::EnqueueResult::QUEUED_EVICTED_NON_REFERENCE:return "queued_evicted";
+    case DecoderQueue::EnqueueResult::DROPPED_NON_REFERENCE:return "dropped_non_ref";
+    case DecoderQueue::EnqueueResult::DROPPED_REFERENCE:return "dropped_ref";
+    }
+    return "?";
+}
+
+static bool g_ok=true;
+
+static void check(bool condition,const std::string& what){
+    if(!condition){
+        std::cout<<"FAILED: "<<what<<"\n";
+        g_ok=false;
+    }
+}
+
+static void check_result(DecoderQueue::EnqueueResult actual,DecoderQueue::EnqueueResult expected,const std::string& what){
+    check(actual==expected,what+" expected "+to_string(expected)+" got "+to_string(actual));
+}
+
+static void check_ids(const std::vector<uint32_t>& actual,const std::vector<uint32_t>& expected,const std::string& what){
+    check(actual==expected,what+" expected "+to_string(expected)+"got "+to_string(actual));
+}
+
+using Result=DecoderQueue::EnqueueResult;
+
+// A mixed ref / non-ref GOP fills the queue, then the decoder stalls
+static void check_full_queue(bool is_h265){
+    const std::string name=is_h265 ? "h265 full queue" : "h264 full queue";
+    DecoderQueue queue(8);
+    uint32_t id=0;
+    // ids 0..7
+    enqueue_all(queue,"IPnPnPnP",id,is_h265);
+    check(queue.size()==8,name+" size");
+    // Each new frame evicts the oldest queued non-reference frame (2, 4, 6), independent of its own type
+    check_result(queue.enqueue(create_frame('P',id++,is_h265),false),Result::QUEUED_EVICTED_NON_REFERENCE,name+" P evicts 2");
+    check_result(queue.enqueue(create_frame('n',id++,is_h265),false),Result::QUEUED_EVICTED_NON_REFERENCE,name+" n evicts 4");
+    check_result(queue.enqueue(create_frame('P',id++,is_h265),false),Result::QUEUED_EVICTED_NON_REFERENCE,name+" P evicts 6");
+    // 9 is queued now and non-reference
+    check_result(queue.enqueue(create_frame('P',id++,is_h265),false),Result::QUEUED_EVICTED_NON_REFERENCE,name+" P evicts 9");
+    check(queue.size()==8,name+" size after evict");
+    // Nothing left to evict
+    check_result(queue.enqueue(create_frame('n',id++,is_h265),false),Result::DROPPED_NON_REFERENCE,name+" n dropped");
+    check_result(queue.enqueue(create_frame('P',id++,is_h265),false),Result::DROPPED_REFERENCE,name+" P dropped");
+    check_result(queue.enqueue(create_frame('I',id++,is_h265),false),Result::DROPPED_REFERENCE,name+" I dropped");
+    check_ids(dequeue_all(queue),{0,1,3,5,7,8,10,11},name+" order");
+    // Space again
+    check_result(queue.enqueue(create_frame('I',id++,is_h265),false),Result::QUEUED,name+" I after drain");
+}
+
+// Not full, but the caller says there is too much video queued
+static void check_overloaded(){
+    DecoderQueue queue(64);
+    uint32_t id=0;
+    // ids 0..5
+    enqueue_all(queue,"IPnnPP",id);
+    check_result(queue.enqueue(create_frame('P',id++),true),Result::QUEUED_EVICTED_NON_REFERENCE,"overloaded P evicts 2");
+    check_result(queue.enqueue(create_frame('P',id++),true),Result::QUEUED_EVICTED_NON_REFERENCE,"overloaded P evicts 3");
+    check_result(queue.enqueue(create_frame('P',id++),true),Result::DROPPED_REFERENCE,"overloaded P dropped");
+    check_result(queue.enqueue(create_frame('n',id++),true),Result::DROPPED_NON_REFERENCE,"overloaded n dropped");
+    // Not overloaded anymore
+    check_result(queue.enqueue(create_frame('n',id++),false),Result::QUEUED,"n queued");
+    check_ids(dequeue_all(queue),{0,1,4,5,6,7,10},"overloaded order");
+}
+
+// An end of sequence NALU has nal_ref_idc 0 too, but must stay in the stream
+static void check_non_vcl_kept(){
+    DecoderQueue queue(4);
+    uint32_t id=0;
+    enqueue_all(queue,"PEPn",id);
+    check_result(queue.enqueue(create_frame('P',id++),false),Result::QUEUED_EVICTED_NON_REFERENCE,"EOS kept, n evicted");
+    check_result(queue.enqueue(create_frame('P',id++),false),Result::DROPPED_REFERENCE,"EOS not evicted");
+    check_ids(dequeue_all(queue),{0,1,2,4},"non vcl order");
+}
+
+static void check_plain_fifo(){
+    DecoderQueue queue(64);
+    uint32_t id=0;
+    enqueue_all(queue,"IPnPnPnPnEI",id);
+    check(queue.size()==11,"fifo size");
+    check_ids(dequeue_all(queue),{0,1,2,3,4,5,6,7,8,9,10},"fifo order");
+    NALUBuffer frame{};
+    check(!queue.try_dequeue(frame),"fifo empty");
+    enqueue_all(queue,"IPn",id);
+    queue.clear();
+    check(queue.size()==0,"clear");
+}
+
+static void check_wait_dequeue(){
+    DecoderQueue queue(8);
+    NALUBuffer frame{};
+    const auto before=std::chrono::steady_clock::now();
+    check(!queue.wait_dequeue_timed(frame,std::chrono::milliseconds(20)),"wait timeout");
+    check(std::chrono::steady_clock::now()-before>=std::chrono::milliseconds(20),"wait timeout duration");
+    std::thread producer([&queue]{
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        queue.enqueue(create_frame('I',42),false);
+    });
+    check(queue.wait_dequeue_timed(frame,std::chrono::seconds(5)),"wait wakes up");
+    check(!frame.is_empty() && frame.get_nal().rtp_timestamp==42,"wait frame");
+    producer.join();
+}
+
+int main(int argc,char* argv[]){
+    (void)argc;
+    (void)argv;
+    check_plain_fifo();
+    check_full_queue(false);
+    check_full_queue(true);
+    check_overloaded();
+    check_non_vcl_kept();
+    check_wait_dequeue();
+    if(!g_ok){
+        return 1;
+    }
+    std::cout<<"All decoder queue checks passed\n";
+    return 0;
+}
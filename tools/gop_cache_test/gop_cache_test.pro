@@ -0,0 +1,21 @@
+# Check of the GOP cache (GOPCache): starts at the first slice of a random access point, keeps all slices of a
+# multi slice keyframe (frames are single NALUs without access unit assembly) and never starts with a partial one.
+# qmake tools/gop_cache_test/gop_cache_test.pro && make
+# ./gop_cache_test
+TEMPLATE = app
+TARGET = gop_cache_test
+CONFIG += c++17 console
+CONFIG -= app_bundle
+QT = core
+
+INCLUDEPATH += $$PWD/../../app/videostreaming/vscommon
+
+include(../../lib/h264/h264.pri)
+
+SOURCES += \
+    $$PWD/main.cpp \
+
+HEADERS += \
+    $$PWD/../../app/videostreaming/vscommon/nalu/GOPCache.hpp \
+
+LIBS += -lpthread
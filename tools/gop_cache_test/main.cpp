@@ -0,0 +1,141 @@
+// Checks the GOP cache (GOPCache) the decoder is primed from on a (re)start: It starts with the first slice of a random
+// access point, keeps every slice of a multi slice keyframe (without access unit assembly each slice is a frame of its own)
+// and never starts with a partial keyframe (joined in the middle of one, or its first slice got lost).
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "nalu/GOPCache.hpp"
+
+// I == first slice of an IDR / IRAP picture, i == further slice of it, P / p == same for a reference picture,
+// S == SPS (non vcl). The number is the rtp timestamp.
+struct Frame{
+    char type;
+    uint32_t rtp_timestamp;
+};
+
+static NALUBuffer create_frame(const Frame& frame,bool is_h265){
+    std::vector<uint8_t> data{0,0,0,1};
+    const bool first_slice= frame.type=='I' || frame.type=='P';
+    if(is_h265){
+        // IDR_W_RADL / TRAIL_R / SPS
+        const uint8_t nut= (frame.type=='I' || frame.type=='i') ? 19 : (frame.type=='P' || frame.type=='p') ? 1 : 33;
+        data.insert(data.end(),{(uint8_t)(nut<<1),0x01});
+    }else{
+        const uint8_t header= (frame.type=='I' || frame.type=='i') ? 0x65 : (frame.type=='P' || frame.type=='p') ? 0x41 : 0x67;
+        data.push_back(header);
+    }
+    // first_mb_in_slice==0 (ue(v) '1') / first_slice_segment_in_pic_flag==1 in the msb - else first_mb_in_slice==1 ('010')
+    data.push_back(first_slice ? 0x88 : 0x40);
+    data.insert(data.end(),{0x84,0x00,0x10});
+    return NALUBuffer(data.data(),(int)data.size(),is_h265,std::chrono::steady_clock::now(),frame.rtp_timestamp);
+}
+
+static char get_type(const NALU& nalu){
+    const bool first_slice=nalu.is_first_slice_in_picture();
+    if(nalu.is_random_access_point())return first_slice ? 'I' : 'i';
+    if(nalu.is_vcl())return first_slice ? 'P' : 'p';
+    return 'S';
+}
+
+static std::string to_string(const std::vector<NALUBuffer>& frames){
+    std::string ret;
+    for(const auto& frame:frames){
+        ret+=std::string(1,get_type(frame.get_nal()))+std::to_string(frame.get_nal().rtp_timestamp)+" ";
+    }
+    return ret;
+}
+
+static std::string to_string(const std::vector<Frame>& frames){
+    std::string ret;
+    for(const auto& frame:frames){
+        ret+=std::string(1,frame.type)+std::to_string(frame.rtp_timestamp)+" ";
+    }
+    return ret;
+}
+
+static bool g_ok=true;
+
+static void check(bool condition,const std::string& what){
+    if(!condition){
+        std::cout<<"FAILED: "<<what<<"\n";
+        g_ok=false;
+    }
+}
+
+static void feed(GOPCache& cache,const std::vector<Frame>& frames,bool is_h265){
+    for(const auto& frame:frames){
+        cache.on_frame(create_frame(frame,is_h265));
+    }
+}
+
+static void check_cache(const GOPCache& cache,const std::vector<Frame>& expected,const std::string& what){
+    const auto actual=to_string(cache.get_frames());
+    check(actual==to_string(expected),what+": expected "+to_string(expected)+"got "+actual);
+}
+
+static void check_multi_slice_keyframe(bool is_h265){
+    const std::string name=is_h265 ? "h265 " : "h264 ";
+    GOPCache cache(1024*1024);
+    feed(cache,{{'S',1},{'I',1},{'i',1},{'i',1},{'P',2},{'p',2},{'P',3}},is_h265);
+    check_cache(cache,{{'I',1},{'i',1},{'i',1},{'P',2},{'p',2},{'P',3}},name+"multi slice keyframe");
+    // The next keyframe replaces the GOP
+    feed(cache,{{'S',4},{'I',4},{'i',4},{'P',5}},is_h265);
+    check_cache(cache,{{'I',4},{'i',4},{'P',5}},name+"next keyframe");
+}
+
+static void check_partial_keyframe(){
+    GOPCache cache(1024*1024);
+    // joined in the middle of a keyframe
+    feed(cache,{{'i',1},{'i',1},{'P',2}},false);
+    check(!cache.is_valid() && cache.get_frames().empty(),"joined mid keyframe: not valid");
+    feed(cache,{{'I',3},{'i',3},{'P',4}},false);
+    check_cache(cache,{{'I',3},{'i',3},{'P',4}},"joined mid keyframe, next keyframe");
+    // the first slice of the next keyframe got lost
+    feed(cache,{{'i',5},{'P',6}},false);
+    check(!cache.is_valid() && cache.get_frames().empty(),"lost first slice: not valid");
+    // a further slice with the timestamp of the cached keyframe, but after another picture
+    feed(cache,{{'I',7},{'P',8},{'i',7}},false);
+    check(!cache.is_valid(),"keyframe slice after another picture: not valid");
+}
+
+// Without rtp (timestamp always 0), the first slice decides
+static void check_no_timestamps(){
+    GOPCache cache(1024*1024);
+    feed(cache,{{'I',0},{'i',0},{'P',0},{'p',0},{'I',0},{'i',0}},false);
+    check_cache(cache,{{'I',0},{'i',0}},"no timestamps");
+}
+
+// Access units (assembly on): one frame per picture
+static void check_access_units(){
+    GOPCache cache(1024*1024);
+    feed(cache,{{'I',1},{'P',2},{'P',3},{'I',4},{'P',5}},true);
+    check_cache(cache,{{'I',4},{'P',5}},"access units");
+}
+
+// A keyframe that doesn't fit must not leave its last slices behind as a partial keyframe
+static void check_keyframe_too_big(){
+    const size_t frame_capacity=create_frame({'I',1},false).get_capacity();
+    GOPCache cache(frame_capacity*3/2);
+    feed(cache,{{'I',1},{'i',1},{'i',1},{'P',2}},false);
+    check(!cache.is_valid() && cache.get_frames().empty(),"keyframe too big: not valid");
+    feed(cache,{{'I',3}},false);
+    check_cache(cache,{{'I',3}},"keyframe too big, next keyframe");
+}
+
+int main(int argc,char* argv[]){
+    (void)argc;
+    (void)argv;
+    check_multi_slice_keyframe(false);
+    check_multi_slice_keyframe(true);
+    check_partial_keyframe();
+    check_no_timestamps();
+    check_access_units();
+    check_keyframe_too_big();
+    if(!g_ok){
+        return 1;
+    }
+    std::cout<<"All GOP cache checks passed\n";
+    return 0;
+}
@@ -0,0 +1,19 @@
+# Benchmark (ns per add() / snapshot) and check (bucket boundaries, percentiles against a sorted reference)
+# of the LatencyHistogram used for all latency stats.
+# qmake tools/latency_histogram_bench/latency_histogram_bench.pro && make
+# ./latency_histogram_bench [--samples 10000000] [--threads N]
+TEMPLATE = app
+TARGET = latency_histogram_bench
+CONFIG += c++17 console
+CONFIG -= app_bundle
+QT = core
+
+INCLUDEPATH += $$PWD/../../app
+
+SOURCES += \
+    $$PWD/main.cpp \
+
+HEADERS += \
+    $$PWD/../../app/common/TimeHelper.hpp \
+
+LIBS += -lpthread
@@ -0,0 +1,225 @@
+// Microbenchmark of the LatencyHistogram (common/TimeHelper.hpp) against the AvgCalculator it replaced, single threaded
+// and with multiple threads adding to the same histogram (like the decode / render stats). Before that, it checks the
+// bucket boundaries and that the percentiles match the ones of a sorted reference within the bucket precision.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/TimeHelper.hpp"
+
+static bool g_ok=true;
+
+static void check(bool condition,const std::string& what){
+    if(!condition){
+        std::cout<<"FAILED: "<<what<<"\n";
+        g_ok=false;
+    }
+}
+
+// Each value lies in [begin,next begin) of its bucket, the buckets are contiguous and (above the linear range)
+// at most 1/SUB_BUCKET_COUNT of their value wide
+static void check_buckets(){
+    using H=LatencyHistogram;
+    for(size_t i=0;i<H::N_BUCKETS;i++){
+        const uint64_t begin=H::bucket_begin(i);
+        check(H::bucket_index(begin)==i,"bucket_index(bucket_begin("+std::to_string(i)+"))");
+        if(i+1==H::N_BUCKETS)break;
+        const uint64_t next_begin=H::bucket_begin(i+1);
+        check(next_begin>begin,"bucket "+std::to_string(i)+" not empty");
+        check(H::bucket_index(next_begin-1)==i,"bucket "+std::to_string(i)+" end");
+        const uint64_t width=next_begin-begin;
+        check(begin<H::SUB_BUCKET_COUNT ? width==1 : width*H::SUB_BUCKET_COUNT<=begin,"bucket "+std::to_string(i)+" width");
+        const uint64_t middle=H::bucket_middle(i);
+        check(middle>=begin && middle<next_begin,"bucket "+std::to_string(i)+" middle");
+    }
+    // Exhaustive for the first 2^20 values, then around each power of two
+    auto check_value=[](uint64_t value){
+        const size_t index=H::bucket_index(value);
+        const bool in_bucket=value>=H::bucket_begin(index) && (index+1==H::N_BUCKETS || value<H::bucket_begin(index+1));
+        check(in_bucket,"value "+std::to_string(value)+" in bucket "+std::to_string(index));
+    };
+    for(uint64_t value=0;value<(1<<20);value++){
+        check_value(value);
+    }
+    for(int bit=20;bit<64;bit++){
+        const uint64_t power=(uint64_t)1<<bit;
+        check_value(power-1);
+        check_value(power);
+        check_value(power+1);
+    }
+    check(H::bucket_index(((uint64_t)1<<H::MAX_VALUE_BITS)-1)==H::N_BUCKETS-1,"last regular bucket");
+    check(H::bucket_index(std::numeric_limits<uint64_t>::max())==H::N_BUCKETS-1,"overflow bucket");
+}
+
+// nearest rank percentile, like LatencyHistogram
+static uint64_t get_reference_percentile(const std::vector<uint64_t>& sorted,double percentile){
+    const uint64_t rank=std::max((uint64_t)1,(uint64_t)std::ceil(percentile*(double)sorted.size()));
+    return sorted[std::min((size_t)rank,sorted.size())-1];
+}
+
+static void check_distribution(const std::string& name,const std::vector<uint64_t>& values){
+    LatencyHistogram histogram{name};
+    for(const auto value:values){
+        histogram.add(std::chrono::nanoseconds(value));
+    }
+    std::vector<uint64_t> sorted=values;
+    std::sort(sorted.begin(),sorted.end());
+    const auto snapshot=histogram.snapshot();
+    check(snapshot.n_samples==values.size(),name+" n samples");
+    check(snapshot.getMin().count()==(int64_t)sorted.front(),name+" min");
+    check(snapshot.getMax().count()==(int64_t)sorted.back(),name+" max");
+    for(const double percentile:{0.0,0.01,0.25,0.5,0.75,0.9,0.95,0.99,0.999,1.0}){
+        const uint64_t expected=get_reference_percentile(sorted,percentile);
+        const uint64_t actual=snapshot.get_percentile(percentile).count();
+        // The middle of the bucket the reference lies in (or the max, if that is smaller)
+        const bool same_bucket=LatencyHistogram::bucket_index(actual)==LatencyHistogram::bucket_index(expected);
+        std::stringstream ss;
+        ss<<name<<" p"<<percentile*100<<" expected "<<expected<<" got "<<actual;
+        check(same_bucket,ss.str());
+    }
+    double sum=0;
+    for(const auto value:values){
+        sum+=value;
+    }
+    const double avg=sum/values.size();
+    const double avg_error=std::abs(snapshot.getAvg().count()-avg)/avg;
+    check(avg_error<=1.0/LatencyHistogram::SUB_BUCKET_COUNT,name+" avg error "+std::to_string(avg_error));
+}
+
+static void check_percentiles(){
+    std::mt19937_64 rng(0);
+    const size_t n=200000;
+    auto generate=[&](auto&& distribution){
+        std::vector<uint64_t> ret(n);
+        for(auto& value:ret){
+            value=(uint64_t)std::max(0.0,(double)distribution(rng));
+        }
+        return ret;
+    };
+    check_distribution("constant",std::vector<uint64_t>(n,1234567));
+    check_distribution("uniform 0-100us",generate(std::uniform_int_distribution<uint64_t>(0,100*1000)));
+    // decode time like, long tail
+    check_distribution("lognormal ~2ms",generate(std::lognormal_distribution<double>(std::log(2*1000*1000),0.5)));
+    // mostly fast, a few stalls
+    std::vector<uint64_t> bimodal=generate(std::normal_distribution<double>(500*1000,50*1000));
+    for(size_t i=0;i<bimodal.size();i+=100){
+        bimodal[i]=50*1000*1000+i;
+    }
+    check_distribution("bimodal 0.5ms / 50ms",bimodal);
+    check_distribution("small",{0,1,2,3,31,32,33,63,64,65});
+    check_distribution("single",{42});
+    // merge == one histogram with all samples, snapshot_and_reset() starts over
+    LatencyHistogram a{"a"};
+    LatencyHistogram b{"b"};
+    LatencyHistogram all{"all"};
+    for(uint64_t i=0;i<10000;i++){
+        const auto value=std::chrono::nanoseconds(i*i);
+        (i%3==0 ? a : b).add(value);
+        all.add(value);
+    }
+    auto merged=a.snapshot_and_reset();
+    merged.merge(b.snapshot());
+    const auto expected=all.snapshot();
+    check(merged.counts==expected.counts && merged.n_samples==expected.n_samples && merged.sum_ns==expected.sum_ns &&
+          merged.min_ns==expected.min_ns && merged.max_ns==expected.max_ns,"merge");
+    check(a.getNSamples()==0 && a.snapshot().getMax().count()==0 && a.getMin().count()==0,"snapshot_and_reset");
+}
+
+template<class F>
+static double measure_ns_per_op(int n_threads,uint64_t n_ops_per_thread,const F& f){
+    std::vector<std::thread> threads;
+    const auto begin=std::chrono::steady_clock::now();
+    for(int t=0;t<n_threads;t++){
+        threads.emplace_back([&f,t,n_ops_per_thread]{
+            // different values per thread, but all in the 0-4ms range - the threads share the same buckets (worst case for contention)
+            uint64_t value=1000*1000+t;
+            for(uint64_t i=0;i<n_ops_per_thread;i++){
+                f(std::chrono::nanoseconds(value));
+                value=(value*7+13)%(4*1000*1000);
+            }
+        });
+    }
+    for(auto& thread:threads){
+        thread.join();
+    }
+    const auto elapsed=std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now()-begin).count();
+    // wall time per add, over all threads
+    return elapsed/(n_ops_per_thread*n_threads);
+}
+
+int main(int argc,char* argv[]){
+    uint64_t n_samples=10*1000*1000;
+    int n_threads=(int)std::max(std::thread::hardware_concurrency(),2u);
+    for(int i=1;i+1<argc;i+=2){
+        const std::string arg=argv[i];
+        if(arg=="--samples")n_samples=std::strtoull(argv[i+1],nullptr,10);
+        else if(arg=="--threads")n_threads=std::atoi(argv[i+1]);
+    }
+    check_buckets();
+    check_percentiles();
+    if(!g_ok){
+        std::cout<<"LatencyHistogram differs from the sorted reference\n";
+        return 1;
+    }
+    std::cout<<"Buckets and percentiles match the sorted reference\n";
+    std::cout<<n_samples<<" samples, "<<n_threads<<" threads, cpus:"<<std::thread::hardware_concurrency()<<"\n";
+    std::cout<<std::fixed<<std::setprecision(2);
+    {
+        AvgCalculator avg{};
+        const double ns=measure_ns_per_op(1,n_samples,[&avg](std::chrono::nanoseconds value){
+            avg.add(value);
+        });
+        std::cout<<std::left<<std::setw(40)<<"AvgCalculator::add (not thread safe)"<<ns<<" ns\n";
+    }
+    {
+        LatencyHistogram histogram{};
+        const double ns=measure_ns_per_op(1,n_samples,[&histogram](std::chrono::nanoseconds value){
+            histogram.add(value);
+        });
+        std::cout<<std::left<<std::setw(40)<<"LatencyHistogram::add"<<ns<<" ns\n";
+    }
+    {
+        AvgCalculator avg{};
+        std::mutex mutex;
+        const double ns=measure_ns_per_op(n_threads,n_samples/n_threads,[&avg,&mutex](std::chrono::nanoseconds value){
+            std::lock_guard<std::mutex> lock(mutex);
+            avg.add(value);
+        });
+        std::cout<<std::left<<std::setw(40)<<"AvgCalculator::add + mutex, "+std::to_string(n_threads)+" threads"<<ns<<" ns\n";
+    }
+    {
+        LatencyHistogram histogram{};
+        const double ns=measure_ns_per_op(n_threads,n_samples/n_threads,[&histogram](std::chrono::nanoseconds value){
+            histogram.add(value);
+        });
+        std::cout<<std::left<<std::setw(40)<<"LatencyHistogram::add, "+std::to_string(n_threads)+" threads"<<ns<<" ns\n";
+        const int n_runs=1000;
+        auto begin=std::chrono::steady_clock::now();
+        uint64_t dummy=0;
+        for(int i=0;i<n_runs;i++){
+            dummy+=histogram.snapshot().n_samples;
+        }
+        const double snapshot_ns=std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now()-begin).count()/n_runs;
+        const auto snapshot=histogram.snapshot();
+        begin=std::chrono::steady_clock::now();
+        for(int i=0;i<n_runs;i++){
+            dummy+=snapshot.get_percentile(0.99).count();
+        }
+        const double percentile_ns=std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now()-begin).count()/n_runs;
+        std::cout<<std::left<<std::setw(40)<<"LatencyHistogram::snapshot"<<snapshot_ns<<" ns\n";
+        std::cout<<std::left<<std::setw(40)<<"Snapshot::get_percentile(0.99)"<<percentile_ns<<" ns\n";
+        // keep the loops
+        if(dummy==0)std::cout<<"\n";
+    }
+    return 0;
+}
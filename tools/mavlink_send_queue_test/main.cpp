@@ -0,0 +1,323 @@
+// Checks the outbound mavlink queue of MavlinkTelemetry (MavlinkSendQueue) with a fake link:
+// coalescing of control messages, strict priority order, drop oldest when a class is full, and the token bucket pacing
+// of the uplink budget - with the control fast lane bypassing it, but paying for its bytes.
+// The pacing checks are timing based, with generous margins.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "telemetry/MavlinkSendQueue.h"
+#include "telemetry/qopenhdmavlinkhelper.hpp"
+
+static bool g_ok=true;
+
+static void check(bool condition,const std::string& what){
+    if(!condition){
+        std::cout<<"FAILED: "<<what<<"\n";
+        g_ok=false;
+    }
+}
+
+// Each test message carries a tag, such that we can tell which one was sent
+static mavlink_message_t create_control(uint8_t target_sys,uint16_t tag){
+    mavlink_rc_channels_override_t rc{};
+    rc.target_system=target_sys;
+    rc.target_component=1;
+    rc.chan1_raw=tag;
+    mavlink_message_t msg;
+    mavlink_msg_rc_channels_override_encode(255,190,&msg,&rc);
+    return msg;
+}
+
+static mavlink_message_t create_command(uint16_t tag){
+    mavlink_command_long_t command{};
+    command.target_system=1;
+    command.target_component=1;
+    command.command=MAV_CMD_REQUEST_MESSAGE;
+    command.param1=tag;
+    mavlink_message_t msg;
+    mavlink_msg_command_long_encode(255,190,&msg,&command);
+    return msg;
+}
+
+static mavlink_message_t create_param_set(uint16_t tag){
+    mavlink_param_set_t param{};
+    param.target_system=1;
+    param.target_component=1;
+    std::strncpy(param.param_id,"TEST",sizeof(param.param_id));
+    param.param_value=tag;
+    param.param_type=MAV_PARAM_TYPE_INT32;
+    mavlink_message_t msg;
+    mavlink_msg_param_set_encode(255,190,&msg,&param);
+    return msg;
+}
+
+static mavlink_message_t create_bulk(uint16_t tag){
+    mavlink_heartbeat_t heartbeat{};
+    heartbeat.type=MAV_TYPE_GCS;
+    heartbeat.autopilot=MAV_AUTOPILOT_INVALID;
+    heartbeat.custom_mode=tag;
+    mavlink_message_t msg;
+    mavlink_msg_heartbeat_encode(255,190,&msg,&heartbeat);
+    return msg;
+}
+
+struct Sent{
+    // c == control, m == command, p == param, b == bulk
+    char type;
+    int tag;
+    uint8_t target_sys;
+    std::chrono::steady_clock::time_point time;
+    bool operator==(const Sent& other)const{
+        return type==other.type && tag==other.tag;
+    }
+};
+
+static Sent to_sent(const mavlink_message_t& msg){
+    Sent ret{'?',-1,0,std::chrono::steady_clock::now()};
+    switch(msg.msgid){
+    case MAVLINK_MSG_ID_RC_CHANNELS_OVERRIDE:
+        ret.type='c';
+        ret.tag=mavlink_msg_rc_channels_override_get_chan1_raw(&msg);
+        ret.target_sys=mavlink_msg_rc_channels_override_get_target_system(&msg);
+        break;
+    case MAVLINK_MSG_ID_COMMAND_LONG:
+        ret.type='m';
+        ret.tag=(int)mavlink_msg_command_long_get_param1(&msg);
+        break;
+    case MAVLINK_MSG_ID_PARAM_SET:
+        ret.type='p';
+        ret.tag=(int)mavlink_msg_param_set_get_param_value(&msg);
+        break;
+    case MAVLINK_MSG_ID_HEARTBEAT:
+        ret.type='b';
+        ret.tag=(int)mavlink_msg_heartbeat_get_custom_mode(&msg);
+        break;
+    default:
+        break;
+    }
+    return ret;
+}
+
+static std::string to_string(const std::vector<Sent>& sent){
+    std::string ret;
+    for(const auto& s:sent){
+        ret+=std::string(1,s.type)+std::to_string(s.tag)+" ";
+    }
+    return ret;
+}
+
+// The link. While blocked, the sender thread hangs in the send callback, such that everything else queues up behind it.
+class FakeLink{
+public:
+    FakeLink():m_queue([this](const mavlink_message_t& msg){return on_send(msg);},[this](const std::string& stats){on_stats(stats);}){}
+    ~FakeLink(){
+        unblock();
+    }
+    void enqueue(const mavlink_message_t& msg){
+        m_queue.enqueue(msg,MavlinkSendQueue::get_default_priority(msg));
+    }
+    // Blocks the sender thread on the given message, returns once it is stuck there
+    void block_with(const mavlink_message_t& msg){
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_blocked=true;
+            m_waiting=false;
+        }
+        enqueue(msg);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock,[this]{return m_waiting;});
+    }
+    void unblock(){
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_blocked=false;
+        }
+        m_cv.notify_all();
+    }
+    // Waits until n messages have been sent (or the timeout), returns all sent messages and clears them
+    std::vector<Sent> take_sent(size_t n,std::chrono::milliseconds timeout=std::chrono::milliseconds(2000)){
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait_for(lock,timeout,[this,n]{return m_sent.size()>=n;});
+        std::vector<Sent> ret;
+        std::swap(ret,m_sent);
+        return ret;
+    }
+    std::string get_last_stats(){
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_last_stats;
+    }
+    MavlinkSendQueue& queue(){
+        return m_queue;
+    }
+private:
+    bool on_send(const mavlink_message_t& msg){
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_waiting=true;
+        m_cv.notify_all();
+        m_cv.wait(lock,[this]{return !m_blocked;});
+        m_sent.push_back(to_sent(msg));
+        m_cv.notify_all();
+        return true;
+    }
+    void on_stats(const std::string& stats){
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_last_stats=stats;
+    }
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_blocked=false;
+    bool m_waiting=false;
+    std::vector<Sent> m_sent;
+    std::string m_last_stats;
+    // last, the sender thread uses the members above
+    MavlinkSendQueue m_queue;
+};
+
+static void check_priority_order(){
+    FakeLink link;
+    link.block_with(create_bulk(0));
+    // enqueued in reverse order of importance, interleaved
+    link.enqueue(create_bulk(1));
+    link.enqueue(create_param_set(1));
+    link.enqueue(create_bulk(2));
+    link.enqueue(create_command(1));
+    link.enqueue(create_param_set(2));
+    link.enqueue(create_control(1,1));
+    link.enqueue(create_command(2));
+    link.enqueue(create_bulk(3));
+    link.unblock();
+    const auto sent=link.take_sent(9);
+    // The one in flight first, then strictly by class, fifo within a class
+    const std::vector<Sent> expected{{'b',0},{'c',1},{'m',1},{'m',2},{'p',1},{'p',2},{'b',1},{'b',2},{'b',3}};
+    check(sent==expected,"priority order: expected "+to_string(expected)+"got "+to_string(sent));
+}
+
+static void check_coalescing(){
+    FakeLink link;
+    link.block_with(create_bulk(0));
+    // Same msg id and target: only the latest is sent, at the position of the first one
+    for(uint16_t tag=1;tag<=10;tag++){
+        link.enqueue(create_control(1,tag));
+        if(tag==1){
+            // different target, not coalesced with the ones for target 1
+            link.enqueue(create_control(2,100));
+        }
+    }
+    // commands are never coalesced
+    link.enqueue(create_command(1));
+    link.enqueue(create_command(1));
+    link.unblock();
+    const auto sent=link.take_sent(5);
+    const std::vector<Sent> expected{{'b',0},{'c',10},{'c',100},{'m',1},{'m',1}};
+    check(sent==expected,"coalescing: expected "+to_string(expected)+"got "+to_string(sent));
+    check(sent.size()>=3 && sent[1].target_sys==1 && sent[2].target_sys==2,"coalescing targets");
+    // nothing else
+    check(link.take_sent(1,std::chrono::milliseconds(100)).empty(),"coalescing: nothing left");
+    // published once per second
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    const auto stats=link.get_last_stats();
+    check(stats.find("coalesced:9")!=std::string::npos,"coalescing stats: "+stats);
+}
+
+static void check_drop_oldest(){
+    FakeLink link;
+    link.block_with(create_bulk(0));
+    // 16 control messages fit, different targets such that they are not coalesced
+    for(uint16_t i=1;i<=20;i++){
+        link.enqueue(create_control((uint8_t)i,i));
+    }
+    // 256 bulk messages fit
+    for(uint16_t i=1;i<=300;i++){
+        link.enqueue(create_bulk(i));
+    }
+    link.unblock();
+    const auto sent=link.take_sent(1+16+256);
+    std::vector<Sent> expected{{'b',0}};
+    for(int i=5;i<=20;i++){
+        expected.push_back({'c',i});
+    }
+    for(int i=45;i<=300;i++){
+        expected.push_back({'b',i});
+    }
+    check(sent==expected,"drop oldest: got "+std::to_string(sent.size())+" messages, first control "+
+          (sent.size()>1 ? to_string({sent[1]}) : "-")+"last "+(sent.empty() ? "-" : to_string({sent.back()})));
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    const auto stats=link.get_last_stats();
+    check(stats.find("dropped:48")!=std::string::npos,"drop oldest stats: "+stats);
+}
+
+static void check_pacing(){
+    // 8kbit/s == 1000 bytes/s, the bucket holds 2 max size packets (the minimum)
+    const int64_t budget_bps=8000;
+    const double bytes_per_s=budget_bps/8.0;
+    const double bucket=2.0*MAVLINK_MAX_PACKET_LEN;
+    const int bulk_size=QOpenHDMavlinkHelper::get_wire_size(create_bulk(0));
+    const int control_size=QOpenHDMavlinkHelper::get_wire_size(create_control(1,0));
+    FakeLink link;
+    link.queue().set_uplink_budget_bps(budget_bps);
+    // let it fill the bucket (560 bytes at 1000 bytes/s)
+    std::this_thread::sleep_for(std::chrono::milliseconds(700));
+    for(uint16_t i=0;i<250;i++){
+        link.enqueue(create_bulk(i));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+    const auto burst_and_1s=link.take_sent(0,std::chrono::milliseconds(0));
+    const double expected=(bucket+bytes_per_s)/bulk_size;
+    check(burst_and_1s.size()>=expected*0.8 && burst_and_1s.size()<=expected*1.2,
+          "pacing: "+std::to_string(burst_and_1s.size())+" bulk messages in 1s, expected ~"+std::to_string((int)expected));
+    // Control is sent right away even though the bulk messages wait for budget
+    const auto before=std::chrono::steady_clock::now();
+    link.enqueue(create_control(1,1));
+    const auto sent=link.take_sent(1,std::chrono::milliseconds(500));
+    const auto it=std::find_if(sent.begin(),sent.end(),[](const Sent& s){return s.type=='c';});
+    check(it!=sent.end() && it->time-before<std::chrono::milliseconds(20),"control fast lane");
+    // Steady state bulk rate
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+    const size_t steady=link.take_sent(0,std::chrono::milliseconds(0)).size();
+    const double expected_steady=bytes_per_s/bulk_size;
+    check(steady>=expected_steady*0.8 && steady<=expected_steady*1.2,
+          "pacing steady: "+std::to_string(steady)+" bulk messages in 1s, expected ~"+std::to_string((int)expected_steady));
+    // A control burst overdraws the budget (16 messages, different targets), the bulk class pays it back
+    for(uint16_t i=1;i<=16;i++){
+        link.enqueue(create_control((uint8_t)i,i));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+    const auto after_burst=link.take_sent(0,std::chrono::milliseconds(0));
+    const long n_control=std::count_if(after_burst.begin(),after_burst.end(),[](const Sent& s){return s.type=='c';});
+    const size_t n_bulk=after_burst.size()-n_control;
+    check(n_control==16,"control burst sent: "+std::to_string(n_control));
+    const double overdraw=std::min(16.0*control_size,std::max(bytes_per_s,bucket));
+    const double expected_after_burst=(bytes_per_s-overdraw)/bulk_size;
+    check(n_bulk<=expected_after_burst+expected_steady*0.2,"control overdraw: "+std::to_string(n_bulk)+
+          " bulk messages in the 1s after the control burst, expected ~"+std::to_string((int)expected_after_burst));
+}
+
+int main(int argc,char* argv[]){
+    (void)argc;
+    (void)argv;
+    check(MavlinkSendQueue::get_default_priority(create_control(1,0))==MavlinkSendQueue::Priority::CONTROL,"control priority");
+    check(MavlinkSendQueue::get_default_priority(create_command(0))==MavlinkSendQueue::Priority::COMMAND,"command priority");
+    check(MavlinkSendQueue::get_default_priority(create_param_set(0))==MavlinkSendQueue::Priority::PARAM,"param priority");
+    check(MavlinkSendQueue::get_default_priority(create_bulk(0))==MavlinkSendQueue::Priority::BULK,"bulk priority");
+    mavlink_timesync_t timesync{};
+    mavlink_message_t timesync_msg;
+    mavlink_msg_timesync_encode(255,190,&timesync_msg,&timesync);
+    check(MavlinkSendQueue::get_default_priority(timesync_msg)==MavlinkSendQueue::Priority::CONTROL,"timesync priority");
+    check_priority_order();
+    check_coalescing();
+    check_drop_oldest();
+    check_pacing();
+    if(!g_ok){
+        return 1;
+    }
+    std::cout<<"All mavlink send queue checks passed\n";
+    return 0;
+}
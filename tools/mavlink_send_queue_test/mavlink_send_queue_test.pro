@@ -0,0 +1,25 @@
+# Check of the outbound mavlink queue (MavlinkSendQueue): coalescing of control messages, strict priority order,
+# drop oldest when a class is full, and the uplink budget (token bucket) with the control fast lane overdrawing it.
+# mavlink (openhd dialect) comes with MAVSDK, same as for QOpenHD (see app/telemetry/telemetry.pri)
+# qmake tools/mavlink_send_queue_test/mavlink_send_queue_test.pro && make
+# ./mavlink_send_queue_test
+TEMPLATE = app
+TARGET = mavlink_send_queue_test
+CONFIG += c++17 console
+CONFIG -= app_bundle
+QT = core
+
+INCLUDEPATH += $$PWD/../..
+INCLUDEPATH += $$PWD/../../app
+INCLUDEPATH += /usr/local/include/mavsdk
+INCLUDEPATH += /usr/include/mavsdk
+
+SOURCES += \
+    $$PWD/main.cpp \
+    $$PWD/../../app/telemetry/MavlinkSendQueue.cpp \
+
+HEADERS += \
+    $$PWD/../../app/telemetry/MavlinkSendQueue.h \
+
+LIBS += -L/usr/local/lib -lmavsdk
+LIBS += -lpthread -latomic
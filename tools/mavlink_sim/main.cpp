@@ -0,0 +1,679 @@
+// Headless telemetry load test. Speaks as the OpenHD ground unit (OHD_SYS_ID_GROUND), the air unit (OHD_SYS_ID_AIR)
+// and an FC over loopback to QOpenHD's mavlink udp port (QOpenHD doesn't know the difference - it learns the remote
+// address from the first packet, same as with a real ground unit) and generates a configurable message mix, e.g.
+// 500Hz ATTITUDE, ADSB_VEHICLE floods and the OpenHD link / video stats.
+// With dev_telemetry_benchmark_report enabled, QOpenHD writes its telemetry stats (received messages, processing time,
+// property publish latency, UI thread CPU) once per second, which are printed next to what was sent. --ramp increases
+// the rate step by step until QOpenHD cannot keep up and reports the maximum sustainable message rate.
+// NOTE: The publish latency is measured inside QOpenHD, from the first setter call of a property until QML got the
+// change (BatchedPropertyPublisher). It does not include the socket, mavsdk and the dispatch to the model - a backlog
+// there shows up as received / drops / processing time instead.
+// Linux only (udp socket drops and process CPU come from /proc).
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "telemetry/mavsdk_include.h"
+#include "telemetry/openhd_defines.hpp"
+
+struct Options{
+    int port=14550;
+    int fc_sys_id=1;
+    // message rates (Hz) of the mix, 0 == off
+    double attitude_hz=50;
+    double global_position_hz=10;
+    double vfr_hud_hz=10;
+    double gps_raw_hz=5;
+    double sys_status_hz=2;
+    double battery_hz=2;
+    double adsb_hz=0;
+    int adsb_n_vehicles=50;
+    double ohd_stats_hz=2;
+    // 0 == forever
+    double duration_s=0;
+    std::string report_filename="/tmp/qopenhd_telemetry_benchmark.txt";
+    bool ramp=false;
+    double ramp_factor=1.5;
+    int ramp_max_steps=12;
+    double ramp_step_s=5;
+    double max_publish_latency_ms=50;
+};
+
+static void print_usage(){
+    std::cout<<"mavlink_sim [options]\n"
+             <<"  --port N             QOpenHD mavlink udp port on 127.0.0.1 (default 14550)\n"
+             <<"  --fc-sys-id N        sys id of the simulated FC (default 1)\n"
+             <<"  --attitude HZ        ATTITUDE (default 50)\n"
+             <<"  --global-position HZ GLOBAL_POSITION_INT (default 10)\n"
+             <<"  --vfr-hud HZ         VFR_HUD (default 10)\n"
+             <<"  --gps-raw HZ         GPS_RAW_INT (default 5)\n"
+             <<"  --sys-status HZ      SYS_STATUS (default 2)\n"
+             <<"  --battery HZ         BATTERY_STATUS (default 2)\n"
+             <<"  --adsb HZ            ADSB_VEHICLE (default 0)\n"
+             <<"  --adsb-vehicles N    n of distinct ADSB vehicles (default 50)\n"
+             <<"  --ohd-stats HZ       OpenHD wifi card / link / telemetry / video stats of air and ground (default 2)\n"
+             <<"  --duration S         stop after S seconds (default 0 == forever)\n"
+             <<"  --report FILE        QOpenHD benchmark report (default /tmp/qopenhd_telemetry_benchmark.txt)\n"
+             <<"  --ramp               multiply all rates (but the heartbeats) step by step until QOpenHD cannot keep up\n"
+             <<"  --ramp-factor X      rate increase per step (default 1.5)\n"
+             <<"  --ramp-steps N       max n of steps (default 12)\n"
+             <<"  --ramp-step-s S      duration of one step (default 5)\n"
+             <<"  --max-publish-latency-ms N\n"
+             <<"                       a step is not sustainable above this p99 property publish latency\n"
+             <<"                       (setter until QML, not including socket / mavsdk / dispatch) (default 50)\n"
+             <<"Example (stress): mavlink_sim --attitude 500 --adsb 1000 --adsb-vehicles 200 --ohd-stats 20\n"
+             <<"QOpenHD needs dev_telemetry_benchmark_report enabled (developer settings) for its side of the stats.\n";
+}
+
+static bool parse_options(int argc,char* argv[],Options& options){
+    for(int i=1;i<argc;i++){
+        const std::string arg=argv[i];
+        const bool has_value=i+1<argc;
+        if(arg=="--help" || arg=="-h"){
+            return false;
+        }else if(arg=="--ramp"){
+            options.ramp=true;
+        }else if(arg=="--port" && has_value){
+            options.port=std::atoi(argv[++i]);
+        }else if(arg=="--fc-sys-id" && has_value){
+            options.fc_sys_id=std::atoi(argv[++i]);
+        }else if(arg=="--attitude" && has_value){
+            options.attitude_hz=std::atof(argv[++i]);
+        }else if(arg=="--global-position" && has_value){
+            options.global_position_hz=std::atof(argv[++i]);
+        }else if(arg=="--vfr-hud" && has_value){
+            options.vfr_hud_hz=std::atof(argv[++i]);
+        }else if(arg=="--gps-raw" && has_value){
+            options.gps_raw_hz=std::atof(argv[++i]);
+        }else if(arg=="--sys-status" && has_value){
+            options.sys_status_hz=std::atof(argv[++i]);
+        }else if(arg=="--battery" && has_value){
+            options.battery_hz=std::atof(argv[++i]);
+        }else if(arg=="--adsb" && has_value){
+            options.adsb_hz=std::atof(argv[++i]);
+        }else if(arg=="--adsb-vehicles" && has_value){
+            options.adsb_n_vehicles=std::max(std::atoi(argv[++i]),1);
+        }else if(arg=="--ohd-stats" && has_value){
+            options.ohd_stats_hz=std::atof(argv[++i]);
+        }else if(arg=="--duration" && has_value){
+            options.duration_s=std::atof(argv[++i]);
+        }else if(arg=="--report" && has_value){
+            options.report_filename=argv[++i];
+        }else if(arg=="--ramp-factor" && has_value){
+            options.ramp_factor=std::max(std::atof(argv[++i]),1.01);
+        }else if(arg=="--ramp-steps" && has_value){
+            options.ramp_max_steps=std::atoi(argv[++i]);
+        }else if(arg=="--ramp-step-s" && has_value){
+            options.ramp_step_s=std::max(std::atof(argv[++i]),2.0);
+        }else if(arg=="--max-publish-latency-ms" && has_value){
+            options.max_publish_latency_ms=std::atof(argv[++i]);
+        }else{
+            std::cout<<"Unknown option "<<arg<<"\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// steady_clock is CLOCK_MONOTONIC, the same clock QOpenHD uses for the report timestamp
+static int64_t get_time_us(){
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class UdpSender{
+public:
+    explicit UdpSender(int port){
+        m_fd=socket(AF_INET,SOCK_DGRAM,0);
+        memset(&m_addr,0,sizeof(m_addr));
+        m_addr.sin_family=AF_INET;
+        m_addr.sin_port=htons(port);
+        inet_pton(AF_INET,"127.0.0.1",&m_addr.sin_addr);
+    }
+    ~UdpSender(){
+        if(m_fd>=0)close(m_fd);
+    }
+    bool send(const mavlink_message_t& msg){
+        uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+        const uint16_t len=mavlink_msg_to_send_buffer(buffer,&msg);
+        if(sendto(m_fd,buffer,len,0,(const sockaddr*)&m_addr,sizeof(m_addr))!=len){
+            n_send_errors++;
+            return false;
+        }
+        n_sent++;
+        return true;
+    }
+    // QOpenHD sends its own heartbeats (and requests) back, we don't care
+    void discard_received(){
+        uint8_t buffer[2048];
+        while(recv(m_fd,buffer,sizeof(buffer),MSG_DONTWAIT)>0){}
+    }
+    uint64_t n_sent=0;
+    uint64_t n_send_errors=0;
+private:
+    int m_fd=-1;
+    sockaddr_in m_addr{};
+};
+
+// One simulated mavlink system, each with its own channel (sequence numbers)
+struct SimSystem{
+    uint8_t sys_id;
+    uint8_t comp_id;
+    uint8_t channel;
+};
+
+struct Stream{
+    std::string name;
+    double rate_hz;
+    // heartbeats are not scaled by --ramp (system discovery / alive)
+    bool scaled;
+    std::function<void(UdpSender& sender,double t_s)> send;
+    int64_t next_due_us=0;
+};
+
+class Simulator{
+public:
+    Simulator(const Options& options):m_options(options),m_sender(options.port){
+        m_ground=SimSystem{OHD_SYS_ID_GROUND,OHD_COMP_ID_LINK_PARAM,MAVLINK_COMM_0};
+        m_air=SimSystem{OHD_SYS_ID_AIR,OHD_COMP_ID_LINK_PARAM,MAVLINK_COMM_1};
+        m_fc=SimSystem{(uint8_t)options.fc_sys_id,MAV_COMP_ID_AUTOPILOT1,MAVLINK_COMM_2};
+        create_streams();
+    }
+    // 1 == the configured rates
+    void set_rate_multiplier(double multiplier){
+        m_multiplier=multiplier;
+    }
+    double get_configured_rate_hz()const{
+        double ret=0;
+        for(const auto& stream:m_streams){
+            ret+=stream.scaled ? stream.rate_hz*m_multiplier : stream.rate_hz;
+        }
+        return ret;
+    }
+    // Sends what is due until end_us, sleeping in between. only_heartbeats: keep the systems alive, nothing else
+    void run_until(int64_t end_us,bool only_heartbeats,const std::function<void()>& on_idle){
+        while(true){
+            const int64_t now_us=get_time_us();
+            if(now_us>=end_us)break;
+            int64_t next_us=std::min(end_us,now_us+100*1000);
+            for(auto& stream:m_streams){
+                if(only_heartbeats && stream.scaled){
+                    // paused - restart with the (next) rate instead of catching up
+                    stream.next_due_us=0;
+                    continue;
+                }
+                const double rate_hz=stream.scaled ? stream.rate_hz*m_multiplier : stream.rate_hz;
+                if(rate_hz<=0)continue;
+                const int64_t interval_us=std::max((int64_t)(1000000/rate_hz),(int64_t)1);
+                if(stream.next_due_us==0 || now_us-stream.next_due_us>1000*1000){
+                    // first run or we fell behind by more than a second - don't burst
+                    stream.next_due_us=now_us;
+                }
+                while(stream.next_due_us<=now_us){
+                    stream.send(m_sender,(now_us-m_start_us)/1000000.0);
+                    stream.next_due_us+=interval_us;
+                }
+                next_us=std::min(next_us,stream.next_due_us);
+            }
+            m_sender.discard_received();
+            if(on_idle)on_idle();
+            const int64_t sleep_us=next_us-get_time_us();
+            if(sleep_us>0){
+                std::this_thread::sleep_for(std::chrono::microseconds(sleep_us));
+            }
+        }
+    }
+    uint64_t get_n_sent()const{
+        return m_sender.n_sent;
+    }
+    uint64_t get_n_send_errors()const{
+        return m_sender.n_send_errors;
+    }
+    void print_mix()const{
+        std::cout<<"Message mix (Hz):";
+        for(const auto& stream:m_streams){
+            if(stream.rate_hz>0){
+                std::cout<<" "<<stream.name<<":"<<stream.rate_hz;
+            }
+        }
+        std::cout<<"\n";
+    }
+private:
+    void add_stream(std::string name,double rate_hz,bool scaled,std::function<void(UdpSender&,double)> send){
+        m_streams.push_back(Stream{name,rate_hz,scaled,send});
+    }
+    static uint32_t time_boot_ms(double t_s){
+        return (uint32_t)(t_s*1000);
+    }
+    void create_streams();
+    void send_ohd_stats(UdpSender& sender,const SimSystem& system,bool is_air,double t_s);
+    const Options m_options;
+    UdpSender m_sender;
+    SimSystem m_ground{},m_air{},m_fc{};
+    std::vector<Stream> m_streams;
+    double m_multiplier=1;
+    const int64_t m_start_us=get_time_us();
+    uint32_t m_adsb_index=0;
+    uint64_t m_n_ohd_stats=0;
+};
+
+void Simulator::create_streams()
+{
+    const auto heartbeat=[](const SimSystem& system,uint8_t type,uint8_t autopilot){
+        return [system,type,autopilot](UdpSender& sender,double){
+            mavlink_message_t msg;
+            mavlink_heartbeat_t heartbeat{};
+            heartbeat.type=type;
+            heartbeat.autopilot=autopilot;
+            heartbeat.base_mode=autopilot==MAV_AUTOPILOT_INVALID ? 0 : MAV_MODE_FLAG_CUSTOM_MODE_ENABLED;
+            heartbeat.system_status=MAV_STATE_ACTIVE;
+            mavlink_msg_heartbeat_encode_chan(system.sys_id,system.comp_id,system.channel,&msg,&heartbeat);
+            sender.send(msg);
+        };
+    };
+    add_stream("HEARTBEAT(ground)",1,false,heartbeat(m_ground,MAV_TYPE_ONBOARD_CONTROLLER,MAV_AUTOPILOT_INVALID));
+    add_stream("HEARTBEAT(air)",1,false,heartbeat(m_air,MAV_TYPE_ONBOARD_CONTROLLER,MAV_AUTOPILOT_INVALID));
+    add_stream("HEARTBEAT(fc)",1,false,heartbeat(m_fc,MAV_TYPE_QUADROTOR,MAV_AUTOPILOT_ARDUPILOTMEGA));
+    // The values change with time, such that each message actually changes the QOpenHD properties
+    add_stream("ATTITUDE",m_options.attitude_hz,true,[this](UdpSender& sender,double t_s){
+        mavlink_message_t msg;
+        mavlink_attitude_t attitude{};
+        attitude.time_boot_ms=time_boot_ms(t_s);
+        attitude.roll=0.5f*std::sin(t_s);
+        attitude.pitch=0.3f*std::sin(0.7*t_s);
+        attitude.yaw=std::fmod(0.5*t_s,2*M_PI)-M_PI;
+        attitude.rollspeed=0.5f*std::cos(t_s);
+        attitude.pitchspeed=0.21f*std::cos(0.7*t_s);
+        attitude.yawspeed=0.5f;
+        mavlink_msg_attitude_encode_chan(m_fc.sys_id,m_fc.comp_id,m_fc.channel,&msg,&attitude);
+        sender.send(msg);
+    });
+    add_stream("GLOBAL_POSITION_INT",m_options.global_position_hz,true,[this](UdpSender& sender,double t_s){
+        mavlink_message_t msg;
+        mavlink_global_position_int_t position{};
+        position.time_boot_ms=time_boot_ms(t_s);
+        position.lat=(int32_t)((47.0+0.001*std::sin(0.05*t_s))*1e7);
+        position.lon=(int32_t)((8.0+0.001*std::cos(0.05*t_s))*1e7);
+        position.relative_alt=(int32_t)(50000+10000*std::sin(0.1*t_s));
+        position.alt=position.relative_alt+400000;
+        position.vx=(int16_t)(500*std::cos(0.05*t_s));
+        position.vy=(int16_t)(500*std::sin(0.05*t_s));
+        position.vz=(int16_t)(100*std::cos(0.1*t_s));
+        position.hdg=(uint16_t)std::fmod(t_s*100,36000);
+        mavlink_msg_global_position_int_encode_chan(m_fc.sys_id,m_fc.comp_id,m_fc.channel,&msg,&position);
+        sender.send(msg);
+    });
+    add_stream("VFR_HUD",m_options.vfr_hud_hz,true,[this](UdpSender& sender,double t_s){
+        mavlink_message_t msg;
+        mavlink_vfr_hud_t vfr_hud{};
+        vfr_hud.airspeed=10+2*std::sin(t_s);
+        vfr_hud.groundspeed=10+2*std::cos(t_s);
+        vfr_hud.heading=(int16_t)std::fmod(t_s,360);
+        vfr_hud.throttle=(uint16_t)(50+20*std::sin(0.3*t_s));
+        vfr_hud.alt=50+10*std::sin(0.1*t_s);
+        vfr_hud.climb=std::cos(0.1*t_s);
+        mavlink_msg_vfr_hud_encode_chan(m_fc.sys_id,m_fc.comp_id,m_fc.channel,&msg,&vfr_hud);
+        sender.send(msg);
+    });
+    add_stream("GPS_RAW_INT",m_options.gps_raw_hz,true,[this](UdpSender& sender,double t_s){
+        mavlink_message_t msg;
+        mavlink_gps_raw_int_t gps{};
+        gps.time_usec=(uint64_t)(t_s*1000000);
+        gps.fix_type=GPS_FIX_TYPE_3D_FIX;
+        gps.lat=(int32_t)(47.0*1e7);
+        gps.lon=(int32_t)(8.0*1e7);
+        gps.eph=(uint16_t)(80+20*std::sin(t_s));
+        gps.epv=UINT16_MAX;
+        gps.vel=UINT16_MAX;
+        gps.cog=UINT16_MAX;
+        gps.satellites_visible=(uint8_t)(12+(int)t_s%4);
+        mavlink_msg_gps_raw_int_encode_chan(m_fc.sys_id,m_fc.comp_id,m_fc.channel,&msg,&gps);
+        sender.send(msg);
+    });
+    add_stream("SYS_STATUS",m_options.sys_status_hz,true,[this](UdpSender& sender,double t_s){
+        mavlink_message_t msg;
+        mavlink_sys_status_t sys_status{};
+        sys_status.load=(uint16_t)(300+100*std::sin(t_s));
+        sys_status.voltage_battery=(uint16_t)(16000-(int)t_s%1000);
+        sys_status.current_battery=(int16_t)(1500+500*std::sin(t_s));
+        sys_status.battery_remaining=(int8_t)(100-(int)(t_s/10)%100);
+        mavlink_msg_sys_status_encode_chan(m_fc.sys_id,m_fc.comp_id,m_fc.channel,&msg,&sys_status);
+        sender.send(msg);
+    });
+    add_stream("BATTERY_STATUS",m_options.battery_hz,true,[this](UdpSender& sender,double t_s){
+        mavlink_message_t msg;
+        mavlink_battery_status_t battery{};
+        std::fill(std::begin(battery.voltages),std::end(battery.voltages),UINT16_MAX);
+        battery.voltages[0]=(uint16_t)(16000-(int)t_s%1000);
+        battery.current_battery=(int16_t)(1500+500*std::sin(t_s));
+        battery.current_consumed=(int32_t)(t_s*4);
+        battery.temperature=INT16_MAX;
+        battery.battery_remaining=(int8_t)(100-(int)(t_s/10)%100);
+        mavlink_msg_battery_status_encode_chan(m_fc.sys_id,m_fc.comp_id,m_fc.channel,&msg,&battery);
+        sender.send(msg);
+    });
+    add_stream("ADSB_VEHICLE",m_options.adsb_hz,true,[this](UdpSender& sender,double t_s){
+        mavlink_message_t msg;
+        // round robin over the vehicles, each flying its own circle around the FC
+        const uint32_t index=m_adsb_index++%m_options.adsb_n_vehicles;
+        const double angle=0.01*t_s+index;
+        const double radius_deg=0.01+0.0005*index;
+        mavlink_adsb_vehicle_t vehicle{};
+        vehicle.ICAO_address=0x100000+index;
+        vehicle.lat=(int32_t)((47.0+radius_deg*std::sin(angle))*1e7);
+        vehicle.lon=(int32_t)((8.0+radius_deg*std::cos(angle))*1e7);
+        vehicle.altitude_type=ADSB_ALTITUDE_TYPE_GEOMETRIC;
+        vehicle.altitude=(int32_t)(1000000+1000*index);
+        vehicle.heading=(uint16_t)std::fmod((angle*180/M_PI+90)*100,36000);
+        vehicle.hor_velocity=20000;
+        vehicle.ver_velocity=0;
+        snprintf(vehicle.callsign,sizeof(vehicle.callsign),"SIM%04u",index%10000);
+        vehicle.emitter_type=ADSB_EMITTER_TYPE_LARGE;
+        vehicle.tslc=1;
+        vehicle.flags=ADSB_FLAGS_VALID_COORDS | ADSB_FLAGS_VALID_ALTITUDE | ADSB_FLAGS_VALID_HEADING | ADSB_FLAGS_VALID_VELOCITY | ADSB_FLAGS_VALID_CALLSIGN;
+        vehicle.squawk=1200;
+        mavlink_msg_adsb_vehicle_encode_chan(m_fc.sys_id,m_fc.comp_id,m_fc.channel,&msg,&vehicle);
+        sender.send(msg);
+    });
+    add_stream("OPENHD_STATS(air)",m_options.ohd_stats_hz,true,[this](UdpSender& sender,double t_s){
+        send_ohd_stats(sender,m_air,true,t_s);
+    });
+    add_stream("OPENHD_STATS(ground)",m_options.ohd_stats_hz,true,[this](UdpSender& sender,double t_s){
+        send_ohd_stats(sender,m_ground,false,t_s);
+    });
+}
+
+void Simulator::send_ohd_stats(UdpSender &sender, const SimSystem &system, bool is_air, double t_s)
+{
+    const uint64_t counter=m_n_ohd_stats++;
+    mavlink_message_t msg;
+    mavlink_openhd_stats_monitor_mode_wifi_card_t card{};
+    card.card_index=0;
+    // dummy0 is the rssi (dBm)
+    card.dummy0=(int8_t)(-50-(int)(10*std::sin(t_s)));
+    card.rx_signal_quality=(int8_t)(80+(int)(10*std::sin(t_s)));
+    mavlink_msg_openhd_stats_monitor_mode_wifi_card_encode_chan(system.sys_id,system.comp_id,system.channel,&msg,&card);
+    sender.send(msg);
+    mavlink_openhd_stats_monitor_mode_wifi_link_t link{};
+    link.curr_tx_pps=(int32_t)(1000+counter%100);
+    link.curr_rx_pps=(int32_t)(900+counter%100);
+    link.curr_tx_bps=(int32_t)(8000000+1000*(counter%100));
+    link.curr_rx_bps=(int32_t)(7000000+1000*(counter%100));
+    link.curr_rx_packet_loss_perc=(int16_t)(counter%5);
+    link.curr_tx_channel_mhz=5805;
+    link.curr_tx_channel_w_mhz=20;
+    link.curr_tx_mcs_index=3;
+    link.curr_rate_kbits=(int32_t)(8000+(counter%10)*100);
+    mavlink_msg_openhd_stats_monitor_mode_wifi_link_encode_chan(system.sys_id,system.comp_id,system.channel,&msg,&link);
+    sender.send(msg);
+    mavlink_openhd_stats_telemetry_t telemetry{};
+    telemetry.curr_tx_pps=(int32_t)(50+counter%10);
+    telemetry.curr_rx_pps=(int32_t)(200+counter%10);
+    telemetry.curr_tx_bps=(int32_t)(20000+100*(counter%10));
+    telemetry.curr_rx_bps=(int32_t)(80000+100*(counter%10));
+    mavlink_msg_openhd_stats_telemetry_encode_chan(system.sys_id,system.comp_id,system.channel,&msg,&telemetry);
+    sender.send(msg);
+    if(is_air){
+        mavlink_openhd_stats_wb_video_air_t video{};
+        video.link_index=0;
+        video.curr_dropped_frames=(int32_t)(counter/100);
+        mavlink_msg_openhd_stats_wb_video_air_encode_chan(system.sys_id,system.comp_id,system.channel,&msg,&video);
+    }else{
+        mavlink_openhd_stats_wb_video_ground_t video{};
+        video.link_index=0;
+        mavlink_msg_openhd_stats_wb_video_ground_encode_chan(system.sys_id,system.comp_id,system.channel,&msg,&video);
+    }
+    sender.send(msg);
+}
+
+// The QOpenHD benchmark report (key=value per line), nullopt if there is none (yet)
+typedef std::map<std::string,double> Report;
+static std::optional<Report> read_report(const std::string& filename){
+    std::ifstream file(filename);
+    if(!file.is_open())return std::nullopt;
+    Report ret;
+    std::string line;
+    while(std::getline(file,line)){
+        const auto pos=line.find('=');
+        if(pos==std::string::npos)continue;
+        ret[line.substr(0,pos)]=std::atof(line.c_str()+pos+1);
+    }
+    if(ret.count("timestamp_us")==0 || ret.count("rx_packets")==0)return std::nullopt;
+    return ret;
+}
+
+// utime + stime of a process, in seconds. -1 if not available
+static double get_process_cpu_time_s(int pid){
+    std::ifstream file("/proc/"+std::to_string(pid)+"/stat");
+    std::string stat;
+    if(!std::getline(file,stat))return -1;
+    // the process name (2nd field) might contain spaces
+    const auto pos=stat.rfind(')');
+    if(pos==std::string::npos)return -1;
+    std::istringstream ss(stat.substr(pos+2));
+    std::string field;
+    // state is field 3, utime / stime are field 14 / 15
+    for(int i=3;i<14 && ss>>field;i++){}
+    uint64_t utime=0,stime=0;
+    if(!(ss>>utime>>stime))return -1;
+    return (double)(utime+stime)/sysconf(_SC_CLK_TCK);
+}
+
+// Datagrams the kernel dropped on the udp socket(s) bound to port (QOpenHD not reading fast enough)
+static uint64_t get_udp_socket_drops(int port){
+    uint64_t ret=0;
+    for(const char* filename:{"/proc/net/udp","/proc/net/udp6"}){
+        std::ifstream file(filename);
+        std::string line;
+        std::getline(file,line);
+        while(std::getline(file,line)){
+            std::istringstream ss(line);
+            std::string slot,local_address;
+            ss>>slot>>local_address;
+            const auto pos=local_address.rfind(':');
+            if(pos==std::string::npos || std::strtol(local_address.c_str()+pos+1,nullptr,16)!=port)continue;
+            // drops is the last column
+            std::string field,last;
+            while(ss>>field)last=field;
+            ret+=std::strtoull(last.c_str(),nullptr,10);
+        }
+    }
+    return ret;
+}
+
+// Everything QOpenHD reported during one interval (fixed rate: 1 second, ramp: one step)
+struct IntervalStats{
+    int n_reports=0;
+    double ui_cpu_perc_sum=0;
+    double publish_latency_avg_us_sum=0;
+    double publish_latency_p99_us_max=0;
+    double processing_p99_us_max=0;
+    void add(const Report& report){
+        n_reports++;
+        ui_cpu_perc_sum+=report.at("ui_cpu_perc");
+        publish_latency_avg_us_sum+=report.at("publish_latency_avg_us");
+        publish_latency_p99_us_max=std::max(publish_latency_p99_us_max,report.at("publish_latency_p99_us"));
+        processing_p99_us_max=std::max(processing_p99_us_max,report.at("processing_p99_us"));
+    }
+    std::string to_string()const{
+        if(n_reports==0)return "no QOpenHD report";
+        std::stringstream ss;
+        ss<<std::fixed<<std::setprecision(1)<<"UI CPU "<<(ui_cpu_perc_sum/n_reports)<<"%"
+          <<" publish latency avg "<<(publish_latency_avg_us_sum/n_reports/1000)<<"ms p99 "<<(publish_latency_p99_us_max/1000)<<"ms"
+          <<" processing p99 "<<(int)processing_p99_us_max<<"us";
+        return ss.str();
+    }
+};
+
+// Polls the report while the simulator is sending
+class ReportReader{
+public:
+    explicit ReportReader(std::string filename):m_filename(filename){}
+    // Returns true if there is a new report
+    bool poll(){
+        const int64_t now_us=get_time_us();
+        if(now_us-m_last_poll_us<200*1000)return false;
+        m_last_poll_us=now_us;
+        auto report=read_report(m_filename);
+        // a report from a previous QOpenHD run (or none) doesn't count
+        if(!report.has_value() || report->at("timestamp_us")<=m_last_timestamp_us || now_us-report->at("timestamp_us")>3*1000*1000){
+            return false;
+        }
+        m_last_timestamp_us=report->at("timestamp_us");
+        latest=report.value();
+        return true;
+    }
+    Report latest;
+private:
+    const std::string m_filename;
+    int64_t m_last_poll_us=0;
+    double m_last_timestamp_us=0;
+};
+
+static void run_fixed_rate(const Options& options,Simulator& simulator,ReportReader& reader){
+    const int64_t start_us=get_time_us();
+    const int64_t end_us=options.duration_s>0 ? start_us+(int64_t)(options.duration_s*1000000) : INT64_MAX;
+    int64_t last_print_us=start_us;
+    uint64_t last_n_sent=0;
+    std::optional<Report> last_report;
+    const uint64_t drops_begin=get_udp_socket_drops(options.port);
+    while(get_time_us()<end_us){
+        IntervalStats stats;
+        std::optional<Report> report;
+        simulator.run_until(std::min(end_us,last_print_us+1000*1000),false,[&](){
+            if(reader.poll()){
+                stats.add(reader.latest);
+                report=reader.latest;
+            }
+        });
+        const int64_t now_us=get_time_us();
+        const double elapsed_s=(now_us-last_print_us)/1000000.0;
+        last_print_us=now_us;
+        std::stringstream ss;
+        ss<<std::fixed<<std::setprecision(0)<<"t="<<(now_us-start_us)/1000000.0<<"s sent "<<(simulator.get_n_sent()-last_n_sent)/elapsed_s<<"/s";
+        last_n_sent=simulator.get_n_sent();
+        if(report.has_value()){
+            ss<<" QOpenHD rx "<<report->at("rx_pps")<<"/s "<<stats.to_string();
+            last_report=report;
+        }else if(!last_report.has_value()){
+            ss<<" (no QOpenHD report - enable dev_telemetry_benchmark_report)";
+        }
+        ss<<" socket drops "<<(get_udp_socket_drops(options.port)-drops_begin);
+        std::cout<<ss.str()<<"\n";
+    }
+}
+
+// Waits for a report that was written after after_us (while keeping the systems alive), nullopt on timeout
+static std::optional<Report> wait_for_report(Simulator& simulator,ReportReader& reader,int64_t after_us,int64_t timeout_us){
+    std::optional<Report> ret;
+    const int64_t end_us=get_time_us()+timeout_us;
+    while(!ret.has_value() && get_time_us()<end_us){
+        simulator.run_until(get_time_us()+100*1000,true,[&](){
+            if(reader.poll() && reader.latest.at("timestamp_us")>after_us){
+                ret=reader.latest;
+            }
+        });
+    }
+    return ret;
+}
+
+static int run_ramp(const Options& options,Simulator& simulator,ReportReader& reader){
+    std::cout<<"Waiting for QOpenHD (systems discovery and first report)\n";
+    auto begin_report=wait_for_report(simulator,reader,get_time_us(),10*1000*1000);
+    if(!begin_report.has_value()){
+        std::cout<<"No QOpenHD report - is QOpenHD running with dev_telemetry_benchmark_report enabled ?\n";
+        return 1;
+    }
+    // heartbeats only, until QOpenHD has discovered the systems (and therefore processes their messages)
+    begin_report=wait_for_report(simulator,reader,get_time_us()+2*1000*1000,10*1000*1000);
+    if(!begin_report.has_value() || begin_report->at("rx_packets")<=0){
+        std::cout<<"QOpenHD doesn't process any messages - is it connected to another ground unit ?\n";
+        return 1;
+    }
+    std::cout<<std::setw(5)<<"step"<<std::setw(11)<<"target/s"<<std::setw(9)<<"sent/s"<<std::setw(10)<<"received"
+             <<std::setw(8)<<"drops"<<std::setw(10)<<"proc CPU"<<"  QOpenHD\n";
+    double max_sustainable_rate=0;
+    double multiplier=1;
+    Report last_report=begin_report.value();
+    for(int step=0;step<options.ramp_max_steps;step++){
+        simulator.set_rate_multiplier(multiplier);
+        const uint64_t n_sent_begin=simulator.get_n_sent();
+        const uint64_t drops_begin=get_udp_socket_drops(options.port);
+        const int pid=(int)last_report.at("pid");
+        const int64_t begin_us=get_time_us();
+        const int64_t end_us=begin_us+(int64_t)(options.ramp_step_s*1000000);
+        // the first second is warm up (rate change, stats of the previous interval)
+        const int64_t measure_begin_us=begin_us+1000*1000;
+        double cpu_begin_s=-1;
+        IntervalStats stats;
+        simulator.run_until(end_us,false,[&](){
+            if(cpu_begin_s<0 && get_time_us()>=measure_begin_us){
+                cpu_begin_s=get_process_cpu_time_s(pid);
+            }
+            if(reader.poll() && reader.latest.at("timestamp_us")>measure_begin_us){
+                stats.add(reader.latest);
+            }
+        });
+        const double cpu_end_s=get_process_cpu_time_s(pid);
+        const double sent_per_s=(simulator.get_n_sent()-n_sent_begin)/((get_time_us()-begin_us)/1000000.0);
+        // heartbeats only, such that everything that was sent has been processed and counted in the next report
+        auto end_report=wait_for_report(simulator,reader,get_time_us()+500*1000,5*1000*1000);
+        if(!end_report.has_value()){
+            std::cout<<"QOpenHD stopped reporting (stalled or crashed)\n";
+            break;
+        }
+        const uint64_t n_sent=simulator.get_n_sent()-n_sent_begin;
+        const double n_received=end_report->at("rx_packets")-last_report.at("rx_packets");
+        const double received_perc=n_sent>0 ? 100.0*n_received/n_sent : 0;
+        const uint64_t drops=get_udp_socket_drops(options.port)-drops_begin;
+        const double process_cpu_perc=cpu_begin_s>=0 && cpu_end_s>=0 ? 100.0*(cpu_end_s-cpu_begin_s)/((end_us-measure_begin_us)/1000000.0) : -1;
+        last_report=end_report.value();
+        const bool sustainable=received_perc>=99 && drops==0 && stats.n_reports>0 && stats.publish_latency_p99_us_max<=options.max_publish_latency_ms*1000;
+        std::cout<<std::fixed<<std::setprecision(0)<<std::setw(5)<<step<<std::setw(11)<<simulator.get_configured_rate_hz()
+                 <<std::setw(9)<<sent_per_s<<std::setw(9)<<std::setprecision(1)<<received_perc<<"%"<<std::setw(8)<<drops
+                 <<std::setw(9)<<process_cpu_perc<<"%  "<<stats.to_string()<<(sustainable ? "" : "  NOT SUSTAINABLE")<<"\n";
+        if(!sustainable)break;
+        max_sustainable_rate=std::max(max_sustainable_rate,sent_per_s);
+        multiplier*=options.ramp_factor;
+    }
+    std::cout<<"Max sustainable message rate: "<<(int)max_sustainable_rate<<" msg/s\n";
+    return 0;
+}
+
+int main(int argc,char* argv[]){
+    Options options{};
+    if(!parse_options(argc,argv,options)){
+        print_usage();
+        return 1;
+    }
+    Simulator simulator(options);
+    simulator.print_mix();
+    std::cout<<"Sending to 127.0.0.1:"<<options.port<<" as ground ("<<OHD_SYS_ID_GROUND<<"), air ("<<OHD_SYS_ID_AIR<<") and FC ("<<options.fc_sys_id<<")\n";
+    ReportReader reader(options.report_filename);
+    int ret=0;
+    if(options.ramp){
+        ret=run_ramp(options,simulator,reader);
+    }else{
+        run_fixed_rate(options,simulator,reader);
+    }
+    if(simulator.get_n_send_errors()>0){
+        std::cout<<simulator.get_n_send_errors()<<" send errors\n";
+    }
+    return ret;
+}
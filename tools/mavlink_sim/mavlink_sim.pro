@@ -0,0 +1,22 @@
+# Headless telemetry load test: stands in for the OpenHD ground unit, the air unit and an FC and floods QOpenHD
+# (udp 14550 on loopback) with a configurable message mix. Optionally ramps the rate to find the maximum sustainable
+# message rate - QOpenHD needs dev_telemetry_benchmark_report enabled for that (see telemetry_benchmark_report.hpp).
+# mavlink (openhd dialect) comes with MAVSDK, same as for QOpenHD (see app/telemetry/telemetry.pri)
+# qmake tools/mavlink_sim/mavlink_sim.pro && make
+# ./mavlink_sim --help
+TEMPLATE = app
+TARGET = mavlink_sim
+CONFIG += c++17 console
+CONFIG -= app_bundle
+QT = core
+
+INCLUDEPATH += $$PWD/../..
+INCLUDEPATH += $$PWD/../../app
+INCLUDEPATH += /usr/local/include/mavsdk
+INCLUDEPATH += /usr/include/mavsdk
+
+SOURCES += \
+    $$PWD/main.cpp \
+
+LIBS += -L/usr/local/lib -lmavsdk
+LIBS += -lpthread -latomic
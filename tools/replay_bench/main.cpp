@@ -0,0 +1,482 @@
+// Headless benchmark of the video receive pipeline, fed by a recorded stream via the ReplaySource.
+// Measures the cost of rtp parsing (RTPDecoder), the KeyFrameFinder and avcodec decode, as well as the
+// latency from the first packet of a frame until it is decoded. Or, with --udp, just replays the stream
+// to QOpenHD (or anything else) over loopback.
+// AVCodecDecoder itself is coupled to the TextureRenderer / QML, the decode stage here uses the same avcodec calls
+// (one packet per access unit, same as with dev_rtp_assemble_access_units) without any rendering.
+// With --threading the stream is replayed once per decode threading policy (same policies as the dev_decode_threading
+// setting) and a summary of decode latency and throughput per policy is printed at the end.
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/TimeHelper.hpp"
+#include "udp/ReplaySource.h"
+#include "rtp/ParseRTP.h"
+#include "nalu/KeyFrameFinder.hpp"
+
+#ifdef REPLAY_BENCH_WITH_AVCODEC
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+#endif
+
+// Same as QOpenHDVideoHelper::DecodeThreading
+enum class Threading{
+    SINGLE,
+    SLICE,
+    FRAME,
+    // slice threads, frame threads once slice threads cannot keep up with the frame rate
+    AUTO
+};
+
+static std::string threading_to_string(Threading threading){
+    switch(threading){
+    case Threading::SINGLE:return "single";
+    case Threading::SLICE:return "slice";
+    case Threading::FRAME:return "frame";
+    case Threading::AUTO:return "auto";
+    }
+    return "?";
+}
+
+struct Options{
+    ReplaySource::Configuration replay{};
+    int n_loops=1;
+    // send to 127.0.0.1:port instead of running the pipeline
+    int udp_port=-1;
+    bool decode=true;
+    // the whole stream is replayed once per policy
+    std::vector<Threading> threading{Threading::SINGLE};
+    // for slice / frame threads, 0 == one per core (like the app)
+    int decode_threads=0;
+};
+
+static void print_usage(){
+    std::cout<<"replay_bench <file.pcap|file.h264|file.h265> [options]\n"
+             <<"  --h265               Annex-B input is h265 (pcap: rtp payload is h265)\n"
+             <<"  --fps N              Annex-B input frame rate (default 60)\n"
+             <<"  --speed X            1.0 == original timing, 0 == as fast as possible (default)\n"
+             <<"  --loops N            replay N times (default 1)\n"
+             <<"  --loss P             drop P percent of the packets\n"
+             <<"  --reorder P          reorder P percent of the packets\n"
+             <<"  --reorder-distance N reordered packets arrive N packets late (default 2)\n"
+             <<"  --seed N             seed for loss / reorder (default 0)\n"
+             <<"  --udp PORT           send to 127.0.0.1:PORT instead of running the pipeline\n"
+             <<"  --no-decode          only rtp parsing and keyframe finder\n"
+             <<"  --threading P,P,...  decode threading policies single|slice|frame|auto|all, one run each (default single)\n"
+             <<"  --threads N          threads for slice / frame threading, 0 == one per core (default 0)\n";
+}
+
+static bool parse_threading(const std::string& value,std::vector<Threading>& threading){
+    threading.clear();
+    std::stringstream ss(value);
+    std::string item;
+    while(std::getline(ss,item,',')){
+        if(item=="single"){
+            threading.push_back(Threading::SINGLE);
+        }else if(item=="slice"){
+            threading.push_back(Threading::SLICE);
+        }else if(item=="frame"){
+            threading.push_back(Threading::FRAME);
+        }else if(item=="auto"){
+            threading.push_back(Threading::AUTO);
+        }else if(item=="all"){
+            threading.insert(threading.end(),{Threading::SINGLE,Threading::SLICE,Threading::FRAME,Threading::AUTO});
+        }else{
+            std::cout<<"Unknown threading policy "<<item<<"\n";
+            return false;
+        }
+    }
+    return !threading.empty();
+}
+
+static bool parse_options(int argc,char* argv[],Options& options){
+    if(argc<2)return false;
+    options.replay.speed=0;
+    for(int i=1;i<argc;i++){
+        const std::string arg=argv[i];
+        const bool has_value=i+1<argc;
+        if(arg=="--help" || arg=="-h"){
+            return false;
+        }else if(arg=="--h265"){
+            options.replay.annexb_is_h265=true;
+        }else if(arg=="--no-decode"){
+            options.decode=false;
+        }else if(arg=="--fps" && has_value){
+            options.replay.annexb_fps=std::atoi(argv[++i]);
+        }else if(arg=="--speed" && has_value){
+            options.replay.speed=std::atof(argv[++i]);
+        }else if(arg=="--loops" && has_value){
+            options.n_loops=std::atoi(argv[++i]);
+        }else if(arg=="--loss" && has_value){
+            options.replay.loss_percent=std::atof(argv[++i]);
+        }else if(arg=="--reorder" && has_value){
+            options.replay.reorder_percent=std::atof(argv[++i]);
+        }else if(arg=="--reorder-distance" && has_value){
+            options.replay.reorder_distance=std::atoi(argv[++i]);
+        }else if(arg=="--seed" && has_value){
+            options.replay.seed=(uint32_t)std::atoi(argv[++i]);
+        }else if(arg=="--udp" && has_value){
+            options.udp_port=std::atoi(argv[++i]);
+        }else if(arg=="--threading" && has_value){
+            if(!parse_threading(argv[++i],options.threading))return false;
+        }else if(arg=="--threads" && has_value){
+            options.decode_threads=std::atoi(argv[++i]);
+        }else if(!arg.empty() && arg[0]!='-' && options.replay.filename.empty()){
+            options.replay.filename=arg;
+        }else{
+            std::cout<<"Unknown option "<<arg<<"\n";
+            return false;
+        }
+    }
+    return !options.replay.filename.empty();
+}
+
+static void print_histogram(const std::string& name,const LatencyHistogram& histogram){
+    const auto snapshot=histogram.snapshot();
+    std::cout<<std::left<<std::setw(28)<<name;
+    if(snapshot.n_samples==0){
+        std::cout<<"-\n";
+        return;
+    }
+    std::cout<<"n="<<snapshot.n_samples<<" p50="<<MyTimeHelper::R(snapshot.get_percentile(0.5))<<" "<<snapshot.getAvgReadable()<<"\n";
+}
+
+static int run_udp(const Options& options){
+    const int sock=socket(AF_INET,SOCK_DGRAM,0);
+    if(sock<0){
+        std::cout<<"Cannot create socket\n";
+        return 1;
+    }
+    sockaddr_in addr{};
+    addr.sin_family=AF_INET;
+    addr.sin_port=htons(options.udp_port);
+    inet_pton(AF_INET,"127.0.0.1",&addr.sin_addr);
+    ReplaySource source("BENCH",options.replay,[&](const UDPReceiver::Datagram* datagrams,size_t n_datagrams){
+        for(size_t i=0;i<n_datagrams;i++){
+            sendto(sock,datagrams[i].data,datagrams[i].data_len,0,(const sockaddr*)&addr,sizeof(addr));
+        }
+    });
+    if(!source.load())return 1;
+    for(int i=0;i<options.n_loops;i++){
+        source.run_blocking();
+    }
+    close(sock);
+    std::cout<<"Sent "<<source.get_stats().to_string()<<"\n";
+    return 0;
+}
+
+struct PipelineResult{
+    Threading threading=Threading::SINGLE;
+    // read back after avcodec_open2
+    int n_threads=1;
+    std::string active_thread_type="none";
+    int n_access_units=0;
+    int n_decoded_frames=0;
+    // auto: frames until the switch to frame threads, -1 if it stayed with slice threads
+    int switched_after_n_frames=-1;
+    double elapsed_s=0;
+    LatencyHistogram decode_time{"decode"};
+    LatencyHistogram fed_until_decoded{"fed until decoded"};
+    LatencyHistogram end_to_end{"end to end"};
+};
+
+#ifdef REPLAY_BENCH_WITH_AVCODEC
+// The avcodec part of AVCodecDecoder (sw decode), including the thread setup of apply_threading_policy()
+// and the auto policy of evaluate_threading_policy()
+class BenchDecoder{
+public:
+    BenchDecoder(bool is_h265,Threading policy,int n_threads,PipelineResult& result)
+        : m_is_h265(is_h265),m_policy(policy),m_n_threads(n_threads),m_result(result),
+          m_active(policy==Threading::AUTO ? Threading::SLICE : policy)
+    {
+        m_packet=av_packet_alloc();
+        m_frame=av_frame_alloc();
+    }
+    ~BenchDecoder(){
+        avcodec_free_context(&m_decoder_ctx);
+        av_packet_free(&m_packet);
+        av_frame_free(&m_frame);
+    }
+    bool open(){
+        avcodec_free_context(&m_decoder_ctx);
+        const AVCodec* decoder=avcodec_find_decoder(m_is_h265 ? AV_CODEC_ID_HEVC : AV_CODEC_ID_H264);
+        m_decoder_ctx=decoder ? avcodec_alloc_context3(decoder) : nullptr;
+        if(m_decoder_ctx==nullptr)return false;
+        if(m_active==Threading::SLICE){
+            m_decoder_ctx->thread_type=FF_THREAD_SLICE;
+            m_decoder_ctx->thread_count=m_n_threads;
+        }else if(m_active==Threading::FRAME){
+            m_decoder_ctx->thread_type=FF_THREAD_FRAME|FF_THREAD_SLICE;
+            m_decoder_ctx->thread_count=m_n_threads;
+        }else{
+            m_decoder_ctx->thread_count=1;
+        }
+        // avcodec disables frame threading with low delay set
+        if(m_active!=Threading::FRAME){
+            m_decoder_ctx->flags|=AV_CODEC_FLAG_LOW_DELAY;
+        }
+        // a freshly opened decoder needs the config data and a keyframe
+        m_wait_for_keyframe=true;
+        m_in_flight.clear();
+        if(avcodec_open2(m_decoder_ctx,decoder,nullptr)!=0)return false;
+        // what avcodec actually uses, not what we requested
+        const int active_thread_type=m_decoder_ctx->active_thread_type;
+        m_result.n_threads=active_thread_type==0 ? 1 : m_decoder_ctx->thread_count;
+        m_result.active_thread_type= (active_thread_type & FF_THREAD_FRAME) ? "frame" : (active_thread_type & FF_THREAD_SLICE) ? "slice" : "none";
+        return true;
+    }
+    // access_unit needs AV_INPUT_BUFFER_PADDING_SIZE bytes of zeroes after size, config_data ends with them
+    void feed(const uint8_t* access_unit,int size,bool is_keyframe,const std::vector<uint8_t>& config_data,
+              std::chrono::steady_clock::time_point first_packet,uint32_t rtp_timestamp){
+        if(m_wait_for_keyframe){
+            if(!is_keyframe)return;
+            m_wait_for_keyframe=false;
+            send(config_data.data(),(int)(config_data.size()-AV_INPUT_BUFFER_PADDING_SIZE),-1);
+        }
+        const auto before=std::chrono::steady_clock::now();
+        const int64_t pts=m_next_pts++;
+        m_in_flight.push_back(InFlight{pts,first_packet,before});
+        send(access_unit,size,pts);
+        const auto decode_time=std::chrono::steady_clock::now()-before;
+        m_result.decode_time.add(decode_time);
+        evaluate_auto(decode_time,rtp_timestamp);
+    }
+    // frame threading holds back frames
+    void flush(){
+        avcodec_send_packet(m_decoder_ctx,nullptr);
+        receive_frames();
+    }
+private:
+    struct InFlight{
+        int64_t pts;
+        std::chrono::steady_clock::time_point first_packet;
+        std::chrono::steady_clock::time_point fed;
+    };
+    void send(const uint8_t* data,int size,int64_t pts){
+        m_packet->data=(uint8_t*)data;
+        m_packet->size=size;
+        m_packet->pts=pts;
+        avcodec_send_packet(m_decoder_ctx,m_packet);
+        receive_frames();
+    }
+    void receive_frames(){
+        while(avcodec_receive_frame(m_decoder_ctx,m_frame)==0){
+            const auto now=std::chrono::steady_clock::now();
+            // no b-frames, frames come out in the order they were fed - the ones before were dropped by the decoder
+            while(!m_in_flight.empty() && m_in_flight.front().pts<m_frame->pts){
+                m_in_flight.pop_front();
+            }
+            if(!m_in_flight.empty() && m_in_flight.front().pts==m_frame->pts){
+                m_result.fed_until_decoded.add(now-m_in_flight.front().fed);
+                m_result.end_to_end.add(now-m_in_flight.front().first_packet);
+                m_in_flight.pop_front();
+            }
+            m_result.n_decoded_frames++;
+            av_frame_unref(m_frame);
+        }
+    }
+    // Like AVCodecDecoder::evaluate_threading_policy(), but the frame interval is the one of the stream (rtp timestamps) -
+    // when replaying as fast as possible the wall clock frame interval is the decode time itself
+    void evaluate_auto(std::chrono::nanoseconds decode_time,uint32_t rtp_timestamp){
+        if(m_policy!=Threading::AUTO || m_active!=Threading::SLICE)return;
+        if(m_eval_n_frames==0){
+            m_eval_begin_rtp_timestamp=rtp_timestamp;
+            m_eval_decode_time=std::chrono::nanoseconds(0);
+        }
+        m_eval_n_frames++;
+        m_eval_decode_time+=decode_time;
+        // 90kHz rtp clock
+        const uint32_t elapsed_ticks=rtp_timestamp-m_eval_begin_rtp_timestamp;
+        if(elapsed_ticks<2*90000)return;
+        const auto frame_interval=std::chrono::nanoseconds((int64_t)elapsed_ticks*1000*1000*1000/90000/(m_eval_n_frames-1));
+        const auto avg_decode_time=m_eval_decode_time/m_eval_n_frames;
+        m_eval_n_frames=0;
+        if(avg_decode_time > frame_interval*9/10){
+            std::cout<<"auto: decode time "<<MyTimeHelper::R(avg_decode_time)<<" exceeds frame interval "<<MyTimeHelper::R(frame_interval)
+                    <<", using frame threads\n";
+            m_result.switched_after_n_frames=m_result.n_access_units;
+            // re-open, like the reconfigure in the app
+            flush();
+            m_active=Threading::FRAME;
+            open();
+        }
+    }
+    const bool m_is_h265;
+    const Threading m_policy;
+    const int m_n_threads;
+    PipelineResult& m_result;
+    Threading m_active;
+    AVCodecContext* m_decoder_ctx=nullptr;
+    AVPacket* m_packet=nullptr;
+    AVFrame* m_frame=nullptr;
+    bool m_wait_for_keyframe=true;
+    int64_t m_next_pts=0;
+    std::deque<InFlight> m_in_flight;
+    int m_eval_n_frames=0;
+    uint32_t m_eval_begin_rtp_timestamp=0;
+    std::chrono::nanoseconds m_eval_decode_time{0};
+};
+#endif
+
+// Replays the stream once through rtp parsing, keyframe finder and (optional) decode with the given threading policy
+static int run_pipeline(const Options& options,Threading threading,PipelineResult& result){
+    const bool is_h265=options.replay.annexb_is_h265;
+    LatencyHistogram parse_time{"parse"};
+    LatencyHistogram keyframe_finder_time{"keyframe finder"};
+    KeyFrameFinder keyframe_finder{};
+    int n_nalus=0;
+    // the current access unit (all NALUs until the rtp marker)
+    std::vector<uint8_t> access_unit;
+    bool access_unit_is_keyframe=false;
+    std::chrono::steady_clock::time_point access_unit_begin{};
+    result.threading=threading;
+#ifdef REPLAY_BENCH_WITH_AVCODEC
+    const int n_threads=options.decode_threads>0 ? options.decode_threads : (int)std::max(std::thread::hardware_concurrency(),1u);
+    BenchDecoder decoder(is_h265,threading,n_threads,result);
+    if(options.decode && !decoder.open()){
+        std::cout<<"Cannot open decoder\n";
+        return 1;
+    }
+    std::vector<uint8_t> config_data;
+#endif
+    auto on_access_unit=[&](uint32_t rtp_timestamp){
+        result.n_access_units++;
+        // Like the decoder, wait for the config data before feeding anything
+        if(!options.decode || !keyframe_finder.allKeyFramesAvailable(is_h265))return;
+#ifdef REPLAY_BENCH_WITH_AVCODEC
+        if(config_data.empty()){
+            config_data=*keyframe_finder.get_keyframe_data(is_h265);
+            config_data.resize(config_data.size()+AV_INPUT_BUFFER_PADDING_SIZE,0);
+        }
+        const size_t size=access_unit.size();
+        // avcodec reads past the end of the data
+        access_unit.resize(size+AV_INPUT_BUFFER_PADDING_SIZE,0);
+        decoder.feed(access_unit.data(),(int)size,access_unit_is_keyframe,config_data,access_unit_begin,rtp_timestamp);
+#else
+        (void)rtp_timestamp;
+#endif
+    };
+    RTPDecoder rtp_decoder([&](const std::chrono::steady_clock::time_point creation_time,NALUBufferPool::Buffer nalu_buffer,bool rtp_marker,uint32_t rtp_timestamp){
+        n_nalus++;
+        const auto before=std::chrono::steady_clock::now();
+        const NALU nalu(nalu_buffer->data.get(),nalu_buffer->size,is_h265,creation_time,rtp_timestamp);
+        keyframe_finder.saveIfKeyFrame(nalu);
+        keyframe_finder_time.add(std::chrono::steady_clock::now()-before);
+        if(access_unit.empty()){
+            access_unit_begin=creation_time;
+            access_unit_is_keyframe=false;
+        }
+        access_unit_is_keyframe|=nalu.is_keyframe();
+        access_unit.insert(access_unit.end(),nalu.getData(),nalu.getData()+nalu.getSize());
+        if(rtp_marker){
+            on_access_unit(rtp_timestamp);
+            access_unit.clear();
+        }
+    },false);
+    ReplaySource source("BENCH",options.replay,[&](const UDPReceiver::Datagram* datagrams,size_t n_datagrams){
+        for(size_t i=0;i<n_datagrams;i++){
+            const auto before=std::chrono::steady_clock::now();
+            if(is_h265){
+                rtp_decoder.parseRTPH265toNALU(datagrams[i].data,datagrams[i].data_len);
+            }else{
+                rtp_decoder.parseRTPH264toNALU(datagrams[i].data,datagrams[i].data_len);
+            }
+            parse_time.add(std::chrono::steady_clock::now()-before);
+        }
+    });
+    if(!source.load())return 1;
+    const auto begin=std::chrono::steady_clock::now();
+    for(int i=0;i<options.n_loops;i++){
+        source.run_blocking();
+    }
+#ifdef REPLAY_BENCH_WITH_AVCODEC
+    if(options.decode){
+        decoder.flush();
+    }
+#endif
+    result.elapsed_s=std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now()-begin).count()/1000.0/1000.0;
+    const auto stats=source.get_stats();
+    std::cout<<std::fixed<<std::setprecision(1);
+    std::cout<<"Replayed "<<stats.to_string()<<" in "<<result.elapsed_s*1000<<"ms\n";
+    if(result.elapsed_s>0){
+        std::cout<<"Throughput: "<<stats.n_bytes*8/result.elapsed_s/1000/1000<<"MBit/s "<<stats.n_packets/result.elapsed_s<<" packets/s "
+                <<result.n_access_units/result.elapsed_s<<" frames/s\n";
+    }
+    std::cout<<"NALUs:"<<n_nalus<<" frames:"<<result.n_access_units<<" decoded:"<<result.n_decoded_frames
+            <<" rtp gaps:"<<rtp_decoder.m_n_gaps<<" lost packets:"<<rtp_decoder.m_n_lost_packets<<"\n";
+    print_histogram("rtp parse per packet",parse_time);
+    print_histogram("keyframe finder per NALU",keyframe_finder_time);
+    print_histogram("decode call per frame",result.decode_time);
+    print_histogram("fed until decoded",result.fed_until_decoded);
+    print_histogram("first packet until decoded",result.end_to_end);
+    return 0;
+}
+
+static void print_summary(const std::vector<PipelineResult*>& results){
+    std::cout<<"\n"<<std::left<<std::setw(10)<<"threading"<<std::right<<std::setw(8)<<"threads"<<std::setw(8)<<"active"<<std::setw(10)<<"decoded"
+             <<std::setw(10)<<"frames/s"<<std::setw(12)<<"decode p50"<<std::setw(12)<<"decode p99"<<std::setw(12)<<"e2e p50"<<std::setw(12)<<"e2e p99"<<"\n";
+    for(const auto* result:results){
+        const auto fed_until_decoded=result->fed_until_decoded.snapshot();
+        const auto end_to_end=result->end_to_end.snapshot();
+        std::string threading=threading_to_string(result->threading);
+        if(result->switched_after_n_frames>=0){
+            threading+="*";
+        }
+        std::cout<<std::left<<std::setw(10)<<threading<<std::right<<std::setw(8)<<result->n_threads<<std::setw(8)<<result->active_thread_type<<std::setw(10)<<result->n_decoded_frames
+                 <<std::setw(10)<<(result->elapsed_s>0 ? result->n_decoded_frames/result->elapsed_s : 0)
+                 <<std::setw(12)<<MyTimeHelper::R(fed_until_decoded.get_percentile(0.5))<<std::setw(12)<<MyTimeHelper::R(fed_until_decoded.get_percentile(0.99))
+                 <<std::setw(12)<<MyTimeHelper::R(end_to_end.get_percentile(0.5))<<std::setw(12)<<MyTimeHelper::R(end_to_end.get_percentile(0.99))<<"\n";
+    }
+    for(const auto* result:results){
+        if(result->switched_after_n_frames>=0){
+            std::cout<<"* switched to frame threads after "<<result->switched_after_n_frames<<" frames\n";
+        }
+    }
+}
+
+int main(int argc,char* argv[]){
+    Options options{};
+    if(!parse_options(argc,argv,options)){
+        print_usage();
+        return 1;
+    }
+    if(options.udp_port>0){
+        return run_udp(options);
+    }
+#ifndef REPLAY_BENCH_WITH_AVCODEC
+    if(options.decode){
+        std::cout<<"Built without avcodec, decode disabled\n";
+        options.decode=false;
+    }
+#endif
+    if(!options.decode){
+        PipelineResult result{};
+        return run_pipeline(options,Threading::SINGLE,result);
+    }
+    // LatencyHistogram is not copyable
+    std::vector<std::unique_ptr<PipelineResult>> results;
+    std::vector<PipelineResult*> summary;
+    for(const auto threading:options.threading){
+        std::cout<<"--- threading:"<<threading_to_string(threading)<<"\n";
+        results.push_back(std::make_unique<PipelineResult>());
+        if(run_pipeline(options,threading,*results.back())!=0)return 1;
+        summary.push_back(results.back().get());
+    }
+    print_summary(summary);
+    return 0;
+}
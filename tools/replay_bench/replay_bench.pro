@@ -0,0 +1,33 @@
+# Headless benchmark of the video receive pipeline (rtp parsing, keyframe finder, avcodec decode),
+# fed by a recorded stream (pcap of rtp/udp or Annex-B file) - no network, no air unit and no GUI needed.
+# qmake tools/replay_bench/replay_bench.pro && make
+# ./replay_bench --help
+# ./replay_bench stream.pcap --threading all   (decode latency / throughput per decode threading policy)
+TEMPLATE = app
+TARGET = replay_bench
+CONFIG += c++17 console
+CONFIG -= app_bundle
+QT = core
+
+INCLUDEPATH += $$PWD/../..
+INCLUDEPATH += $$PWD/../../app
+INCLUDEPATH += $$PWD/../../app/videostreaming/vscommon
+
+include(../../lib/h264/h264.pri)
+
+SOURCES += \
+    $$PWD/main.cpp \
+    $$PWD/../../app/videostreaming/vscommon/rtp/ParseRTP.cpp \
+    $$PWD/../../app/videostreaming/vscommon/udp/ReplaySource.cpp \
+
+HEADERS += \
+    $$PWD/../../app/videostreaming/vscommon/udp/ReplaySource.h \
+
+# decode is optional (--no-decode), but the benchmark is built with it if ffmpeg is available
+CONFIG += link_pkgconfig
+packagesExist(libavcodec) {
+    PKGCONFIG += libavcodec libavutil
+    DEFINES += REPLAY_BENCH_WITH_AVCODEC
+}
+
+LIBS += -lpthread
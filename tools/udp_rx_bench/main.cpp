@@ -0,0 +1,272 @@
+// Loopback benchmark of the UDP video ingest. A sender thread sends rtp sized datagrams to 127.0.0.1 (paced, or as fast
+// as possible), the real UDPReceiver receives them - once with the legacy recvfrom() loop (batch size 1) and once per
+// recvmmsg() batch size. For each run it reports the packets/s received, the loss, the packets per receive syscall and
+// the CPU time of the receive thread per MBit (same metric as the udp_rx_stats in the QRender stats widget).
+// Note that with fewer than 2 cpu cores the sender and the receiver compete for the cpu.
+
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "udp/UDPReceiver.h"
+
+struct Options{
+    int port=5620;
+    double seconds=3;
+    // rtp packet size of the OpenHD video stream
+    int packet_size=1446;
+    // 0 == as fast as possible
+    double rate_mbit=0;
+    std::vector<int> batch_sizes{1,4,8,16,32,64};
+    bool gro=false;
+    // cpu time the consumer spends per datagram (busy wait), like the rtp parsing / NALU copy in RTPReceiver
+    double work_us=0;
+    // datagrams per sendmmsg() - wifibroadcast forwards a whole FEC block at once
+    int burst=16;
+};
+
+static void print_usage(){
+    std::cout<<"udp_rx_bench [options]\n"
+             <<"  --port N             loopback port (default 5620)\n"
+             <<"  --seconds X          measurement time per run (default 3)\n"
+             <<"  --packet-size N      datagram size (default 1446)\n"
+             <<"  --rate MBIT          sender rate in MBit/s, 0 == as fast as possible (default)\n"
+             <<"  --batch N,N,...      recvmmsg batch sizes, 1 == recvfrom (default 1,4,8,16,32,64)\n"
+             <<"  --gro                additionally run each batch size > 1 with UDP_GRO\n"
+             <<"  --work-us X          simulated consumer cpu time per datagram in us (default 0)\n"
+             <<"  --burst N            datagrams sent at once (default 16)\n";
+}
+
+static std::vector<int> parse_list(const std::string& value){
+    std::vector<int> ret;
+    std::stringstream ss(value);
+    std::string item;
+    while(std::getline(ss,item,',')){
+        if(!item.empty())ret.push_back(std::atoi(item.c_str()));
+    }
+    return ret;
+}
+
+static bool parse_options(int argc,char* argv[],Options& options){
+    for(int i=1;i<argc;i++){
+        const std::string arg=argv[i];
+        const bool has_value=i+1<argc;
+        if(arg=="--help" || arg=="-h"){
+            return false;
+        }else if(arg=="--gro"){
+            options.gro=true;
+        }else if(arg=="--port" && has_value){
+            options.port=std::atoi(argv[++i]);
+        }else if(arg=="--seconds" && has_value){
+            options.seconds=std::atof(argv[++i]);
+        }else if(arg=="--packet-size" && has_value){
+            options.packet_size=std::atoi(argv[++i]);
+        }else if(arg=="--rate" && has_value){
+            options.rate_mbit=std::atof(argv[++i]);
+        }else if(arg=="--work-us" && has_value){
+            options.work_us=std::atof(argv[++i]);
+        }else if(arg=="--burst" && has_value){
+            options.burst=std::atoi(argv[++i]);
+        }else if(arg=="--batch" && has_value){
+            options.batch_sizes=parse_list(argv[++i]);
+        }else{
+            std::cout<<"Unknown option "<<arg<<"\n";
+            return false;
+        }
+    }
+    return !options.batch_sizes.empty() && options.packet_size>0 && options.packet_size<=1472 && options.burst>0;
+}
+
+// Sends datagrams of packet_size to 127.0.0.1:port until stopped, in bursts (sendmmsg())
+class Sender{
+public:
+    Sender(const Options& options):m_options(options){}
+    void start(){
+        m_stop=false;
+        m_thread=std::thread(&Sender::loop,this);
+    }
+    void stop(){
+        m_stop=true;
+        m_thread.join();
+    }
+    uint64_t get_n_sent()const{
+        return m_n_sent;
+    }
+private:
+    void loop(){
+        const int sock=socket(AF_INET,SOCK_DGRAM,0);
+        sockaddr_in addr{};
+        addr.sin_family=AF_INET;
+        addr.sin_port=htons(m_options.port);
+        inet_pton(AF_INET,"127.0.0.1",&addr.sin_addr);
+        const int burst=m_options.burst;
+        std::vector<uint8_t> data((size_t)m_options.packet_size*burst,0x80);
+        std::vector<iovec> iovecs(burst);
+        std::vector<mmsghdr> msgs(burst);
+        for(int i=0;i<burst;i++){
+            iovecs[i].iov_base=&data[(size_t)i*m_options.packet_size];
+            iovecs[i].iov_len=m_options.packet_size;
+            msgs[i].msg_hdr.msg_name=&addr;
+            msgs[i].msg_hdr.msg_namelen=sizeof(addr);
+            msgs[i].msg_hdr.msg_iov=&iovecs[i];
+            msgs[i].msg_hdr.msg_iovlen=1;
+        }
+        const double packets_per_s=m_options.rate_mbit*1000*1000/8/m_options.packet_size;
+        const auto begin=std::chrono::steady_clock::now();
+        uint64_t seq=0;
+        while(!m_stop){
+            if(packets_per_s>0){
+                const auto due=begin+std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(m_n_sent/packets_per_s));
+                if(std::chrono::steady_clock::now()<due){
+                    std::this_thread::sleep_until(due);
+                    continue;
+                }
+            }
+            for(int i=0;i<burst;i++){
+                // rtp like, a sequence number such that the payload isn't constant
+                memcpy(iovecs[i].iov_base,&seq,sizeof(seq));
+                seq++;
+            }
+            const int n_sent=sendmmsg(sock,msgs.data(),burst,0);
+            if(n_sent>0){
+                m_n_sent+=n_sent;
+            }
+        }
+        close(sock);
+    }
+    const Options m_options;
+    std::thread m_thread;
+    std::atomic<bool> m_stop{false};
+    std::atomic<uint64_t> m_n_sent{0};
+};
+
+static std::chrono::nanoseconds get_cpu_time(clockid_t clock_id){
+    timespec ts{};
+    clock_gettime(clock_id,&ts);
+    return std::chrono::seconds(ts.tv_sec)+std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+static void busy_wait(double us){
+    if(us<=0)return;
+    const auto end=std::chrono::steady_clock::now()+std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double,std::micro>(us));
+    while(std::chrono::steady_clock::now()<end){
+    }
+}
+
+struct Result{
+    double sent_pps=0;
+    double received_pps=0;
+    double loss_perc=0;
+    double packets_per_callback=0;
+    double received_mbit=0;
+    double rx_cpu_perc=0;
+    double rx_cpu_us_per_mbit=0;
+};
+
+static Result run(const Options& options,int batch_size,bool gro){
+    UDPReceiver::Configuration config{};
+    config.udp_ip_address="127.0.0.1";
+    config.udp_port=options.port;
+    // same as RTPReceiver
+    config.opt_os_receive_buff_size=UDPReceiver::BIG_UDP_RECEIVE_BUFFER_SIZE;
+    config.recvmmsg_batch_size=batch_size;
+    config.enable_udp_gro=gro;
+    std::atomic<uint64_t> n_received{0};
+    std::atomic<uint64_t> n_received_bytes{0};
+    std::atomic<uint64_t> n_callbacks{0};
+    // the receive thread, to measure its cpu time
+    std::atomic<bool> has_rx_clock{false};
+    clockid_t rx_clock{};
+    UDPReceiver receiver("BENCH",config,[&](const UDPReceiver::Datagram* datagrams,size_t n_datagrams){
+        if(!has_rx_clock){
+            pthread_getcpuclockid(pthread_self(),&rx_clock);
+            has_rx_clock=true;
+        }
+        uint64_t n_bytes=0;
+        for(size_t i=0;i<n_datagrams;i++){
+            n_bytes+=datagrams[i].data_len;
+            busy_wait(options.work_us);
+        }
+        n_received+=n_datagrams;
+        n_received_bytes+=n_bytes;
+        n_callbacks++;
+    });
+    receiver.startReceiving();
+    // give the receiver time to bind
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    Sender sender(options);
+    sender.start();
+    // warm up
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    Result result{};
+    if(!has_rx_clock){
+        std::cout<<"Nothing received\n";
+        sender.stop();
+        receiver.stopReceiving();
+        return result;
+    }
+    const auto begin=std::chrono::steady_clock::now();
+    const uint64_t sent_begin=sender.get_n_sent();
+    const uint64_t received_begin=n_received;
+    const uint64_t received_bytes_begin=n_received_bytes;
+    const uint64_t callbacks_begin=n_callbacks;
+    const auto cpu_begin=get_cpu_time(rx_clock);
+    std::this_thread::sleep_for(std::chrono::duration<double>(options.seconds));
+    const uint64_t sent=sender.get_n_sent()-sent_begin;
+    const uint64_t received=n_received-received_begin;
+    const uint64_t received_bytes=n_received_bytes-received_bytes_begin;
+    const uint64_t callbacks=n_callbacks-callbacks_begin;
+    const auto cpu=get_cpu_time(rx_clock)-cpu_begin;
+    const double elapsed_s=std::chrono::duration<double>(std::chrono::steady_clock::now()-begin).count();
+    sender.stop();
+    receiver.stopReceiving();
+    result.sent_pps=sent/elapsed_s;
+    result.received_pps=received/elapsed_s;
+    // packets in flight at the window borders make this slightly imprecise
+    result.loss_perc=sent>received ? 100.0*(sent-received)/sent : 0;
+    result.packets_per_callback=callbacks>0 ? (double)received/callbacks : 0;
+    result.received_mbit=received_bytes*8/1000.0/1000.0/elapsed_s;
+    const double cpu_us=std::chrono::duration_cast<std::chrono::microseconds>(cpu).count();
+    result.rx_cpu_perc=cpu_us/1000.0/1000.0/elapsed_s*100;
+    result.rx_cpu_us_per_mbit=received_bytes>0 ? cpu_us/(received_bytes*8/1000.0/1000.0) : 0;
+    return result;
+}
+
+int main(int argc,char* argv[]){
+    Options options{};
+    if(!parse_options(argc,argv,options)){
+        print_usage();
+        return 1;
+    }
+    std::cout<<"packet size:"<<options.packet_size<<" rate:"<<(options.rate_mbit>0 ? std::to_string((int)options.rate_mbit)+"MBit/s" : "max")
+             <<" burst:"<<options.burst<<" work:"<<options.work_us<<"us cpus:"<<std::thread::hardware_concurrency()<<"\n";
+    std::cout<<std::left<<std::setw(16)<<"mode"<<std::right<<std::setw(12)<<"sent pps"<<std::setw(12)<<"recv pps"<<std::setw(10)<<"MBit/s"
+             <<std::setw(8)<<"loss%"<<std::setw(12)<<"pkts/call"<<std::setw(10)<<"rx cpu%"<<std::setw(12)<<"us/MBit"<<"\n";
+    std::cout<<std::fixed<<std::setprecision(1);
+    auto print=[](const std::string& mode,const Result& result){
+        std::cout<<std::left<<std::setw(16)<<mode<<std::right<<std::setw(12)<<result.sent_pps<<std::setw(12)<<result.received_pps
+                 <<std::setw(10)<<result.received_mbit<<std::setw(8)<<result.loss_perc<<std::setw(12)<<result.packets_per_callback
+                 <<std::setw(10)<<result.rx_cpu_perc<<std::setw(12)<<result.rx_cpu_us_per_mbit<<"\n";
+    };
+    for(const int batch_size:options.batch_sizes){
+        const std::string mode=batch_size<=1 ? "recvfrom" : "recvmmsg "+std::to_string(batch_size);
+        print(mode,run(options,batch_size,false));
+        if(options.gro && batch_size>1){
+            print(mode+"+gro",run(options,batch_size,true));
+        }
+    }
+    return 0;
+}
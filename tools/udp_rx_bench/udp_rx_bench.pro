@@ -0,0 +1,22 @@
+# Loopback benchmark of the UDP video ingest (UDPReceiver): legacy recvfrom() loop vs. recvmmsg() with different batch sizes
+# (and optionally UDP_GRO). Reports received packets/s, loss and the CPU time of the receive thread per MBit.
+# qmake tools/udp_rx_bench/udp_rx_bench.pro && make
+# ./udp_rx_bench --help
+TEMPLATE = app
+TARGET = udp_rx_bench
+CONFIG += c++17 console
+CONFIG -= app_bundle
+QT = core
+
+INCLUDEPATH += $$PWD/../..
+INCLUDEPATH += $$PWD/../../app
+INCLUDEPATH += $$PWD/../../app/videostreaming/vscommon
+
+SOURCES += \
+    $$PWD/main.cpp \
+    $$PWD/../../app/videostreaming/vscommon/udp/UDPReceiver.cpp \
+
+HEADERS += \
+    $$PWD/../../app/videostreaming/vscommon/udp/UDPReceiver.h \
+
+LIBS += -lpthread
@@ -0,0 +1,206 @@
+// Benchmark of the CPU YUV to RGB conversion used for the Qt Software scene graph backend (no OpenGL).
+// Reports megapixels per second for each kernel this cpu supports (row kernels and the whole frame incl. scaling / rotation),
+// and checks that each SIMD kernel gives the exact same output as the scalar one.
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "cpu/yuv_to_rgb.h"
+
+using namespace yuv_to_rgb;
+
+struct TestFrame{
+    int width;
+    int height;
+    std::vector<uint8_t> y;
+    std::vector<uint8_t> u;
+    std::vector<uint8_t> v;
+    std::vector<uint8_t> uv;
+    SrcFrame get(SrcFrame::Format format)const{
+        SrcFrame ret;
+        ret.format=format;
+        ret.width=width;
+        ret.height=height;
+        ret.data[0]=y.data();
+        ret.linesize[0]=width;
+        if(format==SrcFrame::Format::NV12){
+            ret.data[1]=uv.data();
+            ret.linesize[1]=((width+1)/2)*2;
+        }else{
+            ret.data[1]=u.data();
+            ret.data[2]=v.data();
+            ret.linesize[1]=(width+1)/2;
+            ret.linesize[2]=(width+1)/2;
+        }
+        return ret;
+    }
+};
+
+static TestFrame create_test_frame(int width,int height,uint32_t seed){
+    TestFrame ret;
+    ret.width=width;
+    ret.height=height;
+    const int chroma_w=(width+1)/2;
+    const int chroma_h=(height+1)/2;
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> dist(0,255);
+    ret.y.resize((size_t)width*height);
+    ret.u.resize((size_t)chroma_w*chroma_h);
+    ret.v.resize(ret.u.size());
+    ret.uv.resize(ret.u.size()*2);
+    for(auto& value:ret.y)value=dist(rng);
+    for(size_t i=0;i<ret.u.size();i++){
+        ret.u[i]=dist(rng);
+        ret.v[i]=dist(rng);
+        ret.uv[i*2]=ret.u[i];
+        ret.uv[i*2+1]=ret.v[i];
+    }
+    return ret;
+}
+
+struct Image{
+    int width;
+    int height;
+    std::vector<uint8_t> data;
+    Image(int w,int h):width(w),height(h),data((size_t)w*h*4){}
+    DstImage get(){
+        DstImage ret;
+        ret.data=data.data();
+        ret.stride=width*4;
+        ret.width=width;
+        ret.height=height;
+        return ret;
+    }
+};
+
+// Every kernel must give the exact same result as the scalar one, for all widths (tail handling)
+static bool check_kernels(){
+    bool ok=true;
+    for(const auto kernel:get_supported_kernels()){
+        for(int width=1;width<=200;width++){
+            for(const auto format:{SrcFrame::Format::I420,SrcFrame::Format::NV12}){
+                const auto frame=create_test_frame(width,4,width);
+                const auto src=frame.get(format);
+                Image expected(width,4);
+                Image actual(width,4);
+                Converter(Kernel::SCALAR).convert(src,expected.get(),false);
+                Converter(kernel).convert(src,actual.get(),false);
+                if(expected.data!=actual.data){
+                    std::cout<<"Mismatch "<<kernel_to_string(kernel)<<" width:"<<width<<" "<<(format==SrcFrame::Format::NV12 ? "NV12" : "I420")<<"\n";
+                    ok=false;
+                }
+            }
+        }
+    }
+    // Full range of values (BT.601 limited range -> clamped)
+    Image expected(256,1);
+    Image actual(256,1);
+    std::vector<uint8_t> y(256),u(128),v(128);
+    for(int uv_value=0;uv_value<256;uv_value++){
+        for(int i=0;i<256;i++)y[i]=i;
+        std::fill(u.begin(),u.end(),uv_value);
+        std::fill(v.begin(),v.end(),255-uv_value);
+        for(const auto kernel:get_supported_kernels()){
+            get_i420_row_fn(Kernel::SCALAR)(y.data(),u.data(),v.data(),expected.data.data(),256);
+            get_i420_row_fn(kernel)(y.data(),u.data(),v.data(),actual.data.data(),256);
+            if(expected.data!=actual.data){
+                std::cout<<"Mismatch "<<kernel_to_string(kernel)<<" u:"<<uv_value<<"\n";
+                ok=false;
+            }
+        }
+    }
+    return ok;
+}
+
+template<class F>
+static double measure_mpixels_per_second(const F& f,int64_t n_pixels_per_run,int n_runs){
+    f();
+    const auto begin=std::chrono::steady_clock::now();
+    for(int i=0;i<n_runs;i++){
+        f();
+    }
+    const auto elapsed=std::chrono::duration<double>(std::chrono::steady_clock::now()-begin).count();
+    return (double)n_pixels_per_run*n_runs/elapsed/1000.0/1000.0;
+}
+
+int main(int argc,char* argv[]){
+    int width=1920;
+    int height=1080;
+    int n_runs=100;
+    for(int i=1;i+1<argc;i+=2){
+        const std::string arg=argv[i];
+        if(arg=="--width")width=std::atoi(argv[i+1]);
+        else if(arg=="--height")height=std::atoi(argv[i+1]);
+        else if(arg=="--runs")n_runs=std::atoi(argv[i+1]);
+    }
+    if(!check_kernels()){
+        std::cout<<"Kernel output differs from the scalar reference\n";
+        return 1;
+    }
+    std::cout<<"All kernels match the scalar reference\n";
+    const auto frame=create_test_frame(width,height,0);
+    std::cout<<"Source "<<width<<"x"<<height<<", "<<n_runs<<" runs, Mpixel/s (of the output)\n";
+    struct Case{
+        std::string name;
+        int dst_width;
+        int dst_height;
+        bool rotate_90;
+    };
+    const std::vector<Case> cases{
+        {"1:1",width,height,false},
+        {"down 2/3",width*2/3,height*2/3,false},
+        {"up 4/3",width*4/3,height*4/3,false},
+        {"rotate 90",height,width,true},
+    };
+    std::cout<<std::left<<std::setw(8)<<"kernel"<<std::setw(12)<<"row I420"<<std::setw(12)<<"row NV12";
+    for(const auto& c:cases){
+        std::cout<<std::setw(16)<<c.name;
+    }
+    std::cout<<"\n";
+    for(const auto kernel:get_supported_kernels()){
+        std::cout<<std::left<<std::setw(8)<<kernel_to_string(kernel)<<std::fixed<<std::setprecision(0);
+        Image row_dst(width,1);
+        {
+            const auto fn=get_i420_row_fn(kernel);
+            const auto src=frame.get(SrcFrame::Format::I420);
+            std::cout<<std::setw(12)<<measure_mpixels_per_second([&]{
+                for(int y=0;y<height;y++){
+                    fn(src.data[0]+(size_t)y*src.linesize[0],src.data[1]+(size_t)(y/2)*src.linesize[1],src.data[2]+(size_t)(y/2)*src.linesize[2],row_dst.data.data(),width);
+                }
+            },(int64_t)width*height,n_runs);
+        }
+        {
+            const auto fn=get_nv12_row_fn(kernel);
+            const auto src=frame.get(SrcFrame::Format::NV12);
+            std::cout<<std::setw(12)<<measure_mpixels_per_second([&]{
+                for(int y=0;y<height;y++){
+                    fn(src.data[0]+(size_t)y*src.linesize[0],src.data[1]+(size_t)(y/2)*src.linesize[1],row_dst.data.data(),width);
+                }
+            },(int64_t)width*height,n_runs);
+        }
+        for(const auto& c:cases){
+            Image dst(c.dst_width,c.dst_height);
+            auto dst_image=dst.get();
+            Converter converter(kernel);
+            std::stringstream ss;
+            for(const auto format:{SrcFrame::Format::I420,SrcFrame::Format::NV12}){
+                const auto src=frame.get(format);
+                ss<<std::fixed<<std::setprecision(0)<<measure_mpixels_per_second([&]{
+                    converter.convert(src,dst_image,c.rotate_90);
+                },(int64_t)c.dst_width*c.dst_height,n_runs);
+                if(format==SrcFrame::Format::I420)ss<<"/";
+            }
+            std::cout<<std::setw(16)<<ss.str();
+        }
+        std::cout<<"\n";
+    }
+    std::cout<<"(frame columns: I420/NV12)\n";
+    return 0;
+}
@@ -0,0 +1,16 @@
+# Benchmark (Mpixel/s per kernel) and check of the SIMD YUV to RGB conversion used without OpenGL (Qt Software backend).
+# qmake tools/yuv_bench/yuv_bench.pro && make
+# ./yuv_bench [--width 1920] [--height 1080] [--runs 100]
+TEMPLATE = app
+TARGET = yuv_bench
+CONFIG += c++17 console
+CONFIG -= app_bundle qt
+
+INCLUDEPATH += $$PWD/../../app/videostreaming/avcodec
+
+SOURCES += \
+    $$PWD/main.cpp \
+    $$PWD/../../app/videostreaming/avcodec/cpu/yuv_to_rgb.cpp \
+
+HEADERS += \
+    $$PWD/../../app/videostreaming/avcodec/cpu/yuv_to_rgb.h \